@@ -34,3 +34,8 @@ DEFINE_int32(assign_level, 2, "assign level: {0, 1, 2, 3}");
 DEFINE_int32(check_assign_interval, 5000, "check assign interval");
 DEFINE_int32(kill_timeout, 120, "kill appworker timeout");
 
+DEFINE_double(report_usage_change_ratio, 0.1, "usage drifting less than this ratio is not reported in incremental query");
+DEFINE_int32(report_max_removed, 1024, "max removed containers remembered for incremental query");
+
+DEFINE_int32(metrix_collect_cycle, 5, "seconds between two metrix samples kept in agent");
+DEFINE_int32(metrix_retention, 3600, "seconds of metrix samples kept in agent");
@@ -11,6 +11,7 @@
 #include "util/path_tree.h"
 #include "utils/event_log.h"
 
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <stdlib.h>
@@ -26,6 +27,8 @@ DECLARE_string(agent_port);
 DECLARE_string(agent_hostname);
 DECLARE_int32(keepalive_interval);
 DECLARE_string(galaxy_root_path);
+DECLARE_int32(metrix_collect_cycle);
+DECLARE_int32(metrix_retention);
 
 namespace baidu {
 namespace galaxy {
@@ -40,7 +43,10 @@ AgentImpl::AgentImpl() :
     rm_(new baidu::galaxy::resource::ResourceManager),
     cm_(new baidu::galaxy::container::ContainerManager(rm_)),
     health_checker_(new baidu::galaxy::health::HealthChecker()),
-    start_time_(baidu::common::timer::get_micros())
+    metrix_store_(new baidu::galaxy::collector::MetrixStore(
+                FLAGS_metrix_retention / std::max(FLAGS_metrix_collect_cycle, 1))),
+    start_time_(baidu::common::timer::get_micros()),
+    report_tracker_(start_time_)
 {
     version_ = "0.0.1";
     //version_ = __DATE__ + __TIME__;
@@ -86,6 +92,10 @@ void AgentImpl::Setup()
     baidu::galaxy::container::ContainerStatus::Setup();
     cm_->Setup();
 
+    metrix_collector_.reset(new baidu::galaxy::container::MetrixCollector(cm_, metrix_store_));
+    metrix_collector_->Enable(true);
+    baidu::galaxy::collector::CollectorEngine::GetInstance()->Register(metrix_collector_, true);
+
     health_checker_->LoadVolum(rm_);
     health_checker_->LoadCgroup(baidu::galaxy::cgroup::SubsystemFactory::GetInstance());
     health_checker_->Setup();
@@ -131,21 +141,110 @@ void AgentImpl::CreateContainer(::google::protobuf::RpcController* controller,
         ::baidu::galaxy::proto::CreateContainerResponse* response,
         ::google::protobuf::Closure* done)
 {
-    LOG(INFO) << "recv create container request: " << request->DebugString();
+    {
+        boost::mutex::scoped_lock lock(command_mutex_);
+        DoCreateContainer(*request, response->mutable_code());
+    }
+    done->Run();
+}
+
+void AgentImpl::RemoveContainer(::google::protobuf::RpcController* controller,
+        const ::baidu::galaxy::proto::RemoveContainerRequest* request,
+        ::baidu::galaxy::proto::RemoveContainerResponse* response,
+        ::google::protobuf::Closure* done)
+{
+    {
+        boost::mutex::scoped_lock lock(command_mutex_);
+        DoRemoveContainer(*request, response->mutable_code());
+    }
+    done->Run();
+}
+
+void AgentImpl::BatchCommand(::google::protobuf::RpcController* controller,
+        const ::baidu::galaxy::proto::BatchCommandRequest* request,
+        ::baidu::galaxy::proto::BatchCommandResponse* response,
+        ::google::protobuf::Closure* done)
+{
+    LOG(INFO) << "recv batch command request, size: " << request->commands_size();
+    {
+        // commands of one batch are applied in order, never interleaved
+        // with other batches or single create/remove requests
+        boost::mutex::scoped_lock lock(command_mutex_);
+
+        for (int i = 0; i < request->commands_size(); i++) {
+            const baidu::galaxy::proto::ContainerCommand& cmd = request->commands(i);
+            baidu::galaxy::proto::ErrorCode* ec = response->add_results();
+
+            if (cmd.has_create()) {
+                DoCreateContainer(cmd.create(), ec);
+            } else if (cmd.has_remove()) {
+                DoRemoveContainer(cmd.remove(), ec);
+            } else {
+                ec->set_status(baidu::galaxy::proto::kError);
+                ec->set_reason("empty command");
+            }
+        }
+    }
+    response->mutable_code()->set_status(baidu::galaxy::proto::kOk);
+    done->Run();
+}
+
+void AgentImpl::Reserve(::google::protobuf::RpcController* controller,
+        const ::baidu::galaxy::proto::ReserveRequest* request,
+        ::baidu::galaxy::proto::ReserveResponse* response,
+        ::google::protobuf::Closure* done)
+{
+    LOG(INFO) << "recv reserve request, size: " << request->containers_size();
+    {
+        boost::mutex::scoped_lock lock(command_mutex_);
+
+        for (int i = 0; i < request->containers_size(); i++) {
+            const baidu::galaxy::proto::CreateContainerRequest& req = request->containers(i);
+            baidu::galaxy::proto::ErrorCode* ec = response->add_results();
+            baidu::galaxy::container::ContainerId id(req.container_group_id(), req.id());
+
+            // the create came first and claimed the reservation, if any
+            if (cm_->HasContainer(id)) {
+                LOG(INFO) << "container " << id.CompactId() << " exists, nothing to reserve";
+                ec->set_status(baidu::galaxy::proto::kOk);
+                continue;
+            }
+
+            baidu::galaxy::util::ErrorCode err = rm_->Reserve(id.CompactId(),
+                    req.container(),
+                    request->lease_time());
+
+            if (0 != err.Code()) {
+                LOG(WARNING) << "reserve resource for " << id.CompactId()
+                             << " failed: " << err.Message();
+                ec->set_status(baidu::galaxy::proto::kError);
+                ec->set_reason(err.ShortMessage());
+            } else {
+                ec->set_status(baidu::galaxy::proto::kOk);
+            }
+        }
+    }
+    response->mutable_code()->set_status(baidu::galaxy::proto::kOk);
+    done->Run();
+}
+
+void AgentImpl::DoCreateContainer(const baidu::galaxy::proto::CreateContainerRequest& request,
+        baidu::galaxy::proto::ErrorCode* ec)
+{
+    LOG(INFO) << "recv create container request: " << request.DebugString();
     int64_t x = baidu::common::timer::get_micros();
-    std::cerr << x << "create " << request->id() << std::endl;
+    std::cerr << x << "create " << request.id() << std::endl;
 
-    baidu::galaxy::container::ContainerId id(request->container_group_id(), request->id());
-    baidu::galaxy::proto::ErrorCode* ec = response->mutable_code();
+    baidu::galaxy::container::ContainerId id(request.container_group_id(), request.id());
 
-    baidu::galaxy::util::ErrorCode err = cm_->CreateContainer(id, request->container());
+    baidu::galaxy::util::ErrorCode err = cm_->CreateContainer(id, request.container());
     if (0 != err.Code()) {
         ec->set_status(baidu::galaxy::proto::kError);
         ec->set_reason(err.ShortMessage());
         baidu::galaxy::EventLog ev("container");
         LOG(ERROR) << ev.AppendTime("time")
-            .Append("container-id", request->id())
-            .Append("container-group-id", request->container_group_id())
+            .Append("container-id", request.id())
+            .Append("container-group-id", request.container_group_id())
             .Append("hostname", FLAGS_agent_hostname)
             .Append("endpoint", agent_endpoint_)
             .Append("action", "create")
@@ -156,27 +255,21 @@ void AgentImpl::CreateContainer(::google::protobuf::RpcController* controller,
         ec->set_reason("sucess");
         baidu::galaxy::EventLog ev("container");
         LOG(ERROR) << ev.AppendTime("time")
-            .Append("container-id", request->id())
-            .Append("container-group-id", request->container_group_id())
+            .Append("container-id", request.id())
+            .Append("container-group-id", request.container_group_id())
             .Append("hostname", FLAGS_agent_hostname)
             .Append("endpoint", agent_endpoint_)
             .Append("action", "create")
             .Append("status", "kOk").ToString();
     }
-
-    done->Run();
 }
 
-void AgentImpl::RemoveContainer(::google::protobuf::RpcController* controller,
-        const ::baidu::galaxy::proto::RemoveContainerRequest* request,
-        ::baidu::galaxy::proto::RemoveContainerResponse* response,
-        ::google::protobuf::Closure* done)
+void AgentImpl::DoRemoveContainer(const baidu::galaxy::proto::RemoveContainerRequest& request,
+        baidu::galaxy::proto::ErrorCode* ec)
 {
-
-    LOG(INFO) << "recv remove container request: " << request->DebugString();
-    std::cerr << "recv remove container request: " << request->DebugString() << std::endl;
-    baidu::galaxy::container::ContainerId id(request->container_group_id(), request->id());
-    baidu::galaxy::proto::ErrorCode* ec = response->mutable_code();
+    LOG(INFO) << "recv remove container request: " << request.DebugString();
+    std::cerr << "recv remove container request: " << request.DebugString() << std::endl;
+    baidu::galaxy::container::ContainerId id(request.container_group_id(), request.id());
     baidu::galaxy::util::ErrorCode ret = cm_->ReleaseContainer(id);
 
     if (0 != ret.Code()) {
@@ -184,8 +277,8 @@ void AgentImpl::RemoveContainer(::google::protobuf::RpcController* controller,
         ec->set_reason(ret.ShortMessage());
         baidu::galaxy::EventLog ev("container");
         LOG(ERROR) << ev.AppendTime("time")
-            .Append("container-id", request->id())
-            .Append("container-group-id", request->container_group_id())
+            .Append("container-id", request.id())
+            .Append("container-group-id", request.container_group_id())
             .Append("hostname", FLAGS_agent_hostname)
             .Append("endpoint", agent_endpoint_)
             .Append("action", "remove")
@@ -198,16 +291,15 @@ void AgentImpl::RemoveContainer(::google::protobuf::RpcController* controller,
 
         baidu::galaxy::EventLog ev("container");
         LOG(ERROR) << ev.AppendTime("time")
-            .Append("container-id", request->id())
-            .Append("container-group-id", request->container_group_id())
+            .Append("container-id", request.id())
+            .Append("container-group-id", request.container_group_id())
             .Append("hostname", FLAGS_agent_hostname)
             .Append("endpoint", agent_endpoint_)
             .Append("action", "remove")
             .Append("status", "kOk")
-            .Append("detail", request->DebugString()).ToString();
+            .Append("detail", request.DebugString()).ToString();
 
     }
-    done->Run();
 }
 
 void AgentImpl::ListContainers(::google::protobuf::RpcController* controller,
@@ -223,7 +315,7 @@ void AgentImpl::Query(::google::protobuf::RpcController* controller,
         ::google::protobuf::Closure* done)
 {
 
-    std::cerr << "query " << std::endl;
+    rm_->ExpireLeases();
 
     baidu::galaxy::proto::AgentInfo* ai = response->mutable_agent_info();
     ai->set_unhealthy(!health_checker_->Healthy());
@@ -237,9 +329,16 @@ void AgentImpl::Query(::google::protobuf::RpcController* controller,
     std::vector<boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> > cis;
     cm_->ListContainers(cis, full_report);
 
-    for (size_t i = 0; i < cis.size(); i++) {
-        ai->add_container_info()->CopyFrom(*(cis[i]));
-    }
+    // only the reported container infos are incremental, usage is summed
+    // over all containers first; the infos are then moved into the response
+    // instead of copied, changed ones only for an incremental report
+    int64_t seq = 0L;
+    std::vector<boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> > changed;
+    std::vector<std::string> removed;
+    bool incremental = report_tracker_.Diff(cis, request->since_seq(), &seq, changed, removed);
+    incremental = incremental && !full_report && request->has_since_seq();
+    response->set_seq(seq);
+    response->set_incremental(incremental);
 
     int64_t cpu_used = 0L;
     int64_t memory_used = 0L;
@@ -269,6 +368,20 @@ void AgentImpl::Query(::google::protobuf::RpcController* controller,
         }
     }
 
+    if (incremental) {
+        for (size_t i = 0; i < changed.size(); i++) {
+            ai->add_container_info()->Swap(changed[i].get());
+        }
+
+        for (size_t i = 0; i < removed.size(); i++) {
+            response->add_removed_containers(removed[i]);
+        }
+    } else {
+        for (size_t i = 0; i < cis.size(); i++) {
+            ai->add_container_info()->Swap(cis[i].get());
+        }
+    }
+
     baidu::galaxy::proto::Resource* cpu_resource = ai->mutable_cpu_resource();
     cpu_resource->CopyFrom(*(rm_->GetCpuResource()));
     cpu_resource->set_used(cpu_used);
@@ -297,11 +410,61 @@ void AgentImpl::Query(::google::protobuf::RpcController* controller,
 
     baidu::galaxy::proto::ErrorCode* ec = response->mutable_code();
     ec->set_status(baidu::galaxy::proto::kOk);
-    std::cerr << response->DebugString() << std::endl;
     VLOG(10) << "query:" << response->DebugString();
     //std::cout << "query:" << response->DebugString() << std::endl;
     done->Run();
 }
 
+void AgentImpl::QueryMetrix(::google::protobuf::RpcController* controller,
+        const ::baidu::galaxy::proto::QueryMetrixRequest* request,
+        ::baidu::galaxy::proto::QueryMetrixResponse* response,
+        ::google::protobuf::Closure* done)
+{
+    int64_t start = request->has_start_time() ? request->start_time() : 0L;
+    int64_t end = request->has_end_time() ? request->end_time() : baidu::common::timer::get_micros() + 1;
+    std::vector<baidu::galaxy::collector::MetrixSample> samples;
+
+    if (!metrix_store_->Range(request->container_id(), start, end, samples)) {
+        response->mutable_code()->set_status(baidu::galaxy::proto::kError);
+        response->mutable_code()->set_reason("no metrix of container " + request->container_id());
+        done->Run();
+        return;
+    }
+
+    if (request->interval() > 0) {
+        std::vector<baidu::galaxy::collector::MetrixSample> aggregates;
+        baidu::galaxy::collector::MetrixStore::Aggregate(samples, start, request->interval(), aggregates);
+        samples.swap(aggregates);
+    }
+
+    for (size_t i = 0; i < samples.size(); i++) {
+        baidu::galaxy::proto::ContainerMetrix* cm = response->add_metrix();
+        cm->set_time(samples[i].time);
+        cm->set_cpu_used_in_millicore(samples[i].cpu_used_in_millicore);
+        cm->set_memory_used_in_byte(samples[i].memory_used_in_byte);
+        cm->set_volum_used_in_byte(samples[i].volum_used_in_byte);
+        cm->set_read_bps(samples[i].read_bps);
+        cm->set_write_bps(samples[i].write_bps);
+        cm->set_read_iops(samples[i].read_iops);
+        cm->set_write_iops(samples[i].write_iops);
+
+        if (request->container_id().empty()) {
+            cm->set_net_in_bps(samples[i].net_in_bps);
+            cm->set_net_out_bps(samples[i].net_out_bps);
+            cm->set_net_in_pps(samples[i].net_in_pps);
+            cm->set_net_out_pps(samples[i].net_out_pps);
+        }
+
+        if (request->interval() > 0) {
+            cm->set_cpu_max_in_millicore(samples[i].cpu_max_in_millicore);
+            cm->set_memory_max_in_byte(samples[i].memory_max_in_byte);
+            cm->set_sample_count(samples[i].sample_count);
+        }
+    }
+
+    response->mutable_code()->set_status(baidu::galaxy::proto::kOk);
+    done->Run();
+}
+
 }
 }
@@ -16,6 +16,9 @@
 #include "resource/resource_manager.h"
 #include "container/container.h"
 #include "container/container_manager.h"
+#include "container/report_tracker.h"
+#include "container/metrix_collector.h"
+#include "collector/metrix_store.h"
 #include "health/healthy_checker.h"
 
 namespace baidu {
@@ -43,6 +46,16 @@ public:
             ::baidu::galaxy::proto::RemoveContainerResponse* response,
             ::google::protobuf::Closure* done);
 
+    void BatchCommand(::google::protobuf::RpcController* controller,
+            const ::baidu::galaxy::proto::BatchCommandRequest* request,
+            ::baidu::galaxy::proto::BatchCommandResponse* response,
+            ::google::protobuf::Closure* done);
+
+    void Reserve(::google::protobuf::RpcController* controller,
+            const ::baidu::galaxy::proto::ReserveRequest* request,
+            ::baidu::galaxy::proto::ReserveResponse* response,
+            ::google::protobuf::Closure* done);
+
     void ListContainers(::google::protobuf::RpcController* controller,
             const ::baidu::galaxy::proto::ListContainersRequest* request,
             ::baidu::galaxy::proto::ListContainersResponse* response,
@@ -53,9 +66,18 @@ public:
             ::baidu::galaxy::proto::QueryResponse* response,
             ::google::protobuf::Closure* done);
 
+    void QueryMetrix(::google::protobuf::RpcController* controller,
+            const ::baidu::galaxy::proto::QueryMetrixRequest* request,
+            ::baidu::galaxy::proto::QueryMetrixResponse* response,
+            ::google::protobuf::Closure* done);
+
 private:
     void KeepAlive(int internal_ms);
     void HandleMasterChange(const std::string& new_master_endpoint);
+    void DoCreateContainer(const baidu::galaxy::proto::CreateContainerRequest& request,
+            baidu::galaxy::proto::ErrorCode* ec);
+    void DoRemoveContainer(const baidu::galaxy::proto::RemoveContainerRequest& request,
+            baidu::galaxy::proto::ErrorCode* ec);
 
 private:
     baidu::common::ThreadPool heartbeat_pool_;
@@ -66,12 +88,16 @@ private:
     const std::string agent_endpoint_;
     bool running_;
     boost::mutex rpc_mutex_;
+    boost::mutex command_mutex_;
 
     boost::shared_ptr<baidu::galaxy::resource::ResourceManager> rm_;
     boost::shared_ptr<baidu::galaxy::container::ContainerManager> cm_;
     boost::shared_ptr<baidu::galaxy::health::HealthChecker> health_checker_;
+    boost::shared_ptr<baidu::galaxy::collector::MetrixStore> metrix_store_;
+    boost::shared_ptr<baidu::galaxy::container::MetrixCollector> metrix_collector_;
     int64_t start_time_;
     std::string version_;
+    baidu::galaxy::container::ReportTracker report_tracker_;
 
 };
 
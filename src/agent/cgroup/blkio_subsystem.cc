@@ -2,17 +2,29 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 #include "blkio_subsystem.h"
+#include "control_file.h"
 #include "protocol/galaxy.pb.h"
+#include "protocol/agent.pb.h"
 
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
 #include <boost/system/error_code.hpp>
+#include <gflags/gflags.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <unistd.h>
-#include <linux/kdev_t.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+
+#include <set>
+#include <sstream>
+
+DECLARE_string(galaxy_root_path);
 
 namespace baidu {
 namespace galaxy {
@@ -52,6 +64,88 @@ baidu::galaxy::util::ErrorCode BlkioSubsystem::Construct() {
                 err.Message().c_str());
     }
 
+    err = Limit(path.string());
+
+    if (0 != err.Code()) {
+        return ERRORCODE(-1, "limit io failed: %s",
+                err.Message().c_str());
+    }
+
+    return ERRORCODE_OK;
+}
+
+baidu::galaxy::util::ErrorCode BlkioSubsystem::Limit(const std::string& path) {
+    const baidu::galaxy::proto::BlkioRequired& blkio = cgroup_->blkio();
+    const char* files[] = {
+        "blkio.throttle.read_bps_device",
+        "blkio.throttle.write_bps_device",
+        "blkio.throttle.read_iops_device",
+        "blkio.throttle.write_iops_device"
+    };
+    int64_t limits[] = {
+        blkio.read_bps_limit(),
+        blkio.write_bps_limit(),
+        blkio.read_iops_limit(),
+        blkio.write_iops_limit()
+    };
+
+    bool limited = false;
+
+    for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+        limited = limited || limits[i] > 0;
+    }
+
+    if (!limited) {
+        return ERRORCODE_OK;
+    }
+
+    std::vector<std::string> paths = io_paths_;
+
+    if (paths.empty()) {
+        paths.push_back(FLAGS_galaxy_root_path);
+    }
+
+    // volums on one disk share its limits
+    std::set<std::string> devices;
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        int major = 0;
+        int minor = 0;
+        baidu::galaxy::util::ErrorCode err = GetDeviceNum(paths[i], major, minor);
+
+        if (0 != err.Code()) {
+            return ERRORCODE(-1, "get device of %s failed: %s",
+                    paths[i].c_str(),
+                    err.Message().c_str());
+        }
+
+        std::stringstream ss;
+        ss << major << ":" << minor;
+        devices.insert(ss.str());
+    }
+
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        if (limits[i] <= 0) {
+            continue;
+        }
+
+        // a write of a throttle file sets the limit of one device
+        std::set<std::string>::iterator iter = devices.begin();
+
+        for (; iter != devices.end(); iter++) {
+            std::stringstream value;
+            value << *iter << " " << limits[i];
+            baidu::galaxy::util::ErrorCode err = baidu::galaxy::cgroup::Attach(path + "/" + files[i], value.str());
+
+            if (0 != err.Code()) {
+                return ERRORCODE(-1, "attch %s of %s failed: %s",
+                        files[i],
+                        iter->c_str(),
+                        err.Message().c_str());
+            }
+        }
+    }
+
     return ERRORCODE_OK;
 }
 
@@ -60,7 +154,69 @@ boost::shared_ptr<Subsystem> BlkioSubsystem::Clone() {
     return ret;
 }
 
-baidu::galaxy::util::ErrorCode BlkioSubsystem::Collect(std::map<std::string, AutoValue>& stat) {
+baidu::galaxy::util::ErrorCode BlkioSubsystem::Collect(boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix) {
+    return Statistics(Path(), metrix);
+}
+
+baidu::galaxy::util::ErrorCode BlkioSubsystem::Statistics(const std::string& path,
+        boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix) {
+    assert(NULL != metrix.get());
+    // the throttle statistics are kept whether io is limited or not
+    std::map<std::string, std::pair<int64_t, int64_t> > bytes;
+    baidu::galaxy::util::ErrorCode ec = ReadIoStat(path + "/blkio.throttle.io_service_bytes", bytes);
+
+    if (0 != ec.Code()) {
+        return ec;
+    }
+
+    std::map<std::string, std::pair<int64_t, int64_t> > ios;
+    ec = ReadIoStat(path + "/blkio.throttle.io_serviced", ios);
+
+    if (0 != ec.Code()) {
+        return ec;
+    }
+
+    metrix->clear_blkio();
+    std::map<std::string, std::pair<int64_t, int64_t> >::iterator iter = bytes.begin();
+
+    for (; iter != bytes.end(); iter++) {
+        baidu::galaxy::proto::BlkioMetrix* bm = metrix->add_blkio();
+        bm->set_device(iter->first);
+        bm->set_read_bytes(iter->second.first);
+        bm->set_write_bytes(iter->second.second);
+        bm->set_read_ios(ios[iter->first].first);
+        bm->set_write_ios(ios[iter->first].second);
+    }
+
+    return ERRORCODE_OK;
+}
+
+// lines like "8:0 Read 4096", read and write of each device
+baidu::galaxy::util::ErrorCode BlkioSubsystem::ReadIoStat(const std::string& file,
+        std::map<std::string, std::pair<int64_t, int64_t> >& stat) {
+    std::vector<std::string> lines;
+    baidu::galaxy::util::ErrorCode ec = ControlFileCache::GetInstance()->ReadLines(file, lines);
+
+    if (0 != ec.Code()) {
+        return ERRORCODE(-1, "read failed: %s", ec.Message().c_str());
+    }
+
+    for (size_t i = 0; i < lines.size(); i++) {
+        char device[64];
+        char op[16];
+        long long value = 0;
+
+        if (3 != sscanf(lines[i].c_str(), "%63s %15s %lld", device, op, &value)) {
+            continue;
+        }
+
+        if (0 == strcmp(op, "Read")) {
+            stat[device].first = value;
+        } else if (0 == strcmp(op, "Write")) {
+            stat[device].second = value;
+        }
+    }
+
     return ERRORCODE_OK;
 }
 
@@ -68,11 +224,34 @@ baidu::galaxy::util::ErrorCode BlkioSubsystem::GetDeviceNum(const std::string& p
     struct stat st;
 
     if (0 != ::stat(path.c_str(), &st)) {
-        return PERRORCODE(-1, errno, "stat faile failed");
+        return PERRORCODE(-1, errno, "stat %s failed: %s", path.c_str(), strerror(errno));
+    }
+
+    major = major(st.st_dev);
+    minor = minor(st.st_dev);
+
+    // io of a partition is limited on its disk
+    std::stringstream ss;
+    ss << "/sys/dev/block/" << major << ":" << minor;
+    boost::system::error_code ec;
+    boost::filesystem::path dev = boost::filesystem::canonical(ss.str(), ec);
+
+    if (ec.value() == 0 && boost::filesystem::exists(dev / "partition", ec)) {
+        std::string disk = (dev.parent_path() / "dev").string();
+        FILE* file = fopen(disk.c_str(), "r");
+
+        if (NULL == file) {
+            return PERRORCODE(-1, errno, "open %s failed: %s", disk.c_str(), strerror(errno));
+        }
+
+        int n = fscanf(file, "%d:%d", &major, &minor);
+        fclose(file);
+
+        if (2 != n) {
+            return ERRORCODE(-1, "bad device number in %s", disk.c_str());
+        }
     }
 
-    major = MAJOR(st.st_dev);
-    minor = MINOR(st.st_dev);
     return ERRORCODE_OK;
 }
 
@@ -5,6 +5,9 @@
 #pragma once
 #include "subsystem.h"
 
+#include <string>
+#include <vector>
+
 namespace baidu {
 namespace galaxy {
 namespace cgroup {
@@ -16,10 +19,26 @@ public:
     std::string Name();
     baidu::galaxy::util::ErrorCode Construct();
     boost::shared_ptr<Subsystem> Clone();
-    baidu::galaxy::util::ErrorCode Collect(std::map<std::string, AutoValue>& stat);
+    baidu::galaxy::util::ErrorCode Collect(boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix);
+
+    // paths on the disks the container does io to, io is limited on each
+    // of these disks, on the disk of galaxy_root_path if there is none
+    void SetIoPaths(const std::vector<std::string>& paths) {
+        io_paths_ = paths;
+    }
+
+    // io of each disk from the throttle statistics in blkio dir path
+    static baidu::galaxy::util::ErrorCode Statistics(const std::string& path,
+            boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix);
 
 private:
-    baidu::galaxy::util::ErrorCode GetDeviceNum(const std::string& path, int& major, int& minor);
+    baidu::galaxy::util::ErrorCode Limit(const std::string& path);
+    // device number of the disk path is on, the disk of a partition
+    static baidu::galaxy::util::ErrorCode GetDeviceNum(const std::string& path, int& major, int& minor);
+    static baidu::galaxy::util::ErrorCode ReadIoStat(const std::string& file,
+            std::map<std::string, std::pair<int64_t, int64_t> >& stat);
+
+    std::vector<std::string> io_paths_;
 };
 }
 }
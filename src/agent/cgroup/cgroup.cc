@@ -6,11 +6,13 @@
 #include "subsystem_factory.h"
 #include "subsystem.h"
 #include "freezer_subsystem.h"
+#include "blkio_subsystem.h"
 #include "protocol/galaxy.pb.h"
 #include "protocol/agent.pb.h"
 #include "subsystem.h"
 #include "collector/collector_engine.h"
 #include "cgroup_collector.h"
+#include "control_file.h"
 #include <glog/logging.h>
 
 #include <unistd.h>
@@ -35,6 +37,10 @@ void Cgroup::SetDescrition(boost::shared_ptr<baidu::galaxy::proto::Cgroup> cgrou
     cgroup_ = cgroup;
 }
 
+void Cgroup::SetIoPaths(const std::vector<std::string>& paths) {
+    io_paths_ = paths;
+}
+
 baidu::galaxy::util::ErrorCode Cgroup::Construct() {
     assert(subsystem_.empty());
     std::vector<std::string> subsystems;
@@ -61,6 +67,13 @@ baidu::galaxy::util::ErrorCode Cgroup::Construct() {
                 cpu_acct_ = ss;
             } else if ("memory" == subsystems[i]) {
                 memory_ = ss;
+            } else if ("blkio" == subsystems[i]) {
+                blkio_ = ss;
+                boost::shared_ptr<BlkioSubsystem> blkio = boost::dynamic_pointer_cast<BlkioSubsystem>(ss);
+
+                if (NULL != blkio.get()) {
+                    blkio->SetIoPaths(io_paths_);
+                }
             }
 
             subsystem_.push_back(ss);
@@ -101,6 +114,9 @@ baidu::galaxy::util::ErrorCode Cgroup::Construct() {
     collector_.reset(new CgroupCollector());
     collector_->SetCpuacctPath(cpu_acct_->Path() + "/cpuacct.stat");
     collector_->SetMemoryPath(memory_->Path() + "/memory.usage_in_bytes");
+    if (NULL != blkio_.get()) {
+        collector_->SetBlkioPath(blkio_->Path());
+    }
     collector_->SetCycle(5);
     collector_->SetName(container_id_ + "_cgroup");
     collector_->Enable(true);
@@ -144,7 +160,9 @@ baidu::galaxy::util::ErrorCode Cgroup::Destroy() {
     }
 
     for (size_t i = 0; i < subsystem_.size(); i++) {
+        ControlFileCache::GetInstance()->Invalidate(subsystem_[i]->Path());
         baidu::galaxy::util::ErrorCode ec = subsystem_[i]->Destroy();
+        ControlFileCache::GetInstance()->Release(subsystem_[i]->Path());
 
         if (0 != ec.Code()) {
             return ERRORCODE(-1,
@@ -160,7 +178,9 @@ baidu::galaxy::util::ErrorCode Cgroup::Destroy() {
         freezer_->Freeze();
         freezer_->Kill();
         freezer_->Thaw();
+        ControlFileCache::GetInstance()->Invalidate(freezer_->Path());
         baidu::galaxy::util::ErrorCode ec = freezer_->Destroy();
+        ControlFileCache::GetInstance()->Release(freezer_->Path());
 
         if (0 != ec.Code()) {
             return ERRORCODE(-1, "failed in destroying freezer:",
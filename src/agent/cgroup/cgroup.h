@@ -11,6 +11,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 namespace baidu {
 namespace galaxy {
@@ -32,6 +33,8 @@ public:
     ~Cgroup();
     void SetContainerId(const std::string& container_id);
     void SetDescrition(boost::shared_ptr<baidu::galaxy::proto::Cgroup> cgroup);
+    // paths on the disks of the volums, where blkio limits go
+    void SetIoPaths(const std::vector<std::string>& paths);
 
     baidu::galaxy::util::ErrorCode Construct();
     baidu::galaxy::util::ErrorCode Destroy();
@@ -45,8 +48,10 @@ private:
     boost::shared_ptr<FreezerSubsystem> freezer_;
     boost::shared_ptr<Subsystem> cpu_acct_;
     boost::shared_ptr<Subsystem> memory_;
+    boost::shared_ptr<Subsystem> blkio_;
 
     std::string container_id_;
+    std::vector<std::string> io_paths_;
     boost::shared_ptr<baidu::galaxy::proto::Cgroup> cgroup_;
     const boost::shared_ptr<SubsystemFactory> factory_;
     boost::shared_ptr<CgroupCollector> collector_;
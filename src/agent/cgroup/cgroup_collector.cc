@@ -4,8 +4,9 @@
 
 #include "cgroup_collector.h"
 #include "protocol/agent.pb.h"
-#include "util/input_stream_file.h"
+#include "control_file.h"
 #include "cgroup.h"
+#include "blkio_subsystem.h"
 #include "timer.h"
 #include "boost/algorithm/string/predicate.hpp"
 #include <assert.h>
@@ -27,44 +28,65 @@ CgroupCollector::~CgroupCollector() {
 }
 
 baidu::galaxy::util::ErrorCode CgroupCollector::Collect() {
-    boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix1(new baidu::galaxy::proto::CgroupMetrix);
-    int64_t t1 = 0L;
-    baidu::galaxy::util::ErrorCode ec = Collect(metrix1);
+    int64_t now = baidu::common::timer::get_micros();
+    boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> sample(new baidu::galaxy::proto::CgroupMetrix);
+    baidu::galaxy::util::ErrorCode ec = Collect(sample);
 
-    if (ec.Code() == 0) {
-        t1 = baidu::common::timer::get_micros();
-    } else {
-        return ERRORCODE(-1, "%s", ec.Message().c_str());
-    }
-
-    ::usleep(1000000);
-    boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix2(new baidu::galaxy::proto::CgroupMetrix);
-    int64_t t2 = 0L;
-    ec = Collect(metrix2);
-
-    if (ec.Code() == 0) {
-        t2 = baidu::common::timer::get_micros();
-    } else {
+    if (ec.Code() != 0) {
         return ERRORCODE(-1, "%s", ec.Message().c_str());
     }
 
-    // cal cpu
+    // cal cpu from the previous cycle, nothing to compare with in the first one
     boost::mutex::scoped_lock lock(mutex_);
+    boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> last = last_sample_;
+    int64_t last_time = last_time_;
+    last_sample_ = sample;
     metrix_.reset(new baidu::galaxy::proto::CgroupMetrix());
-    last_time_ = baidu::common::timer::get_micros();
-    metrix_->set_memory_used_in_byte(metrix2->memory_used_in_byte());
+    last_time_ = now;
+    metrix_->set_memory_used_in_byte(sample->memory_used_in_byte());
 
-    if (metrix1->has_container_cpu_time() && metrix1->has_system_cpu_time()
-            && metrix2->has_container_cpu_time() && metrix2->has_system_cpu_time()) {
-        double delta1 = (double)(metrix2->container_cpu_time() - metrix1->container_cpu_time());
-        double delta2 = (double)(metrix2->system_cpu_time() - metrix1->system_cpu_time());
+    if (NULL != last.get()
+            && last->has_container_cpu_time() && last->has_system_cpu_time()
+            && sample->has_container_cpu_time() && sample->has_system_cpu_time()) {
+        double delta1 = (double)(sample->container_cpu_time() - last->container_cpu_time());
+        double delta2 = (double)(sample->system_cpu_time() - last->system_cpu_time());
 
+        // a negative delta1 means the cgroup is a new one, start over
         if (delta2 > 0.01 && delta1 > 0.01) {
             int64_t mcore = (int64_t)(1000.0 * delta1 / delta2 * CPU_CORES);
             metrix_->set_cpu_used_in_millicore(mcore);
         }
     }
 
+    for (int i = 0; i < sample->blkio_size(); i++) {
+        baidu::galaxy::proto::BlkioMetrix* bm = metrix_->add_blkio();
+        bm->CopyFrom(sample->blkio(i));
+
+        if (NULL == last.get() || now <= last_time) {
+            continue;
+        }
+
+        for (int j = 0; j < last->blkio_size(); j++) {
+            const baidu::galaxy::proto::BlkioMetrix& lbm = last->blkio(j);
+
+            // counters going back mean the cgroup is a new one
+            if (lbm.device() != bm->device()
+                    || bm->read_bytes() < lbm.read_bytes()
+                    || bm->write_bytes() < lbm.write_bytes()
+                    || bm->read_ios() < lbm.read_ios()
+                    || bm->write_ios() < lbm.write_ios()) {
+                continue;
+            }
+
+            double seconds = (now - last_time) / 1000000.0;
+            bm->set_read_bps((int64_t)((bm->read_bytes() - lbm.read_bytes()) / seconds));
+            bm->set_write_bps((int64_t)((bm->write_bytes() - lbm.write_bytes()) / seconds));
+            bm->set_read_iops((int64_t)((bm->read_ios() - lbm.read_ios()) / seconds));
+            bm->set_write_iops((int64_t)((bm->write_ios() - lbm.write_ios()) / seconds));
+            break;
+        }
+    }
+
     return ERRORCODE_OK;
 }
 
@@ -89,6 +111,11 @@ baidu::galaxy::util::ErrorCode CgroupCollector::Collect(boost::shared_ptr<baidu:
         return ERRORCODE(-1, ec.Message().c_str());
     }
 
+    // io is left out if the kernel keeps no throttle statistics
+    if (!blkio_path_.empty()) {
+        BlkioSubsystem::Statistics(blkio_path_, metrix);
+    }
+
     return ERRORCODE_OK;
 }
 
@@ -143,26 +170,20 @@ baidu::galaxy::util::ErrorCode CgroupCollector::ContainerCpuStat(boost::shared_p
         return ERRORCODE(-1, "empty path");
     }
 
-    baidu::galaxy::file::InputStreamFile in(cpuacct_path_);
+    std::vector<std::string> lines;
+    baidu::galaxy::util::ErrorCode ec = ControlFileCache::GetInstance()->ReadLines(cpuacct_path_, lines);
 
-    if (!in.IsOpen()) {
-        baidu::galaxy::util::ErrorCode ec = in.GetLastError();
-        return ERRORCODE(-1, "open %s failed: %s", cpuacct_path_.c_str(), ec.Message().c_str());
+    if (ec.Code() != 0) {
+        return ERRORCODE(-1, "read (%s) failed: %s",
+                cpuacct_path_.c_str(),
+                ec.Message().c_str());
     }
 
-    std::string line;
     bool has_data = false;
     int64_t cpu_time = 0;
 
-    while (!in.Eof()) {
-        baidu::galaxy::util::ErrorCode ec = in.ReadLine(line);
-
-        if (ec.Code() != 0) {
-            return ERRORCODE(-1, "read (%s) failed: %s",
-                    cpuacct_path_.c_str(),
-                    ec.Message().c_str());
-        }
-
+    for (size_t i = 0; i < lines.size(); i++) {
+        const std::string& line = lines[i];
         char type[32];
         long long int t = 0;
 
@@ -183,26 +204,52 @@ baidu::galaxy::util::ErrorCode CgroupCollector::ContainerCpuStat(boost::shared_p
 }
 
 
-baidu::galaxy::util::ErrorCode CgroupCollector::SystemCpuStat(boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix) {
-    assert(NULL != metrix.get());
-    int64_t cpu_time = 0;
+const int64_t SystemCpuSampler::kMaxSampleAge;
+
+SystemCpuSampler* SystemCpuSampler::GetInstance() {
+    static SystemCpuSampler instance;
+    return &instance;
+}
+
+SystemCpuSampler::SystemCpuSampler() :
+    cpu_time_(0L),
+    sample_time_(0L) {
+}
+
+baidu::galaxy::util::ErrorCode SystemCpuSampler::Sample(int64_t* cpu_time) {
+    boost::mutex::scoped_lock lock(mutex_);
+    int64_t now = baidu::common::timer::get_micros();
+
+    if (sample_time_ > 0 && now - sample_time_ < kMaxSampleAge) {
+        *cpu_time = cpu_time_;
+        return ERRORCODE_OK;
+    }
+
+    baidu::galaxy::util::ErrorCode ec = Read(&cpu_time_);
+
+    if (ec.Code() != 0) {
+        sample_time_ = 0L;
+        return ec;
+    }
+
+    sample_time_ = now;
+    *cpu_time = cpu_time_;
+    return ERRORCODE_OK;
+}
+
+baidu::galaxy::util::ErrorCode SystemCpuSampler::Read(int64_t* cpu_time) {
     const static std::string  path("/proc/stat");
-    baidu::galaxy::file::InputStreamFile in(path);
+    std::vector<std::string> lines;
+    baidu::galaxy::util::ErrorCode ec = ControlFileCache::GetInstance()->ReadLines(path, lines);
 
-    if (!in.IsOpen()) {
-        baidu::galaxy::util::ErrorCode ec = in.GetLastError();
-        return ERRORCODE(-1, "open %s failed: %s", path.c_str(), ec.Message().c_str());
+    if (ec.Code() != 0) {
+        return ERRORCODE(-1, "read (%s) failed: %s", path.c_str(), ec.Message().c_str());
     }
 
-    std::string line;
     bool has_data = false;
 
-    while (!in.Eof()) {
-        baidu::galaxy::util::ErrorCode ec = in.ReadLine(line);
-
-        if (ec.Code() != 0) {
-            return ERRORCODE(-1, "read (%s) failed: %s", path.c_str(), ec.Message().c_str());
-        }
+    for (size_t i = 0; i < lines.size(); i++) {
+        const std::string& line = lines[i];
 
         //cpu  19782368743 69952042 1588879335 90754227704 229233079 0 136086465 0 0
         if (boost::starts_with(line, "cpu ")) {
@@ -228,7 +275,7 @@ baidu::galaxy::util::ErrorCode CgroupCollector::SystemCpuStat(boost::shared_ptr<
                     &cpu_softirq_time,
                     &cpu_stealstolen,
                     &cpu_guest)) {
-                cpu_time = cpu_user_time
+                *cpu_time = cpu_user_time
                            + cpu_nice_time
                            + cpu_system_time
                            + cpu_idle_time
@@ -248,25 +295,28 @@ baidu::galaxy::util::ErrorCode CgroupCollector::SystemCpuStat(boost::shared_ptr<
         return ERRORCODE(-1, "unkown error");
     }
 
-    metrix->set_system_cpu_time(cpu_time);
     return ERRORCODE_OK;
 }
 
 
-baidu::galaxy::util::ErrorCode CgroupCollector::MemoryStat(boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix) {
+baidu::galaxy::util::ErrorCode CgroupCollector::SystemCpuStat(boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix) {
     assert(NULL != metrix.get());
-    const std::string& path = memory_path_;
-    baidu::galaxy::file::InputStreamFile in(path);
+    int64_t cpu_time = 0;
+    baidu::galaxy::util::ErrorCode ec = SystemCpuSampler::GetInstance()->Sample(&cpu_time);
 
-    if (!in.IsOpen()) {
-        baidu::galaxy::util::ErrorCode ec = in.GetLastError();
-        return ERRORCODE(-1, "open file(%s) failed: %s",
-                path.c_str(),
-                ec.Message().c_str());
+    if (ec.Code() != 0) {
+        return ec;
     }
 
+    metrix->set_system_cpu_time(cpu_time);
+    return ERRORCODE_OK;
+}
+
+baidu::galaxy::util::ErrorCode CgroupCollector::MemoryStat(boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix) {
+    assert(NULL != metrix.get());
+    const std::string& path = memory_path_;
     std::string data;
-    baidu::galaxy::util::ErrorCode ec = in.ReadLine(data);
+    baidu::galaxy::util::ErrorCode ec = ControlFileCache::GetInstance()->Read(path, data);
 
     if (ec.Code() != 0) {
         return ERRORCODE(-1, "read failed: %s", ec.Message().c_str());
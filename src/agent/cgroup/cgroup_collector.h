@@ -17,6 +17,24 @@ class CgroupMetrix;
 namespace cgroup {
 class Cgroup;
 
+// /proc/stat of the host, read once for the cgroup collectors of one tick
+class SystemCpuSampler {
+public:
+    static SystemCpuSampler* GetInstance();
+    // total cpu time of the host in USER_HZ, at most kMaxSampleAge old
+    baidu::galaxy::util::ErrorCode Sample(int64_t* cpu_time);
+
+    static const int64_t kMaxSampleAge = 100000; // us
+
+private:
+    SystemCpuSampler();
+    baidu::galaxy::util::ErrorCode Read(int64_t* cpu_time);
+
+    boost::mutex mutex_;
+    int64_t cpu_time_;
+    int64_t sample_time_;
+};
+
 class CgroupCollector : public baidu::galaxy::collector::Collector {
 public:
     explicit CgroupCollector();
@@ -41,6 +59,11 @@ public:
         memory_path_ = path;
     }
 
+    // blkio dir, io is not collected if not set
+    void SetBlkioPath(const std::string& path) {
+        blkio_path_ = path;
+    }
+
 private:
     baidu::galaxy::util::ErrorCode Collect(boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix);
     baidu::galaxy::util::ErrorCode ContainerCpuStat(boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix);
@@ -53,9 +76,12 @@ private:
     boost::mutex mutex_;
 
     boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix_;
+    // cpu times and io of the previous cycle, usage is the delta to them
+    boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> last_sample_;
     int64_t last_time_;
     std::string cpuacct_path_;
     std::string memory_path_;
+    std::string blkio_path_;
 };
 }
 }
@@ -0,0 +1,204 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "control_file.h"
+
+#include <boost/algorithm/string.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace baidu {
+namespace galaxy {
+namespace cgroup {
+
+const size_t ControlFileCache::kMaxOpenFiles;
+
+ControlFileCache::Handle::Handle(int fd) :
+    fd_(fd),
+    buffer_(4096) {
+}
+
+ControlFileCache::Handle::~Handle() {
+    ::close(fd_);
+}
+
+baidu::galaxy::util::ErrorCode ControlFileCache::Handle::Read(std::string& content) {
+    boost::mutex::scoped_lock lock(mutex_);
+    size_t size = 0;
+
+    while (true) {
+        ssize_t ret = ::pread(fd_, &buffer_[size], buffer_.size() - size, size);
+
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return PERRORCODE(-1, errno, "pread failed");
+        }
+
+        if (ret == 0) {
+            break;
+        }
+
+        size += ret;
+
+        if (size == buffer_.size()) {
+            buffer_.resize(buffer_.size() * 2);
+        }
+    }
+
+    content.assign(&buffer_[0], size);
+    return ERRORCODE_OK;
+}
+
+ControlFileCache* ControlFileCache::GetInstance() {
+    static ControlFileCache instance;
+    return &instance;
+}
+
+baidu::galaxy::util::ErrorCode ControlFileCache::Open(const std::string& path,
+        boost::shared_ptr<Handle>& handle) {
+    int64_t generation = 0;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        generation = generation_;
+        std::map<std::string, boost::shared_ptr<Handle> >::iterator iter = handles_.find(path);
+
+        if (iter != handles_.end()) {
+            handle = iter->second;
+            return ERRORCODE_OK;
+        }
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return PERRORCODE(-1, errno, "open file(%s) failed", path.c_str());
+    }
+
+    handle.reset(new Handle(fd));
+    boost::mutex::scoped_lock lock(mutex_);
+
+    // a file of a cgroup being destroyed is closed by its reader, or it
+    // would pin the dead cgroup
+    if (generation == generation_ && !Dead(path) && handles_.size() < kMaxOpenFiles) {
+        handles_.insert(std::make_pair(path, handle));
+    }
+
+    return ERRORCODE_OK;
+}
+
+baidu::galaxy::util::ErrorCode ControlFileCache::Read(const std::string& path, std::string& content) {
+    boost::shared_ptr<Handle> handle;
+    baidu::galaxy::util::ErrorCode ec = Open(path, handle);
+
+    if (ec.Code() != 0) {
+        return ec;
+    }
+
+    ec = handle->Read(content);
+
+    if (ec.Code() != 0) {
+        // the file may be gone with its cgroup, open it once more
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            std::map<std::string, boost::shared_ptr<Handle> >::iterator iter = handles_.find(path);
+
+            if (iter != handles_.end() && iter->second == handle) {
+                handles_.erase(iter);
+            }
+        }
+
+        ec = Open(path, handle);
+
+        if (ec.Code() != 0) {
+            return ec;
+        }
+
+        ec = handle->Read(content);
+
+        if (ec.Code() != 0) {
+            return ERRORCODE(-1, "read file(%s) failed: %s", path.c_str(), ec.Message().c_str());
+        }
+    }
+
+    return ERRORCODE_OK;
+}
+
+baidu::galaxy::util::ErrorCode ControlFileCache::ReadLines(const std::string& path,
+        std::vector<std::string>& lines) {
+    std::string content;
+    baidu::galaxy::util::ErrorCode ec = Read(path, content);
+
+    if (ec.Code() != 0) {
+        return ec;
+    }
+
+    lines.clear();
+    std::vector<std::string> all;
+    boost::split(all, content, boost::is_any_of("\n"));
+
+    for (size_t i = 0; i < all.size(); i++) {
+        if (!all[i].empty()) {
+            lines.push_back(all[i]);
+        }
+    }
+
+    return ERRORCODE_OK;
+}
+
+std::string ControlFileCache::Dir(const std::string& path) {
+    return boost::algorithm::trim_right_copy_if(path, boost::is_any_of("/"));
+}
+
+bool ControlFileCache::Below(const std::string& file, const std::string& dir) {
+    return boost::starts_with(file, dir)
+           && (file.size() == dir.size() || file[dir.size()] == '/');
+}
+
+bool ControlFileCache::Dead(const std::string& path) {
+    for (std::set<std::string>::const_iterator iter = dead_.begin();
+            iter != dead_.end(); iter++) {
+        if (Below(path, *iter)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ControlFileCache::Invalidate(const std::string& path) {
+    std::string dir = Dir(path);
+    boost::mutex::scoped_lock lock(mutex_);
+    dead_.insert(dir);
+    generation_++;
+    std::map<std::string, boost::shared_ptr<Handle> >::iterator iter = handles_.lower_bound(dir);
+
+    // a handle in use is closed by its last reader
+    while (iter != handles_.end() && boost::starts_with(iter->first, dir)) {
+        if (Below(iter->first, dir)) {
+            handles_.erase(iter++);
+        } else {
+            iter++;
+        }
+    }
+}
+
+void ControlFileCache::Release(const std::string& path) {
+    boost::mutex::scoped_lock lock(mutex_);
+    dead_.erase(Dir(path));
+    generation_++;
+}
+
+size_t ControlFileCache::Size() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return handles_.size();
+}
+
+}
+}
+}
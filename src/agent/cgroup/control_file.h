@@ -0,0 +1,70 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+#include "util/error_code.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <stdint.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace baidu {
+namespace galaxy {
+namespace cgroup {
+
+// Control files of cgroups kept open for reading. Each read is a pread from
+// offset 0, which makes the kernel render the file again, so one descriptor
+// serves every later read. Files under a cgroup are closed by Invalidate
+// before the cgroup is destroyed and are not cached again until Release,
+// which is called once the cgroup is removed.
+class ControlFileCache {
+public:
+    static ControlFileCache* GetInstance();
+
+    baidu::galaxy::util::ErrorCode Read(const std::string& path, std::string& content);
+    // the lines of the file, without the empty ones
+    baidu::galaxy::util::ErrorCode ReadLines(const std::string& path, std::vector<std::string>& lines);
+    // close the files of path and below, and read them uncached until Release
+    void Invalidate(const std::string& path);
+    void Release(const std::string& path);
+    size_t Size();
+
+    static const size_t kMaxOpenFiles = 4096;
+
+private:
+    class Handle {
+    public:
+        explicit Handle(int fd);
+        ~Handle();
+        baidu::galaxy::util::ErrorCode Read(std::string& content);
+
+    private:
+        int fd_;
+        boost::mutex mutex_;
+        std::vector<char> buffer_;
+    };
+
+    ControlFileCache() : generation_(0) {}
+    baidu::galaxy::util::ErrorCode Open(const std::string& path, boost::shared_ptr<Handle>& handle);
+    static std::string Dir(const std::string& path);
+    static bool Below(const std::string& file, const std::string& dir);
+    bool Dead(const std::string& path);
+
+    boost::mutex mutex_;
+    std::map<std::string, boost::shared_ptr<Handle> > handles_;
+    // cgroups being destroyed
+    std::set<std::string> dead_;
+    // bumped by Invalidate and Release, a file opened across either is not cached
+    int64_t generation_;
+};
+
+}
+}
+}
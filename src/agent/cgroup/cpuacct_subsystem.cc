@@ -5,7 +5,7 @@
 #include "cpuacct_subsystem.h"
 #include "boost/filesystem/path.hpp"
 #include "boost/filesystem/operations.hpp"
-#include "util/input_stream_file.h"
+#include "control_file.h"
 #include "boost/algorithm/string/predicate.hpp"
 
 #include "protocol/agent.pb.h"
@@ -70,25 +70,19 @@ baidu::galaxy::util::ErrorCode CpuacctSubsystem::CgroupCpuTime(int64_t& cpu_time
     cpu_time = 0;
     boost::filesystem::path path(Path());
     path.append("cpuacct.stat");
-    baidu::galaxy::file::InputStreamFile in(path.string());
+    std::vector<std::string> lines;
+    baidu::galaxy::util::ErrorCode ec = ControlFileCache::GetInstance()->ReadLines(path.string(), lines);
 
-    if (!in.IsOpen()) {
-        baidu::galaxy::util::ErrorCode ec = in.GetLastError();
-        return ERRORCODE(-1, "open %s failed: %s", path.string().c_str(), ec.Message().c_str());
+    if (ec.Code() != 0) {
+        return ERRORCODE(-1, "read (%s) failed: %s",
+                path.string().c_str(),
+                ec.Message().c_str());
     }
 
-    std::string line;
     bool has_data = false;
 
-    while (!in.Eof()) {
-        baidu::galaxy::util::ErrorCode ec = in.ReadLine(line);
-
-        if (ec.Code() != 0) {
-            return ERRORCODE(-1, "read (%s) failed: %s",
-                    path.string().c_str(),
-                    ec.Message().c_str());
-        }
-
+    for (size_t i = 0; i < lines.size(); i++) {
+        const std::string& line = lines[i];
         char type[32];
         long long int t = 0;
 
@@ -110,22 +104,17 @@ baidu::galaxy::util::ErrorCode CpuacctSubsystem::CgroupCpuTime(int64_t& cpu_time
 baidu::galaxy::util::ErrorCode CpuacctSubsystem::SystemCpuTime(int64_t& cpu_time) {
     cpu_time = 0;
     const static std::string  path("/proc/stat");
-    baidu::galaxy::file::InputStreamFile in(path);
+    std::vector<std::string> lines;
+    baidu::galaxy::util::ErrorCode ec = ControlFileCache::GetInstance()->ReadLines(path, lines);
 
-    if (!in.IsOpen()) {
-        baidu::galaxy::util::ErrorCode ec = in.GetLastError();
-        return ERRORCODE(-1, "open %s failed: %s", path.c_str(), ec.Message().c_str());
+    if (ec.Code() != 0) {
+        return ERRORCODE(-1, "read (%s) failed: %s", path.c_str(), ec.Message().c_str());
     }
 
-    std::string line;
     bool has_data = false;
 
-    while (!in.Eof()) {
-        baidu::galaxy::util::ErrorCode ec = in.ReadLine(line);
-
-        if (ec.Code() != 0) {
-            return ERRORCODE(-1, "read (%s) failed: %s", path.c_str(), ec.Message().c_str());
-        }
+    for (size_t i = 0; i < lines.size(); i++) {
+        const std::string& line = lines[i];
 
         //cpu  19782368743 69952042 1588879335 90754227704 229233079 0 136086465 0 0
         if (boost::starts_with(line, "cpu ")) {
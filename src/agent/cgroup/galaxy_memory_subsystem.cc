@@ -7,6 +7,7 @@
 #include "protocol/galaxy.pb.h"
 #include "protocol/agent.pb.h"
 #include "util/input_stream_file.h"
+#include "control_file.h"
 
 #include <unistd.h>
 #include <signal.h>
@@ -45,16 +46,8 @@ baidu::galaxy::util::ErrorCode GalaxyMemorySubsystem::Collect(boost::shared_ptr<
     // 1.set memory usage(rss + cache)
     boost::filesystem::path usage_path(Path());
     usage_path.append("memory.usage_in_bytes");
-    baidu::galaxy::file::InputStreamFile in(usage_path.string());
-    if (!in.IsOpen()) {
-        baidu::galaxy::util::ErrorCode ec = in.GetLastError();
-        return ERRORCODE(-1, "open file(%s) failed: %s",
-                usage_path.string().c_str(),
-                ec.Message().c_str());
-    }
-
     std::string data;
-    baidu::galaxy::util::ErrorCode ec = in.ReadLine(data);
+    baidu::galaxy::util::ErrorCode ec = ControlFileCache::GetInstance()->Read(usage_path.string(), data);
     if (ec.Code() != 0) {
         return ERRORCODE(-1, "read file(%s) failed: %s",
                 usage_path.string().c_str(),
@@ -65,24 +58,22 @@ baidu::galaxy::util::ErrorCode GalaxyMemorySubsystem::Collect(boost::shared_ptr<
     // 2.set memory cache usage
     boost::filesystem::path stat_path(Path());
     stat_path.append("memory.stat");
-    std::string line;
-    std::ifstream stat_file(stat_path.string().c_str());
-    if (stat_file.is_open()) {
-        while (getline(stat_file, line)) {
-            std::istringstream ss(line);
-            std::string name;
-            uint64_t value;
-            ss >> name >> value;
-            if (name == "cache") {
-                metrix->set_memory_cache_in_byte(value);
-                break;
-            }
-        }
-        stat_file.close();
-    } else {
-        return ERRORCODE(-1, "open file(%s) failed: %s",
+    std::vector<std::string> lines;
+    ec = ControlFileCache::GetInstance()->ReadLines(stat_path.string(), lines);
+    if (ec.Code() != 0) {
+        return ERRORCODE(-1, "read file(%s) failed: %s",
                 stat_path.string().c_str(),
-                std::strerror(errno));
+                ec.Message().c_str());
+    }
+    for (size_t i = 0; i < lines.size(); i++) {
+        std::istringstream ss(lines[i]);
+        std::string name;
+        uint64_t value;
+        ss >> name >> value;
+        if (name == "cache") {
+            metrix->set_memory_cache_in_byte(value);
+            break;
+        }
     }
 
     return ERRORCODE_OK;
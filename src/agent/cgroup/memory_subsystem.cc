@@ -5,7 +5,7 @@
 #include "agent/util/path_tree.h"
 #include "protocol/galaxy.pb.h"
 #include "protocol/agent.pb.h"
-#include "util/input_stream_file.h"
+#include "control_file.h"
 
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
@@ -30,17 +30,8 @@ baidu::galaxy::util::ErrorCode MemorySubsystem::Collect(boost::shared_ptr<baidu:
     assert(NULL != metrix.get());
     boost::filesystem::path path(Path());
     path.append("memory.usage_in_bytes");
-    baidu::galaxy::file::InputStreamFile in(path.string());
-
-    if (!in.IsOpen()) {
-        baidu::galaxy::util::ErrorCode ec = in.GetLastError();
-        return ERRORCODE(-1, "open file(%s) failed: %s",
-                path.string().c_str(),
-                ec.Message().c_str());
-    }
-
     std::string data;
-    baidu::galaxy::util::ErrorCode ec = in.ReadLine(data);
+    baidu::galaxy::util::ErrorCode ec = ControlFileCache::GetInstance()->Read(path.string(), data);
 
     if (ec.Code() != 0) {
         return ERRORCODE(-1, "read failed: %s", ec.Message().c_str());
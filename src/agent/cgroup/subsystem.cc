@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include "subsystem.h"
+#include "control_file.h"
 #include "protocol/galaxy.pb.h"
 #include "gflags/gflags.h"
 
@@ -12,8 +13,12 @@
 #include <boost/lexical_cast/lexical_cast_old.hpp>
 #include <sys/types.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include <stdio.h>
+#include <string.h>
 
 DECLARE_string(cgroup_root_path);
 
@@ -85,54 +90,16 @@ baidu::galaxy::util::ErrorCode Subsystem::Attach(pid_t pid) {
 baidu::galaxy::util::ErrorCode Subsystem::GetProcs(std::vector<int>& pids) {
     boost::filesystem::path proc_path(Path());
     proc_path.append("cgroup.procs");
-    boost::system::error_code ec;
+    std::vector<std::string> str_pids;
+    baidu::galaxy::util::ErrorCode ec =
+        ControlFileCache::GetInstance()->ReadLines(proc_path.string(), str_pids);
 
-    if (!boost::filesystem::exists(proc_path, ec)) {
-        return ERRORCODE(-1, "no such file %s: %s",
+    if (ec.Code() != 0) {
+        return ERRORCODE(-1, "read %s failed: %s",
                 proc_path.string().c_str(),
-                ec.message().c_str());
-    }
-
-    FILE* fin = ::fopen(proc_path.string().c_str(), "re");
-
-    if (NULL == fin) {
-        return ERRORCODE(-1,
-                "failed in open file: %s",
-                proc_path.string().c_str());
-    }
-
-    std::string value;
-    char temp_read_buffer[30];
-
-    while (::feof(fin) == 0) {
-        size_t readlen = ::fread((void*) temp_read_buffer,
-                         sizeof(char),
-                         sizeof temp_read_buffer, fin);
-
-        if (readlen == 0) {
-            break;
-        }
-
-        value.append(temp_read_buffer, readlen);
+                ec.Message().c_str());
     }
 
-    if (::ferror(fin) != 0) {
-        ::fclose(fin);
-        return ERRORCODE(-1,
-                "close file faile: %s",
-                proc_path.string().c_str());
-    }
-
-    ::fclose(fin);
-    boost::algorithm::trim(value);
-
-    if (value.empty()) {
-        return ERRORCODE_OK;
-    }
-
-    std::vector<std::string> str_pids;
-    boost::split(str_pids, value, boost::is_any_of("\n"));
-
     for (size_t i = 0; i < str_pids.size(); i++) {
         pids.push_back(atoi(str_pids[i].c_str()));
     }
@@ -150,27 +117,26 @@ baidu::galaxy::util::ErrorCode Attach(const std::string& file, int64_t value, bo
 }
 
 baidu::galaxy::util::ErrorCode Attach(const std::string& file, const std::string& value, bool append) {
-    FILE* fd = NULL;
-
-    if (append) {
-        fd = ::fopen(file.c_str(), "a+");
-    } else {
-        fd = ::fopen(file.c_str(), "w");
-    }
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+    int fd = ::open(file.c_str(), flags, 0644);
 
-    if (NULL == fd) {
+    if (fd < 0) {
         return PERRORCODE(-1, errno,
                 "open file(%s) failed",
                 file.c_str());
     }
 
-    int ret = ::fprintf(fd, "%s\n", value.c_str());
-    ::fclose(fd);
+    // one write for the whole value, cgroup files take a value per write
+    std::string line = value + "\n";
+    ssize_t ret = ::write(fd, line.data(), line.size());
+    int err = errno;
+    ::close(fd);
 
-    if (ret <= 0) {
-        return PERRORCODE(-1, errno,
-                "close file(%s) failed",
-                file.c_str());
+    if (ret != static_cast<ssize_t>(line.size())) {
+        return PERRORCODE(-1, err,
+                "write file(%s) failed: %s",
+                file.c_str(),
+                strerror(err));
     }
 
     return ERRORCODE_OK;
@@ -11,12 +11,21 @@
 #include <boost/bind.hpp>
 
 #include <assert.h>
-#include <unistd.h>
+#include <time.h>
 
 namespace baidu {
 namespace galaxy {
 namespace collector {
 
+// due times follow the monotonic clock, a step of the wall clock neither
+// stalls the collectors nor makes them run all at once
+static int64_t MonotonicMicros()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000L + ts.tv_nsec / 1000;
+}
+
 CollectorEngine::CollectorEngine() :
     running_(false)
 {
@@ -46,116 +55,165 @@ baidu::galaxy::util::ErrorCode CollectorEngine::Register(boost::shared_ptr<Colle
         }
     }
 
-    boost::shared_ptr<CollectorEngine::RuntimeCollector> rc(new CollectorEngine::RuntimeCollector(collector));
-    rc->SetFast(fast);
-
+    boost::shared_ptr<CollectorEngine::RuntimeCollector> rc(new CollectorEngine::RuntimeCollector(collector, fast));
     collectors_.push_back(rc);
+
+    DueEvent event;
+    event.due_time = MonotonicMicros();
+    event.rc = rc;
+    due_queue_.push(event);
+    cond_.notify_one();
     return ERRORCODE_OK;
 }
 
-/*void CollectorEngine::Unregister(boost::shared_ptr<Collector> collector)
+void CollectorEngine::Unregister(boost::shared_ptr<Collector> collector)
 {
     assert(NULL != collector.get());
     boost::mutex::scoped_lock lock(mutex_);
-    std::vector<boost::shared_ptr<RuntimeCollector> >::iterator iter = collectors_.begin();
+    std::list<boost::shared_ptr<RuntimeCollector> >::iterator iter = collectors_.begin();
 
     while (iter != collectors_.end()) {
         if ((*iter)->GetCollector()->Equal(collector.get())) {
-            (*iter)->GetCollector()->Enable(false);
-            collectors_.erase(iter);
+            // its due event is dropped when it comes to the top
+            (*iter)->Remove();
+            collectors_.erase(iter++);
+        } else {
+            iter++;
         }
     }
-}*/
+}
+
+void CollectorEngine::GetStats(std::vector<CollectorStat>& stats)
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    stats.clear();
+    std::list<boost::shared_ptr<RuntimeCollector> >::iterator iter = collectors_.begin();
+
+    for (; iter != collectors_.end(); iter++) {
+        stats.push_back((*iter)->Stat());
+    }
+}
 
 int CollectorEngine::Setup()
 {
     assert(!running_);
-//return 0;
 
     int ret = -1;
+    running_ = true;
     if (main_collect_thread_.Start(boost::bind(&CollectorEngine::CollectMainThreadRoutine, this))) {
         ret = 0;
+    } else {
+        running_ = false;
     }
     return ret;
 }
 
 void CollectorEngine::TearDown()
 {
-    running_ = false;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        running_ = false;
+        cond_.notify_one();
+    }
     main_collect_thread_.Join();
 }
 
 void CollectorEngine::CollectMainThreadRoutine()
 {
-    running_ = true;
+    boost::mutex::scoped_lock lock(mutex_);
     while (running_) {
-        int64_t now = baidu::common::timer::get_micros();
-        {
-            boost::mutex::scoped_lock lock(mutex_);
-            VLOG(10) << "collector size: " << collectors_.size();
-            std::list<boost::shared_ptr<RuntimeCollector> >::iterator iter = collectors_.begin();
-            for (; iter != collectors_.end(); iter++) {
-                VLOG(10) << (*iter)->ToString();
-                if (!(*iter)->Enabled()) {
-                    continue;
-                }
+        int64_t now = MonotonicMicros();
 
-                if ((*iter)->Expired(now)) {
-                    if ((*iter)->IsRunning()) {
-                        LOG(WARNING) << "last collection is not commplete: "
-                                     << (*iter)->GetCollector()->Name();
-                        continue;
-                    }
-
-                    if (!(*iter)->GetCollector()->Enabled()) {
-                        LOG(WARNING) << "collector is not enabled: "
-                                     << (*iter)->GetCollector()->Name();
-                        continue;
-                    }
-
-                    if ((*iter)->Fast()) {
-                        (*iter)->SetRunning(true);
-                        fast_collector_pool_.AddTask(boost::bind(&CollectorEngine::CollectRoutine, this, *iter));
-                        (*iter)->UpdateNextRuntime();
-                        VLOG(10) << (*iter)->Name() << " set fast running true";
-                    } else {
-                        if (collector_pool_.PendingNum() == 0){
-                            collector_pool_.AddTask(boost::bind(&CollectorEngine::CollectRoutine,
-                                            this, 
-                                            *iter));
-                            (*iter)->UpdateNextRuntime();
-                            VLOG(10) << (*iter)->Name() << " set slow running true";
-                        } else {
-                            LOG(INFO) << "no thread for slow collector: " << (*iter)->Name();
-                        }
-                    }
-                }
-            }
+        while (!due_queue_.empty() && due_queue_.top().due_time <= now) {
+            DueEvent event = due_queue_.top();
+            due_queue_.pop();
+            VLOG(10) << event.rc->ToString();
+            Dispatch(event, now);
+        }
 
-            iter = collectors_.begin();
-            while (iter != collectors_.end()) {
-                if (!(*iter)->Enabled() && (*iter)->IsRunning()) {
-                    LOG(WARNING) << "collector " << (*iter)->Name() << " is disabled, but is running";
-                    iter++;
-                } else if (!(*iter)->Enabled()) {
-                    collectors_.erase(iter++);
-                } else {
-                    iter++;
+        // sleep until the earliest collector is due or a new one comes
+        if (due_queue_.empty()) {
+            cond_.wait(lock);
+        } else {
+            int64_t wait = due_queue_.top().due_time - now;
+            cond_.timed_wait(lock, boost::posix_time::microseconds(wait));
+        }
+    }
+}
+
+void CollectorEngine::Dispatch(const DueEvent& event, int64_t now)
+{
+    boost::shared_ptr<RuntimeCollector> rc = event.rc;
+    if (rc->Removed()) {
+        return;
+    }
+
+    int64_t cycle = rc->Cycle();
+    DueEvent next;
+    next.rc = rc;
+
+    if (!rc->Enabled()) {
+        if (rc->IsRunning()) {
+            LOG(WARNING) << "collector " << rc->Name() << " is disabled, but is running";
+            next.due_time = now + cycle;
+            due_queue_.push(next);
+        } else {
+            VLOG(10) << "remove disabled collector: " << rc->Name();
+            std::list<boost::shared_ptr<RuntimeCollector> >::iterator iter = collectors_.begin();
+            for (; iter != collectors_.end(); iter++) {
+                if (iter->get() == rc.get()) {
+                    collectors_.erase(iter);
+                    break;
                 }
             }
         }
-        ::sleep(1);
+        return;
+    }
+
+    // keep to the cycle, cycles the engine lagged behind are not made up
+    next.due_time = event.due_time + cycle;
+    if (next.due_time <= now) {
+        int64_t missed = (now - event.due_time) / cycle;
+        next.due_time = event.due_time + (missed + 1) * cycle;
+        int64_t skipped = rc->Skip(missed);
+        LOG(WARNING) << "collector " << rc->Name() << " lagged " << now - event.due_time
+                     << "us behind, skip " << missed << " cycles, " << skipped << " skipped in total";
+    }
+    due_queue_.push(next);
+
+    if (rc->IsRunning()) {
+        int64_t skipped = rc->Skip(1);
+        LOG(WARNING) << "last collection is not commplete: " << rc->Name()
+                     << ", " << skipped << " cycles skipped in total";
+        return;
+    }
+
+    if (!rc->Fast() && collector_pool_.PendingNum() != 0) {
+        int64_t skipped = rc->Skip(1);
+        LOG(WARNING) << "no thread for slow collector: " << rc->Name()
+                     << ", " << skipped << " cycles skipped in total";
+        return;
+    }
+
+    rc->Start(now, now - event.due_time, event.due_time + cycle);
+    if (rc->Fast()) {
+        fast_collector_pool_.AddTask(boost::bind(&CollectorEngine::CollectRoutine, this, rc));
+    } else {
+        collector_pool_.AddTask(boost::bind(&CollectorEngine::CollectRoutine, this, rc));
     }
 }
 
 void CollectorEngine::CollectRoutine(boost::shared_ptr<CollectorEngine::RuntimeCollector> rc)
 {
-    int64_t t0 = baidu::common::timer::get_micros();
     VLOG(10) << "begin collect " << rc->Name();
     rc->GetCollector()->Collect();
-    rc->SetRunning(false);
-    int64_t t1 = baidu::common::timer::get_micros();
-    VLOG(10) << rc->Name() << " set running false: " << t1 - t0;
+    int64_t t1 = MonotonicMicros();
+    if (rc->Finish(t1)) {
+        CollectorStat stat = rc->Stat();
+        LOG(WARNING) << "collection of " << rc->Name() << " outran its cycle, cost "
+                     << stat.last_cost << "us, " << stat.overruns << " overruns in total";
+    }
+    VLOG(10) << rc->Name() << " set running false: " << rc->Stat().last_cost;
 }
 
 }
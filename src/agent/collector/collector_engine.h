@@ -7,6 +7,7 @@
 #include "util/error_code.h"
 #include "boost/shared_ptr.hpp"
 #include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
 #include "thread.h"
 #include "timer.h"
 #include "thread_pool.h"
@@ -14,6 +15,10 @@
 #include <stdint.h>
 
 #include <list>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
 
 
 namespace baidu {
@@ -22,10 +27,21 @@ namespace collector {
 
 class CollectorEngine {
 public:
+    struct CollectorStat {
+        std::string name;
+        bool fast;
+        int64_t collections;    // collections started
+        int64_t skipped;        // cycles with no collection started
+        int64_t overruns;       // collections not done within their cycle
+        int64_t last_cost;      // micros the last collection took
+        int64_t max_delay;      // micros the start of a collection lagged most
+    };
+
     ~CollectorEngine();
     static boost::shared_ptr<CollectorEngine> GetInstance();
     baidu::galaxy::util::ErrorCode Register(boost::shared_ptr<Collector> collector, bool fast = false);
-    //void Unregister(boost::shared_ptr<Collector> collector);
+    void Unregister(boost::shared_ptr<Collector> collector);
+    void GetStats(std::vector<CollectorStat>& stats);
     int Setup();
     void TearDown();
 
@@ -35,16 +51,19 @@ private:
 
     class RuntimeCollector {
     public:
-        RuntimeCollector(boost::shared_ptr<Collector> collector) :
+        RuntimeCollector(boost::shared_ptr<Collector> collector, bool fast) :
             collector_(collector),
-            next_time_(0),
             is_running_(false),
-            fast_(false) {
-        }
-
-        bool Expired(int64_t now) {
-            boost::mutex::scoped_lock lock(mutex_);
-            return next_time_ <= now;
+            removed_(false),
+            deadline_(0),
+            start_time_(0) {
+            stat_.name = collector->Name();
+            stat_.fast = fast;
+            stat_.collections = 0;
+            stat_.skipped = 0;
+            stat_.overruns = 0;
+            stat_.last_cost = 0;
+            stat_.max_delay = 0;
         }
 
         bool IsRunning() {
@@ -52,73 +71,111 @@ private:
             return is_running_;
         }
 
-        void SetRunning(bool r) {
+        // a collection started at now, it is due to be done before deadline
+        void Start(int64_t now, int64_t delay, int64_t deadline) {
             boost::mutex::scoped_lock lock(mutex_);
-            is_running_ = r;
+            is_running_ = true;
+            start_time_ = now;
+            deadline_ = deadline;
+            stat_.collections++;
+            if (delay > stat_.max_delay) {
+                stat_.max_delay = delay;
+            }
         }
 
-        void SetFast(bool fast) {
+        // returns true if the collection outran its deadline
+        bool Finish(int64_t now) {
             boost::mutex::scoped_lock lock(mutex_);
-            fast_ = fast;
-
+            is_running_ = false;
+            stat_.last_cost = now - start_time_;
+            if (now > deadline_) {
+                stat_.overruns++;
+                return true;
+            }
+            return false;
         }
 
-        void UpdateNextRuntime() {
+        int64_t Skip(int64_t cycles) {
             boost::mutex::scoped_lock lock(mutex_);
-            next_time_ += collector_->Cycle() * 1000000L;
-            int64_t now = baidu::common::timer::get_micros();
-
-            if (next_time_ < now) {
-                next_time_ = now;
-            }
+            stat_.skipped += cycles;
+            return stat_.skipped;
+        }
 
-            if (next_time_ > now + collector_->Cycle() * 1000000L * 2L) {
-                next_time_ = now;
-            }
+        void Remove() {
+            boost::mutex::scoped_lock lock(mutex_);
+            removed_ = true;
+        }
 
+        bool Removed() {
+            boost::mutex::scoped_lock lock(mutex_);
+            return removed_;
         }
 
         bool Fast() {
-            boost::mutex::scoped_lock lock(mutex_);
-            return fast_;
+            return stat_.fast;
         }
 
         bool Enabled() {
-            boost::mutex::scoped_lock lock(mutex_);
             return collector_->Enabled();
         }
 
+        // unit micro second, one second at least
+        int64_t Cycle() {
+            int cycle = collector_->Cycle();
+            return (cycle > 0 ? cycle : 1) * 1000000L;
+        }
+
         std::string Name() {
-            boost::mutex::scoped_lock lock(mutex_);
-            return collector_->Name();
+            return stat_.name;
         }
 
         boost::shared_ptr<baidu::galaxy::collector::Collector> GetCollector() {
             return collector_;
         }
 
+        CollectorStat Stat() {
+            boost::mutex::scoped_lock lock(mutex_);
+            return stat_;
+        }
+
         std::string ToString() {
             boost::mutex::scoped_lock lock(mutex_);
             std::stringstream ss;
-            ss << "name:" << collector_->Name() << " "
+            ss << "name:" << stat_.name << " "
                 <<"addr:" << (int64_t)collector_.get() << " "
-                << "next_time:"<< next_time_ << " "
-                << "running: " << is_running_;
+                << "running: " << is_running_ << " "
+                << "collections: " << stat_.collections << " "
+                << "skipped: " << stat_.skipped << " "
+                << "overruns: " << stat_.overruns;
             return ss.str();
         }
 
     private:
         boost::shared_ptr<baidu::galaxy::collector::Collector> collector_;
-        int64_t next_time_;
         bool is_running_;
-        bool fast_;
+        bool removed_;
+        int64_t deadline_;
+        int64_t start_time_;
+        CollectorStat stat_;
         boost::mutex mutex_;
     };
 
+    // the collector is due at due_time, the earliest on top of the queue
+    struct DueEvent {
+        int64_t due_time;
+        boost::shared_ptr<RuntimeCollector> rc;
+        bool operator<(const DueEvent& e) const {
+            return due_time > e.due_time;
+        }
+    };
+
+    void Dispatch(const DueEvent& event, int64_t now);
     void CollectRoutine(boost::shared_ptr<RuntimeCollector> rc);
     void CollectMainThreadRoutine();
     std::list<boost::shared_ptr<RuntimeCollector> > collectors_;
+    std::priority_queue<DueEvent> due_queue_;
     boost::mutex mutex_;
+    boost::condition_variable cond_;
     bool running_;
     baidu::common::ThreadPool fast_collector_pool_;  // for fast
     baidu::common::ThreadPool collector_pool_;  // for slow
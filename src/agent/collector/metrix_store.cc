@@ -0,0 +1,162 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "metrix_store.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+namespace baidu {
+namespace galaxy {
+namespace collector {
+
+MetrixSeries::MetrixSeries(size_t capacity) :
+    samples_(capacity),
+    next_(0),
+    size_(0) {
+    assert(capacity > 0);
+}
+
+void MetrixSeries::Append(const MetrixSample& sample) {
+    MetrixSample s = sample;
+    s.cpu_max_in_millicore = s.cpu_used_in_millicore;
+    s.memory_max_in_byte = s.memory_used_in_byte;
+    s.sample_count = 1;
+
+    boost::mutex::scoped_lock lock(mutex_);
+    samples_[next_] = s;
+    next_ = (next_ + 1) % samples_.size();
+
+    if (size_ < samples_.size()) {
+        size_++;
+    }
+}
+
+void MetrixSeries::Range(int64_t start, int64_t end, std::vector<MetrixSample>& samples) {
+    boost::mutex::scoped_lock lock(mutex_);
+    size_t oldest = (next_ + samples_.size() - size_) % samples_.size();
+
+    for (size_t i = 0; i < size_; i++) {
+        const MetrixSample& s = samples_[(oldest + i) % samples_.size()];
+
+        if (s.time >= end) {
+            break;
+        }
+
+        if (s.time >= start) {
+            samples.push_back(s);
+        }
+    }
+}
+
+size_t MetrixSeries::Size() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return size_;
+}
+
+MetrixStore::MetrixStore(size_t capacity) :
+    capacity_(capacity > 0 ? capacity : 1) {
+}
+
+void MetrixStore::Append(const std::string& id, const MetrixSample& sample) {
+    boost::shared_ptr<MetrixSeries> series;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        boost::shared_ptr<MetrixSeries>& s = series_[id];
+
+        if (NULL == s.get()) {
+            s.reset(new MetrixSeries(capacity_));
+        }
+
+        series = s;
+    }
+    series->Append(sample);
+}
+
+void MetrixStore::Retain(const std::set<std::string>& ids) {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map<std::string, boost::shared_ptr<MetrixSeries> >::iterator iter = series_.begin();
+
+    while (iter != series_.end()) {
+        if (!iter->first.empty() && ids.find(iter->first) == ids.end()) {
+            series_.erase(iter++);
+        } else {
+            iter++;
+        }
+    }
+}
+
+bool MetrixStore::Range(const std::string& id,
+        int64_t start,
+        int64_t end,
+        std::vector<MetrixSample>& samples) {
+    boost::shared_ptr<MetrixSeries> series;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        std::map<std::string, boost::shared_ptr<MetrixSeries> >::iterator iter = series_.find(id);
+
+        if (iter == series_.end()) {
+            return false;
+        }
+
+        series = iter->second;
+    }
+    series->Range(start, end, samples);
+    return true;
+}
+
+size_t MetrixStore::Size() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return series_.size();
+}
+
+void MetrixStore::Aggregate(const std::vector<MetrixSample>& samples,
+        int64_t start,
+        int64_t interval,
+        std::vector<MetrixSample>& aggregates) {
+    assert(interval > 0);
+    size_t i = 0;
+
+    while (i < samples.size()) {
+        MetrixSample sum;
+        sum.time = start + (samples[i].time - start) / interval * interval;
+
+        // samples are in the order of time
+        for (; i < samples.size() && samples[i].time < sum.time + interval; i++) {
+            const MetrixSample& s = samples[i];
+            sum.cpu_used_in_millicore += s.cpu_used_in_millicore;
+            sum.memory_used_in_byte += s.memory_used_in_byte;
+            sum.volum_used_in_byte += s.volum_used_in_byte;
+            sum.read_bps += s.read_bps;
+            sum.write_bps += s.write_bps;
+            sum.read_iops += s.read_iops;
+            sum.write_iops += s.write_iops;
+            sum.net_in_bps += s.net_in_bps;
+            sum.net_out_bps += s.net_out_bps;
+            sum.net_in_pps += s.net_in_pps;
+            sum.net_out_pps += s.net_out_pps;
+            sum.cpu_max_in_millicore = std::max(sum.cpu_max_in_millicore, s.cpu_used_in_millicore);
+            sum.memory_max_in_byte = std::max(sum.memory_max_in_byte, s.memory_used_in_byte);
+            sum.sample_count++;
+        }
+
+        sum.cpu_used_in_millicore /= sum.sample_count;
+        sum.memory_used_in_byte /= sum.sample_count;
+        sum.volum_used_in_byte /= sum.sample_count;
+        sum.read_bps /= sum.sample_count;
+        sum.write_bps /= sum.sample_count;
+        sum.read_iops /= sum.sample_count;
+        sum.write_iops /= sum.sample_count;
+        sum.net_in_bps /= sum.sample_count;
+        sum.net_out_bps /= sum.sample_count;
+        sum.net_in_pps /= sum.sample_count;
+        sum.net_out_pps /= sum.sample_count;
+        aggregates.push_back(sum);
+    }
+}
+
+}
+}
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/mutex.hpp"
+
+#include <stdint.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace baidu {
+namespace galaxy {
+namespace collector {
+
+struct MetrixSample {
+    MetrixSample() :
+        time(0),
+        cpu_used_in_millicore(0),
+        memory_used_in_byte(0),
+        volum_used_in_byte(0),
+        read_bps(0),
+        write_bps(0),
+        read_iops(0),
+        write_iops(0),
+        net_in_bps(0),
+        net_out_bps(0),
+        net_in_pps(0),
+        net_out_pps(0),
+        cpu_max_in_millicore(0),
+        memory_max_in_byte(0),
+        sample_count(0) {
+    }
+
+    int64_t time;  // unit micro second
+    int64_t cpu_used_in_millicore;
+    int64_t memory_used_in_byte;
+    int64_t volum_used_in_byte;
+    // io of all disks
+    int64_t read_bps;
+    int64_t write_bps;
+    int64_t read_iops;
+    int64_t write_iops;
+    // of the host only, containers share its network namespace
+    int64_t net_in_bps;
+    int64_t net_out_bps;
+    int64_t net_in_pps;
+    int64_t net_out_pps;
+    // of the samples aggregated, the fields above are their average,
+    // a raw sample is one of its own
+    int64_t cpu_max_in_millicore;
+    int64_t memory_max_in_byte;
+    int32_t sample_count;
+};
+
+// the latest samples of one container or of the host, in the order they
+// are taken, the oldest one is overwritten when it is full
+class MetrixSeries {
+public:
+    explicit MetrixSeries(size_t capacity);
+    void Append(const MetrixSample& sample);
+    // samples taken in [start, end), oldest first
+    void Range(int64_t start, int64_t end, std::vector<MetrixSample>& samples);
+    size_t Size();
+
+private:
+    boost::mutex mutex_;
+    std::vector<MetrixSample> samples_;
+    size_t next_;  // slot of the next sample
+    size_t size_;
+};
+
+// series of all containers and of the host, the host is the series of id ""
+class MetrixStore {
+public:
+    explicit MetrixStore(size_t capacity);
+    void Append(const std::string& id, const MetrixSample& sample);
+    // drops series of containers not in ids, the host is kept
+    void Retain(const std::set<std::string>& ids);
+    // false if there is no series of id
+    bool Range(const std::string& id,
+            int64_t start,
+            int64_t end,
+            std::vector<MetrixSample>& samples);
+    size_t Size();
+
+    // raw samples in one interval aligned to start are aggregated into one
+    static void Aggregate(const std::vector<MetrixSample>& samples,
+            int64_t start,
+            int64_t interval,
+            std::vector<MetrixSample>& aggregates);
+
+private:
+    const size_t capacity_;
+    boost::mutex mutex_;
+    std::map<std::string, boost::shared_ptr<MetrixSeries> > series_;
+};
+
+}
+}
+}
@@ -49,6 +49,12 @@ namespace baidu {
 namespace galaxy {
 namespace container {
 
+static bool IoOnDisk(const baidu::galaxy::proto::VolumRequired& volum) {
+    return !volum.source_path().empty()
+           && (baidu::galaxy::proto::kSsd == volum.medium()
+               || baidu::galaxy::proto::kDisk == volum.medium());
+}
+
 Container::Container(const ContainerId& id, const baidu::galaxy::proto::ContainerDescription& desc) :
     IContainer(id, desc),
     volum_group_(new baidu::galaxy::volum::VolumGroup()),
@@ -218,6 +224,20 @@ baidu::galaxy::util::ErrorCode Container::Reload(boost::shared_ptr<baidu::galaxy
 }
 
 int Container::ConstructCgroup() {
+    // the volum group is constructed later, the disks of its volums are
+    // those of their source paths, tmpfs and bfs are on no local disk
+    std::vector<std::string> io_paths;
+
+    if (IoOnDisk(desc_.workspace_volum())) {
+        io_paths.push_back(desc_.workspace_volum().source_path());
+    }
+
+    for (int i = 0; i < desc_.data_volums_size(); i++) {
+        if (IoOnDisk(desc_.data_volums(i))) {
+            io_paths.push_back(desc_.data_volums(i).source_path());
+        }
+    }
+
     for (int i = 0; i < desc_.cgroups_size(); i++) {
         boost::shared_ptr<baidu::galaxy::cgroup::Cgroup> cg(new baidu::galaxy::cgroup::Cgroup(
                 baidu::galaxy::cgroup::SubsystemFactory::GetInstance()));
@@ -225,6 +245,7 @@ int Container::ConstructCgroup() {
         desc->CopyFrom(desc_.cgroups(i));
         cg->SetContainerId(id_.SubId());
         cg->SetDescrition(desc);
+        cg->SetIoPaths(io_paths);
         baidu::galaxy::util::ErrorCode err = cg->Construct();
 
         if (0 != err.Code()) {
@@ -617,7 +638,7 @@ boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> Container::ContainerInfo(
     boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> ret(new baidu::galaxy::proto::ContainerInfo());
     ret->set_id(id_.SubId());
     ret->set_group_id(id_.GroupId());
-    ret->set_created_time(0);
+    ret->set_created_time(created_time_);
     ret->set_status(status_.Status());
     ret->set_cpu_used(0);
     boost::shared_ptr<baidu::galaxy::proto::ContainerMetrix> metrix = ContainerMetrix();
@@ -710,17 +731,33 @@ boost::shared_ptr<baidu::galaxy::proto::ContainerMetrix> Container::ContainerMet
     int64_t memory_used_in_byte = 0L;
     int64_t cpu_used_in_millicore = 0L;
 
+    int64_t read_bps = 0L;
+    int64_t write_bps = 0L;
+    int64_t read_iops = 0L;
+    int64_t write_iops = 0L;
+
     for (size_t i = 0; i < cgroup_.size(); i++) {
         boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> m = cgroup_[i]->Statistics();
 
         if (NULL != cm.get()) {
             memory_used_in_byte += m->memory_used_in_byte();
             cpu_used_in_millicore += m->cpu_used_in_millicore();
+
+            for (int j = 0; j < m->blkio_size(); j++) {
+                read_bps += m->blkio(j).read_bps();
+                write_bps += m->blkio(j).write_bps();
+                read_iops += m->blkio(j).read_iops();
+                write_iops += m->blkio(j).write_iops();
+            }
         }
     }
 
     cm->set_memory_used_in_byte(memory_used_in_byte);
     cm->set_cpu_used_in_millicore(cpu_used_in_millicore);
+    cm->set_read_bps(read_bps);
+    cm->set_write_bps(write_bps);
+    cm->set_read_iops(read_iops);
+    cm->set_write_iops(write_iops);
     cm->set_time(baidu::common::timer::get_micros());
     return cm;
 }
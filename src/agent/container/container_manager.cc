@@ -208,8 +208,12 @@ baidu::galaxy::util::ErrorCode ContainerManager::CreateContainer(const Container
         }
     }
 
-    // allcate resource
-    ec = res_man_->Allocate(desc);
+    // allcate resource, unless reserved by resman before
+    if (res_man_->Claim(id.CompactId(), desc)) {
+        ec = ERRORCODE_OK;
+    } else {
+        ec = res_man_->Allocate(desc);
+    }
 
     if (0 != ec.Code()) {
         LOG(WARNING) << "fail in allocating resource for container "
@@ -413,6 +417,25 @@ void ContainerManager::ListContainers(std::vector<boost::shared_ptr<baidu::galax
     }
 }
 
+bool ContainerManager::HasContainer(const ContainerId& id) {
+    boost::mutex::scoped_lock lock(mutex_);
+    return work_containers_.find(id) != work_containers_.end();
+}
+
+void ContainerManager::ListContainerMetrix(std::map<std::string, boost::shared_ptr<baidu::galaxy::proto::ContainerMetrix> >& metrix) {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map<ContainerId, boost::shared_ptr<baidu::galaxy::container::IContainer> >::iterator iter =  work_containers_.begin();
+
+    while (iter != work_containers_.end()) {
+        boost::shared_ptr<baidu::galaxy::proto::ContainerMetrix> cm = iter->second->ContainerMetrix();
+
+        if (NULL != cm.get()) {
+            metrix[iter->first.SubId()] = cm;
+        }
+
+        iter++;
+    }
+}
 
 int ContainerManager::Reload() {
     std::vector<boost::shared_ptr<baidu::galaxy::proto::ContainerMeta> > metas;
@@ -37,6 +37,9 @@ public:
 
     baidu::galaxy::util::ErrorCode ReleaseContainer(const ContainerId& id);
     void ListContainers(std::vector<boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> >& cis, bool fullinfo);
+    bool HasContainer(const ContainerId& id);
+    // key: sub id of the container
+    void ListContainerMetrix(std::map<std::string, boost::shared_ptr<baidu::galaxy::proto::ContainerMetrix> >& metrix);
 
 private:
     baidu::galaxy::util::ErrorCode DependentVolums(const baidu::galaxy::proto::ContainerDescription& desc,
@@ -0,0 +1,191 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "metrix_collector.h"
+#include "container_manager.h"
+#include "cgroup/control_file.h"
+#include "protocol/galaxy.pb.h"
+#include "protocol/agent.pb.h"
+#include "timer.h"
+#include "gflags/gflags.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+DECLARE_int32(metrix_collect_cycle);
+
+namespace baidu {
+namespace galaxy {
+namespace container {
+
+MetrixCollector::MetrixCollector(boost::shared_ptr<ContainerManager> cm,
+        boost::shared_ptr<baidu::galaxy::collector::MetrixStore> store) :
+    cm_(cm),
+    store_(store),
+    enable_(false),
+    cycle_(FLAGS_metrix_collect_cycle),
+    last_net_time_(0L) {
+    assert(NULL != cm_.get());
+    assert(NULL != store_.get());
+}
+
+MetrixCollector::~MetrixCollector() {
+}
+
+baidu::galaxy::util::ErrorCode MetrixCollector::Collect() {
+    std::vector<boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> > cis;
+    cm_->ListContainers(cis, false);
+    std::map<std::string, boost::shared_ptr<baidu::galaxy::proto::ContainerMetrix> > metrix;
+    cm_->ListContainerMetrix(metrix);
+
+    baidu::galaxy::collector::MetrixSample host;
+    host.time = baidu::common::timer::get_micros();
+    std::set<std::string> ids;
+
+    for (size_t i = 0; i < cis.size(); i++) {
+        baidu::galaxy::collector::MetrixSample sample;
+        sample.time = host.time;
+        sample.cpu_used_in_millicore = cis[i]->cpu_used();
+        sample.memory_used_in_byte = cis[i]->memory_used();
+
+        for (int j = 0; j < cis[i]->volum_used_size(); j++) {
+            sample.volum_used_in_byte += cis[i]->volum_used(j).used_size();
+        }
+
+        std::map<std::string, boost::shared_ptr<baidu::galaxy::proto::ContainerMetrix> >::iterator iter =
+            metrix.find(cis[i]->id());
+
+        if (iter != metrix.end()) {
+            sample.read_bps = iter->second->read_bps();
+            sample.write_bps = iter->second->write_bps();
+            sample.read_iops = iter->second->read_iops();
+            sample.write_iops = iter->second->write_iops();
+        }
+
+        store_->Append(cis[i]->id(), sample);
+        ids.insert(cis[i]->id());
+
+        host.cpu_used_in_millicore += sample.cpu_used_in_millicore;
+        host.memory_used_in_byte += sample.memory_used_in_byte;
+        host.volum_used_in_byte += sample.volum_used_in_byte;
+        host.read_bps += sample.read_bps;
+        host.write_bps += sample.write_bps;
+        host.read_iops += sample.read_iops;
+        host.write_iops += sample.write_iops;
+    }
+
+    NetStat(&host);
+    store_->Append("", host);
+    store_->Retain(ids);
+    return ERRORCODE_OK;
+}
+
+void MetrixCollector::NetStat(baidu::galaxy::collector::MetrixSample* host) {
+    std::vector<std::string> lines;
+    NetCounters net;
+
+    if (0 != baidu::galaxy::cgroup::ControlFileCache::GetInstance()->ReadLines("/proc/net/dev", lines).Code()
+            || !ParseNetDev(lines, &net)) {
+        last_net_time_ = 0L;
+        return;
+    }
+
+    NetCounters last = last_net_;
+    int64_t last_time = last_net_time_;
+    last_net_ = net;
+    last_net_time_ = host->time;
+
+    // counters going back mean an interface is gone
+    if (last_time <= 0L
+            || host->time <= last_time
+            || net.in_bytes < last.in_bytes
+            || net.out_bytes < last.out_bytes
+            || net.in_packets < last.in_packets
+            || net.out_packets < last.out_packets) {
+        return;
+    }
+
+    double seconds = (host->time - last_time) / 1000000.0;
+    host->net_in_bps = (int64_t)((net.in_bytes - last.in_bytes) / seconds);
+    host->net_out_bps = (int64_t)((net.out_bytes - last.out_bytes) / seconds);
+    host->net_in_pps = (int64_t)((net.in_packets - last.in_packets) / seconds);
+    host->net_out_pps = (int64_t)((net.out_packets - last.out_packets) / seconds);
+}
+
+bool MetrixCollector::ParseNetDev(const std::vector<std::string>& lines, NetCounters* counters) {
+    assert(NULL != counters);
+    bool has_data = false;
+
+    for (size_t i = 0; i < lines.size(); i++) {
+        //  eth0: 3420117431 5239641 0 0 0 0 0 0 2781538291 4719282 0 0 0 0 0 0
+        size_t colon = lines[i].find(':');
+
+        if (std::string::npos == colon) {
+            continue;
+        }
+
+        std::string name = lines[i].substr(0, colon);
+        name.erase(0, name.find_first_not_of(' '));
+
+        if (name.empty() || name == "lo") {
+            continue;
+        }
+
+        long long int in_bytes = 0L;
+        long long int in_packets = 0L;
+        long long int out_bytes = 0L;
+        long long int out_packets = 0L;
+        long long int skip = 0L;
+
+        if (10 == sscanf(lines[i].c_str() + colon + 1,
+                "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
+                &in_bytes,
+                &in_packets,
+                &skip,
+                &skip,
+                &skip,
+                &skip,
+                &skip,
+                &skip,
+                &out_bytes,
+                &out_packets)) {
+            counters->in_bytes += in_bytes;
+            counters->in_packets += in_packets;
+            counters->out_bytes += out_bytes;
+            counters->out_packets += out_packets;
+            has_data = true;
+        }
+    }
+
+    return has_data;
+}
+
+void MetrixCollector::Enable(bool enable) {
+    enable_ = enable;
+}
+
+bool MetrixCollector::Enabled() {
+    return enable_;
+}
+
+bool MetrixCollector::Equal(const Collector* c) {
+    assert(NULL != c);
+    return Name() == c->Name();
+}
+
+int MetrixCollector::Cycle() {
+    return cycle_;
+}
+
+std::string MetrixCollector::Name() const {
+    return "metrix_collector";
+}
+
+}
+}
+}
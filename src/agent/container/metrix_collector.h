@@ -0,0 +1,71 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+#include "collector/collector.h"
+#include "collector/metrix_store.h"
+#include "util/error_code.h"
+#include "boost/shared_ptr.hpp"
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace baidu {
+namespace galaxy {
+namespace container {
+
+class ContainerManager;
+
+// samples usage of each container and of the host into a metrix store
+class MetrixCollector : public baidu::galaxy::collector::Collector {
+public:
+    // counters of all interfaces but lo
+    struct NetCounters {
+        NetCounters() :
+            in_bytes(0),
+            out_bytes(0),
+            in_packets(0),
+            out_packets(0) {
+        }
+
+        int64_t in_bytes;
+        int64_t out_bytes;
+        int64_t in_packets;
+        int64_t out_packets;
+    };
+
+
+    MetrixCollector(boost::shared_ptr<ContainerManager> cm,
+            boost::shared_ptr<baidu::galaxy::collector::MetrixStore> store);
+    ~MetrixCollector();
+
+    baidu::galaxy::util::ErrorCode Collect();
+    void Enable(bool enable);
+    bool Enabled();
+    bool Equal(const Collector*);
+    int Cycle(); // unit second
+    std::string Name() const;
+
+    // lines of /proc/net/dev, false if there is no interface in them
+    static bool ParseNetDev(const std::vector<std::string>& lines, NetCounters* counters);
+
+private:
+    // rates of the host network from the previous cycle, as the cgroup
+    // collector does for cpu, nothing to compare with in the first one
+    void NetStat(baidu::galaxy::collector::MetrixSample* host);
+
+    boost::shared_ptr<ContainerManager> cm_;
+    boost::shared_ptr<baidu::galaxy::collector::MetrixStore> store_;
+    bool enable_;
+    int cycle_;
+    // only Collect touches them, the engine never runs it twice at once
+    NetCounters last_net_;
+    int64_t last_net_time_;
+};
+
+}
+}
+}
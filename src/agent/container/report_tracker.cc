@@ -0,0 +1,139 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "report_tracker.h"
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <stdlib.h>
+
+DECLARE_double(report_usage_change_ratio);
+DECLARE_int32(report_max_removed);
+
+namespace baidu {
+namespace galaxy {
+namespace container {
+
+ReportTracker::ReportTracker(int64_t base_seq) :
+    seq_(base_seq),
+    floor_seq_(base_seq) {
+}
+
+ReportTracker::~ReportTracker() {
+}
+
+bool ReportTracker::Diff(const std::vector<boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> >& cis,
+        int64_t since_seq,
+        int64_t* seq,
+        std::vector<boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> >& changed,
+        std::vector<std::string>& removed) {
+    MutexLock lock(&mutex_);
+    std::set<std::string> seen;
+
+    for (size_t i = 0; i < cis.size(); i++) {
+        const baidu::galaxy::proto::ContainerInfo& ci = *cis[i];
+        std::string key = Key(ci);
+        std::map<std::string, Entry>::iterator iter = entries_.find(ci.id());
+
+        if (iter == entries_.end() || Changed(iter->second, key, ci)) {
+            Entry& entry = entries_[ci.id()];
+            entry.seq = ++seq_;
+            entry.key = key;
+            entry.cpu_used = ci.cpu_used();
+            entry.memory_used = ci.memory_used();
+            entry.volum_used = VolumUsed(ci);
+        }
+
+        seen.insert(ci.id());
+    }
+
+    std::map<std::string, Entry>::iterator iter = entries_.begin();
+
+    while (iter != entries_.end()) {
+        if (seen.find(iter->first) == seen.end()) {
+            removed_[++seq_] = iter->first;
+            entries_.erase(iter++);
+        } else {
+            iter++;
+        }
+    }
+
+    while (removed_.size() > (size_t)FLAGS_report_max_removed) {
+        floor_seq_ = removed_.begin()->first;
+        removed_.erase(removed_.begin());
+    }
+
+    *seq = seq_;
+
+    if (since_seq < floor_seq_ || since_seq > seq_) {
+        return false;
+    }
+
+    for (size_t i = 0; i < cis.size(); i++) {
+        if (entries_[cis[i]->id()].seq > since_seq) {
+            changed.push_back(cis[i]);
+        }
+    }
+
+    std::map<int64_t, std::string>::const_iterator rit = removed_.upper_bound(since_seq);
+
+    for (; rit != removed_.end(); rit++) {
+        removed.push_back(rit->second);
+    }
+
+    return true;
+}
+
+std::string ReportTracker::Key(const baidu::galaxy::proto::ContainerInfo& ci) {
+    // everything but usage and the full description, built from the fields
+    // as this runs for every container on every query
+    std::stringstream ss;
+    ss << ci.group_id() << "|" << ci.created_time() << "|" << ci.status()
+       << "|" << ci.container_desc().version() << "|" << ci.restart_counter()
+       << "|" << ci.memory_fail_cnt() << "|";
+
+    for (int i = 0; i < ci.volum_used_size(); i++) {
+        const baidu::galaxy::proto::Volum& volum = ci.volum_used(i);
+        ss << volum.path() << ":" << volum.device_path() << ":" << volum.medium()
+           << ":" << volum.assigned_size() << ":" << volum.exclusive() << ",";
+    }
+
+    ss << "|";
+
+    for (int i = 0; i < ci.port_used_size(); i++) {
+        ss << ci.port_used(i) << ",";
+    }
+
+    return ss.str();
+}
+
+bool ReportTracker::Drift(int64_t reported, int64_t now) {
+    int64_t base = std::max(llabs(reported), llabs(now));
+    return llabs(now - reported) > base * FLAGS_report_usage_change_ratio;
+}
+
+int64_t ReportTracker::VolumUsed(const baidu::galaxy::proto::ContainerInfo& ci) {
+    int64_t used = 0L;
+
+    for (int i = 0; i < ci.volum_used_size(); i++) {
+        used += ci.volum_used(i).used_size();
+    }
+
+    return used;
+}
+
+bool ReportTracker::Changed(const Entry& entry, const std::string& key,
+        const baidu::galaxy::proto::ContainerInfo& ci) {
+    return entry.key != key
+           || Drift(entry.cpu_used, ci.cpu_used())
+           || Drift(entry.memory_used, ci.memory_used())
+           || Drift(entry.volum_used, VolumUsed(ci));
+}
+
+}
+}
+}
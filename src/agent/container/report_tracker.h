@@ -0,0 +1,65 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+#include "protocol/galaxy.pb.h"
+#include "boost/shared_ptr.hpp"
+#include <mutex.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace baidu {
+namespace galaxy {
+namespace container {
+
+// Keeps a monotonic seq of the container reports of agent, so that RM can
+// ask for containers changed since a former report instead of all of them.
+// Usage drifting less than FLAGS_report_usage_change_ratio is not a change.
+class ReportTracker {
+public:
+    // seq starts from base_seq, use the start time of agent to make seqs of
+    // a restarted agent unknown to the former one
+    explicit ReportTracker(int64_t base_seq);
+    ~ReportTracker();
+
+    // Records the current reports and returns the seq after them in seq.
+    // changed and removed are filled with containers changed and removed
+    // after since_seq; returns false if since_seq is unknown, then a full
+    // report is needed
+    bool Diff(const std::vector<boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> >& cis,
+            int64_t since_seq,
+            int64_t* seq,
+            std::vector<boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> >& changed,
+            std::vector<std::string>& removed);
+
+private:
+    struct Entry {
+        int64_t seq;
+        std::string key;
+        // usage in the last report of the container
+        int64_t cpu_used;
+        int64_t memory_used;
+        int64_t volum_used;
+    };
+
+    static std::string Key(const baidu::galaxy::proto::ContainerInfo& ci);
+    static bool Drift(int64_t reported, int64_t now);
+    static int64_t VolumUsed(const baidu::galaxy::proto::ContainerInfo& ci);
+    static bool Changed(const Entry& entry, const std::string& key,
+            const baidu::galaxy::proto::ContainerInfo& ci);
+
+    Mutex mutex_;
+    int64_t seq_;
+    // deltas after floor_seq_ can be served
+    int64_t floor_seq_;
+    std::map<std::string, Entry> entries_;
+    // seq of removal -> container id
+    std::map<int64_t, std::string> removed_;
+};
+
+}
+}
+}
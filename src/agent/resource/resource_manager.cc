@@ -9,6 +9,7 @@
 #include "memory_resource.h"
 #include "volum_resource.h"
 #include <boost/thread/lock_guard.hpp>
+#include "timer.h"
 
 #include <glog/logging.h>
 
@@ -50,11 +51,16 @@ std::string ResourceManager::ToString() {
 }
 
 baidu::galaxy::util::ErrorCode ResourceManager::Allocate(const baidu::galaxy::proto::ContainerDescription& desc) {
+    boost::mutex::scoped_lock lock(mutex_);
+    ExpireLeasesLocked(baidu::common::timer::get_micros());
+    return DoAllocate(desc);
+}
+
+baidu::galaxy::util::ErrorCode ResourceManager::DoAllocate(const baidu::galaxy::proto::ContainerDescription& desc) {
     int64_t memroy_require = 0;
     int64_t cpu_millicores = 0;
     std::vector<const baidu::galaxy::proto::VolumRequired*> vv;
     CalResource(desc, cpu_millicores, memroy_require, vv);
-    boost::mutex::scoped_lock lock(mutex_);
 
     if (desc.priority() != proto::kJobBestEffort) {
         // allocate cpu
@@ -105,11 +111,15 @@ baidu::galaxy::util::ErrorCode ResourceManager::Allocate(std::vector<const baidu
 
 
 baidu::galaxy::util::ErrorCode ResourceManager::Release(const baidu::galaxy::proto::ContainerDescription& desc) {
+    boost::mutex::scoped_lock lock(mutex_);
+    return DoRelease(desc);
+}
+
+baidu::galaxy::util::ErrorCode ResourceManager::DoRelease(const baidu::galaxy::proto::ContainerDescription& desc) {
     int64_t memroy_require = 0;
     int64_t cpu_millicores = 0;
     std::vector<const baidu::galaxy::proto::VolumRequired*> vv;
     CalResource(desc, cpu_millicores, memroy_require, vv);
-    boost::mutex::scoped_lock lock(mutex_);
     if (desc.priority() != proto::kJobBestEffort) {
         int ret = cpu_->Release(cpu_millicores);
 
@@ -137,6 +147,76 @@ baidu::galaxy::util::ErrorCode ResourceManager::Release(const baidu::galaxy::pro
     return ERRORCODE_OK;
 }
 
+baidu::galaxy::util::ErrorCode ResourceManager::Reserve(const std::string& key,
+        const baidu::galaxy::proto::ContainerDescription& desc,
+        int64_t lease_ms) {
+    boost::mutex::scoped_lock lock(mutex_);
+    int64_t now = baidu::common::timer::get_micros();
+    ExpireLeasesLocked(now);
+    std::map<std::string, Lease>::iterator iter = leases_.find(key);
+
+    if (iter != leases_.end()) {
+        if (iter->second.desc->SerializeAsString() == desc.SerializeAsString()) {
+            iter->second.expire_time = now + lease_ms * 1000;
+            return ERRORCODE_OK;
+        }
+
+        // the container is placed with another desc, e.g. after an update
+        DoRelease(*iter->second.desc);
+        leases_.erase(iter);
+    }
+
+    baidu::galaxy::util::ErrorCode ec = DoAllocate(desc);
+
+    if (0 != ec.Code()) {
+        return ec;
+    }
+
+    Lease& lease = leases_[key];
+    lease.desc.reset(new baidu::galaxy::proto::ContainerDescription(desc));
+    lease.expire_time = now + lease_ms * 1000;
+    return ERRORCODE_OK;
+}
+
+bool ResourceManager::Claim(const std::string& key,
+        const baidu::galaxy::proto::ContainerDescription& desc) {
+    boost::mutex::scoped_lock lock(mutex_);
+    ExpireLeasesLocked(baidu::common::timer::get_micros());
+    std::map<std::string, Lease>::iterator iter = leases_.find(key);
+
+    if (iter == leases_.end()) {
+        return false;
+    }
+
+    bool same = iter->second.desc->SerializeAsString() == desc.SerializeAsString();
+
+    if (!same) {
+        DoRelease(*iter->second.desc);
+    }
+
+    leases_.erase(iter);
+    return same;
+}
+
+void ResourceManager::ExpireLeases() {
+    boost::mutex::scoped_lock lock(mutex_);
+    ExpireLeasesLocked(baidu::common::timer::get_micros());
+}
+
+void ResourceManager::ExpireLeasesLocked(int64_t now) {
+    std::map<std::string, Lease>::iterator iter = leases_.begin();
+
+    while (iter != leases_.end()) {
+        if (iter->second.expire_time <= now) {
+            LOG(INFO) << "lease of " << iter->first << " expired";
+            DoRelease(*iter->second.desc);
+            leases_.erase(iter++);
+        } else {
+            iter++;
+        }
+    }
+}
+
 int ResourceManager::Resource(boost::shared_ptr<void> resource) {
     assert(0);
     return -1;
@@ -13,6 +13,8 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include <map>
+#include <string>
 #include <vector>
 
 namespace baidu {
@@ -34,6 +36,15 @@ public:
 
     baidu::galaxy::util::ErrorCode Allocate(const baidu::galaxy::proto::ContainerDescription& desc);
     baidu::galaxy::util::ErrorCode Release(const baidu::galaxy::proto::ContainerDescription& desc);
+    // holds the resource of desc for the container of key, the lease is
+    // released unless claimed in lease_ms; reserving again renews it
+    baidu::galaxy::util::ErrorCode Reserve(const std::string& key,
+            const baidu::galaxy::proto::ContainerDescription& desc,
+            int64_t lease_ms);
+    // turns the lease of key into the allocation of desc, false if there is
+    // no lease of the same desc, any lease left is released then
+    bool Claim(const std::string& key, const baidu::galaxy::proto::ContainerDescription& desc);
+    void ExpireLeases();
     int Resource(boost::shared_ptr<void> resource);
 
     boost::shared_ptr<baidu::galaxy::proto::Resource> GetCpuResource();
@@ -41,6 +52,13 @@ public:
     void GetVolumResource(std::vector<boost::shared_ptr<baidu::galaxy::proto::VolumResource> >& resource);
 
 private:
+    struct Lease {
+        boost::shared_ptr<baidu::galaxy::proto::ContainerDescription> desc;
+        int64_t expire_time;
+    };
+    baidu::galaxy::util::ErrorCode DoAllocate(const baidu::galaxy::proto::ContainerDescription& desc);
+    baidu::galaxy::util::ErrorCode DoRelease(const baidu::galaxy::proto::ContainerDescription& desc);
+    void ExpireLeasesLocked(int64_t now);
     baidu::galaxy::util::ErrorCode Allocate(std::vector<const baidu::galaxy::proto::VolumRequired*>& vv);
     void CalResource(const baidu::galaxy::proto::ContainerDescription& desc,
             int64_t& cpu_millicores,
@@ -50,6 +68,7 @@ private:
     boost::scoped_ptr<CpuResource> cpu_;
     boost::scoped_ptr<MemoryResource> memory_;
     boost::scoped_ptr<VolumResource> volum_;
+    std::map<std::string, Lease> leases_;
 
 };
 
@@ -3,6 +3,9 @@
 DEFINE_string(nexus_root, "", "root prefix on nexus");
 DEFINE_string(nexus_addr, "", "nexus server list");
 DEFINE_string(jobs_store_path, "/jobs", "appmaster jobs store path");
+DEFINE_bool(meta_compact_encoding, false, "write jobs with the versioned encoding, job descriptions stored once per content");
+DEFINE_bool(meta_migrate, false, "rewrite the jobs written before meta_compact_encoding while reloading them, with meta_compact_encoding only");
+DEFINE_int64(meta_compress_min_size, 512, "compress encoded job records not shorter than this, negative to never compress");
 DEFINE_string(appmaster_port, "1647", "appmaster listen port");
 DEFINE_string(appworker_cmdline, "", "appworker default cmdline");
 DEFINE_int32(master_job_check_interval, 5, "master job checker interval");
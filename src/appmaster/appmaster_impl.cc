@@ -15,10 +15,13 @@
 #include <boost/scoped_ptr.hpp>
 #include <snappy.h>
 #include "utils/event_log.h"
+#include "utils/meta_codec.h"
 
 DECLARE_string(nexus_root);
 DECLARE_string(nexus_addr);
 DECLARE_string(jobs_store_path);
+DECLARE_bool(meta_compact_encoding);
+DECLARE_bool(meta_migrate);
 DECLARE_string(appworker_cmdline);
 DECLARE_int32(safe_interval);
 DECLARE_string(appmaster_path);
@@ -61,6 +64,23 @@ void AppMasterImpl::Init() {
 }
 
 void AppMasterImpl::ReloadAppInfo() {
+    // descs stored apart, by digest
+    std::map<std::string, JobDescription> descs;
+    std::string desc_start_key = FLAGS_nexus_root
+                                 + MetaCodec::DescPrefix(FLAGS_jobs_store_path) + "/";
+    ::galaxy::ins::sdk::ScanResult* desc_result = nexus_->Scan(desc_start_key,
+                                                               desc_start_key + "~");
+    while (!desc_result->Done()) {
+        assert(desc_result->Error() == ::galaxy::ins::sdk::kOK);
+        std::string payload;
+        if (!MetaCodec::Decode(desc_result->Value(), &payload)
+            || !descs[desc_result->Key().substr(desc_start_key.size())].ParseFromString(payload)) {
+            LOG(WARNING) << "faild to parse job desc: " << desc_result->Key();
+        }
+        desc_result->Next();
+    }
+    delete desc_result;
+
     std::string start_key = FLAGS_nexus_root + FLAGS_jobs_store_path + "/";
     std::string end_key = start_key + "~";
     ::galaxy::ins::sdk::ScanResult* result = nexus_->Scan(start_key, end_key);
@@ -68,12 +88,28 @@ void AppMasterImpl::ReloadAppInfo() {
     while (!result->Done()) {
         assert(result->Error() == ::galaxy::ins::sdk::kOK);
         std::string key = result->Key();
-        std::string job_raw_data = result->Value();
+        std::string job_raw_data;
         JobInfo job_info;
-        bool ok = job_info.ParseFromString(job_raw_data);
+        bool ok = MetaCodec::Decode(result->Value(), &job_raw_data)
+                  && job_info.ParseFromString(job_raw_data);
+        if (ok && job_info.has_desc_digest()) {
+            std::map<std::string, JobDescription>::const_iterator desc_it;
+            std::map<std::string, JobDescription>::const_iterator last_desc_it;
+            desc_it = descs.find(job_info.desc_digest());
+            last_desc_it = descs.find(job_info.last_desc_digest());
+            ok = desc_it != descs.end() && last_desc_it != descs.end();
+            if (ok) {
+                job_info.mutable_desc()->CopyFrom(desc_it->second);
+                job_info.mutable_last_desc()->CopyFrom(last_desc_it->second);
+            }
+        }
         if (ok) {
             LOG(INFO) << "reload job: " << job_info.jobid();
             job_manager_.ReloadJobInfo(job_info);
+            if (FLAGS_meta_compact_encoding && FLAGS_meta_migrate
+                && !MetaCodec::IsEncoded(result->Value())) {
+                job_manager_.MigrateJob(job_info.jobid());
+            }
         } else {
             LOG(WARNING) <<  "faild to parse job_info: " << key;
         }
@@ -178,6 +214,7 @@ void AppMasterImpl::BuildContainerDescription(const ::baidu::galaxy::proto::JobD
     container_desc->set_run_user(job_desc.run_user());
     container_desc->set_version(job_desc.version());
     container_desc->set_max_per_host(job_desc.deploy().max_per_host());
+    container_desc->set_gang(job_desc.deploy().gang());
     container_desc->set_tag(job_desc.deploy().tag());
 
     if (job_desc.has_volum_view()) {
@@ -228,6 +265,9 @@ void AppMasterImpl::BuildContainerDescription(const ::baidu::galaxy::proto::JobD
     for (int i = 0; i < job_desc.volum_jobs_size(); i++) {
         container_desc->add_volum_jobs(job_desc.volum_jobs(i));
     }
+    for (int i = 0; i < job_desc.deploy().anti_affinity_jobs_size(); i++) {
+        container_desc->add_anti_affinity_groups(job_desc.deploy().anti_affinity_jobs(i));
+    }
     container_desc->mutable_workspace_volum()->CopyFrom(job_desc.pod().workspace_volum());
     container_desc->mutable_data_volums()->CopyFrom(job_desc.pod().data_volums());
     for (int i = 0; i < job_desc.pod().tasks_size(); i++) {
@@ -16,6 +16,8 @@ DECLARE_int32(master_pod_check_interval);
 DECLARE_int32(master_pod_dead_time);
 DECLARE_int32(master_fail_last_threshold);
 DECLARE_string(jobs_store_path);
+DECLARE_bool(meta_compact_encoding);
+DECLARE_int64(meta_compress_min_size);
 
 namespace baidu {
 namespace galaxy {
@@ -1259,6 +1261,13 @@ void JobManager::ReloadJobInfo(const JobInfo& job_info) {
             }
         }
     }
+    if (job_info.has_desc_digest()) {
+        std::set<std::string> digests;
+        digests.insert(job_info.desc_digest());
+        digests.insert(job_info.last_desc_digest());
+        MutexLock desc_lock(&desc_mutex_);
+        desc_refs_.Assign(job->id_, digests, NULL, NULL);
+    }
     MutexLock lock(&mutex_);
     jobs_[job->id_] = job;
     job_checker_.DelayTask(FLAGS_master_job_check_interval * 1000, boost::bind(&JobManager::CheckJobStatus, this, job));
@@ -1336,41 +1345,108 @@ bool JobManager::SaveToNexus(const Job* job) {
     JobInfo job_info;
     job_info.set_jobid(job->id_);
     job_info.set_status(job->status_);
-    job_info.mutable_last_desc()->CopyFrom(job->last_desc_);
-    job_info.mutable_desc()->CopyFrom(job->desc_);
-    job_info.mutable_user()->CopyFrom(job->user_);
     job_info.set_action(job->action_type_);
+    job_info.mutable_user()->CopyFrom(job->user_);
     job_info.set_create_time(job->create_time_);
     job_info.set_update_time(job->update_time_);
     job_info.set_rollback_time(job->rollback_time_);
 
+    // digest -> serialized desc, desc and last_desc are mostly the same
+    std::map<std::string, std::string> desc_bufs;
+    std::set<std::string> digests;
+    if (FLAGS_meta_compact_encoding) {
+        std::string desc_buf = job->desc_.SerializeAsString();
+        std::string last_desc_buf = job->last_desc_.SerializeAsString();
+        job_info.set_desc_digest(MetaCodec::Digest(desc_buf));
+        job_info.set_last_desc_digest(MetaCodec::Digest(last_desc_buf));
+        desc_bufs[job_info.desc_digest()] = desc_buf;
+        desc_bufs[job_info.last_desc_digest()] = last_desc_buf;
+        digests.insert(job_info.desc_digest());
+        digests.insert(job_info.last_desc_digest());
+    } else {
+        job_info.mutable_last_desc()->CopyFrom(job->last_desc_);
+        job_info.mutable_desc()->CopyFrom(job->desc_);
+    }
+
     std::string job_raw_data;
     std::string job_key = FLAGS_nexus_root + FLAGS_jobs_store_path
                           + "/" + job->id_;
     job_info.SerializeToString(&job_raw_data);
+    if (FLAGS_meta_compact_encoding) {
+        std::string record;
+        MetaCodec::Encode(job_raw_data, FLAGS_meta_compress_min_size, &record);
+        job_raw_data.swap(record);
+    }
+    std::string desc_key_prefix = FLAGS_nexus_root
+                                  + MetaCodec::DescPrefix(FLAGS_jobs_store_path) + "/";
+    // a desc is not deleted while another job starts to refer to it
+    MutexLock lock(&desc_mutex_);
+    std::set<std::string> old_digests;
+    desc_refs_.Get(job->id_, &old_digests);
+    std::vector<std::string> added;
+    std::vector<std::string> released;
+    desc_refs_.Assign(job->id_, digests, &added, &released);
     ::galaxy::ins::sdk::SDKError err;
-    bool put_ok = nexus_->Put(job_key, job_raw_data, &err);
+    bool put_ok = true;
+    for (size_t i = 0; i < added.size() && put_ok; i++) {
+        std::string desc_record;
+        MetaCodec::Encode(desc_bufs[added[i]], FLAGS_meta_compress_min_size, &desc_record);
+        put_ok = nexus_->Put(desc_key_prefix + added[i], desc_record, &err);
+    }
+    if (put_ok) {
+        put_ok = nexus_->Put(job_key, job_raw_data, &err);
+    }
     if (!put_ok) {
-        LOG(WARNING) << "fail to put job " <<job_info.desc().name()
+        LOG(WARNING) << "fail to put job " << job->desc_.name()
         << " id " << job_info.jobid() << " to nexus err msg"
         << ::galaxy::ins::sdk::InsSDK::StatusToString(err);
+        released.clear();
+        desc_refs_.Assign(job->id_, old_digests, NULL, &released);
     }
+    DeleteDescs(released);
     return true;
 }
 
 bool JobManager::DeleteFromNexus(const JobId& job_id) {
     std::string job_key = FLAGS_nexus_root + FLAGS_jobs_store_path
                           + "/" + job_id;
+    MutexLock lock(&desc_mutex_);
     ::galaxy::ins::sdk::SDKError err;
     bool delete_ok = nexus_->Delete(job_key, &err);
     if (!delete_ok) {
         LOG(WARNING) << "fail to delete job :" << job_key
         << "from nexus err msg "
         << ::galaxy::ins::sdk::InsSDK::StatusToString(err);
+        return true;
     }
+    std::vector<std::string> released;
+    desc_refs_.Assign(job_id, std::set<std::string>(), NULL, &released);
+    DeleteDescs(released);
     return true;
 }
 
+void JobManager::DeleteDescs(const std::vector<std::string>& digests) {
+    desc_mutex_.AssertHeld();
+    std::string desc_key_prefix = FLAGS_nexus_root
+                                  + MetaCodec::DescPrefix(FLAGS_jobs_store_path) + "/";
+    for (size_t i = 0; i < digests.size(); i++) {
+        ::galaxy::ins::sdk::SDKError err;
+        if (!nexus_->Delete(desc_key_prefix + digests[i], &err)) {
+            LOG(WARNING) << "fail to delete job desc :" << digests[i]
+            << " from nexus err msg "
+            << ::galaxy::ins::sdk::InsSDK::StatusToString(err);
+        }
+    }
+}
+
+void JobManager::MigrateJob(const JobId& job_id) {
+    MutexLock lock(&mutex_);
+    std::map<JobId, Job*>::iterator job_it = jobs_.find(job_id);
+    if (job_it != jobs_.end()) {
+        SaveToNexus(job_it->second);
+    }
+}
+
 void JobManager::SetResmanEndpoint(std::string new_endpoint) {
     MutexLock lock(&resman_mutex_);
     resman_endpoint_ = new_endpoint;
@@ -14,6 +14,7 @@
 #include "protocol/galaxy.pb.h"
 #include "rpc/rpc_client.h"
 #include "naming/private_sdk.h"
+#include "utils/meta_codec.h"
 
 namespace baidu {
 namespace galaxy {
@@ -140,6 +141,8 @@ public:
                             const std::string podid, proto::ForceAction action);
 
     void ReloadJobInfo(const JobInfo& job_info);
+    // rewrites the job stored before the compact encoding
+    void MigrateJob(const JobId& job_id);
     void GetJobsOverview(JobOverviewList* jobs_overview);
     void SetResmanEndpoint(std::string new_endpoint);
     Status GetJobInfo(const JobId& jobid, JobInfo* job_info);
@@ -179,6 +182,7 @@ private:
     Status DistroyPod(Job* job, void* arg);
     bool SaveToNexus(const Job* job);
     bool DeleteFromNexus(const JobId& job_id);
+    void DeleteDescs(const std::vector<std::string>& digests);
     Status ContinueUpdateJob(Job* job, void* arg);
     Status RollbackJob(Job* job, void* arg);
     Status PauseUpdatePod(Job* job, void* arg);
@@ -208,6 +212,9 @@ private:
     ThreadPool pod_checker_;
     Mutex mutex_;
     Mutex resman_mutex_;
+    // descs of jobs stored apart, see MetaCodec
+    Mutex desc_mutex_;
+    DescRefs desc_refs_;
     std::string resman_endpoint_;
     RpcClient rpc_client_;
     // nexus
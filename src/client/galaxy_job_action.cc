@@ -1127,6 +1127,20 @@ bool JobAction::GenerateJson(const std::string& jobid) {
 
         rapidjson::Value blkio(rapidjson::kObjectType);
         blkio.AddMember("weight", sdk_task.blkio.weight, allocator);
+        if (sdk_task.blkio.read_bps_limit > 0) {
+            obj_str.SetString(StringUnit(sdk_task.blkio.read_bps_limit).c_str(), allocator);
+            blkio.AddMember("read_bps_limit", obj_str, allocator);
+        }
+        if (sdk_task.blkio.write_bps_limit > 0) {
+            obj_str.SetString(StringUnit(sdk_task.blkio.write_bps_limit).c_str(), allocator);
+            blkio.AddMember("write_bps_limit", obj_str, allocator);
+        }
+        if (sdk_task.blkio.read_iops_limit > 0) {
+            blkio.AddMember("read_iops_limit", sdk_task.blkio.read_iops_limit, allocator);
+        }
+        if (sdk_task.blkio.write_iops_limit > 0) {
+            blkio.AddMember("write_iops_limit", sdk_task.blkio.write_iops_limit, allocator);
+        }
 
         rapidjson::Value ports(rapidjson::kArrayType);
         for (uint32_t j = 0; j < sdk_task.ports.size(); ++j) {
@@ -414,6 +414,21 @@ int ParseBlkio(const rapidjson::Value& blkio_json, ::baidu::galaxy::sdk::BlkioRe
         return -1;
     }
     blkio->weight = blkio_json["weight"].GetInt();
+
+    if (blkio_json.HasMember("read_bps_limit")
+            && 0 != UnitStringToByte(blkio_json["read_bps_limit"].GetString(), &blkio->read_bps_limit)) {
+        return -1;
+    }
+    if (blkio_json.HasMember("write_bps_limit")
+            && 0 != UnitStringToByte(blkio_json["write_bps_limit"].GetString(), &blkio->write_bps_limit)) {
+        return -1;
+    }
+    if (blkio_json.HasMember("read_iops_limit")) {
+        blkio->read_iops_limit = blkio_json["read_iops_limit"].GetInt64();
+    }
+    if (blkio_json.HasMember("write_iops_limit")) {
+        blkio->write_iops_limit = blkio_json["write_iops_limit"].GetInt64();
+    }
     return 0;
 }
 
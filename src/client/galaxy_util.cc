@@ -376,6 +376,9 @@ std::string StringStatus(const ::baidu::galaxy::sdk::Status& status) {
     case ::baidu::galaxy::sdk::kManualQuit:
         result = "kManualQuit";
         break;
+    case ::baidu::galaxy::sdk::kThrottled:
+        result = "kThrottled";
+        break;
     default:
         result = "";
     }
@@ -0,0 +1,90 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// compare the best-fit-decreasing volum solver with the exhaustive search
+// on synthetic disk layouts
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include "resman/volum_solver.h"
+#include "timer.h"
+
+namespace sched = baidu::galaxy::sched;
+namespace proto = baidu::galaxy::proto;
+
+const int64_t kGB = 1024L * 1024 * 1024;
+
+void MakeLayout(int disk_num, std::map<sched::DevicePath, sched::VolumInfo>& volum_free) {
+    for (int i = 0; i < disk_num; i++) {
+        std::stringstream ss;
+        ss << "/home/disk" << i;
+        sched::VolumInfo& info = volum_free[ss.str()];
+        info.medium = (i % 4 == 3) ? proto::kSsd : proto::kDisk;
+        info.size = (100 + rand() % 1900) * kGB;
+        info.exclusive = (rand() % 10 == 0);
+    }
+}
+
+void MakeVolums(int volum_num, std::vector<proto::VolumRequired>& volums) {
+    for (int i = 0; i < volum_num; i++) {
+        proto::VolumRequired volum;
+        volum.set_medium((rand() % 5 == 0) ? proto::kSsd : proto::kDisk);
+        volum.set_size((10 + rand() % 990) * kGB);
+        volum.set_exclusive(rand() % 3 == 0);
+        volums.push_back(volum);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " disk_num volum_num [rounds] [seed]" << std::endl;
+        return -1;
+    }
+    int disk_num = atoi(argv[1]);
+    int volum_num = atoi(argv[2]);
+    int rounds = argc > 3 ? atoi(argv[3]) : 1000;
+    srand(argc > 4 ? atoi(argv[4]) : 0);
+
+    int64_t best_fit_cost = 0;
+    int64_t exhaustive_cost = 0;
+    int best_fit_ok = 0;
+    int exhaustive_ok = 0;
+    int select_ok = 0;
+    for (int r = 0; r < rounds; r++) {
+        std::map<sched::DevicePath, sched::VolumInfo> volum_free;
+        std::vector<proto::VolumRequired> volums;
+        MakeLayout(disk_num, volum_free);
+        MakeVolums(volum_num, volums);
+
+        std::vector<sched::DevicePath> devices;
+        int64_t start = baidu::common::timer::get_micros();
+        if (sched::BestFitVolumDevices(volums, volum_free, devices)) {
+            best_fit_ok++;
+        }
+        best_fit_cost += baidu::common::timer::get_micros() - start;
+
+        devices.clear();
+        start = baidu::common::timer::get_micros();
+        if (sched::ExhaustiveVolumDevices(volums, volum_free, devices)) {
+            exhaustive_ok++;
+        }
+        exhaustive_cost += baidu::common::timer::get_micros() - start;
+
+        devices.clear();
+        if (sched::SelectVolumDevices(volums, volum_free, devices)) {
+            select_ok++;
+        }
+    }
+    printf("disks: %d, volums: %d, rounds: %d\n", disk_num, volum_num, rounds);
+    printf("best-fit:   %6d placed, %10ld us total, %8.2f us/round\n",
+           best_fit_ok, best_fit_cost, (double)best_fit_cost / rounds);
+    printf("exhaustive: %6d placed, %10ld us total, %8.2f us/round\n",
+           exhaustive_ok, exhaustive_cost, (double)exhaustive_cost / rounds);
+    printf("select:     %6d placed\n", select_ok);
+    return 0;
+}
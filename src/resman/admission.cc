@@ -0,0 +1,91 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "admission.h"
+#include <string.h>
+#include <algorithm>
+
+namespace baidu {
+namespace galaxy {
+
+Admission::Admission() {
+    for (int i = 0; i < 2; i++) {
+        rate_[i] = 0;
+        burst_[i] = 0;
+    }
+}
+
+void Admission::SetLimit(Kind kind, double rate, double burst) {
+    MutexLock lock(&mu_);
+    rate_[kind] = rate;
+    burst_[kind] = std::max(burst, 1.0);
+    buckets_[kind].clear();
+}
+
+void Admission::SetUsers(const std::set<std::string>& users) {
+    MutexLock lock(&mu_);
+    users_ = users;
+    for (int i = 0; i < 2; i++) {
+        std::map<std::string, Bucket>::iterator it = buckets_[i].begin();
+        while (it != buckets_[i].end()) {
+            if (!it->first.empty() && users_.find(it->first) == users_.end()) {
+                buckets_[i].erase(it++);
+            } else {
+                it++;
+            }
+        }
+    }
+}
+
+void Admission::AddUser(const std::string& user) {
+    MutexLock lock(&mu_);
+    users_.insert(user);
+}
+
+void Admission::RemoveUser(const std::string& user) {
+    MutexLock lock(&mu_);
+    users_.erase(user);
+    for (int i = 0; i < 2; i++) {
+        buckets_[i].erase(user);
+    }
+}
+
+bool Admission::Admit(const std::string& user, Kind kind, int64_t now) {
+    MutexLock lock(&mu_);
+    if (rate_[kind] <= 0) {
+        return true;
+    }
+    std::string key = users_.find(user) != users_.end() ? user : "";
+    std::map<std::string, Bucket>::iterator it = buckets_[kind].find(key);
+    if (it == buckets_[kind].end()) {
+        Bucket bucket;
+        bucket.tokens = burst_[kind];
+        bucket.last = now;
+        it = buckets_[kind].insert(std::make_pair(key, bucket)).first;
+    }
+    Bucket& bucket = it->second;
+    if (now > bucket.last) {
+        bucket.tokens = std::min(burst_[kind],
+                                 bucket.tokens + (now - bucket.last) * rate_[kind] / 1000000);
+        bucket.last = now;
+    }
+    if (bucket.tokens < 1) {
+        return false;
+    }
+    bucket.tokens -= 1;
+    return true;
+}
+
+Admission::Kind Admission::KindOf(const std::string& method_name) {
+    const char* reads[] = {"Status", "List", "Show", "Get"};
+    for (size_t i = 0; i < sizeof(reads) / sizeof(reads[0]); i++) {
+        if (method_name.compare(0, strlen(reads[i]), reads[i]) == 0) {
+            return kRead;
+        }
+    }
+    return kMutate;
+}
+
+} //namespace galaxy
+} //namespace baidu
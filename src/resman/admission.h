@@ -0,0 +1,47 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include "mutex.h"
+
+namespace baidu {
+namespace galaxy {
+
+// Token buckets of the rpc of each user, reads and mutations limited apart.
+// Users unknown to resman share one bucket, so that made up names do not
+// get a bucket each.
+class Admission {
+public:
+    enum Kind {
+        kRead = 0,
+        kMutate = 1
+    };
+    Admission();
+    // tokens per second and bucket size, a rate of 0 admits everything
+    void SetLimit(Kind kind, double rate, double burst);
+    void SetUsers(const std::set<std::string>& users);
+    void AddUser(const std::string& user);
+    void RemoveUser(const std::string& user);
+    // takes a token of the user, false when the bucket is empty
+    bool Admit(const std::string& user, Kind kind, int64_t now);
+    // Status, List*, Show* and Get* read, the others mutate
+    static Kind KindOf(const std::string& method_name);
+private:
+    struct Bucket {
+        double tokens;
+        int64_t last; // micros of the last refill
+    };
+    Mutex mu_;
+    double rate_[2];
+    double burst_[2];
+    std::set<std::string> users_;
+    std::map<std::string, Bucket> buckets_[2];
+};
+
+} //namespace galaxy
+} //namespace baidu
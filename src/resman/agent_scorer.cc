@@ -0,0 +1,137 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "agent_scorer.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <boost/foreach.hpp>
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+
+DECLARE_string(rack_tag_prefix);
+
+namespace baidu {
+namespace galaxy {
+namespace sched {
+
+// average share of cpu and memory left free after placing the container
+static double FreeRatio(const Agent& agent, const Container& container) {
+    int64_t cpu_need = 0;
+    int64_t memory_need = container.require->TmpfsNeed();
+    if (container.priority != proto::kJobBestEffort) {
+        cpu_need = container.require->CpuNeed();
+        memory_need += container.require->MemoryNeed();
+    }
+    double cpu_ratio = 0.0;
+    if (agent.CpuTotal() > 0) {
+        cpu_ratio = static_cast<double>(agent.CpuFree() - cpu_need) / agent.CpuTotal();
+    }
+    double memory_ratio = 0.0;
+    if (agent.MemoryTotal() > 0) {
+        memory_ratio = static_cast<double>(agent.MemoryFree() - memory_need) / agent.MemoryTotal();
+    }
+    double ratio = (cpu_ratio + memory_ratio) / 2;
+    return std::max(0.0, std::min(1.0, ratio));
+}
+
+double LeastAllocatedScorer::Score(const ScoreContext& /*context*/,
+                                   const Agent& agent,
+                                   const Container& container) const {
+    return FreeRatio(agent, container);
+}
+
+double MostAllocatedScorer::Score(const ScoreContext& /*context*/,
+                                  const Agent& agent,
+                                  const Container& container) const {
+    return 1.0 - FreeRatio(agent, container);
+}
+
+double RackSpreadScorer::Score(const ScoreContext& context,
+                               const Agent& agent,
+                               const Container& /*container*/) const {
+    std::map<std::string, int>::const_iterator it = context.rack_counts.find(GetRack(agent));
+    if (it == context.rack_counts.end()) {
+        return 1.0;
+    }
+    return 1.0 / (1 + it->second);
+}
+
+double AntiAffinityScorer::Score(const ScoreContext& /*context*/,
+                                 const Agent& agent,
+                                 const Container& container) const {
+    int conflicts = 0;
+    BOOST_FOREACH(const ContainerGroupId& group_id, container.require->anti_affinity) {
+        conflicts += agent.ContainerCount(group_id);
+    }
+    return 1.0 / (1 + conflicts);
+}
+
+bool ScorePolicy::Parse(const std::string& spec) {
+    std::vector<std::pair<AgentScorer::Ptr, double> > scorers;
+    bool need_rack = false;
+    std::vector<std::string> items;
+    boost::split(items, spec, boost::is_any_of(","));
+    BOOST_FOREACH(std::string item, items) {
+        boost::trim(item);
+        if (item.empty()) {
+            continue;
+        }
+        std::string name = item;
+        double weight = 1.0;
+        size_t idx = item.find(":");
+        if (idx != std::string::npos) {
+            name = boost::trim_copy(item.substr(0, idx));
+            char* end = NULL;
+            std::string weight_str = item.substr(idx + 1);
+            weight = strtod(weight_str.c_str(), &end);
+            if (end == weight_str.c_str() || weight < 0) {
+                LOG(WARNING) << "invalid weight of scorer: " << item;
+                return false;
+            }
+        }
+        AgentScorer::Ptr scorer;
+        if (name == "least_allocated") {
+            scorer.reset(new LeastAllocatedScorer());
+        } else if (name == "most_allocated") {
+            scorer.reset(new MostAllocatedScorer());
+        } else if (name == "rack_spread") {
+            scorer.reset(new RackSpreadScorer());
+            need_rack = true;
+        } else if (name == "anti_affinity") {
+            scorer.reset(new AntiAffinityScorer());
+        } else {
+            LOG(WARNING) << "unknown scorer: " << name;
+            return false;
+        }
+        scorers.push_back(std::make_pair(scorer, weight));
+    }
+    scorers_.swap(scorers);
+    need_rack_ = need_rack;
+    return true;
+}
+
+double ScorePolicy::Score(const ScoreContext& context,
+                          const Agent& agent,
+                          const Container& container) const {
+    double score = 0.0;
+    for (size_t i = 0; i < scorers_.size(); i++) {
+        score += scorers_[i].second * scorers_[i].first->Score(context, agent, container);
+    }
+    return score;
+}
+
+std::string GetRack(const Agent& agent) {
+    BOOST_FOREACH(const std::string& tag, agent.Tags()) {
+        if (boost::starts_with(tag, FLAGS_rack_tag_prefix)) {
+            return tag;
+        }
+    }
+    return agent.Endpoint();
+}
+
+} //namespace sched
+} //namespace galaxy
+} //namespace baidu
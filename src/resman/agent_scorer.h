@@ -0,0 +1,98 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <boost/shared_ptr.hpp>
+#include "scheduler.h"
+
+namespace baidu {
+namespace galaxy {
+namespace sched {
+
+// what scorers know about the container group being placed
+struct ScoreContext {
+    // containers of the group already put on each rack,
+    // only built for policies which need it
+    std::map<std::string, int> rack_counts;
+    bool racks_built;
+    ScoreContext() : racks_built(false) {}
+};
+
+// ranks the agents on which a container fits, in [0, 1], higher is better
+class AgentScorer {
+public:
+    virtual ~AgentScorer() {}
+    virtual double Score(const ScoreContext& context,
+                         const Agent& agent,
+                         const Container& container) const = 0;
+    typedef boost::shared_ptr<AgentScorer> Ptr;
+};
+
+// the agent with the most free cpu and memory after placing, spreads load
+class LeastAllocatedScorer : public AgentScorer {
+public:
+    virtual double Score(const ScoreContext& context,
+                         const Agent& agent,
+                         const Container& container) const;
+};
+
+// the agent with the least free cpu and memory after placing, packs agents
+// full and keeps others empty for large containers
+class MostAllocatedScorer : public AgentScorer {
+public:
+    virtual double Score(const ScoreContext& context,
+                         const Agent& agent,
+                         const Container& container) const;
+};
+
+// the rack holding the fewest containers of the group
+class RackSpreadScorer : public AgentScorer {
+public:
+    virtual double Score(const ScoreContext& context,
+                         const Agent& agent,
+                         const Container& container) const;
+};
+
+// the agent holding the fewest containers of the groups
+// which the container should keep away from
+class AntiAffinityScorer : public AgentScorer {
+public:
+    virtual double Score(const ScoreContext& context,
+                         const Agent& agent,
+                         const Container& container) const;
+};
+
+// weighted sum of scorers, written as "name:weight,name:weight",
+// e.g. "most_allocated:1,anti_affinity:2"; an empty policy means first fit
+class ScorePolicy {
+public:
+    ScorePolicy() : need_rack_(false) {}
+    bool Parse(const std::string& spec);
+    bool Empty() const {
+        return scorers_.empty();
+    }
+    // whether ScoreContext::rack_counts is used
+    bool NeedRack() const {
+        return need_rack_;
+    }
+    double Score(const ScoreContext& context,
+                 const Agent& agent,
+                 const Container& container) const;
+    typedef boost::shared_ptr<ScorePolicy> Ptr;
+private:
+    std::vector<std::pair<AgentScorer::Ptr, double> > scorers_;
+    bool need_rack_;
+};
+
+// the first agent tag starting with FLAGS_rack_tag_prefix,
+// agents without such a tag are racks of their own
+std::string GetRack(const Agent& agent);
+
+} //namespace sched
+} //namespace galaxy
+} //namespace baidu
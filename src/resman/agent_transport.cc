@@ -0,0 +1,68 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "agent_transport.h"
+
+#include <boost/scoped_ptr.hpp>
+
+namespace baidu {
+namespace galaxy {
+
+void RpcAgentTransport::Query(const std::string& endpoint,
+                              const proto::QueryRequest* request,
+                              proto::QueryResponse* response,
+                              QueryCallback callback) {
+    proto::Agent_Stub* stub;
+    rpc_client_.GetStub(endpoint, &stub);
+    boost::scoped_ptr<proto::Agent_Stub> stub_guard(stub);
+    rpc_client_.AsyncRequest(stub, &proto::Agent_Stub::Query,
+                             request, response, callback, 5, 1);
+}
+
+void RpcAgentTransport::CreateContainer(const std::string& endpoint,
+                                        const proto::CreateContainerRequest* request,
+                                        proto::CreateContainerResponse* response,
+                                        CreateContainerCallback callback) {
+    proto::Agent_Stub* stub;
+    rpc_client_.GetStub(endpoint, &stub);
+    boost::scoped_ptr<proto::Agent_Stub> stub_guard(stub);
+    rpc_client_.AsyncRequest(stub, &proto::Agent_Stub::CreateContainer,
+                             request, response, callback, 5, 1);
+}
+
+void RpcAgentTransport::RemoveContainer(const std::string& endpoint,
+                                        const proto::RemoveContainerRequest* request,
+                                        proto::RemoveContainerResponse* response,
+                                        RemoveContainerCallback callback) {
+    proto::Agent_Stub* stub;
+    rpc_client_.GetStub(endpoint, &stub);
+    boost::scoped_ptr<proto::Agent_Stub> stub_guard(stub);
+    rpc_client_.AsyncRequest(stub, &proto::Agent_Stub::RemoveContainer,
+                             request, response, callback, 5, 1);
+}
+
+void RpcAgentTransport::BatchCommand(const std::string& endpoint,
+                                     const proto::BatchCommandRequest* request,
+                                     proto::BatchCommandResponse* response,
+                                     BatchCommandCallback callback) {
+    proto::Agent_Stub* stub;
+    rpc_client_.GetStub(endpoint, &stub);
+    boost::scoped_ptr<proto::Agent_Stub> stub_guard(stub);
+    rpc_client_.AsyncRequest(stub, &proto::Agent_Stub::BatchCommand,
+                             request, response, callback, 5, 1);
+}
+
+void RpcAgentTransport::Reserve(const std::string& endpoint,
+                                const proto::ReserveRequest* request,
+                                proto::ReserveResponse* response,
+                                ReserveCallback callback) {
+    proto::Agent_Stub* stub;
+    rpc_client_.GetStub(endpoint, &stub);
+    boost::scoped_ptr<proto::Agent_Stub> stub_guard(stub);
+    rpc_client_.AsyncRequest(stub, &proto::Agent_Stub::Reserve,
+                             request, response, callback, 5, 1);
+}
+
+} //namespace galaxy
+} //namespace baidu
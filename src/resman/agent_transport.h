@@ -0,0 +1,85 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#pragma once
+
+#include <string>
+#include <boost/function.hpp>
+#include "src/protocol/agent.pb.h"
+#include "src/rpc/rpc_client.h"
+
+namespace baidu {
+namespace galaxy {
+
+// async rpc from resman to agents; the request and response are owned by
+// the callback, which is called with (request, response, rpc_fail, err)
+class AgentTransport {
+public:
+    typedef boost::function<void (const proto::QueryRequest*,
+                                  proto::QueryResponse*,
+                                  bool, int)> QueryCallback;
+    typedef boost::function<void (const proto::CreateContainerRequest*,
+                                  proto::CreateContainerResponse*,
+                                  bool, int)> CreateContainerCallback;
+    typedef boost::function<void (const proto::RemoveContainerRequest*,
+                                  proto::RemoveContainerResponse*,
+                                  bool, int)> RemoveContainerCallback;
+    typedef boost::function<void (const proto::BatchCommandRequest*,
+                                  proto::BatchCommandResponse*,
+                                  bool, int)> BatchCommandCallback;
+    typedef boost::function<void (const proto::ReserveRequest*,
+                                  proto::ReserveResponse*,
+                                  bool, int)> ReserveCallback;
+
+    virtual ~AgentTransport() {}
+    virtual void Query(const std::string& endpoint,
+                       const proto::QueryRequest* request,
+                       proto::QueryResponse* response,
+                       QueryCallback callback) = 0;
+    virtual void CreateContainer(const std::string& endpoint,
+                                 const proto::CreateContainerRequest* request,
+                                 proto::CreateContainerResponse* response,
+                                 CreateContainerCallback callback) = 0;
+    virtual void RemoveContainer(const std::string& endpoint,
+                                 const proto::RemoveContainerRequest* request,
+                                 proto::RemoveContainerResponse* response,
+                                 RemoveContainerCallback callback) = 0;
+    virtual void BatchCommand(const std::string& endpoint,
+                              const proto::BatchCommandRequest* request,
+                              proto::BatchCommandResponse* response,
+                              BatchCommandCallback callback) = 0;
+    virtual void Reserve(const std::string& endpoint,
+                         const proto::ReserveRequest* request,
+                         proto::ReserveResponse* response,
+                         ReserveCallback callback) = 0;
+};
+
+// sofa-pbrpc to real agents
+class RpcAgentTransport : public AgentTransport {
+public:
+    virtual void Query(const std::string& endpoint,
+                       const proto::QueryRequest* request,
+                       proto::QueryResponse* response,
+                       QueryCallback callback);
+    virtual void CreateContainer(const std::string& endpoint,
+                                 const proto::CreateContainerRequest* request,
+                                 proto::CreateContainerResponse* response,
+                                 CreateContainerCallback callback);
+    virtual void RemoveContainer(const std::string& endpoint,
+                                 const proto::RemoveContainerRequest* request,
+                                 proto::RemoveContainerResponse* response,
+                                 RemoveContainerCallback callback);
+    virtual void BatchCommand(const std::string& endpoint,
+                              const proto::BatchCommandRequest* request,
+                              proto::BatchCommandResponse* response,
+                              BatchCommandCallback callback);
+    virtual void Reserve(const std::string& endpoint,
+                         const proto::ReserveRequest* request,
+                         proto::ReserveResponse* response,
+                         ReserveCallback callback);
+private:
+    RpcClient rpc_client_;
+};
+
+} //namespace galaxy
+} //namespace baidu
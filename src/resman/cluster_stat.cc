@@ -0,0 +1,79 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cluster_stat.h"
+
+namespace baidu {
+namespace galaxy {
+
+void ClusterStat::Usage::Add(const proto::Resource& resource, int sign) {
+    total += sign * resource.total();
+    assigned += sign * resource.assigned();
+    used += sign * resource.used();
+    entries += sign;
+}
+
+ClusterStat::ClusterStat() : alive_agents_(0),
+                             dead_agents_(0),
+                             total_containers_(0) {
+
+}
+
+void ClusterStat::Add(const std::string& pool,
+                      proto::AgentStatus status,
+                      const proto::AgentInfo& info,
+                      int sign) {
+    std::pair<int64_t, int64_t>& pool_agents = pools_[pool];
+    pool_agents.first += sign;
+    if (status == proto::kAgentAlive || status == proto::kAgentFreezed) {
+        alive_agents_ += sign;
+        pool_agents.second += sign;
+    } else if (status == proto::kAgentDead) {
+        dead_agents_ += sign;
+    }
+    if (pool_agents.first == 0) {
+        pools_.erase(pool);
+    }
+    total_containers_ += sign * info.container_info_size();
+    cpu_.Add(info.cpu_resource(), sign);
+    memory_.Add(info.memory_resource(), sign);
+    for (int i = 0; i < info.volum_resources_size(); i++) {
+        const proto::VolumResource& vr = info.volum_resources(i);
+        Usage& usage = volum_[vr.medium()];
+        usage.Add(vr.volum(), sign);
+        if (usage.entries == 0) {
+            volum_.erase(vr.medium());
+        }
+    }
+}
+
+void ClusterStat::Fill(proto::StatusResponse* response) const {
+    response->mutable_cpu()->set_total(cpu_.total);
+    response->mutable_cpu()->set_assigned(cpu_.assigned);
+    response->mutable_cpu()->set_used(cpu_.used);
+    response->mutable_memory()->set_total(memory_.total);
+    response->mutable_memory()->set_assigned(memory_.assigned);
+    response->mutable_memory()->set_used(memory_.used);
+    response->set_alive_agents(alive_agents_);
+    response->set_dead_agents(dead_agents_);
+    std::map<proto::VolumMedium, Usage>::const_iterator v_it;
+    for (v_it = volum_.begin(); v_it != volum_.end(); v_it++) {
+        proto::VolumResource* vrs = response->add_volum();
+        vrs->mutable_volum()->set_total(v_it->second.total);
+        vrs->mutable_volum()->set_assigned(v_it->second.assigned);
+        vrs->mutable_volum()->set_used(v_it->second.used);
+        vrs->set_medium(v_it->first);
+    }
+    response->set_total_containers(total_containers_);
+    std::map<std::string, std::pair<int64_t, int64_t> >::const_iterator p_it;
+    for (p_it = pools_.begin(); p_it != pools_.end(); p_it++) {
+        proto::PoolStatus* pool_status = response->add_pools();
+        pool_status->set_name(p_it->first);
+        pool_status->set_total_agents(p_it->second.first);
+        pool_status->set_alive_agents(p_it->second.second);
+    }
+}
+
+} //namespace galaxy
+} //namespace baidu
@@ -0,0 +1,46 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#pragma once
+
+#include <map>
+#include <string>
+#include "src/protocol/resman.pb.h"
+
+namespace baidu {
+namespace galaxy {
+
+// cluster wide and per pool aggregates of the agent reports, kept
+// incrementally so that Status does not walk all agents
+class ClusterStat {
+public:
+    ClusterStat();
+    // sign is 1 when the agent joins the aggregates, -1 when it leaves,
+    // an agent leaves with the same status and info it joined with
+    void Add(const std::string& pool,
+             proto::AgentStatus status,
+             const proto::AgentInfo& info,
+             int sign);
+    // fills everything but total_agents, total_groups and in_safe_mode
+    void Fill(proto::StatusResponse* response) const;
+private:
+    struct Usage {
+        int64_t total;
+        int64_t assigned;
+        int64_t used;
+        int64_t entries; // resources summed up
+        Usage() : total(0), assigned(0), used(0), entries(0) {}
+        void Add(const proto::Resource& resource, int sign);
+    };
+    int64_t alive_agents_;
+    int64_t dead_agents_;
+    int64_t total_containers_;
+    Usage cpu_;
+    Usage memory_;
+    std::map<proto::VolumMedium, Usage> volum_;
+    // agents reported in each pool, and the alive ones
+    std::map<std::string, std::pair<int64_t, int64_t> > pools_;
+};
+
+} //namespace galaxy
+} //namespace baidu
@@ -0,0 +1,398 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "meta_journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DECLARE_int64(meta_flush_interval);
+DECLARE_int64(meta_journal_max_size);
+
+namespace baidu {
+namespace galaxy {
+
+MemoryMetaStore::MemoryMetaStore() : available_(true), write_count_(0) {
+
+}
+
+bool MemoryMetaStore::Put(const std::string& key, const std::string& value) {
+    MutexLock lock(&mu_);
+    if (!available_) {
+        return false;
+    }
+    kvs_[key] = value;
+    write_count_++;
+    return true;
+}
+
+bool MemoryMetaStore::Delete(const std::string& key) {
+    MutexLock lock(&mu_);
+    if (!available_) {
+        return false;
+    }
+    kvs_.erase(key);
+    write_count_++;
+    return true;
+}
+
+bool MemoryMetaStore::Scan(const std::string& start, const std::string& end,
+                           std::map<std::string, std::string>& kvs) {
+    MutexLock lock(&mu_);
+    if (!available_) {
+        return false;
+    }
+    std::map<std::string, std::string>::const_iterator it = kvs_.lower_bound(start);
+    for (; it != kvs_.end() && it->first < end; it++) {
+        kvs[it->first] = it->second;
+    }
+    return true;
+}
+
+void MemoryMetaStore::SetAvailable(bool available) {
+    MutexLock lock(&mu_);
+    available_ = available;
+}
+
+bool MemoryMetaStore::Get(const std::string& key, std::string* value) {
+    MutexLock lock(&mu_);
+    std::map<std::string, std::string>::const_iterator it = kvs_.find(key);
+    if (it == kvs_.end()) {
+        return false;
+    }
+    *value = it->second;
+    return true;
+}
+
+int64_t MemoryMetaStore::WriteCount() {
+    MutexLock lock(&mu_);
+    return write_count_;
+}
+
+static bool WriteAll(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t ret = write(fd, data.data() + done, data.size() - done);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        done += ret;
+    }
+    return true;
+}
+
+// a record is the 4 bytes length of the entry followed by the entry
+static std::string EncodeRecord(const proto::MetaJournalEntry& entry) {
+    std::string payload;
+    entry.SerializeToString(&payload);
+    uint32_t len = payload.size();
+    std::string record(reinterpret_cast<const char*>(&len), sizeof(len));
+    record.append(payload);
+    return record;
+}
+
+MetaJournal::MetaJournal(MetaStore* store, const std::string& path)
+    : store_(store),
+      path_(path),
+      fd_(-1),
+      journal_size_(0),
+      header_size_(0),
+      seq_(0),
+      open_(false),
+      stop_(false),
+      flush_pool_(1) {
+
+}
+
+MetaJournal::~MetaJournal() {
+    {
+        MutexLock lock(&mu_);
+        stop_ = true;
+    }
+    // writes not flushed yet stay in the journal
+    flush_pool_.Stop(false);
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool MetaJournal::Open(const std::string& epoch_key, const std::string& epoch) {
+    std::map<std::string, std::string> kvs;
+    if (!store_->Scan(epoch_key, epoch_key + std::string(1, '\0'), kvs)) {
+        LOG(WARNING) << "fail to read meta epoch: " << epoch_key;
+        return false;
+    }
+    const std::string store_epoch = kvs[epoch_key];
+    MutexLock lock(&mu_);
+    std::string journal_epoch;
+    if (!path_.empty() && !Replay(&journal_epoch)) {
+        return false;
+    }
+    if (!pending_.empty() && journal_epoch != store_epoch) {
+        LOG(WARNING) << "drop stale meta journal: " << path_
+                     << ", epoch: " << journal_epoch
+                     << ", epoch of store: " << store_epoch
+                     << ", pending entries: " << pending_.size();
+        pending_.clear();
+    }
+    // the pending entries kept are flushed in the new epoch
+    if (!store_->Put(epoch_key, epoch)) {
+        LOG(WARNING) << "fail to write meta epoch: " << epoch_key;
+        return false;
+    }
+    epoch_ = epoch;
+    if (!path_.empty() && !Rewrite()) {
+        return false;
+    }
+    open_ = true;
+    if (path_.empty()) {
+        return true;
+    }
+    LOG(INFO) << "meta journal opened: " << path_
+              << ", epoch: " << epoch_
+              << ", pending entries: " << pending_.size();
+    flush_pool_.DelayTask(FLAGS_meta_flush_interval,
+                          boost::bind(&MetaJournal::FlushRoutine, this));
+    return true;
+}
+
+bool MetaJournal::Put(const std::string& key, const std::string& value) {
+    proto::MetaJournalEntry entry;
+    entry.set_key(key);
+    entry.set_value(value);
+    return Write(entry);
+}
+
+bool MetaJournal::Delete(const std::string& key) {
+    proto::MetaJournalEntry entry;
+    entry.set_key(key);
+    entry.set_deleted(true);
+    return Write(entry);
+}
+
+bool MetaJournal::Write(const proto::MetaJournalEntry& entry) {
+    {
+        MutexLock lock(&mu_);
+        if (!open_) {
+            LOG(WARNING) << "meta write before the journal is open: " << entry.key();
+            return false;
+        }
+    }
+    if (path_.empty()) {
+        if (entry.deleted()) {
+            return store_->Delete(entry.key());
+        }
+        return store_->Put(entry.key(), entry.value());
+    }
+    MutexLock lock(&mu_);
+    if (!Append(entry)) {
+        return false;
+    }
+    Pending& pending = pending_[entry.key()];
+    pending.seq = ++seq_;
+    pending.entry = entry;
+    return true;
+}
+
+bool MetaJournal::Scan(const std::string& start, const std::string& end,
+                       std::map<std::string, std::string>& kvs) {
+    if (!store_->Scan(start, end, kvs)) {
+        return false;
+    }
+    MutexLock lock(&mu_);
+    std::map<std::string, Pending>::const_iterator it = pending_.lower_bound(start);
+    for (; it != pending_.end() && it->first < end; it++) {
+        const proto::MetaJournalEntry& entry = it->second.entry;
+        if (entry.deleted()) {
+            kvs.erase(entry.key());
+        } else {
+            kvs[entry.key()] = entry.value();
+        }
+    }
+    return true;
+}
+
+bool MetaJournal::Flush() {
+    MutexLock flush_lock(&flush_mu_);
+    std::map<std::string, Pending> batch;
+    {
+        MutexLock lock(&mu_);
+        batch = pending_;
+    }
+    bool all_ok = true;
+    std::map<std::string, Pending>::const_iterator it;
+    for (it = batch.begin(); it != batch.end(); it++) {
+        const proto::MetaJournalEntry& entry = it->second.entry;
+        bool ok = entry.deleted() ? store_->Delete(entry.key())
+                                  : store_->Put(entry.key(), entry.value());
+        if (!ok) {
+            LOG(WARNING) << "fail to flush meta: " << entry.key();
+            all_ok = false;
+            continue;
+        }
+        MutexLock lock(&mu_);
+        std::map<std::string, Pending>::iterator p_it = pending_.find(it->first);
+        // a newer write of the key waits for the next flush
+        if (p_it != pending_.end() && p_it->second.seq == it->second.seq) {
+            pending_.erase(p_it);
+        }
+    }
+    MutexLock lock(&mu_);
+    // an idle flush finds the journal empty already and leaves it alone
+    bool drained = pending_.empty() && journal_size_ > header_size_;
+    if (fd_ >= 0 && (drained || journal_size_ > FLAGS_meta_journal_max_size)) {
+        Rewrite();
+    }
+    return all_ok;
+}
+
+size_t MetaJournal::PendingSize() {
+    MutexLock lock(&mu_);
+    return pending_.size();
+}
+
+void MetaJournal::FlushRoutine() {
+    Flush();
+    MutexLock lock(&mu_);
+    if (!stop_) {
+        flush_pool_.DelayTask(FLAGS_meta_flush_interval,
+                              boost::bind(&MetaJournal::FlushRoutine, this));
+    }
+}
+
+bool MetaJournal::Append(const proto::MetaJournalEntry& entry) {
+    mu_.AssertHeld();
+    std::string record = EncodeRecord(entry);
+    if (fd_ < 0) {
+        LOG(WARNING) << "meta journal is not open: " << path_;
+        return false;
+    }
+    if (!WriteAll(fd_, record) || fdatasync(fd_) != 0) {
+        LOG(WARNING) << "fail to append meta journal: " << path_
+                     << ", err: " << strerror(errno);
+        // never leave a torn record before the next ones
+        if (ftruncate(fd_, journal_size_) != 0) {
+            LOG(WARNING) << "fail to truncate meta journal: " << path_;
+        }
+        return false;
+    }
+    journal_size_ += record.size();
+    return true;
+}
+
+bool MetaJournal::Replay(std::string* journal_epoch) {
+    mu_.AssertHeld();
+    int fd = open(path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        LOG(WARNING) << "fail to open meta journal: " << path_
+                     << ", err: " << strerror(errno);
+        return false;
+    }
+    std::string data;
+    char buf[65536];
+    ssize_t len = 0;
+    while ((len = read(fd, buf, sizeof(buf))) != 0) {
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG(WARNING) << "fail to read meta journal: " << path_
+                         << ", err: " << strerror(errno);
+            close(fd);
+            return false;
+        }
+        data.append(buf, len);
+    }
+    close(fd);
+
+    size_t offset = 0;
+    int64_t records = 0;
+    while (offset + sizeof(uint32_t) <= data.size()) {
+        uint32_t record_len = 0;
+        memcpy(&record_len, data.data() + offset, sizeof(record_len));
+        if (offset + sizeof(record_len) + record_len > data.size()) {
+            break;
+        }
+        proto::MetaJournalEntry entry;
+        if (!entry.ParseFromArray(data.data() + offset + sizeof(record_len), record_len)) {
+            break;
+        }
+        offset += sizeof(record_len) + record_len;
+        if (entry.has_epoch()) {
+            *journal_epoch = entry.epoch();
+            continue;
+        }
+        Pending& pending = pending_[entry.key()];
+        pending.seq = ++seq_;
+        pending.entry = entry;
+        records++;
+    }
+    if (offset != data.size()) {
+        // torn write of the last record before a crash, never acknowledged
+        LOG(WARNING) << "drop broken tail of meta journal: " << path_
+                     << ", bytes: " << (data.size() - offset);
+    }
+    LOG(INFO) << "replay meta journal: " << path_ << ", records: " << records;
+    return true;
+}
+
+bool MetaJournal::Rewrite() {
+    mu_.AssertHeld();
+    std::string tmp_path = path_ + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG(WARNING) << "fail to create meta journal: " << tmp_path
+                     << ", err: " << strerror(errno);
+        return false;
+    }
+    proto::MetaJournalEntry header;
+    header.set_epoch(epoch_);
+    std::string data = EncodeRecord(header);
+    int64_t header_size = data.size();
+    std::map<std::string, Pending>::const_iterator it;
+    for (it = pending_.begin(); it != pending_.end(); it++) {
+        data.append(EncodeRecord(it->second.entry));
+    }
+    if (!WriteAll(fd, data) || fsync(fd) != 0) {
+        LOG(WARNING) << "fail to write meta journal: " << tmp_path
+                     << ", err: " << strerror(errno);
+        close(fd);
+        return false;
+    }
+    close(fd);
+    if (rename(tmp_path.c_str(), path_.c_str()) != 0) {
+        LOG(WARNING) << "fail to rename meta journal: " << tmp_path
+                     << ", err: " << strerror(errno);
+        return false;
+    }
+    int new_fd = open(path_.c_str(), O_WRONLY | O_APPEND);
+    if (new_fd < 0) {
+        LOG(WARNING) << "fail to open meta journal: " << path_
+                     << ", err: " << strerror(errno);
+        return false;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    fd_ = new_fd;
+    journal_size_ = data.size();
+    header_size_ = header_size;
+    return true;
+}
+
+} //namespace galaxy
+} //namespace baidu
@@ -0,0 +1,98 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#pragma once
+
+#include <map>
+#include <string>
+#include "src/protocol/galaxy.pb.h"
+#include "mutex.h"
+#include "thread_pool.h"
+
+namespace baidu {
+namespace galaxy {
+
+// where the meta of resman is persisted at last
+class MetaStore {
+public:
+    virtual ~MetaStore() {}
+    virtual bool Put(const std::string& key, const std::string& value) = 0;
+    virtual bool Delete(const std::string& key) = 0;
+    // all pairs with start <= key < end
+    virtual bool Scan(const std::string& start, const std::string& end,
+                      std::map<std::string, std::string>& kvs) = 0;
+};
+
+// keeps everything in memory, for test
+class MemoryMetaStore : public MetaStore {
+public:
+    MemoryMetaStore();
+    virtual bool Put(const std::string& key, const std::string& value);
+    virtual bool Delete(const std::string& key);
+    virtual bool Scan(const std::string& start, const std::string& end,
+                      std::map<std::string, std::string>& kvs);
+    // an unavailable store fails all operations
+    void SetAvailable(bool available);
+    bool Get(const std::string& key, std::string* value);
+    int64_t WriteCount();
+private:
+    Mutex mu_;
+    bool available_;
+    int64_t write_count_;
+    std::map<std::string, std::string> kvs_;
+};
+
+// Write-behind journal in front of a MetaStore.
+// Put and Delete return once the write is synced to the local journal, the
+// writes are coalesced by key and written to the store in background. Writes
+// not in the store yet are replayed from the journal by Open and seen by Scan.
+// With an empty journal path, writes go to the store directly.
+// Nothing is replayed, written or flushed before Open, which is called by
+// the owner of the store only, i.e. with the lock of the leader held.
+class MetaJournal {
+public:
+    MetaJournal(MetaStore* store, const std::string& path);
+    ~MetaJournal();
+    // each owner of the store writes a new epoch to epoch_key. A journal of
+    // another epoch than the one in the store is dropped, another owner has
+    // written the store since and its writes are stale
+    bool Open(const std::string& epoch_key, const std::string& epoch);
+    bool Put(const std::string& key, const std::string& value);
+    bool Delete(const std::string& key);
+    bool Scan(const std::string& start, const std::string& end,
+              std::map<std::string, std::string>& kvs);
+    // writes pending entries to the store, false if any of them failed
+    bool Flush();
+    size_t PendingSize();
+private:
+    struct Pending {
+        int64_t seq;
+        proto::MetaJournalEntry entry;
+    };
+    bool Write(const proto::MetaJournalEntry& entry);
+    bool Append(const proto::MetaJournalEntry& entry);
+    // the epoch of the journal in journal_epoch
+    bool Replay(std::string* journal_epoch);
+    bool Rewrite();
+    void FlushRoutine();
+
+    MetaStore* store_;
+    const std::string path_;
+    int fd_;
+    int64_t journal_size_;
+    // of the epoch record the journal starts with
+    int64_t header_size_;
+    int64_t seq_;
+    std::string epoch_;
+    bool open_;
+    bool stop_;
+    // key -> latest write not in the store yet
+    std::map<std::string, Pending> pending_;
+    Mutex mu_;
+    // one flush at a time
+    Mutex flush_mu_;
+    ThreadPool flush_pool_;
+};
+
+} //namespace galaxy
+} //namespace baidu
@@ -0,0 +1,47 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "nexus_meta_store.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <glog/logging.h>
+
+namespace baidu {
+namespace galaxy {
+
+NexusMetaStore::NexusMetaStore(::galaxy::ins::sdk::InsSDK* nexus) : nexus_(nexus) {
+
+}
+
+bool NexusMetaStore::Put(const std::string& key, const std::string& value) {
+    ::galaxy::ins::sdk::SDKError err;
+    bool ret = nexus_->Put(key, value, &err);
+    if (!ret) {
+        LOG(WARNING) << "nexus error: " << err;
+    }
+    return ret;
+}
+
+bool NexusMetaStore::Delete(const std::string& key) {
+    ::galaxy::ins::sdk::SDKError err;
+    bool ret = nexus_->Delete(key, &err);
+    if (!ret) {
+        LOG(WARNING) << "nexus error:" << err;
+    }
+    return ret;
+}
+
+bool NexusMetaStore::Scan(const std::string& start, const std::string& end,
+                          std::map<std::string, std::string>& kvs) {
+    ::galaxy::ins::sdk::ScanResult* result = nexus_->Scan(start, end);
+    boost::scoped_ptr< ::galaxy::ins::sdk::ScanResult > result_guard(result);
+    while (!result->Done()) {
+        kvs[result->Key()] = result->Value();
+        result->Next();
+    }
+    return result->Error() == ::galaxy::ins::sdk::kOK;
+}
+
+} //namespace galaxy
+} //namespace baidu
@@ -0,0 +1,26 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#pragma once
+
+#include <map>
+#include <string>
+#include "ins_sdk.h"
+#include "meta_journal.h"
+
+namespace baidu {
+namespace galaxy {
+
+class NexusMetaStore : public MetaStore {
+public:
+    explicit NexusMetaStore(::galaxy::ins::sdk::InsSDK* nexus);
+    virtual bool Put(const std::string& key, const std::string& value);
+    virtual bool Delete(const std::string& key);
+    virtual bool Scan(const std::string& start, const std::string& end,
+                      std::map<std::string, std::string>& kvs);
+private:
+    ::galaxy::ins::sdk::InsSDK* nexus_;
+};
+
+} //namespace galaxy
+} //namespace baidu
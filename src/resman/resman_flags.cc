@@ -2,15 +2,51 @@
 
 DEFINE_string(resman_port, "1645", "resman listen port");
 DEFINE_int64(sched_interval, 50, "scheduling interval (ms)");
+DEFINE_bool(sched_batch_mode, false, "schedule all pending containers against all agents in one pass");
+DEFINE_int64(batch_sched_interval, 1000, "interval between two batch scheduling passes (ms)");
+DEFINE_int64(query_snapshot_interval, 1000, "max age of the snapshot served to list queries (ms)");
 DEFINE_int64(container_group_gc_check_interval, 30000, "container group gc check interval (ms)");
 DEFINE_string(nexus_root, "/galaxy3", "root prefix on nexus");
 DEFINE_string(nexus_addr, "", "nexus server list");
+DEFINE_string(meta_journal_path, "", "local journal of meta writes not in nexus yet, empty to write nexus synchronously");
+DEFINE_int64(meta_flush_interval, 100, "interval of flushing the meta journal to nexus (ms)");
+DEFINE_string(rpc_record_path, "", "record rpc handled by resman and agent query results to this file for resman_replay");
+DEFINE_int64(meta_journal_max_size, 64 * 1024 * 1024, "rewrite the meta journal with pending writes only beyond this size");
+DEFINE_bool(meta_compact_encoding, false, "write meta records with the versioned encoding, container group descriptions stored once per content");
+DEFINE_bool(meta_migrate, false, "rewrite the meta records written before meta_compact_encoding once the lock is held, with meta_compact_encoding only");
+DEFINE_int64(meta_compress_min_size, 512, "compress encoded meta records not shorter than this, negative to never compress");
+DEFINE_bool(resman_standby, false, "wait for the resman lock as a warm standby following the meta and agents of the leader");
+DEFINE_int64(standby_sync_interval, 1000, "interval of a standby reloading the meta written by the leader (ms)");
+DEFINE_double(user_read_rate, 0, "Status, List*, Show* and Get* rpc admitted per second for each user, 0 for no limit");
+DEFINE_int32(user_read_burst, 200, "reads a user may send at once above user_read_rate");
+DEFINE_double(user_mutate_rate, 0, "mutating rpc admitted per second for each user, 0 for no limit");
+DEFINE_int32(user_mutate_burst, 30, "mutations a user may send at once above user_mutate_rate");
 DEFINE_int32(agent_timeout, 30 , "timeout of agent, in seconds");
 DEFINE_int32(agent_query_interval , 5, "query interval of agent, in seconds");
+DEFINE_bool(agent_adaptive_query, true, "query busy agents faster and back off on stable ones, instead of agent_query_interval for all");
+DEFINE_int32(agent_query_min_interval, 1000, "query interval of busy agents, in milliseconds");
+DEFINE_int32(agent_query_max_interval, 20, "longest query interval of stable agents, in seconds");
+DEFINE_double(agent_query_jitter, 0.2, "random spread of adaptive query intervals, as a ratio of the interval");
+DEFINE_int64(agent_dead_check_interval, 1000, "interval of looking for agents not heartbeating in agent_timeout, not bound to their query intervals (ms)");
+DEFINE_int32(agent_query_max_outstanding, 200, "max agent queries on the way at once, 0 for no limit");
+DEFINE_bool(agent_incremental_query, true, "query agents for containers changed since the last report only");
+DEFINE_bool(agent_batch_command, false, "send the commands of one agent query in a single batch rpc, resent one by one if it fails");
+DEFINE_bool(agent_reservation, true, "reserve the resource of newly placed containers on their agents before creating them");
+DEFINE_int64(reservation_interval, 100, "interval of sending the reservations of new placements to agents (ms)");
+DEFINE_int64(reservation_lease_time, 30000, "agents release a reservation not followed by the creation in this time (ms)");
 DEFINE_int32(container_group_max_replica, 100000, "max replica allowed for one group");
 DEFINE_double(safe_mode_percent, 0.85, "when agent alive percent bigger than this, leave safe mode");
 DEFINE_bool(check_container_version, false, "by default, AM will handle that");
 DEFINE_int32(max_batch_pods, 12, "max batch pods per agent");
+DEFINE_bool(enable_preemption, false, "evict lower priority containers for pending ones in batch scheduling, gangs excluded");
+DEFINE_int32(preempt_group_budget, 2, "max containers of one group preempted within preempt_budget_window");
+DEFINE_int32(preempt_budget_window, 600, "window of the preemption budget, in seconds");
+DEFINE_string(sched_score_policy, "", "scoring of feasible agents in batch mode and for gangs, e.g. least_allocated:1,anti_affinity:2; empty for first fit");
+DEFINE_string(sched_pool_score_policy, "", "scoring per pool in batch mode and for gangs, overriding sched_score_policy, e.g. pool_a=most_allocated;pool_b=rack_spread");
+DEFINE_int32(sched_score_candidates, 32, "max feasible agents scored for one container");
+DEFINE_int32(sched_select_max_agents, 1000, "max agents of one pool and tag examined when looking for candidates of one container, 0 for no limit");
+DEFINE_string(rack_tag_prefix, "rack:", "agent tags with this prefix name the rack of the agent");
+DEFINE_int32(preempt_max_agents, 16, "max agents examined when looking for victims of one container");
 
 DEFINE_int32(overassign_level, 2, "overassign level: {0, 1, 2, 3}");
 DEFINE_double(reserved_percent, 2.0, "resource reserved percent");
@@ -5,6 +5,7 @@
 #include "resman_impl.h"
 #include <string>
 #include <sstream>
+#include <algorithm>
 #include <stdlib.h>
 #include <time.h>
 #include <assert.h>
@@ -16,13 +17,34 @@
 #include <boost/scoped_ptr.hpp>
 
 #include "event_log.h"
+#include "meta_codec.h"
 
 DECLARE_string(nexus_root);
 DECLARE_string(nexus_addr);
 DECLARE_int32(agent_timeout);
 DECLARE_int32(agent_query_interval);
+DECLARE_bool(agent_adaptive_query);
+DECLARE_int32(agent_query_min_interval);
+DECLARE_int32(agent_query_max_interval);
+DECLARE_double(agent_query_jitter);
+DECLARE_int32(agent_query_max_outstanding);
+DECLARE_int64(agent_dead_check_interval);
+DECLARE_bool(agent_incremental_query);
+DECLARE_bool(agent_batch_command);
+DECLARE_string(meta_journal_path);
+DECLARE_string(rpc_record_path);
+DECLARE_bool(meta_compact_encoding);
+DECLARE_int64(meta_compress_min_size);
 DECLARE_int32(container_group_max_replica);
 DECLARE_double(safe_mode_percent);
+DECLARE_int64(standby_sync_interval);
+DECLARE_double(user_read_rate);
+DECLARE_int32(user_read_burst);
+DECLARE_double(user_mutate_rate);
+DECLARE_int32(user_mutate_burst);
+DECLARE_bool(agent_reservation);
+DECLARE_int64(reservation_interval);
+DECLARE_int64(reservation_lease_time);
 
 const std::string sAgentPrefix = "/agent";
 const std::string sUserPrefix = "/user";
@@ -30,6 +52,8 @@ const std::string sContainerGroupPrefix = "/container_group";
 const std::string sTagPrefix = "/tag";
 const std::string sRMLock = "/resman_lock";
 const std::string sRMAddr = "/resman";
+const std::string sMetaEpoch = "/meta_epoch";
+const std::string sAgentQueryMethod = "baidu.galaxy.proto.Agent.Query";
 
 #define CHECK_USER() do {\
     if (!CheckUserExist(request, response, done)) {\
@@ -41,20 +65,183 @@ const std::string sRMAddr = "/resman";
 namespace baidu {
 namespace galaxy {
 
+// whether containers of the agent are being created, removed or changed,
+// so that the agent is worth querying soon again
+static bool IsReportActive(const proto::AgentInfo& last,
+                           const proto::AgentInfo& report) {
+    if (last.container_info_size() != report.container_info_size()) {
+        return true;
+    }
+    std::map<std::string, proto::ContainerStatus> last_status;
+    for (int i = 0; i < last.container_info_size(); i++) {
+        last_status[last.container_info(i).id()] = last.container_info(i).status();
+    }
+    for (int i = 0; i < report.container_info_size(); i++) {
+        const proto::ContainerInfo& container = report.container_info(i);
+        if (container.status() == proto::kContainerPending
+            || container.status() == proto::kContainerAllocating
+            || container.status() == proto::kContainerDestroying) {
+            return true;
+        }
+        std::map<std::string, proto::ContainerStatus>::const_iterator it;
+        it = last_status.find(container.id());
+        if (it == last_status.end() || it->second != container.status()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// reports but the full ones carry the version of container descriptions only
+static bool HasFullDesc(const proto::ContainerInfo& container) {
+    const proto::ContainerDescription& desc = container.container_desc();
+    std::vector<const google::protobuf::FieldDescriptor*> fields;
+    desc.GetReflection()->ListFields(desc, &fields);
+    return fields.size() > 1;
+}
+
+// fills in the descriptions of the ready containers from the last
+// report, false if one of them is not there with the same version
+static bool CompleteReport(const proto::AgentInfo& last,
+                           const proto::AgentInfo& report,
+                           proto::AgentInfo& completed) {
+    std::map<std::string, const proto::ContainerInfo*> last_containers;
+    for (int i = 0; i < last.container_info_size(); i++) {
+        last_containers[last.container_info(i).id()] = &last.container_info(i);
+    }
+    completed.CopyFrom(report);
+    bool complete = true;
+    for (int i = 0; i < completed.container_info_size(); i++) {
+        proto::ContainerInfo* container = completed.mutable_container_info(i);
+        std::map<std::string, const proto::ContainerInfo*>::const_iterator it;
+        it = last_containers.find(container->id());
+        if (it != last_containers.end()
+            && it->second->created_time() == container->created_time()
+            && it->second->container_desc().version() == container->container_desc().version()
+            && HasFullDesc(*it->second)) {
+            container->mutable_container_desc()->CopyFrom(it->second->container_desc());
+        } else if (container->status() == proto::kContainerReady) {
+            complete = false;
+        }
+    }
+    return complete;
+}
+
 ResManImpl::ResManImpl() : scheduler_(new sched::Scheduler()),
                            safe_mode_(true),
                            force_safe_mode_(false),
-                           start_time_(0) {
+                           outstanding_queries_(0),
+                           standby_(false),
+                           sync_pool_(1),
+                           reserve_pool_(1),
+                           rpc_recorder_(NULL),
+                           start_time_(0),
+                           status_snapshot_(new proto::StatusResponse()) {
     nexus_ = new InsSDK(FLAGS_nexus_addr);
+    meta_store_ = new NexusMetaStore(nexus_);
+    meta_journal_ = new MetaJournal(meta_store_, FLAGS_meta_journal_path);
+    agent_transport_ = new RpcAgentTransport();
+}
+
+ResManImpl::ResManImpl(MetaStore* meta_store, AgentTransport* agent_transport)
+                         : scheduler_(new sched::Scheduler()),
+                           nexus_(NULL),
+                           meta_store_(meta_store),
+                           safe_mode_(true),
+                           force_safe_mode_(false),
+                           outstanding_queries_(0),
+                           standby_(false),
+                           sync_pool_(1),
+                           reserve_pool_(1),
+                           agent_transport_(agent_transport),
+                           rpc_recorder_(NULL),
+                           start_time_(0),
+                           status_snapshot_(new proto::StatusResponse()) {
+    meta_journal_ = new MetaJournal(meta_store_, FLAGS_meta_journal_path);
 }
 
 ResManImpl::~ResManImpl() {
+    reserve_pool_.Stop(false);
+    delete meta_journal_;
+    delete meta_store_;
     delete scheduler_;
     delete nexus_;
+    delete agent_transport_;
+    delete rpc_recorder_;
+}
+
+void ResManImpl::CallMethod(const ::google::protobuf::MethodDescriptor* method,
+                            ::google::protobuf::RpcController* controller,
+                            const ::google::protobuf::Message* request,
+                            ::google::protobuf::Message* response,
+                            ::google::protobuf::Closure* done) {
+    // throttled ones are not recorded, a replay admits what was admitted
+    if (!Admit(method, request, response)) {
+        done->Run();
+        return;
+    }
+    if (rpc_recorder_ != NULL) {
+        rpc_recorder_->Record(method->full_name(), "", *request, NULL);
+    }
+    proto::ResMan::CallMethod(method, controller, request, response, done);
+}
+
+bool ResManImpl::Admit(const ::google::protobuf::MethodDescriptor* method,
+                       const ::google::protobuf::Message* request,
+                       ::google::protobuf::Message* response) {
+    const ::google::protobuf::FieldDescriptor* user_field =
+        request->GetDescriptor()->FindFieldByName("user");
+    if (user_field == NULL || user_field->message_type() != proto::User::descriptor()) {
+        // from agents
+        return true;
+    }
+    const proto::User& user = static_cast<const proto::User&>(
+        request->GetReflection()->GetMessage(*request, user_field));
+    if (admission_.Admit(user.user(), Admission::KindOf(method->name()),
+                         common::timer::get_micros())) {
+        return true;
+    }
+    LOG(WARNING) << "rpc throttled, method:" << method->name() << ", user:" << user.user();
+    const ::google::protobuf::FieldDescriptor* code_field =
+        response->GetDescriptor()->FindFieldByName("error_code");
+    if (code_field != NULL && code_field->message_type() == proto::ErrorCode::descriptor()) {
+        proto::ErrorCode* err = static_cast<proto::ErrorCode*>(
+            response->GetReflection()->MutableMessage(response, code_field));
+        err->set_status(proto::kThrottled);
+        err->set_reason("too many requests of user: " + user.user());
+    }
+    return false;
 }
 
 bool ResManImpl::Init() {
     bool load_ok = false;
+    admission_.SetLimit(Admission::kRead, FLAGS_user_read_rate, FLAGS_user_read_burst);
+    admission_.SetLimit(Admission::kMutate, FLAGS_user_mutate_rate, FLAGS_user_mutate_burst);
+    // the journal is opened by RegisterOnNexus once the lock is held,
+    // without nexus nobody else owns the store
+    if (nexus_ == NULL) {
+        std::stringstream epoch;
+        epoch << "offline:" << common::timer::get_micros();
+        if (!meta_journal_->Open(FLAGS_nexus_root + sMetaEpoch, epoch.str())) {
+            LOG(WARNING) << "fail to open meta journal";
+            return false;
+        }
+    }
+    if (!FLAGS_rpc_record_path.empty()) {
+        rpc_recorder_ = new RpcRecorder();
+        if (!rpc_recorder_->Open(FLAGS_rpc_record_path)) {
+            delete rpc_recorder_;
+            rpc_recorder_ = NULL;
+        } else {
+            std::map<std::string, std::string> kvs;
+            meta_journal_->Scan(FLAGS_nexus_root + "/", FLAGS_nexus_root + "/\xff", kvs);
+            std::map<std::string, std::string>::const_iterator kv_it;
+            for (kv_it = kvs.begin(); kv_it != kvs.end(); kv_it++) {
+                rpc_recorder_->RecordMeta(kv_it->first.substr(FLAGS_nexus_root.size()),
+                                          kv_it->second);
+            }
+        }
+    }
     load_ok = LoadObjects(sAgentPrefix, agents_);
     if (!load_ok) {
         LOG(WARNING) << "fail to load agent meta";
@@ -90,7 +277,7 @@ bool ResManImpl::Init() {
     }
 
     ReloadUsersAuth();
-    load_ok = LoadObjects(sContainerGroupPrefix, container_groups_);
+    load_ok = LoadContainerGroups(container_groups_);
     if (!load_ok) {
         LOG(WARNING) << "failt to load container groups meta";
         return false;
@@ -105,14 +292,27 @@ bool ResManImpl::Init() {
                  << "TRACE END";
     }
     start_time_ = common::timer::get_micros();
+    if (FLAGS_agent_reservation || FLAGS_agent_adaptive_query) {
+        scheduler_->TrackPlacements(true, FLAGS_agent_reservation);
+        reserve_pool_.DelayTask(FLAGS_reservation_interval,
+            boost::bind(&ResManImpl::ReserveRoutine, this)
+        );
+    }
+    query_pool_.DelayTask(FLAGS_agent_dead_check_interval,
+        boost::bind(&ResManImpl::DeadCheckRoutine, this)
+    );
+    MutexLock lock(&mu_);
+    PublishStatus();
     return true;
 }
 
 void ResManImpl::ReloadUsersAuth() {
+    std::set<std::string> user_names;
     std::map<std::string, proto::UserMeta>::const_iterator user_it;
     for (user_it = users_.begin(); user_it != users_.end(); user_it++) {
         const std::string& user_name = user_it->first;
         const proto::UserMeta& user_meta = user_it->second;
+        user_names.insert(user_name);
         for (int i = 0; i < user_meta.grants_size(); i++) {
             const proto::Grant& grant = user_meta.grants(i);
             const std::string& pool_name = grant.pool();
@@ -130,6 +330,7 @@ void ResManImpl::ReloadUsersAuth() {
             }
         }
     }
+    admission_.SetUsers(user_names);
 }
 
 bool ResManImpl::RegisterOnNexus(const std::string& endpoint) {
@@ -139,6 +340,12 @@ bool ResManImpl::RegisterOnNexus(const std::string& endpoint) {
         LOG(WARNING) << "failed to acquire resman lock, " << err;
         return false;
     }
+    // the pending writes of the journal are replayed and flushed by the
+    // owner of the lock only, unless another leader has written since
+    if (!meta_journal_->Open(FLAGS_nexus_root + sMetaEpoch, nexus_->GetSessionID())) {
+        LOG(WARNING) << "fail to open meta journal";
+        return false;
+    }
     ret = nexus_->Put(FLAGS_nexus_root + sRMAddr, endpoint, &err);
     if (!ret) {
         LOG(WARNING) << "failed to write resman endpoint to nexus, " << err;
@@ -165,6 +372,198 @@ void ResManImpl::OnLockChange(std::string lock_session_id) {
     }
 }
 
+void ResManImpl::StartStandby() {
+    MutexLock lock(&mu_);
+    LOG(INFO) << "resman runs as a standby";
+    standby_ = true;
+    std::map<std::string, proto::AgentMeta>::const_iterator it;
+    for (it = agents_.begin(); it != agents_.end(); it++) {
+        FollowAgent(it->first);
+    }
+    PublishStatus();
+    sync_pool_.DelayTask(FLAGS_standby_sync_interval,
+        boost::bind(&ResManImpl::SyncMetaRoutine, this)
+    );
+}
+
+void ResManImpl::TakeOver() {
+    // the writes of the former leader before it lost the lock
+    SyncMeta();
+    bool leave_safe_mode_event = false;
+    {
+        MutexLock lock(&mu_);
+        if (!standby_) {
+            return;
+        }
+        standby_ = false;
+        // the agents have not heartbeated the new leader yet
+        int32_t now_tm = common::timer::now_time();
+        std::map<std::string, AgentStat>::iterator it;
+        for (it = agent_stats_.begin(); it != agent_stats_.end(); it++) {
+            if (it->second.status != proto::kAgentDead) {
+                it->second.last_heartbeat_time = now_tm;
+            }
+        }
+        // agents already reported to the standby, no need to wait for them
+        if (!force_safe_mode_ &&
+            safe_mode_ &&
+            ReportedAgents() > (double)agents_.size() * FLAGS_safe_mode_percent) {
+            LOG(INFO) << "leave safe mode";
+            safe_mode_ = false;
+            leave_safe_mode_event = true;
+        }
+        PublishStatus();
+    }
+    LOG(INFO) << "standby takes over, in safe mode: " << !leave_safe_mode_event;
+    if (leave_safe_mode_event) {
+        scheduler_->Start();
+    }
+}
+
+void ResManImpl::FollowAgent(const std::string& agent_endpoint) {
+    mu_.AssertHeld();
+    if (agent_stats_.find(agent_endpoint) != agent_stats_.end()) {
+        return;
+    }
+    AgentStat& agent = agent_stats_[agent_endpoint];
+    agent.status = proto::kAgentAlive;
+    agent.last_heartbeat_time = common::timer::now_time();
+    agent.reported = false;
+    AccountAgent(agent_endpoint, 1);
+    int64_t delay = 0;
+    if (FLAGS_agent_adaptive_query) {
+        delay = rand() % (FLAGS_agent_query_interval * 1000);
+    }
+    ScheduleQuery(agent_endpoint, delay, true);
+}
+
+void ResManImpl::SyncMetaRoutine() {
+    SyncMeta();
+    MutexLock lock(&mu_);
+    if (standby_) {
+        sync_pool_.DelayTask(FLAGS_standby_sync_interval,
+            boost::bind(&ResManImpl::SyncMetaRoutine, this)
+        );
+    }
+}
+
+void ResManImpl::SyncMeta() {
+    MutexLock sync_lock(&sync_mu_);
+    std::map<std::string, proto::AgentMeta> agents;
+    std::map<std::string, proto::TagMeta> tag_map;
+    std::map<std::string, proto::UserMeta> users;
+    std::map<std::string, proto::ContainerGroupMeta> container_groups;
+    if (!LoadObjects(sAgentPrefix, agents)
+        || !LoadObjects(sTagPrefix, tag_map)
+        || !LoadObjects(sUserPrefix, users)
+        || !LoadContainerGroups(container_groups)) {
+        LOG(WARNING) << "fail to load meta, standby keeps the last one";
+        return;
+    }
+    MutexLock lock(&mu_);
+    if (!standby_) {
+        return;
+    }
+    // agents, the removed ones first
+    std::map<std::string, proto::AgentMeta>::iterator agent_it = agents_.begin();
+    while (agent_it != agents_.end()) {
+        const std::string endpoint = agent_it->first;
+        if (agents.find(endpoint) != agents.end()) {
+            agent_it++;
+            continue;
+        }
+        LOG(INFO) << "standby removes agent: " << endpoint;
+        AccountAgent(endpoint, -1);
+        pools_[agent_it->second.pool()].erase(endpoint);
+        agent_stats_.erase(endpoint);
+        agents_.erase(agent_it++);
+        scheduler_->RemoveAgent(endpoint);
+    }
+    for (agent_it = agents.begin(); agent_it != agents.end(); agent_it++) {
+        const std::string& endpoint = agent_it->first;
+        const proto::AgentMeta& agent_meta = agent_it->second;
+        std::map<std::string, proto::AgentMeta>::iterator old_it = agents_.find(endpoint);
+        if (old_it == agents_.end()) {
+            LOG(INFO) << "standby adds agent: " << endpoint;
+            agents_[endpoint] = agent_meta;
+            pools_[agent_meta.pool()].insert(endpoint);
+            FollowAgent(endpoint);
+        } else if (old_it->second.pool() != agent_meta.pool()) {
+            AccountAgent(endpoint, -1);
+            pools_[old_it->second.pool()].erase(endpoint);
+            old_it->second = agent_meta;
+            AccountAgent(endpoint, 1);
+            pools_[agent_meta.pool()].insert(endpoint);
+            scheduler_->SetPool(endpoint, agent_meta.pool());
+        } else {
+            old_it->second = agent_meta;
+        }
+    }
+    // tags
+    std::map<std::string, std::set<std::string> > tags;
+    std::map<std::string, proto::TagMeta>::const_iterator tag_it;
+    for (tag_it = tag_map.begin(); tag_it != tag_map.end(); tag_it++) {
+        std::set<std::string>& endpoints = tags[tag_it->first];
+        for (int i = 0; i < tag_it->second.endpoints_size(); i++) {
+            endpoints.insert(tag_it->second.endpoints(i));
+        }
+    }
+    std::map<std::string, std::set<std::string> >::iterator old_tag_it = tags_.begin();
+    while (old_tag_it != tags_.end()) {
+        if (tags.find(old_tag_it->first) != tags.end()) {
+            old_tag_it++;
+            continue;
+        }
+        ApplyTag(old_tag_it->first, std::set<std::string>());
+        tags_.erase(old_tag_it++);
+    }
+    std::map<std::string, std::set<std::string> >::const_iterator new_tag_it;
+    for (new_tag_it = tags.begin(); new_tag_it != tags.end(); new_tag_it++) {
+        ApplyTag(new_tag_it->first, new_tag_it->second);
+    }
+    // users
+    users_ = users;
+    users_can_create_.clear();
+    users_can_update_.clear();
+    users_can_remove_.clear();
+    users_can_list_.clear();
+    ReloadUsersAuth();
+    // container groups
+    std::map<std::string, proto::ContainerGroupMeta>::iterator group_it;
+    group_it = container_groups_.begin();
+    while (group_it != container_groups_.end()) {
+        const std::string group_id = group_it->first;
+        if (container_groups.find(group_id) != container_groups.end()) {
+            group_it++;
+            continue;
+        }
+        LOG(INFO) << "standby removes container group: " << group_id;
+        container_groups_.erase(group_it++);
+        scheduler_->Kill(group_id);
+    }
+    for (group_it = container_groups.begin(); group_it != container_groups.end(); group_it++) {
+        const std::string& group_id = group_it->first;
+        const proto::ContainerGroupMeta& group_meta = group_it->second;
+        std::map<std::string, proto::ContainerGroupMeta>::iterator old_it;
+        old_it = container_groups_.find(group_id);
+        bool killed = false;
+        if (old_it != container_groups_.end()) {
+            if (old_it->second.SerializeAsString() == group_meta.SerializeAsString()) {
+                continue;
+            }
+            killed = old_it->second.status() == proto::kContainerGroupTerminated;
+        }
+        VLOG(10) << "standby reloads container group: " << group_id;
+        container_groups_[group_id] = group_meta;
+        scheduler_->Reload(group_meta);
+        if (old_it != container_groups_.end() && !killed
+            && group_meta.status() == proto::kContainerGroupTerminated) {
+            scheduler_->Kill(group_id);
+        }
+    }
+    PublishStatus();
+}
+
 void ResManImpl::EnterSafeMode(::google::protobuf::RpcController* controller,
                                const ::baidu::galaxy::proto::EnterSafeModeRequest* request,
                                ::baidu::galaxy::proto::EnterSafeModeResponse* response,
@@ -174,6 +573,7 @@ void ResManImpl::EnterSafeMode(::google::protobuf::RpcController* controller,
         safe_mode_ = true;
         force_safe_mode_ = true;
         scheduler_->Stop();
+        PublishStatus();
         response->mutable_error_code()->set_status(proto::kOk);
         EventLog ev("cluster");
         LOG(ERROR) << ev
@@ -197,6 +597,7 @@ void ResManImpl::LeaveSafeMode(::google::protobuf::RpcController* controller,
             safe_mode_ = false;
             force_safe_mode_ = false;
             scheduler_->Start();
+            PublishStatus();
             response->mutable_error_code()->set_status(proto::kOk);
             EventLog ev("cluster");
             LOG(ERROR) << ev
@@ -218,131 +619,98 @@ void ResManImpl::Status(::google::protobuf::RpcController* controller,
                         const ::baidu::galaxy::proto::StatusRequest* request,
                         ::baidu::galaxy::proto::StatusResponse* response,
                         ::google::protobuf::Closure* done) {
-    MutexLock lock(&mu_);
-    uint32_t total_agents = agents_.size();
-    uint32_t alive_agents = 0;
-    uint32_t dead_agents = 0;
-    int64_t cpu_total = 0;
-    int64_t cpu_assigned = 0;
-    int64_t cpu_used = 0;
-    int64_t memory_total = 0;
-    int64_t memory_assigned = 0;
-    int64_t memory_used = 0;
-    int64_t total_containers = 0;
-    int64_t total_container_groups = container_groups_.size();
-    std::map<proto::VolumMedium, int64_t> volum_total;
-    std::map<proto::VolumMedium, int64_t> volum_assigned;
-    std::map<proto::VolumMedium, int64_t> volum_used;
-    std::map<std::string, AgentStat>::const_iterator it;
-    std::map<std::string, int64_t> pool_total;
-    std::map<std::string, int64_t> pool_alive;
-    for (it = agent_stats_.begin(); it != agent_stats_.end(); it ++) {
-        const std::string& endpoint = it->first;
-        if (agents_.find(endpoint) == agents_.end()) {
-            continue;
-        }
-        std::string pool_name = agents_[endpoint].pool();
-        proto::AgentStatus agent_status = it->second.status;
-        const proto::AgentInfo& agent_info = it->second.info;
-        pool_total[pool_name]++;
-        if (agent_status == proto::kAgentAlive || agent_status == proto::kAgentFreezed) {
-            alive_agents++;
-            pool_alive[pool_name]++;
-        } else if (agent_status == proto::kAgentDead) {
-            dead_agents++;
-        }
-        total_containers += agent_info.container_info_size();
-        cpu_total += agent_info.cpu_resource().total();
-        cpu_assigned += agent_info.cpu_resource().assigned();
-        cpu_used += agent_info.cpu_resource().used();
-        memory_total += agent_info.memory_resource().total();
-        memory_assigned += agent_info.memory_resource().assigned();
-        memory_used += agent_info.memory_resource().used();
-        for (int i = 0; i < agent_info.volum_resources_size(); i++) {
-            proto::VolumMedium medium = agent_info.volum_resources(i).medium();
-            const proto::Resource& vs = agent_info.volum_resources(i).volum();
-            volum_total[medium] += vs.total();
-            volum_assigned[medium] += vs.assigned();
-            volum_used[medium] += vs.used();
-        }
+    boost::shared_ptr<const proto::StatusResponse> snapshot;
+    {
+        MutexLock lock(&status_mu_);
+        snapshot = status_snapshot_;
     }
-    response->mutable_error_code()->set_status(proto::kOk);
-    response->mutable_cpu()->set_total(cpu_total);
-    response->mutable_cpu()->set_assigned(cpu_assigned);
-    response->mutable_cpu()->set_used(cpu_used);
-    response->mutable_memory()->set_total(memory_total);
-    response->mutable_memory()->set_assigned(memory_assigned);
-    response->mutable_memory()->set_used(memory_used);
-    response->set_total_agents(total_agents);
-    response->set_alive_agents(alive_agents);
-    response->set_dead_agents(dead_agents);
-    std::map<proto::VolumMedium,int64_t>::const_iterator v_it;
-    for (v_it = volum_total.begin(); v_it != volum_total.end(); v_it++) {
-        proto::VolumMedium medium = v_it->first;
-        int64_t size_total = v_it->second;
-        proto::VolumResource* vrs = response->add_volum();
-        vrs->mutable_volum()->set_total(size_total);
-        vrs->mutable_volum()->set_assigned(volum_assigned[medium]);
-        vrs->mutable_volum()->set_used(volum_used[medium]);
-        vrs->set_medium(medium);
-    }
-    response->set_total_containers(total_containers);
-    response->set_total_groups(total_container_groups);
-    std::map<std::string, int64_t >::const_iterator p_it;
-    for (p_it = pool_total.begin(); p_it != pool_total.end(); p_it++) {
-        const std::string& pool_name = p_it->first;
-        proto::PoolStatus* pool_status = response->add_pools();
-        pool_status->set_total_agents(p_it->second);
-        pool_status->set_name(pool_name);
-        pool_status->set_alive_agents(pool_alive[pool_name]);
-    }
-    response->set_in_safe_mode(safe_mode_);
+    response->CopyFrom(*snapshot);
     VLOG(10) << "cluster status:" << response->DebugString();
     done->Run();
 }
 
-void ResManImpl::QueryAgent(const std::string& agent_endpoint, bool is_first_query) {
-    MutexLock lock(&mu_);
-    std::map<std::string, AgentStat>::iterator agent_it;
-    agent_it = agent_stats_.find(agent_endpoint);
-    if (agent_it == agent_stats_.end()) {
-        LOG(WARNING) << "no need to query on expired agent: " << agent_endpoint;
+void ResManImpl::AccountAgent(const std::string& endpoint, int sign) {
+    mu_.AssertHeld();
+    std::map<std::string, proto::AgentMeta>::const_iterator meta_it;
+    meta_it = agents_.find(endpoint);
+    std::map<std::string, AgentStat>::const_iterator stat_it;
+    stat_it = agent_stats_.find(endpoint);
+    if (meta_it == agents_.end() || stat_it == agent_stats_.end()) {
         return;
     }
-    AgentStat& agent = agent_it->second;
-    int32_t now_tm = common::timer::now_time();
-    VLOG(10) << agent_endpoint << ",  last:" << agent.last_heartbeat_time
-             << ",timeout:" << FLAGS_agent_timeout
-             << ",now_tm:" << now_tm;
-    if (agent.last_heartbeat_time + FLAGS_agent_timeout < now_tm) {
-        LOG(WARNING) << "this agent maybe dead:" << agent_endpoint;
-        if (agent.status != proto::kAgentDead) {
-            EventLog ev("agent");
-            LOG(ERROR) << ev
-                .AppendTime("time").Append("endpoint", agent_endpoint)
-                .Append("action", "dead").Append("detail", "agent heartbeat tiemout, agent dead")
-                .ToString();
+    cluster_stat_.Add(meta_it->second.pool(), stat_it->second.status,
+                      stat_it->second.info, sign);
+}
+
+void ResManImpl::PublishStatus() {
+    mu_.AssertHeld();
+    proto::StatusResponse* status = new proto::StatusResponse();
+    status->mutable_error_code()->set_status(proto::kOk);
+    cluster_stat_.Fill(status);
+    status->set_total_agents(agents_.size());
+    status->set_total_groups(container_groups_.size());
+    status->set_in_safe_mode(safe_mode_);
+    boost::shared_ptr<const proto::StatusResponse> snapshot(status);
+    MutexLock lock(&status_mu_);
+    status_snapshot_.swap(snapshot);
+}
+
+void ResManImpl::QueryAgent(const std::string& agent_endpoint, bool is_first_query) {
+    proto::QueryRequest* request = NULL;
+    {
+        MutexLock lock(&mu_);
+        std::map<std::string, AgentStat>::iterator agent_it;
+        agent_it = agent_stats_.find(agent_endpoint);
+        if (agent_it == agent_stats_.end()) {
+            LOG(WARNING) << "no need to query on expired agent: " << agent_endpoint;
+            return;
+        }
+        AgentStat& agent = agent_it->second;
+        agent.query_task = 0;
+        int32_t now_tm = common::timer::now_time();
+        VLOG(10) << agent_endpoint << ",  last:" << agent.last_heartbeat_time
+                 << ",timeout:" << FLAGS_agent_timeout
+                 << ",now_tm:" << now_tm;
+        if (agent.last_heartbeat_time + FLAGS_agent_timeout < now_tm) {
+            LOG(WARNING) << "this agent maybe dead:" << agent_endpoint;
+            if (agent.status != proto::kAgentDead) {
+                EventLog ev("agent");
+                LOG(ERROR) << ev
+                    .AppendTime("time").Append("endpoint", agent_endpoint)
+                    .Append("action", "dead").Append("detail", "agent heartbeat tiemout, agent dead")
+                    .ToString();
+            }
+            if (agent.status != proto::kAgentDead) {
+                AccountAgent(agent_endpoint, -1);
+                agent.status = proto::kAgentDead;
+                AccountAgent(agent_endpoint, 1);
+                PublishStatus();
+            }
+            scheduler_->RemoveAgent(agent_endpoint);
+            agent.reported = false;
+            ScheduleQuery(agent_endpoint, FLAGS_agent_query_interval * 1000, true);
+            return;
+        }
+        if (FLAGS_agent_query_max_outstanding > 0
+            && outstanding_queries_ >= FLAGS_agent_query_max_outstanding) {
+            VLOG(10) << "too many queries on the way, delay query of " << agent_endpoint;
+            ScheduleQuery(agent_endpoint, FLAGS_agent_query_min_interval, is_first_query);
+            return;
+        }
+        outstanding_queries_++;
+        request = new proto::QueryRequest();
+        request->set_full_report(is_first_query);
+        if (!is_first_query && FLAGS_agent_incremental_query && agent.report_seq > 0) {
+            request->set_since_seq(agent.report_seq);
         }
-        agent.status = proto::kAgentDead;
-        scheduler_->RemoveAgent(agent_endpoint);
-        query_pool_.DelayTask(FLAGS_agent_query_interval * 1000,
-            boost::bind(&ResManImpl::QueryAgent, this, agent_endpoint, true)
-        );
-        return;
     }
-    proto::Agent_Stub* stub;
-    rpc_client_.GetStub(agent_endpoint, &stub);
-    boost::scoped_ptr<proto::Agent_Stub> stub_guard(stub);
-    boost::function<void (const proto::QueryRequest*,
-                          proto::QueryResponse*, bool, int)> callback;
+    // not with mu_ held, an in-process transport may answer at once
+    AgentTransport::QueryCallback callback;
     callback = boost::bind(&ResManImpl::QueryAgentCallback, this,
                            agent_endpoint, is_first_query,
                            _1, _2, _3, _4);
-    proto::QueryRequest* request = new proto::QueryRequest();
-    request->set_full_report(is_first_query);
     proto::QueryResponse* response = new proto::QueryResponse();
-    rpc_client_.AsyncRequest(stub, &proto::Agent_Stub::Query,
-                             request, response, callback, 5, 1);
+    agent_transport_->Query(agent_endpoint, request, response, callback);
     VLOG(10) << "send query command to:" << agent_endpoint;
 }
 
@@ -353,54 +721,78 @@ void ResManImpl::QueryAgentCallback(std::string agent_endpoint,
                                     bool rpc_fail, int err) {
     boost::scoped_ptr<const proto::QueryRequest> request_guard(request);
     boost::scoped_ptr<proto::QueryResponse> response_guard(response);
+    bool standby = false;
+    {
+        MutexLock lock(&mu_);
+        outstanding_queries_--;
+        standby = standby_;
+    }
     if (response->code().status() != proto::kOk || rpc_fail) {
         LOG(WARNING) << "failed to query on: " << agent_endpoint
                      << " err: " << err << ", rpc_fail:" << rpc_fail;
-        query_pool_.DelayTask(FLAGS_agent_query_interval * 1000,
-            boost::bind(&ResManImpl::QueryAgent, this, agent_endpoint, is_first_query)
-        );
+        MutexLock lock(&mu_);
+        ScheduleQuery(agent_endpoint, FLAGS_agent_query_interval * 1000, is_first_query);
         return;
     }
+    if (rpc_recorder_ != NULL) {
+        rpc_recorder_->Record(sAgentQueryMethod, agent_endpoint, *request, response);
+    }
+    const proto::AgentInfo* report = &response->agent_info();
+    proto::AgentInfo merged;
+    proto::AgentInfo completed;
+    if (response->incremental()) {
+        if (!MergeAgentReport(agent_endpoint, *request, *response, merged)) {
+            LOG(WARNING) << "incremental report does not follow the last one, "
+                         << "ask for all containers next time: " << agent_endpoint;
+            MutexLock lock(&mu_);
+            std::map<std::string, AgentStat>::iterator stat_it = agent_stats_.find(agent_endpoint);
+            if (stat_it == agent_stats_.end()) {
+                return;
+            }
+            stat_it->second.report_seq = 0;
+            ScheduleQuery(agent_endpoint, FLAGS_agent_query_min_interval, is_first_query);
+            return;
+        }
+        report = &merged;
+    }
+    // the agent is busy, a first query makes commands for it soon
+    bool active = is_first_query;
     if (is_first_query) {
         MutexLock lock(&mu_);
-        std::map<std::string, proto::AgentMeta>::iterator agent_it
-            = agents_.find(agent_endpoint);
-        if (agent_it == agents_.end()) {
+        if (!AddAgentToScheduler(agent_endpoint, response->agent_info())) {
             LOG(WARNING) << "query result for expired agent:" << agent_endpoint;
             return;
         }
-        proto::AgentMeta& agent_meta = agent_it->second;
-        const proto::AgentInfo& agent_info = response->agent_info();
-        int64_t cpu = agent_info.cpu_resource().total();
-        int64_t memory = agent_info.memory_resource().total();
-        std::map<sched::DevicePath, sched::VolumInfo> volums;
-        for (int i = 0; i < agent_info.volum_resources_size(); i++) {
-            const proto::VolumResource& vres = agent_info.volum_resources(i);
-            sched::VolumInfo& vinfo = volums[vres.device_path()];
-            vinfo.size = vres.volum().total();
-            vinfo.medium = vres.medium();
-        }
-        const std::set<std::string>& tags = agent_tags_[agent_endpoint];
-        std::string pool_name = agent_meta.pool();
-        sched::Agent::Ptr agent(new sched::Agent(agent_endpoint,
-                                                 cpu,
-                                                 memory,
-                                                 volums,
-                                                 tags,
-                                                 pool_name));
-        scheduler_->RemoveAgent(agent_endpoint);
-        scheduler_->AddAgent(agent, agent_info);
         LOG(INFO) << "TRACE BEGIN, first query result from:" << agent_endpoint
-                  << "\n" << agent_info.DebugString()
+                  << "\n" << response->agent_info().DebugString()
                   << "\nTRACE END";
         is_first_query = false;
+    } else if (standby) {
+        // no command from a standby, the scheduler only follows the agent.
+        // The report kept in the stat carries full descriptions, those of
+        // containers not in it yet take a full report
+        MutexLock lock(&mu_);
+        std::map<std::string, AgentStat>::const_iterator stat_it;
+        stat_it = agent_stats_.find(agent_endpoint);
+        if (stat_it != agent_stats_.end()) {
+            if (!CompleteReport(stat_it->second.info, *report, completed)) {
+                VLOG(10) << "container description missing, ask for a full report: "
+                         << agent_endpoint;
+                is_first_query = true;
+                active = true;
+            } else if (IsReportActive(stat_it->second.info, completed)) {
+                AddAgentToScheduler(agent_endpoint, completed);
+            }
+            report = &completed;
+        }
     } else {
         VLOG(10) << "TRACE BEGIN, query result from: " << agent_endpoint
-                 << "\n" << response->agent_info().DebugString()
+                 << "\n" << response->DebugString()
                  << "\nTRACE END";
         std::vector<sched::AgentCommand> commands;
-        scheduler_->MakeCommand(agent_endpoint, response->agent_info(), commands);
+        scheduler_->MakeCommand(agent_endpoint, *report, commands);
         SendCommandsToAgent(agent_endpoint, commands);
+        active = !commands.empty();
     }
 
     bool leave_safe_mode_event = false;
@@ -410,10 +802,21 @@ void ResManImpl::QueryAgentCallback(std::string agent_endpoint,
             LOG(INFO) << "this agent may be removed, no need to query again";
             return;
         }
-        agent_stats_[agent_endpoint].info = response->agent_info();
-        if (!force_safe_mode_ &&
+        AccountAgent(agent_endpoint, -1);
+        AgentStat& stat = agent_stats_[agent_endpoint];
+        active = active || IsReportActive(stat.info, *report);
+        stat.info = *report;
+        stat.report_seq = response->seq();
+        // the first query added the agent to the scheduler, later ones follow it
+        stat.reported = true;
+        if (standby_) {
+            // agents heartbeat the leader only, an answer tells it is alive
+            stat.last_heartbeat_time = common::timer::now_time();
+        }
+        AccountAgent(agent_endpoint, 1);
+        if (!standby_ && !force_safe_mode_ &&
             safe_mode_ &&
-            agent_stats_.size() > (double)agents_.size() * FLAGS_safe_mode_percent) {
+            ReportedAgents() > (double)agents_.size() * FLAGS_safe_mode_percent) {
             int64_t running_time = (common::timer::get_micros() - start_time_) / 1000000;
             LOG(INFO) << "running time: " << running_time << " seconds";
             if ( running_time > FLAGS_agent_timeout) {
@@ -422,33 +825,210 @@ void ResManImpl::QueryAgentCallback(std::string agent_endpoint,
                 leave_safe_mode_event = true;
             }
         }
+        PublishStatus();
+        //query again later
+        ScheduleQuery(agent_endpoint, NextQueryDelay(stat, active), is_first_query);
     }
     if (leave_safe_mode_event) {
         scheduler_->Start();
     }
-    //query again later
-    query_pool_.DelayTask(FLAGS_agent_query_interval * 1000,
+}
+
+void ResManImpl::ScheduleQuery(const std::string& agent_endpoint,
+                               int64_t delay, bool is_first_query) {
+    mu_.AssertHeld();
+    std::map<std::string, AgentStat>::iterator it = agent_stats_.find(agent_endpoint);
+    if (it == agent_stats_.end()) {
+        return;
+    }
+    AgentStat& stat = it->second;
+    if (FLAGS_agent_adaptive_query && FLAGS_agent_query_jitter > 0) {
+        double rnd = (double)rand() / RAND_MAX * 2 - 1;
+        delay += (int64_t)(delay * FLAGS_agent_query_jitter * rnd);
+    }
+    stat.query_task = query_pool_.DelayTask(delay,
         boost::bind(&ResManImpl::QueryAgent, this, agent_endpoint, is_first_query)
     );
+    stat.query_due = common::timer::get_micros() + delay * 1000;
+    stat.query_task_first = is_first_query;
+}
+
+int64_t ResManImpl::NextQueryDelay(AgentStat& stat, bool active) {
+    mu_.AssertHeld();
+    if (!FLAGS_agent_adaptive_query) {
+        return FLAGS_agent_query_interval * 1000;
+    }
+    if (active || stat.query_expedite) {
+        stat.query_interval = FLAGS_agent_query_min_interval;
+    } else if (stat.query_interval == 0) {
+        stat.query_interval = FLAGS_agent_query_interval * 1000;
+    } else {
+        stat.query_interval = std::min(stat.query_interval * 2,
+                                       (int64_t)FLAGS_agent_query_max_interval * 1000);
+    }
+    stat.query_expedite = false;
+    return stat.query_interval;
+}
+
+void ResManImpl::ExpediteQuery(const std::string& agent_endpoint) {
+    mu_.AssertHeld();
+    if (!FLAGS_agent_adaptive_query) {
+        return;
+    }
+    std::map<std::string, AgentStat>::iterator it = agent_stats_.find(agent_endpoint);
+    if (it == agent_stats_.end()) {
+        return;
+    }
+    it->second.query_interval = FLAGS_agent_query_min_interval;
+    AdvanceQuery(agent_endpoint, FLAGS_agent_query_min_interval);
+}
+
+void ResManImpl::AdvanceQuery(const std::string& agent_endpoint, int64_t delay) {
+    mu_.AssertHeld();
+    std::map<std::string, AgentStat>::iterator it = agent_stats_.find(agent_endpoint);
+    if (it == agent_stats_.end()) {
+        return;
+    }
+    AgentStat& stat = it->second;
+    int64_t due = common::timer::get_micros() + delay * 1000;
+    if (stat.query_task == 0) {
+        stat.query_expedite = true;
+    } else if (stat.query_due > due) {
+        // never block on a running query, it waits for mu_
+        if (query_pool_.CancelTask(stat.query_task, true)) {
+            ScheduleQuery(agent_endpoint, delay, stat.query_task_first);
+        } else {
+            stat.query_expedite = true;
+        }
+    }
+}
+
+size_t ResManImpl::ReportedAgents() {
+    mu_.AssertHeld();
+    size_t reported = 0;
+    std::map<std::string, AgentStat>::const_iterator it;
+    for (it = agent_stats_.begin(); it != agent_stats_.end(); it++) {
+        if (it->second.reported && it->second.status != proto::kAgentDead) {
+            reported++;
+        }
+    }
+    return reported;
+}
+
+void ResManImpl::DeadCheckRoutine() {
+    MutexLock lock(&mu_);
+    int32_t now_tm = common::timer::now_time();
+    std::map<std::string, AgentStat>::iterator it;
+    for (it = agent_stats_.begin(); it != agent_stats_.end(); it++) {
+        const AgentStat& stat = it->second;
+        if (stat.status != proto::kAgentDead
+            && stat.last_heartbeat_time + FLAGS_agent_timeout < now_tm) {
+            AdvanceQuery(it->first, 0);
+        }
+    }
+    query_pool_.DelayTask(FLAGS_agent_dead_check_interval,
+        boost::bind(&ResManImpl::DeadCheckRoutine, this)
+    );
+}
+
+void ResManImpl::ExpeditePoolQueries(const proto::ContainerDescription& desc) {
+    mu_.AssertHeld();
+    for (int i = 0; i < desc.pool_names_size(); i++) {
+        std::map<std::string, std::set<std::string> >::const_iterator pool_it;
+        pool_it = pools_.find(desc.pool_names(i));
+        if (pool_it == pools_.end()) {
+            continue;
+        }
+        std::set<std::string>::const_iterator ep_it;
+        for (ep_it = pool_it->second.begin(); ep_it != pool_it->second.end(); ep_it++) {
+            ExpediteQuery(*ep_it);
+        }
+    }
+}
+
+bool ResManImpl::MergeAgentReport(const std::string& agent_endpoint,
+                                  const proto::QueryRequest& request,
+                                  const proto::QueryResponse& response,
+                                  proto::AgentInfo& merged) {
+    MutexLock lock(&mu_);
+    std::map<std::string, AgentStat>::iterator it = agent_stats_.find(agent_endpoint);
+    if (it == agent_stats_.end() || it->second.report_seq == 0
+        || it->second.report_seq != request.since_seq()) {
+        return false;
+    }
+    const proto::AgentInfo& last = it->second.info;
+    const proto::AgentInfo& delta = response.agent_info();
+    std::map<std::string, const proto::ContainerInfo*> containers;
+    for (int i = 0; i < last.container_info_size(); i++) {
+        containers[last.container_info(i).id()] = &last.container_info(i);
+    }
+    for (int i = 0; i < response.removed_containers_size(); i++) {
+        containers.erase(response.removed_containers(i));
+    }
+    for (int i = 0; i < delta.container_info_size(); i++) {
+        containers[delta.container_info(i).id()] = &delta.container_info(i);
+    }
+    merged.CopyFrom(delta);
+    merged.clear_container_info();
+    std::map<std::string, const proto::ContainerInfo*>::const_iterator c_it;
+    for (c_it = containers.begin(); c_it != containers.end(); c_it++) {
+        merged.add_container_info()->CopyFrom(*c_it->second);
+    }
+    return true;
+}
+
+bool ResManImpl::AddAgentToScheduler(const std::string& agent_endpoint,
+                                     const proto::AgentInfo& agent_info) {
+    mu_.AssertHeld();
+    std::map<std::string, proto::AgentMeta>::iterator agent_it
+        = agents_.find(agent_endpoint);
+    if (agent_it == agents_.end()) {
+        return false;
+    }
+    proto::AgentMeta& agent_meta = agent_it->second;
+    int64_t cpu = agent_info.cpu_resource().total();
+    int64_t memory = agent_info.memory_resource().total();
+    std::map<sched::DevicePath, sched::VolumInfo> volums;
+    for (int i = 0; i < agent_info.volum_resources_size(); i++) {
+        const proto::VolumResource& vres = agent_info.volum_resources(i);
+        sched::VolumInfo& vinfo = volums[vres.device_path()];
+        vinfo.size = vres.volum().total();
+        vinfo.medium = vres.medium();
+    }
+    const std::set<std::string>& tags = agent_tags_[agent_endpoint];
+    std::string pool_name = agent_meta.pool();
+    sched::Agent::Ptr agent(new sched::Agent(agent_endpoint,
+                                             cpu,
+                                             memory,
+                                             volums,
+                                             tags,
+                                             pool_name));
+    scheduler_->RemoveAgent(agent_endpoint);
+    scheduler_->AddAgent(agent, agent_info);
+    return true;
 }
 
 void ResManImpl::SendCommandsToAgent(const std::string& agent_endpoint,
                                      const std::vector<sched::AgentCommand>& commands) {
+    if (FLAGS_agent_batch_command) {
+        SendBatchCommandToAgent(agent_endpoint, commands);
+    } else {
+        SendEachCommandToAgent(agent_endpoint, commands);
+    }
+}
+
+void ResManImpl::SendEachCommandToAgent(const std::string& agent_endpoint,
+                                        const std::vector<sched::AgentCommand>& commands) {
     std::vector<sched::AgentCommand>::const_iterator it;
     for (it = commands.begin(); it != commands.end(); it++) {
         const sched::AgentCommand& cmd = *it;
-        proto::Agent_Stub* stub;
-        rpc_client_.GetStub(agent_endpoint, &stub);
-        boost::scoped_ptr<proto::Agent_Stub> stub_guard(stub);
         if (cmd.action == sched::kCreateContainer) {
             proto::CreateContainerRequest* request = new proto::CreateContainerRequest();
             proto::CreateContainerResponse* response = new proto::CreateContainerResponse();
             request->set_id(cmd.container_id);
             request->set_container_group_id(cmd.container_group_id);
             request->mutable_container()->CopyFrom(cmd.desc);
-            boost::function<void (const proto::CreateContainerRequest*,
-                                  proto::CreateContainerResponse*,
-                                  bool, int)> callback;
+            AgentTransport::CreateContainerCallback callback;
             callback = boost::bind(&ResManImpl::CreateContainerCallback, this,
                                    agent_endpoint, _1, _2, _3, _4);
             LOG(INFO) << "send create command, container: "
@@ -457,23 +1037,19 @@ void ResManImpl::SendCommandsToAgent(const std::string& agent_endpoint,
             VLOG(10) << "TRACE BEGIN create container: " << cmd.container_id;
             VLOG(10) <<  request->DebugString();
             VLOG(10) << "TRACE END";
-            rpc_client_.AsyncRequest(stub, &proto::Agent_Stub::CreateContainer,
-                                     request, response, callback, 5, 1);
+            agent_transport_->CreateContainer(agent_endpoint, request, response, callback);
         } else if (cmd.action == sched::kDestroyContainer) {
             proto::RemoveContainerRequest* request = new proto::RemoveContainerRequest();
             proto::RemoveContainerResponse* response = new proto::RemoveContainerResponse();
             request->set_id(cmd.container_id);
             request->set_container_group_id(cmd.container_group_id);
-            boost::function<void (const proto::RemoveContainerRequest*,
-                                  proto::RemoveContainerResponse*,
-                                  bool, int)> callback;
+            AgentTransport::RemoveContainerCallback callback;
             callback = boost::bind(&ResManImpl::RemoveContainerCallback, this,
                                    agent_endpoint, _1, _2, _3, _4);
             VLOG(10) << "TRACE BEGIN remove container: " << cmd.container_id;
             VLOG(10) <<  request->DebugString();
             VLOG(10) << "TRACE END";
-            rpc_client_.AsyncRequest(stub, &proto::Agent_Stub::RemoveContainer,
-                                     request, response, callback, 5, 1);
+            agent_transport_->RemoveContainer(agent_endpoint, request, response, callback);
             LOG(INFO) << "send remove command, container: "
                       << cmd.container_id << ", agent:"
                       << agent_endpoint;
@@ -481,6 +1057,78 @@ void ResManImpl::SendCommandsToAgent(const std::string& agent_endpoint,
     }
 }
 
+void ResManImpl::SendBatchCommandToAgent(const std::string& agent_endpoint,
+                                         const std::vector<sched::AgentCommand>& commands) {
+    if (commands.empty()) {
+        return;
+    }
+    proto::BatchCommandRequest* request = new proto::BatchCommandRequest();
+    proto::BatchCommandResponse* response = new proto::BatchCommandResponse();
+    std::vector<sched::AgentCommand>::const_iterator it;
+    for (it = commands.begin(); it != commands.end(); it++) {
+        const sched::AgentCommand& cmd = *it;
+        if (cmd.action == sched::kCreateContainer) {
+            proto::CreateContainerRequest* create = request->add_commands()->mutable_create();
+            create->set_id(cmd.container_id);
+            create->set_container_group_id(cmd.container_group_id);
+            create->mutable_container()->CopyFrom(cmd.desc);
+            LOG(INFO) << "batch create command, container: "
+                      << cmd.container_id << ", agent:"
+                      << agent_endpoint;
+        } else if (cmd.action == sched::kDestroyContainer) {
+            proto::RemoveContainerRequest* remove = request->add_commands()->mutable_remove();
+            remove->set_id(cmd.container_id);
+            remove->set_container_group_id(cmd.container_group_id);
+            LOG(INFO) << "batch remove command, container: "
+                      << cmd.container_id << ", agent:"
+                      << agent_endpoint;
+        }
+    }
+    AgentTransport::BatchCommandCallback callback;
+    callback = boost::bind(&ResManImpl::BatchCommandCallback, this,
+                           agent_endpoint, _1, _2, _3, _4);
+    VLOG(10) << "TRACE BEGIN batch command to: " << agent_endpoint;
+    VLOG(10) <<  request->DebugString();
+    VLOG(10) << "TRACE END";
+    agent_transport_->BatchCommand(agent_endpoint, request, response, callback);
+    LOG(INFO) << "send batch command, size: " << request->commands_size()
+              << ", agent:" << agent_endpoint;
+}
+
+void ResManImpl::ReserveRoutine() {
+    std::map<sched::AgentEndpoint, std::vector<sched::AgentCommand> > placements;
+    scheduler_->TakePlacements(placements);
+    std::map<sched::AgentEndpoint, std::vector<sched::AgentCommand> >::const_iterator it;
+    for (it = placements.begin(); it != placements.end(); it++) {
+        const std::string& agent_endpoint = it->first;
+        if (!FLAGS_agent_reservation) {
+            // the create commands go with the next query
+            MutexLock lock(&mu_);
+            ExpediteQuery(agent_endpoint);
+            continue;
+        }
+        proto::ReserveRequest* request = new proto::ReserveRequest();
+        proto::ReserveResponse* response = new proto::ReserveResponse();
+        request->set_lease_time(FLAGS_reservation_lease_time);
+        std::vector<sched::AgentCommand>::const_iterator cmd_it;
+        for (cmd_it = it->second.begin(); cmd_it != it->second.end(); cmd_it++) {
+            proto::CreateContainerRequest* container = request->add_containers();
+            container->set_id(cmd_it->container_id);
+            container->set_container_group_id(cmd_it->container_group_id);
+            container->mutable_container()->CopyFrom(cmd_it->desc);
+        }
+        AgentTransport::ReserveCallback callback;
+        callback = boost::bind(&ResManImpl::ReserveCallback, this,
+                               agent_endpoint, _1, _2, _3, _4);
+        agent_transport_->Reserve(agent_endpoint, request, response, callback);
+        LOG(INFO) << "send reservation, size: " << request->containers_size()
+                  << ", agent:" << agent_endpoint;
+    }
+    reserve_pool_.DelayTask(FLAGS_reservation_interval,
+        boost::bind(&ResManImpl::ReserveRoutine, this)
+    );
+}
+
 void ResManImpl::KeepAlive(::google::protobuf::RpcController* controller,
                            const ::baidu::galaxy::proto::KeepAliveRequest* request,
                            ::baidu::galaxy::proto::KeepAliveResponse* response,
@@ -504,7 +1152,9 @@ void ResManImpl::KeepAlive(::google::protobuf::RpcController* controller,
     if (agent_first_heartbeat) {
         LOG(INFO) << "first heartbeat of: " << agent_ep;
     }
+    AccountAgent(agent_ep, -1);
     AgentStat& agent = agent_stats_[agent_ep];
+    proto::AgentStatus old_status = agent.status;
     if (agent.status == proto::kAgentDead) {
         EventLog ev("agent");
         LOG(ERROR) << ev
@@ -516,12 +1166,19 @@ void ResManImpl::KeepAlive(::google::protobuf::RpcController* controller,
     if (agent.status != proto::kAgentOffline && agent.status != proto::kAgentFreezed) {
         agent.status = proto::kAgentAlive;
     }
+    AccountAgent(agent_ep, 1);
+    if (agent_first_heartbeat || agent.status != old_status) {
+        PublishStatus();
+    }
     agent.last_heartbeat_time = common::timer::now_time();
     VLOG(10) << "heartbeat of: " << agent_ep << ", last: " << agent.last_heartbeat_time;
     if (agent_first_heartbeat) {
-        query_pool_.AddTask(
-            boost::bind(&ResManImpl::QueryAgent, this, agent_ep, true)
-        );
+        // spread the first queries, all agents come at once after a failover
+        int64_t delay = 0;
+        if (FLAGS_agent_adaptive_query) {
+            delay = rand() % (FLAGS_agent_query_interval * 1000);
+        }
+        ScheduleQuery(agent_ep, delay, true);
     }
     done->Run();
 }
@@ -569,8 +1226,7 @@ void ResManImpl::CreateContainerGroup(::google::protobuf::RpcController* control
     }
     container_group_meta.set_id(container_group_id);
     LOG(INFO) << container_group_meta.DebugString();
-    bool ret = SaveObject(sContainerGroupPrefix + "/" + container_group_id,
-                          container_group_meta);
+    bool ret = SaveContainerGroup(container_group_meta);
     if (!ret) {
         proto::ErrorCode* err = response->mutable_error_code();
         err->set_status(proto::kCreateContainerGroupFail);
@@ -582,6 +1238,8 @@ void ResManImpl::CreateContainerGroup(::google::protobuf::RpcController* control
         {
             MutexLock lock(&mu_);
             container_groups_[container_group_id] = container_group_meta;
+            PublishStatus();
+            ExpeditePoolQueries(container_group_meta.desc());
         }
     }
     done->Run();
@@ -623,7 +1281,7 @@ void ResManImpl::RemoveContainerGroup(::google::protobuf::RpcController* control
         done->Run();
         return;
     }
-    bool ret = RemoveObject(sContainerGroupPrefix + "/" + request->id());
+    bool ret = RemoveContainerGroupMeta(request->id());
     if (!ret) {
         proto::ErrorCode* err = response->mutable_error_code();
         err->set_status(proto::kRemoveContainerGroupFail);
@@ -632,6 +1290,8 @@ void ResManImpl::RemoveContainerGroup(::google::protobuf::RpcController* control
         {
             MutexLock lock(&mu_);
             container_groups_.erase(request->id());
+            PublishStatus();
+            ExpeditePoolQueries(desc);
         }
         scheduler_->Kill(request->id());
         response->mutable_error_code()->set_status(proto::kOk);
@@ -732,9 +1392,10 @@ void ResManImpl::UpdateContainerGroup(::google::protobuf::RpcController* control
     {
         MutexLock lock(&mu_);
         container_groups_[new_meta.id()] = new_meta;
+        ExpeditePoolQueries(old_meta.desc());
+        ExpeditePoolQueries(new_meta.desc());
     }
-    bool save_ok = SaveObject(sContainerGroupPrefix + "/" + new_meta.id(),
-                              new_meta);
+    bool save_ok = SaveContainerGroup(new_meta);
     if (!save_ok) {
         proto::ErrorCode* err = response->mutable_error_code();
         err->set_status(proto::kUpdateContainerGroupFail);
@@ -753,10 +1414,12 @@ void ResManImpl::ListContainerGroups(::google::protobuf::RpcController* controll
                                      ::baidu::galaxy::proto::ListContainerGroupsResponse* response,
                                      ::google::protobuf::Closure* done) {
     std::vector<proto::ContainerGroupStatistics> container_groups;
-    scheduler_->ListContainerGroups(container_groups);
+    int64_t snapshot_time = 0;
+    scheduler_->ListContainerGroups(container_groups, snapshot_time);
     for (size_t i = 0; i < container_groups.size(); i++) {
         response->add_containers()->CopyFrom(container_groups[i]);
     }
+    response->set_snapshot_time(snapshot_time);
     response->mutable_error_code()->set_status(proto::kOk);
     VLOG(16) << "list containers:" << response->DebugString();
     done->Run();
@@ -823,7 +1486,10 @@ void ResManImpl::AddAgent(::google::protobuf::RpcController* controller,
     } else {
         {
             MutexLock lock(&mu_);
+            AccountAgent(agent_meta.endpoint(), -1);
             agents_[agent_meta.endpoint()] = agent_meta;
+            AccountAgent(agent_meta.endpoint(), 1);
+            PublishStatus();
             pools_[agent_meta.pool()].insert(agent_meta.endpoint());
         }
         response->mutable_error_code()->set_status(proto::kOk);
@@ -867,8 +1533,10 @@ void ResManImpl::RemoveAgent(::google::protobuf::RpcController* controller,
         response->mutable_error_code()->set_reason("fail to delete meta from nexus");
     } else {
         MutexLock lock(&mu_);
+        AccountAgent(endpoint, -1);
         agents_.erase(endpoint);
         agent_stats_.erase(endpoint);
+        PublishStatus();
         pools_[agent_pool].erase(endpoint);
         std::set<std::string>::const_iterator tag_it;
         for (tag_it = agent_tags.begin(); tag_it != agent_tags.end(); tag_it++) {
@@ -992,37 +1660,43 @@ void ResManImpl::CreateTag(::google::protobuf::RpcController* controller,
         err->set_reason("fail to save tag to nexus");
     } else {
         MutexLock lock(&mu_);
-        std::set<std::string>& tag_old = tags_[tag];
-        std::set<std::string>::iterator it_old = tag_old.begin();
-        std::set<std::string>::iterator it_new = tag_new.begin();
-        while (it_old != tag_old.end() && it_new != tag_new.end()) {
-            if (*it_old < *it_new) {
-                agent_tags_[*it_old].erase(tag);
-                scheduler_->RemoveTag(*it_old, tag);
-                it_old++;
-            } else if (*it_old == *it_new) {
-                it_old++;
-                it_new++;
-            } else {
-                agent_tags_[*it_new].insert(tag);
-                scheduler_->AddTag(*it_new, tag);
-                it_new++;
-            }
-        }
-        while (it_old != tag_old.end()) {
+        ApplyTag(tag, tag_new);
+    }
+    response->mutable_error_code()->set_status(proto::kOk);
+    done->Run();
+}
+
+void ResManImpl::ApplyTag(const std::string& tag,
+                          const std::set<std::string>& tag_new) {
+    mu_.AssertHeld();
+    std::set<std::string>& tag_old = tags_[tag];
+    std::set<std::string>::iterator it_old = tag_old.begin();
+    std::set<std::string>::const_iterator it_new = tag_new.begin();
+    while (it_old != tag_old.end() && it_new != tag_new.end()) {
+        if (*it_old < *it_new) {
             agent_tags_[*it_old].erase(tag);
             scheduler_->RemoveTag(*it_old, tag);
             it_old++;
-        }
-        while (it_new != tag_new.end()) {
+        } else if (*it_old == *it_new) {
+            it_old++;
+            it_new++;
+        } else {
             agent_tags_[*it_new].insert(tag);
             scheduler_->AddTag(*it_new, tag);
             it_new++;
         }
-        tag_old = tag_new;
     }
-    response->mutable_error_code()->set_status(proto::kOk);
-    done->Run();
+    while (it_old != tag_old.end()) {
+        agent_tags_[*it_old].erase(tag);
+        scheduler_->RemoveTag(*it_old, tag);
+        it_old++;
+    }
+    while (it_new != tag_new.end()) {
+        agent_tags_[*it_new].insert(tag);
+        scheduler_->AddTag(*it_new, tag);
+        it_new++;
+    }
+    tag_old = tag_new;
 }
 
 void ResManImpl::ListTags(::google::protobuf::RpcController* controller,
@@ -1129,7 +1803,10 @@ void ResManImpl::AddAgentToPool(::google::protobuf::RpcController* controller,
         response->mutable_error_code()->set_reason("fail to save agent meta to nexus");
     } else {
         MutexLock lock(&mu_);
+        AccountAgent(endpoint, -1);
         agents_[endpoint].set_pool(pool);
+        AccountAgent(endpoint, 1);
+        PublishStatus();
         if (pools_.find(old_pool) != pools_.end()) {
             pools_[old_pool].erase(endpoint);
         }
@@ -1228,6 +1905,7 @@ void ResManImpl::AddUser(::google::protobuf::RpcController* controller,
     } else {
         MutexLock lock(&mu_);
         users_[user_name] = user_meta;
+        admission_.AddUser(user_name);
         response->mutable_error_code()->set_status(proto::kOk);
     }
     done->Run();
@@ -1255,6 +1933,7 @@ void ResManImpl::RemoveUser(::google::protobuf::RpcController* controller,
     } else {
         MutexLock lock(&mu_);
         users_.erase(user_name);
+        admission_.RemoveUser(user_name);
         response->mutable_error_code()->set_status(proto::kOk);
     }
     done->Run();
@@ -1432,13 +2111,18 @@ void ResManImpl::AssignQuota(::google::protobuf::RpcController* controller,
 }
 
 bool ResManImpl::RemoveObject(const std::string& key) {
-    ::galaxy::ins::sdk::SDKError err;
     std::string full_key = FLAGS_nexus_root + key;
-    bool ret = nexus_->Delete(full_key, &err);
-    if (!ret) {
-        LOG(WARNING) << "nexus error:" << err;
+    return meta_journal_->Delete(full_key);
+}
+
+bool ResManImpl::SaveBuffer(const std::string& key, const std::string& raw_buf) {
+    std::string full_key = FLAGS_nexus_root + key;
+    if (!FLAGS_meta_compact_encoding) {
+        return meta_journal_->Put(full_key, raw_buf);
     }
-    return ret;
+    std::string record;
+    MetaCodec::Encode(raw_buf, FLAGS_meta_compress_min_size, &record);
+    return meta_journal_->Put(full_key, record);
 }
 
 template <class ProtoClass>
@@ -1449,37 +2133,184 @@ bool ResManImpl::SaveObject(const std::string& key,
         LOG(WARNING) << "save object to protobuf fail";
         return false;
     }
-    ::galaxy::ins::sdk::SDKError err;
-    std::string full_key = FLAGS_nexus_root + key;
-    bool ret = nexus_->Put(full_key, raw_buf, &err);
-    if (!ret) {
-        LOG(WARNING) << "nexus error: " << err;
-    }
-    return ret;
+    return SaveBuffer(key, raw_buf);
 }
 
 template <class ProtoClass>
 bool ResManImpl::LoadObjects(const std::string& prefix,
                              std::map<std::string, ProtoClass>& objs) {
     std::string full_prefix = FLAGS_nexus_root + prefix;
-    ::galaxy::ins::sdk::ScanResult* result
-        = nexus_->Scan(full_prefix + "/", full_prefix + "/\xff");
-    boost::scoped_ptr< ::galaxy::ins::sdk::ScanResult > result_guard(result);
+    std::map<std::string, std::string> kvs;
+    if (!meta_journal_->Scan(full_prefix + "/", full_prefix + "/\xff", kvs)) {
+        return false;
+    }
     size_t prefix_len = full_prefix.size() + 1;
-    while (!result->Done()) {
-        const std::string& full_key = result->Key();
-        const std::string& raw_obj_buf = result->Value();
+    std::map<std::string, std::string>::const_iterator it;
+    for (it = kvs.begin(); it != kvs.end(); it++) {
+        const std::string& full_key = it->first;
+        const std::string& raw_obj_buf = it->second;
         std::string key = full_key.substr(prefix_len);
-        LOG(INFO) << "try load " << key << " from nexus";
+        VLOG(10) << "try load " << key << " from nexus";
+        std::string payload;
+        if (!MetaCodec::Decode(raw_obj_buf, &payload)) {
+            LOG(WARNING) << "decode meta record fail: " << key;
+            return false;
+        }
         ProtoClass& obj = objs[key];
-        bool parse_ok = obj.ParseFromString(raw_obj_buf);
+        bool parse_ok = obj.ParseFromString(payload);
         if (!parse_ok) {
             LOG(WARNING) << "parse protobuf object fail ";
             return false;
         }
-        result->Next();
     }
-    return result->Error() == ::galaxy::ins::sdk::kOK;
+    return true;
+}
+
+bool ResManImpl::SaveContainerGroup(const proto::ContainerGroupMeta& meta) {
+    const std::string& id = meta.id();
+    const std::string desc_prefix = MetaCodec::DescPrefix(sContainerGroupPrefix);
+    proto::ContainerGroupMeta record(meta);
+    record.clear_desc_digest();
+    std::string desc_buf;
+    std::set<std::string> digests;
+    if (FLAGS_meta_compact_encoding) {
+        if (!meta.desc().SerializeToString(&desc_buf)) {
+            LOG(WARNING) << "save container group desc to protobuf fail";
+            return false;
+        }
+        record.clear_desc();
+        record.set_desc_digest(MetaCodec::Digest(desc_buf));
+        digests.insert(record.desc_digest());
+    }
+    // a description is not removed while another group starts to refer to it
+    MutexLock lock(&desc_mu_);
+    std::set<std::string> old_digests;
+    desc_refs_.Get(id, &old_digests);
+    std::vector<std::string> added;
+    std::vector<std::string> released;
+    desc_refs_.Assign(id, digests, &added, &released);
+    bool save_ok = true;
+    for (size_t i = 0; i < added.size() && save_ok; i++) {
+        save_ok = SaveBuffer(desc_prefix + "/" + added[i], desc_buf);
+    }
+    if (save_ok) {
+        save_ok = SaveObject(sContainerGroupPrefix + "/" + id, record);
+    }
+    if (!save_ok) {
+        // the group still refers to what it did
+        released.clear();
+        desc_refs_.Assign(id, old_digests, NULL, &released);
+    }
+    for (size_t i = 0; i < released.size(); i++) {
+        if (!RemoveObject(desc_prefix + "/" + released[i])) {
+            LOG(WARNING) << "fail to remove container group desc: " << released[i];
+        }
+    }
+    return save_ok;
+}
+
+bool ResManImpl::RemoveContainerGroupMeta(const std::string& container_group_id) {
+    const std::string desc_prefix = MetaCodec::DescPrefix(sContainerGroupPrefix);
+    MutexLock lock(&desc_mu_);
+    if (!RemoveObject(sContainerGroupPrefix + "/" + container_group_id)) {
+        return false;
+    }
+    std::vector<std::string> released;
+    desc_refs_.Assign(container_group_id, std::set<std::string>(), NULL, &released);
+    for (size_t i = 0; i < released.size(); i++) {
+        if (!RemoveObject(desc_prefix + "/" + released[i])) {
+            LOG(WARNING) << "fail to remove container group desc: " << released[i];
+        }
+    }
+    return true;
+}
+
+bool ResManImpl::LoadContainerGroups(std::map<std::string, proto::ContainerGroupMeta>& container_groups) {
+    std::map<std::string, proto::ContainerDescription> descs;
+    if (!LoadObjects(sContainerGroupPrefix, container_groups)
+        || !LoadObjects(MetaCodec::DescPrefix(sContainerGroupPrefix), descs)) {
+        return false;
+    }
+    DescRefs desc_refs;
+    std::map<std::string, proto::ContainerGroupMeta>::iterator it;
+    for (it = container_groups.begin(); it != container_groups.end(); it++) {
+        proto::ContainerGroupMeta& meta = it->second;
+        if (!meta.has_desc_digest()) {
+            continue;
+        }
+        std::map<std::string, proto::ContainerDescription>::const_iterator desc_it;
+        desc_it = descs.find(meta.desc_digest());
+        if (desc_it == descs.end()) {
+            LOG(WARNING) << "desc of container group " << it->first
+                         << " not found: " << meta.desc_digest();
+            return false;
+        }
+        std::set<std::string> digests;
+        digests.insert(meta.desc_digest());
+        desc_refs.Assign(it->first, digests, NULL, NULL);
+        meta.mutable_desc()->CopyFrom(desc_it->second);
+        meta.clear_desc_digest();
+    }
+    MutexLock lock(&desc_mu_);
+    desc_refs_ = desc_refs;
+    return true;
+}
+
+void ResManImpl::MigrateMeta() {
+    if (!FLAGS_meta_compact_encoding) {
+        return;
+    }
+    const std::string desc_prefix = MetaCodec::DescPrefix(sContainerGroupPrefix);
+    // descs go last, the groups migrated refer to theirs by then
+    const std::string prefixes[] = {sAgentPrefix, sTagPrefix, sUserPrefix,
+                                    sContainerGroupPrefix, desc_prefix};
+    int64_t migrated = 0;
+    int64_t dropped = 0;
+    std::set<std::string> digests;
+    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++) {
+        const std::string& prefix = prefixes[i];
+        std::string full_prefix = FLAGS_nexus_root + prefix;
+        std::map<std::string, std::string> kvs;
+        if (!meta_journal_->Scan(full_prefix + "/", full_prefix + "/\xff", kvs)) {
+            LOG(WARNING) << "fail to scan meta for migration: " << prefix;
+            return;
+        }
+        std::map<std::string, std::string>::const_iterator it;
+        for (it = kvs.begin(); it != kvs.end(); it++) {
+            std::string key = it->first.substr(FLAGS_nexus_root.size());
+            if (prefix == desc_prefix) {
+                // left behind by a leader failing between writes
+                std::string digest = key.substr(prefix.size() + 1);
+                if (digests.find(digest) == digests.end() && RemoveObject(key)) {
+                    dropped++;
+                }
+                continue;
+            }
+            if (prefix != sContainerGroupPrefix) {
+                if (!MetaCodec::IsEncoded(it->second) && SaveBuffer(key, it->second)) {
+                    migrated++;
+                }
+                continue;
+            }
+            std::string payload;
+            proto::ContainerGroupMeta meta;
+            if (!MetaCodec::Decode(it->second, &payload) || !meta.ParseFromString(payload)) {
+                LOG(WARNING) << "fail to parse container group meta, migration stops: " << key;
+                return;
+            }
+            if (!MetaCodec::IsEncoded(it->second) || !meta.has_desc_digest()) {
+                if (!SaveContainerGroup(meta)) {
+                    LOG(WARNING) << "fail to migrate container group meta, migration stops: " << key;
+                    return;
+                }
+                migrated++;
+                meta.set_desc_digest(MetaCodec::Digest(meta.desc().SerializeAsString()));
+            }
+            digests.insert(meta.desc_digest());
+        }
+    }
+    LOG(INFO) << "meta records migrated: " << migrated
+              << ", unreferenced descs dropped: " << dropped;
 }
 
 void ResManImpl::CreateContainerCallback(std::string agent_endpoint,
@@ -1527,6 +2358,100 @@ void ResManImpl::RemoveContainerCallback(std::string agent_endpoint,
     }
 }
 
+void ResManImpl::BatchCommandCallback(std::string agent_endpoint,
+                                      const proto::BatchCommandRequest* request,
+                                      proto::BatchCommandResponse* response,
+                                      bool fail, int err) {
+    boost::scoped_ptr<const proto::BatchCommandRequest> request_guard(request);
+    boost::scoped_ptr<proto::BatchCommandResponse> response_guard(response);
+    VLOG(10) << "batch command response:" << response->DebugString();
+    if (fail || response->code().status() != proto::kOk) {
+        // agents not knowing the batch rpc fail it as well, the commands
+        // are not lost but sent one by one, failed creates go back to pending
+        LOG(WARNING) << "rpc fail of batch command, err: " << err
+                     << ", agent: " << agent_endpoint
+                     << ", size: " << request->commands_size()
+                     << ", resend one by one";
+        std::vector<sched::AgentCommand> commands;
+        for (int i = 0; i < request->commands_size(); i++) {
+            const proto::ContainerCommand& cmd = request->commands(i);
+            sched::AgentCommand command;
+            if (cmd.has_create()) {
+                command.action = sched::kCreateContainer;
+                command.container_id = cmd.create().id();
+                command.container_group_id = cmd.create().container_group_id();
+                command.desc.CopyFrom(cmd.create().container());
+            } else if (cmd.has_remove()) {
+                command.action = sched::kDestroyContainer;
+                command.container_id = cmd.remove().id();
+                command.container_group_id = cmd.remove().container_group_id();
+            } else {
+                continue;
+            }
+            commands.push_back(command);
+        }
+        SendEachCommandToAgent(agent_endpoint, commands);
+        return;
+    }
+    for (int i = 0; i < request->commands_size() && i < response->results_size(); i++) {
+        const proto::ContainerCommand& cmd = request->commands(i);
+        const proto::ErrorCode& result = response->results(i);
+        if (result.status() == proto::kOk) {
+            continue;
+        }
+        if (cmd.has_create()) {
+            LOG(WARNING) << "fail to create contaienr, reason:"
+                         << result.reason()
+                         << ", agent:" << agent_endpoint
+                         << ", contaienr_id: " << cmd.create().id();
+            scheduler_->ChangeStatus(cmd.create().container_group_id(),
+                                     cmd.create().id(),
+                                     proto::kContainerPending);
+        } else if (cmd.has_remove()) {
+            LOG(WARNING) << "fail to remove contaienr, reason:"
+                         << result.reason()
+                         << ", agent:" << agent_endpoint
+                         << ", container:" << cmd.remove().id();
+        }
+    }
+}
+
+void ResManImpl::ReserveCallback(std::string agent_endpoint,
+                                 const proto::ReserveRequest* request,
+                                 proto::ReserveResponse* response,
+                                 bool fail, int err) {
+    boost::scoped_ptr<const proto::ReserveRequest> request_guard(request);
+    boost::scoped_ptr<proto::ReserveResponse> response_guard(response);
+    bool rpc_fail = fail || response->code().status() != proto::kOk;
+    if (rpc_fail) {
+        // agents without reservation, the create command tells
+        VLOG(10) << "rpc fail of reservation, err: " << err
+                 << ", agent: " << agent_endpoint;
+    }
+    for (int i = 0; i < request->containers_size(); i++) {
+        const proto::CreateContainerRequest& container = request->containers(i);
+        if (!rpc_fail && i < response->results_size()
+            && response->results(i).status() != proto::kOk) {
+            LOG(WARNING) << "fail to reserve for container, reason:"
+                         << response->results(i).reason()
+                         << ", agent:" << agent_endpoint
+                         << ", container_id: " << container.id();
+            if (scheduler_->CancelPlacement(container.container_group_id(),
+                                            container.id(),
+                                            agent_endpoint)) {
+                continue;
+            }
+        }
+        // the create command goes only after the answer of the agent
+        scheduler_->AckReservation(container.container_group_id(),
+                                   container.id(),
+                                   agent_endpoint);
+    }
+    // create the reserved containers now rather than at the next query
+    MutexLock lock(&mu_);
+    ExpediteQuery(agent_endpoint);
+}
+
 template <class RpcRequest, class RpcResponse, class DoneClosure>
 bool ResManImpl::CheckUserExist(const RpcRequest* request,
                                 RpcResponse* response,
@@ -1589,6 +2514,8 @@ void ResManImpl::Preempt(::google::protobuf::RpcController* controller,
         response->mutable_error_code()->set_reason(fail_reason);
     } else {
         response->mutable_error_code()->set_status(proto::kOk);
+        MutexLock lock(&mu_);
+        ExpediteQuery(agent_endpoint);
     }
     done->Run();
 }
@@ -1611,7 +2538,10 @@ void ResManImpl::FreezeAgent(::google::protobuf::RpcController* controller,
         response->mutable_error_code()->set_status(proto::kError);
         response->mutable_error_code()->set_reason("no such agent");
     } else {
+        AccountAgent(endpoint, -1);
         it->second.status = proto::kAgentFreezed;
+        AccountAgent(endpoint, 1);
+        PublishStatus();
         response->mutable_error_code()->set_status(proto::kOk);
         EventLog ev("agent");
         LOG(ERROR) << ev
@@ -1642,7 +2572,10 @@ void ResManImpl::ThawAgent(::google::protobuf::RpcController* controller,
         response->mutable_error_code()->set_reason("no such freezed agent");
     } else {
         if (it->second.status == proto::kAgentFreezed) {
+            AccountAgent(endpoint, -1);
             it->second.status = proto::kAgentAlive;
+            AccountAgent(endpoint, 1);
+            PublishStatus();
         }
         response->mutable_error_code()->set_status(proto::kOk);
         EventLog ev("agent");
@@ -7,11 +7,19 @@
 #include <map>
 #include <set>
 #include <vector>
+#include <boost/shared_ptr.hpp>
 
 #include "src/protocol/resman.pb.h"
 #include "src/protocol/agent.pb.h"
 #include "scheduler.h"
 #include "ins_sdk.h"
+#include "meta_journal.h"
+#include "nexus_meta_store.h"
+#include "agent_transport.h"
+#include "rpc_recorder.h"
+#include "cluster_stat.h"
+#include "meta_codec.h"
+#include "admission.h"
 #include "src/rpc/rpc_client.h"
 #include "mutex.h"
 #include "thread_pool.h"
@@ -25,14 +33,39 @@ struct AgentStat {
     proto::AgentStatus status;
     proto::AgentInfo info;
     int32_t last_heartbeat_time; //timestamp in seconds
+    int64_t report_seq; //seq of the agent report merged in info, 0 if none
+    int64_t query_interval; //current adaptive query interval, in ms
+    int64_t query_task; //delayed query in query_pool_, 0 if none
+    int64_t query_due; //when query_task runs, in micros
+    bool query_task_first; //query_task is a first query
+    bool query_expedite; //a query is on the way, make the next one soon
+    bool reported; //a report of the agent is in the scheduler
 };
 
 class ResManImpl : public baidu::galaxy::proto::ResMan {
 public:
     ResManImpl();
+    // without nexus, takes the ownership of meta_store and agent_transport,
+    // for offline replay
+    ResManImpl(MetaStore* meta_store, AgentTransport* agent_transport);
     ~ResManImpl();
+    // records the rpc before handling it when rpc_record_path is set
+    virtual void CallMethod(const ::google::protobuf::MethodDescriptor* method,
+                            ::google::protobuf::RpcController* controller,
+                            const ::google::protobuf::Message* request,
+                            ::google::protobuf::Message* response,
+                            ::google::protobuf::Closure* done);
     bool Init();
     bool RegisterOnNexus(const std::string& endpoint);
+    // follows the meta and the agents of the leader as a warm standby,
+    // without sending commands to agents, until TakeOver
+    void StartStandby();
+    // becomes the leader once the resman lock is held
+    void TakeOver();
+    // rewrites meta written before the compact encoding and drops
+    // descriptions no container group refers to, only with the lock held;
+    // resman_main runs it when asked to by meta_migrate
+    void MigrateMeta();
     void EnterSafeMode(::google::protobuf::RpcController* controller,
                        const ::baidu::galaxy::proto::EnterSafeModeRequest* request,
                        ::baidu::galaxy::proto::EnterSafeModeResponse* response,
@@ -173,6 +206,41 @@ private:
                             const proto::QueryRequest* request,
                             proto::QueryResponse* response,
                             bool fail , int err);
+    // adds (sign 1) or takes (sign -1) the agent off cluster_stat_,
+    // around every change of its pool, status or info
+    void AccountAgent(const std::string& endpoint, int sign);
+    // makes the current cluster status visible to Status
+    void PublishStatus();
+    // scheduling of agent queries, with mu_ held
+    void ScheduleQuery(const std::string& agent_endpoint,
+                       int64_t delay, bool is_first_query);
+    int64_t NextQueryDelay(AgentStat& stat, bool active);
+    // alive agents whose reports are in the scheduler, with mu_ held;
+    // safe mode is left on them, not on the agents merely known
+    size_t ReportedAgents();
+    // query the agent soon, as it may have commands to take
+    void ExpediteQuery(const std::string& agent_endpoint);
+    // runs the query of the agent within delay (ms) unless it runs sooner
+    void AdvanceQuery(const std::string& agent_endpoint, int64_t delay);
+    // queries the agents missing heartbeats at once, QueryAgent finds them
+    // dead then; a stable agent may be queried only every
+    // agent_query_max_interval otherwise
+    void DeadCheckRoutine();
+    // the agents in the pools of the container group
+    void ExpeditePoolQueries(const proto::ContainerDescription& desc);
+    // replaces the agent in the scheduler with the report, with mu_ held
+    bool AddAgentToScheduler(const std::string& agent_endpoint,
+                             const proto::AgentInfo& agent_info);
+    // queries an agent not heartbeating this standby, with mu_ held
+    void FollowAgent(const std::string& agent_endpoint);
+    // reloads the meta written by the leader into a standby
+    void SyncMeta();
+    void SyncMetaRoutine();
+    void ApplyTag(const std::string& tag, const std::set<std::string>& tag_new);
+    bool MergeAgentReport(const std::string& agent_endpoint,
+                          const proto::QueryRequest& request,
+                          const proto::QueryResponse& response,
+                          proto::AgentInfo& merged);
     void CreateContainerCallback(std::string agent_endpoint,
                                  const proto::CreateContainerRequest* request,
                                  proto::CreateContainerResponse* response,
@@ -181,8 +249,24 @@ private:
                                  const proto::RemoveContainerRequest* request,
                                  proto::RemoveContainerResponse* response,
                                  bool fail, int err);
+    void BatchCommandCallback(std::string agent_endpoint,
+                              const proto::BatchCommandRequest* request,
+                              proto::BatchCommandResponse* response,
+                              bool fail, int err);
     void SendCommandsToAgent(const std::string& agent_endpoint,
                              const std::vector<sched::AgentCommand>& commands);
+    void SendBatchCommandToAgent(const std::string& agent_endpoint,
+                                 const std::vector<sched::AgentCommand>& commands);
+    void SendEachCommandToAgent(const std::string& agent_endpoint,
+                                const std::vector<sched::AgentCommand>& commands);
+    // hands new placements to their agents: reserves the resource of them
+    // first with agent_reservation, so that a disagreeing agent is known
+    // before the create command, and queries the agents soon for it
+    void ReserveRoutine();
+    void ReserveCallback(std::string agent_endpoint,
+                         const proto::ReserveRequest* request,
+                         proto::ReserveResponse* response,
+                         bool fail, int err);
     template <class ProtoClass>
     bool SaveObject(const std::string& key,
                     const ProtoClass& obj);
@@ -192,6 +276,15 @@ private:
                      std::map<std::string, ProtoClass>& objs);
 
     bool RemoveObject(const std::string& key);
+    // false with the response filled when the user is over the rate
+    bool Admit(const ::google::protobuf::MethodDescriptor* method,
+               const ::google::protobuf::Message* request,
+               ::google::protobuf::Message* response);
+    bool SaveBuffer(const std::string& key, const std::string& raw_buf);
+    // container groups keep their descriptions apart, see MetaCodec
+    bool SaveContainerGroup(const proto::ContainerGroupMeta& meta);
+    bool RemoveContainerGroupMeta(const std::string& container_group_id);
+    bool LoadContainerGroups(std::map<std::string, proto::ContainerGroupMeta>& container_groups);
     static void OnRMLockChange(const ::galaxy::ins::sdk::WatchParam& param,
                                ::galaxy::ins::sdk::SDKError err);
     void OnLockChange(std::string lock_session_id);
@@ -215,6 +308,8 @@ private:
 
     sched::Scheduler* scheduler_;
     InsSDK* nexus_;
+    MetaStore* meta_store_;
+    MetaJournal* meta_journal_;
     std::map<std::string, proto::AgentMeta> agents_;
     std::map<std::string, AgentStat> agent_stats_;
     std::map<std::string, std::set<std::string> > agent_tags_;
@@ -230,8 +325,24 @@ private:
     bool safe_mode_;
     bool force_safe_mode_;
     ThreadPool query_pool_;
-    RpcClient rpc_client_;
+    int32_t outstanding_queries_;
+    bool standby_;
+    // one SyncMeta at a time
+    Mutex sync_mu_;
+    ThreadPool sync_pool_;
+    ThreadPool reserve_pool_;
+    // descriptions referred to by container groups, held across the
+    // writes of a container group
+    Mutex desc_mu_;
+    DescRefs desc_refs_;
+    // rates of the rpc of each user, not under mu_
+    Admission admission_;
+    AgentTransport* agent_transport_;
+    RpcRecorder* rpc_recorder_;
     int64_t start_time_;
+    ClusterStat cluster_stat_;
+    Mutex status_mu_;
+    boost::shared_ptr<const proto::StatusResponse> status_snapshot_;
 };
 
 }
@@ -17,6 +17,8 @@
 #include "event_log.h"
 
 DECLARE_string(resman_port);
+DECLARE_bool(resman_standby);
+DECLARE_bool(meta_migrate);
 
 static volatile bool s_quit = false;
 static void SignalIntHandler(int /*sig*/){
@@ -28,16 +30,34 @@ int main(int argc, char* argv[]) {
     google::InitGoogleLogging(argv[0]);
     baidu::galaxy::SetupLog("resman");
     baidu::galaxy::ResManImpl * resman = new baidu::galaxy::ResManImpl();
+    std::string rm_endpoint = ::baidu::common::util::GetLocalHostName() + ":" +FLAGS_resman_port;
+    // the meta journal is replayed once the lock is held, so a leader
+    // registers before it loads the meta
+    bool nexus_ok = true;
+    if (!FLAGS_resman_standby) {
+        nexus_ok = resman->RegisterOnNexus(rm_endpoint);
+        if (!nexus_ok) {
+            LOG(WARNING) << "fail to register RM on nexus";
+            exit(-1);
+        }
+    }
     bool init_ok = resman->Init();
     if (!init_ok) {
         LOG(WARNING) << "fail to load meta from nexus";
         exit(-1);
     }
-    std::string rm_endpoint = ::baidu::common::util::GetLocalHostName() + ":" +FLAGS_resman_port;
-    bool nexus_ok = resman->RegisterOnNexus(rm_endpoint);
-    if (!nexus_ok) {
-        LOG(WARNING) << "fail to register RM on nexus";
-        exit(-1);
+    if (FLAGS_resman_standby) {
+        resman->StartStandby();
+        // waits here until the lock of the leader is released
+        nexus_ok = resman->RegisterOnNexus(rm_endpoint);
+        if (!nexus_ok) {
+            LOG(WARNING) << "fail to register RM on nexus";
+            exit(-1);
+        }
+        resman->TakeOver();
+    }
+    if (FLAGS_meta_migrate) {
+        resman->MigrateMeta();
     }
     sofa::pbrpc::RpcServerOptions options;
     sofa::pbrpc::RpcServer rpc_server(options);
@@ -0,0 +1,123 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "rpc_recorder.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <glog/logging.h>
+#include "timer.h"
+
+namespace baidu {
+namespace galaxy {
+
+// flush buffered records at least once a second
+const int64_t kRecordFlushInterval = 1000000L;
+
+RpcRecorder::RpcRecorder() : file_(NULL), last_flush_time_(0) {
+
+}
+
+RpcRecorder::~RpcRecorder() {
+    if (file_ != NULL) {
+        fclose(file_);
+    }
+}
+
+bool RpcRecorder::Open(const std::string& path) {
+    MutexLock lock(&mu_);
+    file_ = fopen(path.c_str(), "ab");
+    if (file_ == NULL) {
+        LOG(WARNING) << "fail to open rpc record file: " << path
+                     << ", err: " << strerror(errno);
+        return false;
+    }
+    LOG(INFO) << "record rpc to " << path;
+    return true;
+}
+
+void RpcRecorder::Record(const std::string& method,
+                         const std::string& endpoint,
+                         const google::protobuf::Message& request,
+                         const google::protobuf::Message* response) {
+    int64_t now = common::timer::get_micros();
+    proto::RpcRecord record;
+    record.set_time(now);
+    record.set_method(method);
+    if (!endpoint.empty()) {
+        record.set_endpoint(endpoint);
+    }
+    request.SerializeToString(record.mutable_request());
+    if (response != NULL) {
+        response->SerializeToString(record.mutable_response());
+    }
+    Write(record);
+}
+
+void RpcRecorder::RecordMeta(const std::string& key, const std::string& value) {
+    proto::RpcRecord record;
+    record.set_time(common::timer::get_micros());
+    record.set_meta_key(key);
+    record.set_request(value);
+    Write(record);
+}
+
+void RpcRecorder::Write(const proto::RpcRecord& record) {
+    std::string buf;
+    record.SerializeToString(&buf);
+    uint32_t len = buf.size();
+
+    MutexLock lock(&mu_);
+    if (file_ == NULL) {
+        return;
+    }
+    if (fwrite(&len, sizeof(len), 1, file_) != 1
+        || fwrite(buf.data(), 1, buf.size(), file_) != buf.size()) {
+        LOG(WARNING) << "fail to write rpc record, stop recording";
+        fclose(file_);
+        file_ = NULL;
+        return;
+    }
+    if (record.time() - last_flush_time_ > kRecordFlushInterval) {
+        fflush(file_);
+        last_flush_time_ = record.time();
+    }
+}
+
+RpcRecordReader::RpcRecordReader() : file_(NULL) {
+
+}
+
+RpcRecordReader::~RpcRecordReader() {
+    if (file_ != NULL) {
+        fclose(file_);
+    }
+}
+
+bool RpcRecordReader::Open(const std::string& path) {
+    file_ = fopen(path.c_str(), "rb");
+    if (file_ == NULL) {
+        LOG(WARNING) << "fail to open rpc record file: " << path
+                     << ", err: " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool RpcRecordReader::Next(proto::RpcRecord* record) {
+    uint32_t len = 0;
+    if (fread(&len, sizeof(len), 1, file_) != 1) {
+        return false;
+    }
+    std::string buf(len, '\0');
+    if (len > 0 && fread(&buf[0], 1, len, file_) != len) {
+        LOG(WARNING) << "torn rpc record at the end of file";
+        return false;
+    }
+    return record->ParseFromString(buf);
+}
+
+} //namespace galaxy
+} //namespace baidu
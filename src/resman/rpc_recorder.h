@@ -0,0 +1,49 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <google/protobuf/message.h>
+#include "src/protocol/resman.pb.h"
+#include "mutex.h"
+
+namespace baidu {
+namespace galaxy {
+
+// Records the rpc handled by resman and the agent responses it gets into
+// a local file, to be replayed by resman_replay. A record is the 4 bytes
+// length of a proto::RpcRecord followed by the record.
+class RpcRecorder {
+public:
+    RpcRecorder();
+    ~RpcRecorder();
+    bool Open(const std::string& path);
+    // response is only kept for rpc to agents, NULL otherwise
+    void Record(const std::string& method,
+                const std::string& endpoint,
+                const google::protobuf::Message& request,
+                const google::protobuf::Message* response);
+    // meta the recorded resman starts with, key is relative to nexus root
+    void RecordMeta(const std::string& key, const std::string& value);
+private:
+    void Write(const proto::RpcRecord& record);
+    Mutex mu_;
+    FILE* file_;
+    int64_t last_flush_time_;
+};
+
+class RpcRecordReader {
+public:
+    RpcRecordReader();
+    ~RpcRecordReader();
+    bool Open(const std::string& path);
+    // false at the end of file, or at a record torn by a crash
+    bool Next(proto::RpcRecord* record);
+private:
+    FILE* file_;
+};
+
+} //namespace galaxy
+} //namespace baidu
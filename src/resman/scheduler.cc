@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 #include "scheduler.h"
+#include "volum_solver.h"
+#include "agent_scorer.h"
 
 #include <sys/time.h>
 #include <time.h>
@@ -12,14 +14,26 @@
 #include <boost/foreach.hpp>
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
+#include <boost/algorithm/string.hpp>
 #include <glog/logging.h>
 #include <gflags/gflags.h>
 #include "timer.h"
 
 DECLARE_int64(sched_interval);
+DECLARE_bool(sched_batch_mode);
+DECLARE_int64(batch_sched_interval);
+DECLARE_int64(query_snapshot_interval);
 DECLARE_int64(container_group_gc_check_interval);
 DECLARE_bool(check_container_version);
 DECLARE_int32(max_batch_pods);
+DECLARE_bool(enable_preemption);
+DECLARE_int32(preempt_group_budget);
+DECLARE_int32(preempt_budget_window);
+DECLARE_int32(preempt_max_agents);
+DECLARE_string(sched_score_policy);
+DECLARE_string(sched_pool_score_policy);
+DECLARE_int32(sched_score_candidates);
+DECLARE_int32(sched_select_max_agents);
 DECLARE_double(reserved_percent);
 
 namespace baidu {
@@ -30,6 +44,112 @@ const int sMaxPort = 9999;
 const int sMinPort = 1026;
 const std::string kDynamicPort = "dynamic";
 
+template <class T>
+static std::vector<T> CgroupRequired(const proto::ContainerDescription& container_desc,
+                                     const T& (proto::Cgroup::*field)() const) {
+    std::vector<T> required;
+    for (int j = 0; j < container_desc.cgroups_size(); j++) {
+        required.push_back((container_desc.cgroups(j).*field)());
+    }
+    return required;
+}
+
+static std::vector<proto::PortRequired> PortsRequired(
+        const proto::ContainerDescription& container_desc) {
+    std::vector<proto::PortRequired> ports;
+    for (int j = 0; j < container_desc.cgroups_size(); j++) {
+        const proto::Cgroup& cgroup = container_desc.cgroups(j);
+        ports.insert(ports.end(), cgroup.ports().begin(), cgroup.ports().end());
+    }
+    return ports;
+}
+
+static std::vector<proto::VolumRequired> VolumsRequired(
+        const proto::ContainerDescription& container_desc) {
+    std::vector<proto::VolumRequired> volums;
+    volums.push_back(container_desc.workspace_volum());
+    volums.insert(volums.end(), container_desc.data_volums().begin(),
+                  container_desc.data_volums().end());
+    return volums;
+}
+
+Requirement::Requirement(const proto::ContainerDescription& container_desc)
+    : tag(container_desc.tag()),
+      pool_names(container_desc.pool_names().begin(), container_desc.pool_names().end()),
+      max_per_host(container_desc.max_per_host()),
+      v2_support(container_desc.has_v2_support() && container_desc.v2_support()),
+      gang(container_desc.gang()),
+      cpu(CgroupRequired(container_desc, &proto::Cgroup::cpu)),
+      memory(CgroupRequired(container_desc, &proto::Cgroup::memory)),
+      volums(VolumsRequired(container_desc)),
+      ports(PortsRequired(container_desc)),
+      version(container_desc.version()),
+      tcp_throts(CgroupRequired(container_desc, &proto::Cgroup::tcp_throt)),
+      blkios(CgroupRequired(container_desc, &proto::Cgroup::blkio)),
+      volum_jobs(container_desc.volum_jobs().begin(), container_desc.volum_jobs().end()),
+      anti_affinity(container_desc.anti_affinity_groups().begin(),
+                    container_desc.anti_affinity_groups().end()),
+      container_type(container_desc.container_type()),
+      cpu_need_(0), memory_need_(0), disk_need_(0),
+      ssd_need_(0), tmpfs_need_(0), fingerprint_(0) {
+    Summarize();
+}
+
+void Requirement::Summarize() {
+    cpu_need_ = 0;
+    memory_need_ = 0;
+    disk_need_ = 0;
+    ssd_need_ = 0;
+    tmpfs_need_ = 0;
+    device_volums_.clear();
+    for (size_t i = 0; i < cpu.size(); i++) {
+        cpu_need_ += cpu[i].milli_core();
+    }
+    for (size_t i = 0; i < memory.size(); i++) {
+        memory_need_ += memory[i].size();
+    }
+    for (size_t i = 0; i < volums.size(); i++) {
+        const proto::VolumRequired& v = volums[i];
+        if (v.medium() == proto::kTmpfs) {
+            tmpfs_need_ += v.size();
+            continue;
+        }
+        if (v.medium() == proto::kDisk) {
+            disk_need_ += v.size();
+        } else if (v.medium() == proto::kSsd) {
+            ssd_need_ += v.size();
+        }
+        device_volums_.push_back(v);
+    }
+    // everything checked by Agent::TryPut, except the container group itself
+    std::stringstream ss;
+    ss << tag << "|" << container_type << "|" << max_per_host << "|"
+       << cpu_need_ << "|" << memory_need_ << "|" << tmpfs_need_ << "|";
+    BOOST_FOREACH(const std::string& pool_name, pool_names) {
+        ss << pool_name << ",";
+    }
+    ss << "|";
+    for (size_t i = 0; i < device_volums_.size(); i++) {
+        ss << device_volums_[i].medium() << ":" << device_volums_[i].size()
+           << ":" << device_volums_[i].exclusive() << ",";
+    }
+    ss << "|";
+    for (size_t i = 0; i < ports.size(); i++) {
+        ss << ports[i].port() << ",";
+    }
+    ss << "|";
+    for (size_t i = 0; i < volum_jobs.size(); i++) {
+        ss << volum_jobs[i] << ",";
+    }
+    // FNV-1a
+    const std::string& key = ss.str();
+    fingerprint_ = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size(); i++) {
+        fingerprint_ ^= static_cast<unsigned char>(key[i]);
+        fingerprint_ *= 1099511628211ULL;
+    }
+}
+
 Agent::Agent(const AgentEndpoint& endpoint,
             int64_t cpu,
             int64_t memory,
@@ -52,6 +172,7 @@ Agent::Agent(const AgentEndpoint& endpoint,
     tags_ = tags;
     pool_name_ = pool_name;
     batch_container_count_ = 0;
+    index_ = NULL;
 }
 
 ContainerGroupId Agent::ExtractGroupId(const ContainerId& container_id) {
@@ -60,6 +181,14 @@ ContainerGroupId Agent::ExtractGroupId(const ContainerId& container_id) {
     return container_id.substr(0, idx);
 }
 
+int Agent::ContainerCount(const ContainerGroupId& container_group_id) const {
+    std::map<ContainerGroupId, int>::const_iterator it = container_counts_.find(container_group_id);
+    if (it == container_counts_.end()) {
+        return 0;
+    }
+    return it->second;
+}
+
 void Agent::SetAssignment(int64_t cpu_assigned,
                           int64_t cpu_deep_assigned,
                           int64_t memory_assigned,
@@ -102,6 +231,13 @@ void Agent::SetAssignment(int64_t cpu_assigned,
             volum_jobs_free_[volum_job_id].erase(volum_container_id);
         }
     }
+    UpdateIndex();
+}
+
+void Agent::UpdateIndex() {
+    if (index_ != NULL) {
+        index_->Update(this);
+    }
 }
 
 void Agent::SetReserved(int64_t cpu_reserved,
@@ -171,17 +307,8 @@ bool Agent::TryPut(const Container* container, ResourceError& err) {
         }
     }
 
-    int64_t size_ramdisk = 0;
-    const std::vector<proto::VolumRequired>& volums = container->require->volums;
-    std::vector<proto::VolumRequired> volums_no_ramdisk;
-
-    BOOST_FOREACH(const proto::VolumRequired& v, volums) {
-        if (v.medium() == proto::kTmpfs) {
-            size_ramdisk += v.size();
-        } else {
-            volums_no_ramdisk.push_back(v);
-        }
-    }
+    int64_t size_ramdisk = container->require->TmpfsNeed();
+    const std::vector<proto::VolumRequired>& volums_no_ramdisk = container->require->DeviceVolums();
 
     if (container->priority != proto::kJobBestEffort) {
         if (size_ramdisk + memory_assigned_ + container->require->MemoryNeed()> memory_total_) {
@@ -201,13 +328,13 @@ bool Agent::TryPut(const Container* container, ResourceError& err) {
         return false;
     }
 
-    if (container->require->ports.size() + port_assigned_.size()
+    if (container->require->PortCount() + port_assigned_.size()
         > port_total_) {
         err = proto::kNoPort;
         return false;
     }
 
-    const std::vector<proto::PortRequired> ports = container->require->ports;
+    const std::vector<proto::PortRequired>& ports = container->require->ports;
     std::vector<std::string> ports_free;
     if (!SelectFreePorts(ports, ports_free)) {
         err = proto::kPortConflict;
@@ -243,15 +370,8 @@ void Agent::Put(Container::Ptr container) {
         cpu_deep_assigned_ += container->require->CpuNeed();
         memory_deep_assigned_ += container->require->MemoryNeed();
     }
-    int64_t size_ramdisk = 0;
-    std::vector<proto::VolumRequired> volums_no_ramdisk;
-    BOOST_FOREACH(const proto::VolumRequired& v, container->require->volums) {
-        if (v.medium() == proto::kTmpfs) {
-            size_ramdisk += v.size();
-        } else {
-            volums_no_ramdisk.push_back(v);
-        }
-    }
+    int64_t size_ramdisk = container->require->TmpfsNeed();
+    const std::vector<proto::VolumRequired>& volums_no_ramdisk = container->require->DeviceVolums();
     memory_assigned_ += size_ramdisk;
     assert(memory_assigned_ <= memory_total_);
     //volums
@@ -307,6 +427,7 @@ void Agent::Put(Container::Ptr container) {
     if (container->priority == proto::kJobBatch) {
         batch_container_count_ ++;
     }
+    UpdateIndex();
 }
 
 bool Agent::SelectFreePorts(const std::vector<proto::PortRequired>& ports_need,
@@ -429,15 +550,7 @@ void Agent::Evict(Container::Ptr container) {
             memory_assigned_ -= container->require->TmpfsNeed();
         }
     }
-    int64_t size_ramdisk = 0;
-    std::vector<proto::VolumRequired> volums_no_ramdisk;
-    BOOST_FOREACH(const proto::VolumRequired& v, container->require->volums) {
-        if (v.medium() == proto::kTmpfs) {
-            size_ramdisk += v.size();
-        } else {
-            volums_no_ramdisk.push_back(v);
-        }
-    }
+    int64_t size_ramdisk = container->require->TmpfsNeed();
     memory_assigned_ -= size_ramdisk;
     assert(memory_assigned_ >= 0);
     //volums
@@ -480,13 +593,58 @@ void Agent::Evict(Container::Ptr container) {
     if (container->priority == proto::kJobBatch) {
         batch_container_count_ --;
     }
+    UpdateIndex();
+}
+
+void Agent::Unevict(Container::Ptr container) {
+    if (container->priority != proto::kJobBestEffort) {
+        cpu_assigned_ += container->require->CpuNeed();
+        memory_assigned_ += container->require->MemoryNeed();
+    } else {
+        cpu_deep_assigned_ += container->require->CpuNeed();
+        memory_deep_assigned_ += container->require->MemoryNeed();
+        if (container->require->TmpfsNeed()) {
+            memory_assigned_ += container->require->TmpfsNeed();
+        }
+    }
+    memory_assigned_ += container->require->TmpfsNeed();
+    for (size_t i = 0; i < container->allocated_volums.size(); i++) {
+        const std::pair<DevicePath, VolumInfo>& tup = container->allocated_volums[i];
+        volum_assigned_[tup.first].size += tup.second.size;
+        if (tup.second.exclusive) {
+            volum_assigned_[tup.first].exclusive = true;
+        }
+    }
+    BOOST_FOREACH(const std::string& port, container->allocated_ports) {
+        port_assigned_.insert(port);
+    }
+    containers_[container->id] = container;
+    container_counts_[container->container_group_id] += 1;
+    for (size_t i = 0; i < container->allocated_volum_containers.size(); i++) {
+        const ContainerId& volum_container_id = container->allocated_volum_containers[i];
+        const ContainerGroupId& volum_job_id = ExtractGroupId(volum_container_id);
+        std::map<ContainerGroupId, std::set<ContainerId> >::iterator it;
+        it = volum_jobs_free_.find(volum_job_id);
+        if (it != volum_jobs_free_.end()) {
+            it->second.erase(volum_container_id);
+            if (it->second.empty()) {
+                volum_jobs_free_.erase(it);
+            }
+        }
+    }
+    if (container->priority == proto::kJobBatch) {
+        batch_container_count_ ++;
+    }
+    UpdateIndex();
 }
 
 bool Agent::SelectDevices(const std::vector<proto::VolumRequired>& volums,
                           std::vector<DevicePath>& devices) {
+    if (volums.empty()) {
+        return true;
+    }
     typedef std::map<DevicePath, VolumInfo> VolumMap;
     VolumMap volum_free;
-    std::set<DevicePath> path_used;
     BOOST_FOREACH(const VolumMap::value_type& pair, volum_total_) {
         const DevicePath& device_path = pair.first;
         const VolumInfo& volum_info = pair.second;
@@ -499,89 +657,364 @@ bool Agent::SelectDevices(const std::vector<proto::VolumRequired>& volums,
             }
         }
     }
-    return RecurSelectDevices(0, volums, volum_free, devices, path_used);
+    return SelectVolumDevices(volums, volum_free, devices);
 }
 
-bool Agent::RecurSelectDevices(size_t i, const std::vector<proto::VolumRequired>& volums,
-                               std::map<DevicePath, VolumInfo>& volum_free,
-                               std::vector<DevicePath>& devices,
-                               std::set<DevicePath>& path_used) {
-    if (i >= volums.size()) {
-        if (devices.size() == volums.size()) {
-            return true;
-        } else {
-            return false;
+void ResourceStat::Add(const Container& container, int64_t sign) {
+    const Requirement& require = *container.require;
+    for (size_t i = 0; i < require.volums.size(); i++) {
+        proto::VolumMedium medium = require.volums[i].medium();
+        int64_t as = require.volums[i].size();
+        int64_t us = 0;
+        if ((int)i < container.remote_info.volum_used_size()) {
+            us = container.remote_info.volum_used(i).used_size();
+        }
+        volum_assigned[medium] += sign * as;
+        volum_used[medium] += sign * us;
+        if (volum_assigned[medium] == 0 && volum_used[medium] == 0) {
+            volum_assigned.erase(medium);
+            volum_used.erase(medium);
+        }
+    }
+    cpu_assigned += sign * require.CpuNeed();
+    cpu_used += sign * container.remote_info.cpu_used();
+    memory_assigned += sign * require.MemoryNeed();
+    memory_used += sign * container.remote_info.memory_used();
+}
+
+void AgentIndex::Update(Agent* agent) {
+    Remove(agent->endpoint_);
+    IndexedKey& key = indexed_[agent->endpoint_];
+    key.pool_name = agent->pool_name_;
+    key.tags = agent->tags_;
+    key.entry.cpu_free = agent->cpu_total_ - agent->cpu_assigned_;
+    key.entry.memory_free = agent->memory_total_ - agent->memory_assigned_;
+    key.entry.endpoint = agent->endpoint_;
+    key.stat.total_agents = 1;
+    key.stat.cpu_total = agent->cpu_total_;
+    key.stat.cpu_assigned = agent->cpu_assigned_;
+    key.stat.memory_total = agent->memory_total_;
+    key.stat.memory_assigned = agent->memory_assigned_;
+    PoolStat& pool_stat = pool_stats_[key.pool_name];
+    pool_stat.total_agents += key.stat.total_agents;
+    pool_stat.cpu_total += key.stat.cpu_total;
+    pool_stat.cpu_assigned += key.stat.cpu_assigned;
+    pool_stat.memory_total += key.stat.memory_total;
+    pool_stat.memory_assigned += key.stat.memory_assigned;
+    std::map<std::string, Bucket>& pool_buckets = buckets_[key.pool_name];
+    pool_buckets[""].insert(key.entry);
+    BOOST_FOREACH(const std::string& tag, key.tags) {
+        pool_buckets[tag].insert(key.entry);
+    }
+}
+
+void AgentIndex::Remove(const AgentEndpoint& endpoint) {
+    std::map<AgentEndpoint, IndexedKey>::iterator it = indexed_.find(endpoint);
+    if (it == indexed_.end()) {
+        return;
+    }
+    const IndexedKey& key = it->second;
+    PoolStat& pool_stat = pool_stats_[key.pool_name];
+    pool_stat.total_agents -= key.stat.total_agents;
+    pool_stat.cpu_total -= key.stat.cpu_total;
+    pool_stat.cpu_assigned -= key.stat.cpu_assigned;
+    pool_stat.memory_total -= key.stat.memory_total;
+    pool_stat.memory_assigned -= key.stat.memory_assigned;
+    if (pool_stat.total_agents == 0) {
+        pool_stats_.erase(key.pool_name);
+    }
+    std::map<std::string, Bucket>& pool_buckets = buckets_[key.pool_name];
+    pool_buckets[""].erase(key.entry);
+    if (pool_buckets[""].empty()) {
+        pool_buckets.erase("");
+    }
+    BOOST_FOREACH(const std::string& tag, key.tags) {
+        pool_buckets[tag].erase(key.entry);
+        if (pool_buckets[tag].empty()) {
+            pool_buckets.erase(tag);
         }
     }
-    const proto::VolumRequired& volum_need = volums[i];
-    typedef std::map<DevicePath, VolumInfo> VolumMap;
-    BOOST_FOREACH(VolumMap::value_type& pair, volum_free) {
-        const DevicePath& device_path = pair.first;
-        VolumInfo& volum_info = pair.second;
-        if (volum_info.exclusive || volum_need.size() > volum_info.size) {
+    if (pool_buckets.empty()) {
+        buckets_.erase(key.pool_name);
+    }
+    indexed_.erase(it);
+}
+
+void AgentIndex::Select(const std::set<std::string>& pool_names,
+                        const std::string& tag,
+                        int64_t cpu_need,
+                        int64_t memory_need,
+                        size_t max_visits,
+                        std::vector<AgentEndpoint>& endpoints,
+                        ResourceError& err) {
+    bool pool_found = false;
+    bool tag_found = false;
+    bool cpu_found = false;
+    BOOST_FOREACH(const std::string& pool_name, pool_names) {
+        std::map<std::string, std::map<std::string, Bucket> >::iterator pool_it;
+        pool_it = buckets_.find(pool_name);
+        if (pool_it == buckets_.end()) {
             continue;
         }
-        if (volum_info.medium != volum_need.medium()) {
+        pool_found = true;
+        std::map<std::string, Bucket>::iterator tag_it = pool_it->second.find(tag);
+        if (tag_it == pool_it->second.end()) {
             continue;
         }
-        if (volum_need.exclusive() &&
-            path_used.find(device_path) != path_used.end()) {
-            continue;
+        tag_found = true;
+        const Bucket& bucket = tag_it->second;
+        size_t visits = 0;
+        Bucket::const_reverse_iterator it;
+        for (it = bucket.rbegin(); it != bucket.rend(); it++) {
+            if (it->cpu_free < cpu_need) {
+                break;
+            }
+            if (max_visits > 0 && visits++ >= max_visits) {
+                break;
+            }
+            cpu_found = true;
+            if (it->memory_free < memory_need) {
+                continue;
+            }
+            endpoints.push_back(it->endpoint);
         }
-        volum_info.size -= volum_need.size();
-        volum_info.exclusive = volum_need.exclusive();
-        devices.push_back(device_path);
-        path_used.insert(device_path);
-        if (RecurSelectDevices(i + 1, volums, volum_free, devices, path_used)) {
-            return true;
-        } else {
-            volum_info.size += volum_need.size();
-            volum_info.exclusive = false;
-            devices.pop_back();
-            path_used.erase(device_path);
+    }
+    if (!endpoints.empty()) {
+        err = proto::kResOk;
+    } else if (!pool_found) {
+        err = proto::kPoolMismatch;
+    } else if (!tag_found) {
+        err = proto::kTagMismatch;
+    } else if (!cpu_found) {
+        err = proto::kNoCpu;
+    } else {
+        err = proto::kNoMemory;
+    }
+}
+
+bool AgentIndex::GetPoolStat(const std::string& pool_name, PoolStat& stat) const {
+    std::map<std::string, PoolStat>::const_iterator it = pool_stats_.find(pool_name);
+    if (it == pool_stats_.end()) {
+        return false;
+    }
+    stat = it->second;
+    return true;
+}
+
+struct VictimLess {
+    int64_t now;
+    explicit VictimLess(int64_t t) : now(t) {}
+    bool operator () (const Container::Ptr& a, const Container::Ptr& b) const {
+        if (a->priority != b->priority) {
+            return a->priority > b->priority;
+        }
+        if (a->allocated_time != b->allocated_time) {
+            return a->allocated_time > b->allocated_time;
         }
+        return a->id < b->id;
     }
-    return false;
+};
+
+Preemptor::Preemptor(int group_budget, int window)
+    : group_budget_(group_budget), window_(window) {
 }
 
+int Preemptor::Budget(const ContainerGroupId& container_group_id, int64_t now) {
+    std::map<ContainerGroupId, std::deque<int64_t> >::iterator it;
+    it = history_.find(container_group_id);
+    if (it == history_.end()) {
+        return group_budget_;
+    }
+    std::deque<int64_t>& history = it->second;
+    while (!history.empty()
+           && now - history.front() >= static_cast<int64_t>(window_) * 1000000L) {
+        history.pop_front();
+    }
+    int used = history.size();
+    if (history.empty()) {
+        history_.erase(it);
+    }
+    return group_budget_ - used;
+}
 
-Scheduler::Scheduler() : stop_(true) {
-    srand(time(NULL));
+void Preemptor::Record(const std::vector<Container::Ptr>& victims, int64_t now) {
+    BOOST_FOREACH(const Container::Ptr& victim, victims) {
+        history_[victim->container_group_id].push_back(now);
+    }
+}
+
+Preemptor::Cost Preemptor::GetCost(const std::vector<Container::Ptr>& victims, int64_t now) {
+    Cost cost;
+    BOOST_FOREACH(const Container::Ptr& victim, victims) {
+        cost.top_priority = std::min(cost.top_priority, victim->priority);
+        cost.victims++;
+        if (victim->allocated_time > 0 && now > victim->allocated_time) {
+            cost.work_lost += now - victim->allocated_time;
+        }
+    }
+    return cost;
+}
+
+bool Preemptor::Fits(Agent& agent, const Container::Ptr& container,
+                     const std::vector<Container::Ptr>& victims, ResourceError& err) {
+    if (victims.empty()) {
+        return agent.TryPut(container.get(), err);
+    }
+    // the victims are evicted for a moment and put back as they were,
+    // the index is left alone as the agent ends up unchanged
+    AgentIndex* index = agent.index_;
+    agent.index_ = NULL;
+    BOOST_FOREACH(const Container::Ptr& victim, victims) {
+        // Evict changes the container, so evict a copy
+        Container::Ptr copy(new Container(*victim));
+        agent.Evict(copy);
+    }
+    bool fits = agent.TryPut(container.get(), err);
+    for (size_t i = victims.size(); i > 0; i--) {
+        agent.Unevict(victims[i - 1]);
+    }
+    agent.index_ = index;
+    return fits;
 }
 
-void Scheduler::SetRequirement(Requirement::Ptr require,
-                               const proto::ContainerDescription& container_desc) {
-    require->tag = container_desc.tag();
-    require->v2_support = false;
-    if (container_desc.has_v2_support() && container_desc.v2_support()) {
-        require->v2_support = true;
+bool Preemptor::SelectVictims(Agent& agent, const Container::Ptr& container,
+                              bool manual, int64_t now,
+                              std::vector<Container::Ptr>& victims,
+                              ResourceError& err) {
+    victims.clear();
+    if (Fits(agent, container, victims, err)) {
+        return true;
     }
-    for (int j = 0; j < container_desc.pool_names_size(); j++) {
-        require->pool_names.insert(container_desc.pool_names(j));
+    if (err == proto::kTagMismatch || err == proto::kPoolMismatch
+        || err == proto::kTooManyPods) {
+        return false; //evicting others does not help
     }
-    require->max_per_host = container_desc.max_per_host();
-    for (int j = 0; j < container_desc.cgroups_size(); j++) {
-        const proto::Cgroup& cgroup = container_desc.cgroups(j);
-        require->cpu.push_back(cgroup.cpu());
-        require->memory.push_back(cgroup.memory());
-        for (int k = 0; k < cgroup.ports_size(); k++) {
-            require->ports.push_back(cgroup.ports(k));
+    std::vector<Container::Ptr> candidates;
+    BOOST_FOREACH(const ContainerMap::value_type& pair, agent.containers_) {
+        const Container::Ptr& victim = pair.second;
+        if (victim->container_group_id == container->container_group_id
+            || victim->require->container_type == proto::kVolumContainer) {
+            continue;
+        }
+        if (victim->require->gang) {
+            continue; // evicting one member would break the whole gang
+        }
+        if (victim->status != kContainerAllocating && victim->status != kContainerReady) {
+            continue;
+        }
+        if (!manual && victim->priority <= container->priority) {
+            continue;
+        }
+        candidates.push_back(victim);
+    }
+    std::sort(candidates.begin(), candidates.end(), VictimLess(now));
+
+    std::map<ContainerGroupId, int> budgets;
+    std::vector<Container::Ptr> chosen;
+    if (!manual) {
+        std::vector<Container::Ptr> allowed;
+        BOOST_FOREACH(const Container::Ptr& victim, candidates) {
+            const ContainerGroupId& group_id = victim->container_group_id;
+            if (budgets.find(group_id) == budgets.end()) {
+                budgets[group_id] = Budget(group_id, now);
+            }
+            if (budgets[group_id] > 0) {
+                allowed.push_back(victim);
+            }
         }
-        require->tcp_throts.push_back(cgroup.tcp_throt());
-        require->blkios.push_back(cgroup.blkio());
+        candidates.swap(allowed);
     }
-    require->volums.push_back(container_desc.workspace_volum());
-    for (int j = 0; j < container_desc.data_volums_size(); j++) {
-        require->volums.push_back(container_desc.data_volums(j));
+    ResourceError fit_err = err;
+    // one victim is enough in most cases, the cheapest one which makes room wins
+    BOOST_FOREACH(const Container::Ptr& victim, candidates) {
+        chosen.assign(1, victim);
+        if (Fits(agent, container, chosen, fit_err)) {
+            victims.swap(chosen);
+            err = proto::kResOk;
+            return true;
+        }
+    }
+    // otherwise evict from the cheapest until it fits,
+    // then give back the victims which are not needed
+    chosen.clear();
+    bool fits = false;
+    BOOST_FOREACH(const Container::Ptr& victim, candidates) {
+        if (!manual) {
+            int& budget = budgets[victim->container_group_id];
+            if (budget <= 0) {
+                continue;
+            }
+            budget--;
+        }
+        chosen.push_back(victim);
+        if (Fits(agent, container, chosen, fit_err)) {
+            fits = true;
+            break;
+        }
+    }
+    if (!fits) {
+        err = fit_err;
+        return false;
+    }
+    for (int i = chosen.size() - 1; i >= 0 && chosen.size() > 1; i--) {
+        std::vector<Container::Ptr> rest(chosen);
+        rest.erase(rest.begin() + i);
+        if (Fits(agent, container, rest, fit_err)) {
+            chosen.swap(rest);
+        }
+    }
+    victims.swap(chosen);
+    err = proto::kResOk;
+    return true;
+}
+
+Scheduler::Scheduler() : preemptor_(FLAGS_preempt_group_budget, FLAGS_preempt_budget_window),
+                         track_placements_(false), reserve_placements_(false),
+                         snapshot_time_(0), snapshot_building_(false), stop_(true) {
+    srand(time(NULL));
+    // nothing else sees the scheduler yet, the policies are set without mu_
+    ScorePolicy::Ptr policy(new ScorePolicy());
+    if (policy->Parse(FLAGS_sched_score_policy)) {
+        score_policies_[""] = policy;
+    } else {
+        LOG(WARNING) << "invalid sched_score_policy, use first fit: " << FLAGS_sched_score_policy;
+    }
+    std::vector<std::string> pool_policies;
+    boost::split(pool_policies, FLAGS_sched_pool_score_policy, boost::is_any_of(";"));
+    BOOST_FOREACH(const std::string& pool_policy, pool_policies) {
+        size_t idx = pool_policy.find("=");
+        if (idx == std::string::npos) {
+            if (!boost::trim_copy(pool_policy).empty()) {
+                LOG(WARNING) << "invalid pool score policy: " << pool_policy;
+            }
+            continue;
+        }
+        std::string pool_name = boost::trim_copy(pool_policy.substr(0, idx));
+        policy.reset(new ScorePolicy());
+        if (!policy->Parse(pool_policy.substr(idx + 1))) {
+            LOG(WARNING) << "invalid score policy of pool " << pool_name << ": " << pool_policy;
+            continue;
+        }
+        score_policies_[pool_name] = policy;
     }
-    require->version = container_desc.version();
-    for (int j = 0; j < container_desc.volum_jobs_size(); j++) {
-        require->volum_jobs.push_back(container_desc.volum_jobs(j));
+    if (!FLAGS_sched_batch_mode
+        && (!FLAGS_sched_score_policy.empty() || !FLAGS_sched_pool_score_policy.empty())) {
+        LOG(WARNING) << "score policies only apply to gangs without --sched_batch_mode, "
+                     << "the per agent scheduling loop puts other containers first fit";
     }
-    require->container_type = container_desc.container_type();
 }
 
 void Scheduler::AddAgent(Agent::Ptr agent, const proto::AgentInfo& agent_info) {
+    // parse the agent report before taking the scheduler lock
+    std::vector<Requirement::Ptr> requirements(agent_info.container_info_size());
+    for (int i = 0; i < agent_info.container_info_size(); i++) {
+        const proto::ContainerInfo& container_info = agent_info.container_info(i);
+        if (container_info.status() != kContainerReady) {
+            continue;
+        }
+        requirements[i].reset(new Requirement(container_info.container_desc()));
+    }
+
     MutexLock locker(&mu_);
 
     int64_t cpu_assigned = 0;
@@ -628,16 +1061,14 @@ void Scheduler::AddAgent(Agent::Ptr agent, const proto::AgentInfo& agent_info) {
         container->allocated_volums.clear();
         container->allocated_volum_containers.clear();
 
-        Requirement::Ptr require(new Requirement());
+        Requirement::Ptr require = requirements[i];
         const proto::ContainerDescription& container_desc = container_info.container_desc();
-        SetRequirement(require, container_desc);
         if (container_group->require->version == require->version) {
             require = container_group->require;
         }
         container->id = container_info.id();
         container->container_group_id = container_info.group_id();
         container->priority = container_desc.priority();
-        container->status = container_info.status();
         container->require = require;
         if (container->priority != proto::kJobBestEffort) {
             cpu_assigned += require->CpuNeed();
@@ -709,10 +1140,27 @@ void Scheduler::AddAgent(Agent::Ptr agent, const proto::AgentInfo& agent_info) {
             );
         }
         containers[container->id] = container;
-        container_groups_[container->container_group_id]->containers[container->id] = container;
+        container_group->containers[container->id] = container;
         container->allocated_agent = agent->endpoint_;
-        ChangeStatus(container, container->status);
-    }
+        // the reported container goes straight to ready, it has never been
+        // in the pending state its default status claims
+        if (container_group->states[container->status].erase(container->id) > 0) {
+            AccountContainer(container_group, container, -1);
+        }
+        container->status = kContainerReady;
+        container->last_res_err = proto::kResOk;
+        // the creation time reported by the agent survives resman restarts
+        container->allocated_time = container_info.created_time() > 0
+                                    ? container_info.created_time()
+                                    : common::timer::get_micros();
+        container_group->states[kContainerReady][container->id] = container;
+        AccountContainer(container_group, container, 1);
+    }
+    std::map<AgentEndpoint, Agent::Ptr>::iterator old_it = agents_.find(agent->endpoint_);
+    if (old_it != agents_.end() && old_it->second != agent) {
+        old_it->second->index_ = NULL;
+    }
+    agent->index_ = &agent_index_;
     agent->SetAssignment(
         cpu_assigned, cpu_deep_assigned,
         memory_assigned, memory_deep_assigned,
@@ -748,6 +1196,9 @@ void Scheduler::RemoveAgent(const AgentEndpoint& endpoint) {
             }
         }
     }
+    agent_index_.Remove(endpoint);
+    placements_.erase(endpoint);
+    agent->index_ = NULL;
     agents_.erase(endpoint);
     freezed_agents_.erase(endpoint);
 }
@@ -761,6 +1212,7 @@ void Scheduler::AddTag(const AgentEndpoint& endpoint, const std::string& tag) {
     }
     Agent::Ptr agent = it->second;
     agent->tags_.insert(tag);
+    agent->UpdateIndex();
 }
 
 void Scheduler::RemoveTag(const AgentEndpoint& endpoint, const std::string& tag) {
@@ -772,6 +1224,7 @@ void Scheduler::RemoveTag(const AgentEndpoint& endpoint, const std::string& tag)
     }
     Agent::Ptr agent = it->second;
     agent->tags_.erase(tag);
+    agent->UpdateIndex();
 }
 
 void Scheduler::SetPool(const AgentEndpoint& endpoint, const std::string& pool_name) {
@@ -783,6 +1236,7 @@ void Scheduler::SetPool(const AgentEndpoint& endpoint, const std::string& pool_n
     }
     Agent::Ptr agent = it->second;
     agent->pool_name_ = pool_name;
+    agent->UpdateIndex();
 }
 
 bool Scheduler::FreezeAgent(const AgentEndpoint& endpoint) {
@@ -848,8 +1302,7 @@ ContainerGroupId Scheduler::Submit(const std::string& container_group_name,
         LOG(WARNING) << "container_group id conflict:" << container_group_id;
         return "";
     }
-    Requirement::Ptr req(new Requirement());
-    SetRequirement(req, container_desc);
+    Requirement::Ptr req(new Requirement(container_desc));
     ContainerGroup::Ptr container_group(new ContainerGroup());
     container_group->require = req;
     container_group->id = container_group_id;
@@ -875,10 +1328,9 @@ ContainerGroupId Scheduler::Submit(const std::string& container_group_name,
 
 void Scheduler::Reload(const proto::ContainerGroupMeta& container_group_meta) {
     MutexLock lock(&mu_);
-    Requirement::Ptr req(new Requirement());
-    ContainerGroup::Ptr container_group(new ContainerGroup());
     VLOG(10) << "reload desc:" << container_group_meta.desc().DebugString();
-    SetRequirement(req, container_group_meta.desc());
+    Requirement::Ptr req(new Requirement(container_group_meta.desc()));
+    ContainerGroup::Ptr container_group(new ContainerGroup());
     container_group->require = req;
     container_group->id = container_group_meta.id();
     container_group->priority = container_group_meta.desc().priority();
@@ -895,6 +1347,30 @@ void Scheduler::Reload(const proto::ContainerGroupMeta& container_group_meta) {
         container_group->terminated = false;
     }
 
+    std::map<ContainerGroupId, ContainerGroup::Ptr>::iterator it;
+    it = container_groups_.find(container_group->id);
+    if (it != container_groups_.end()) {
+        // a standby resman follows the meta of the leader,
+        // keep the containers already known from agents
+        ContainerGroup::Ptr exist_group = it->second;
+        container_group_queue_.erase(exist_group);
+        AccountUserAlloc(exist_group, -exist_group->Replica());
+        exist_group->require = container_group->require;
+        exist_group->priority = container_group->priority;
+        exist_group->replica = container_group->replica;
+        exist_group->update_interval = container_group->update_interval;
+        exist_group->container_desc = container_group->container_desc;
+        exist_group->name = container_group->name;
+        exist_group->user_name = container_group->user_name;
+        exist_group->submit_time = container_group->submit_time;
+        exist_group->update_time = container_group->update_time;
+        BOOST_FOREACH(ContainerMap::value_type& pair, exist_group->states[kContainerPending]) {
+            pair.second->require = exist_group->require;
+        }
+        AccountUserAlloc(exist_group, exist_group->Replica());
+        container_group_queue_.insert(exist_group);
+        return;
+    }
     container_groups_[container_group->id] = container_group;
     container_group_queue_.insert(container_group);
 }
@@ -1064,7 +1540,9 @@ void Scheduler::ChangeStatus(ContainerGroup::Ptr container_group,
         return;
     }
     ContainerStatus old_status = container->status;
-    container_group->states[old_status].erase(container_id);
+    if (container_group->states[old_status].erase(container_id) > 0) {
+        AccountContainer(container_group, container, -1);
+    }
     container_group->states[new_status][container_id] = container;
     LOG(INFO) << "change status: " << container_id
               << " from: " << proto::ContainerStatus_Name(old_status)
@@ -1086,9 +1564,62 @@ void Scheduler::ChangeStatus(ContainerGroup::Ptr container_group,
         }
     }
     container->status = new_status;
+    if (new_status != kContainerAllocating) {
+        container->victims.clear();
+        container->reserving = false;
+    }
+    if (new_status == kContainerPending) {
+        container->reported = false;
+    }
     if (new_status == kContainerReady) {
         container->last_res_err = proto::kResOk;
     }
+    if ((new_status == kContainerAllocating || new_status == kContainerReady)
+        && old_status != kContainerAllocating && old_status != kContainerReady) {
+        container->allocated_time = common::timer::get_micros();
+    }
+    if (track_placements_ && new_status == kContainerAllocating
+        && old_status == kContainerPending) {
+        placements_[container->allocated_agent].push_back(container);
+        container->reserving = reserve_placements_;
+    }
+    AccountContainer(container_group, container, 1);
+}
+
+void Scheduler::AccountContainer(const ContainerGroup::Ptr& container_group,
+                                 const Container::Ptr& container, int64_t sign) {
+    mu_.AssertHeld();
+    switch (container->status) {
+        case kContainerReady:
+            container_group->ready_stat.Add(*container, sign);
+            // fall through
+        case kContainerPending:
+        case kContainerAllocating:
+            AccountUserAlloc(container_group, sign);
+            break;
+        default:
+            break;
+    }
+}
+
+void Scheduler::AccountUserAlloc(const ContainerGroup::Ptr& container_group, int64_t replica) {
+    mu_.AssertHeld();
+    if (replica == 0) {
+        return;
+    }
+    const Requirement& require = *container_group->require;
+    proto::Quota& alloc = user_alloc_[container_group->user_name];
+    alloc.set_replica(alloc.replica() + replica);
+    if (container_group->priority != proto::kJobBestEffort) {
+        alloc.set_millicore(alloc.millicore() + require.CpuNeed() * replica);
+        alloc.set_memory(alloc.memory() + require.MemoryNeed() * replica);
+    }
+    alloc.set_memory(alloc.memory() + require.TmpfsNeed() * replica);
+    alloc.set_disk(alloc.disk() + require.DiskNeed() * replica);
+    alloc.set_ssd(alloc.ssd() + require.SsdNeed() * replica);
+    if (alloc.replica() == 0) {
+        user_alloc_.erase(container_group->user_name);
+    }
 }
 
 void Scheduler::CheckTagAndPool(Agent::Ptr agent) {
@@ -1103,7 +1634,7 @@ void Scheduler::CheckTagAndPool(Agent::Ptr agent) {
     }
 }
 
-void Scheduler::Start() {
+void Scheduler::Start(bool sched_loop) {
     LOG(INFO) << "scheduler started";
     std::vector<std::pair<ContainerGroupId, int> > replicas;
     std::set<ContainerGroupId> need_kill;
@@ -1127,8 +1658,14 @@ void Scheduler::Start() {
             Kill(group_id);
         }
     }
-    AgentEndpoint fake_endpoint = "";
-    ScheduleNextAgent(fake_endpoint);
+    if (!sched_loop) {
+        LOG(INFO) << "scheduling loop is not started";
+    } else if (FLAGS_sched_batch_mode) {
+        ScheduleBatchLoop();
+    } else {
+        AgentEndpoint fake_endpoint = "";
+        ScheduleNextAgent(fake_endpoint);
+    }
 }
 
 void Scheduler::Stop() {
@@ -1167,7 +1704,9 @@ void Scheduler::CheckVersion(Agent::Ptr agent) {
         }
         ContainerGroup::Ptr container_group = it->second;
         if (container->require->version == container_group->require->version) {
+            AccountContainer(container_group, container, -1);
             container->require = container_group->require;
+            AccountContainer(container_group, container, 1);
             continue;
         }
         int32_t now = common::timer::now_time();
@@ -1203,7 +1742,8 @@ void Scheduler::ScheduleNextAgent(AgentEndpoint pre_endpoint) {
         agent = it->second;
         endpoint = it->first;
     } else {
-        // turn to the start
+        // turn to the start, gangs are placed once a round
+        sched_pool_.AddTask(boost::bind(&Scheduler::ScheduleGangs, this));
         sched_pool_.AddTask(boost::bind(&Scheduler::ScheduleNextAgent, this, ""));
         return;
     }
@@ -1214,6 +1754,29 @@ void Scheduler::ScheduleNextAgent(AgentEndpoint pre_endpoint) {
         return;
     }
 
+    ScheduleAgentLocked(agent);
+    //scheduling round for the next agent
+    sched_pool_.DelayTask(FLAGS_sched_interval,
+                    boost::bind(&Scheduler::ScheduleNextAgent, this, endpoint));
+}
+
+int Scheduler::ScheduleAgent(const AgentEndpoint& endpoint) {
+    MutexLock lock(&mu_);
+    std::map<AgentEndpoint, Agent::Ptr>::iterator it = agents_.find(endpoint);
+    if (it == agents_.end()) {
+        LOG(WARNING) << "schedule agent fail, no such agent:" << endpoint;
+        return 0;
+    }
+    if (freezed_agents_.find(endpoint) != freezed_agents_.end()) {
+        return 0;
+    }
+    return ScheduleAgentLocked(it->second);
+}
+
+int Scheduler::ScheduleAgentLocked(Agent::Ptr agent) {
+    mu_.AssertHeld();
+    const AgentEndpoint& endpoint = agent->endpoint_;
+    int put_count = 0;
     if (FLAGS_check_container_version) {
         CheckVersion(agent); //check containers version
     }
@@ -1225,6 +1788,9 @@ void Scheduler::ScheduleNextAgent(AgentEndpoint pre_endpoint) {
         if (container_group->states[kContainerPending].size() == 0) {
             continue; // no pending pods
         }
+        if (container_group->require->gang) {
+            continue; // placed by ScheduleGangs
+        }
         ContainerId last_id = container_group->last_sched_container_id;
         ContainerMap::iterator container_it =
                 container_group->states[kContainerPending].upper_bound(last_id);
@@ -1248,10 +1814,298 @@ void Scheduler::ScheduleNextAgent(AgentEndpoint pre_endpoint) {
         }
         agent->Put(container);
         ChangeStatus(container, kContainerAllocating);
+        put_count++;
     }
-    //scheduling round for the next agent
-    sched_pool_.DelayTask(FLAGS_sched_interval,
-                    boost::bind(&Scheduler::ScheduleNextAgent, this, endpoint));
+    return put_count;
+}
+
+void Scheduler::ScheduleBatchLoop() {
+    {
+        MutexLock lock(&mu_);
+        if (stop_) {
+            VLOG(16) << "no scheduling, because scheduler is stoped.";
+            sched_pool_.DelayTask(FLAGS_batch_sched_interval,
+                        boost::bind(&Scheduler::ScheduleBatchLoop, this));
+            return;
+        }
+    }
+    int64_t start_time = common::timer::get_micros();
+    int put_count = ScheduleBatch();
+    VLOG(10) << "batch scheduling pass, put: " << put_count
+             << ", cost: " << common::timer::get_micros() - start_time << " us";
+    sched_pool_.DelayTask(FLAGS_batch_sched_interval,
+                    boost::bind(&Scheduler::ScheduleBatchLoop, this));
+}
+
+int Scheduler::ScheduleBatch() {
+    MutexLock lock(&mu_);
+    std::map<AgentEndpoint, Agent::Ptr>::iterator it;
+    for (it = agents_.begin(); it != agents_.end(); it++) {
+        if (freezed_agents_.find(it->first) != freezed_agents_.end()) {
+            continue;
+        }
+        if (FLAGS_check_container_version) {
+            CheckVersion(it->second);
+        }
+        CheckTagAndPool(it->second); //may evict some containers
+    }
+    if (agents_.size() == freezed_agents_.size()) {
+        VLOG(16) << "no alive agents for scheduler.";
+        return 0;
+    }
+    //snapshot of pending containers, in the order of container group queue
+    std::vector<std::pair<ContainerGroup::Ptr, std::vector<Container::Ptr> > > pendings;
+    std::set<ContainerGroup::Ptr, ContainerGroupQueueLess>::iterator jt;
+    for (jt = container_group_queue_.begin(); jt != container_group_queue_.end(); jt++) {
+        ContainerGroup::Ptr container_group = *jt;
+        if (container_group->states[kContainerPending].size() == 0) {
+            continue; // no pending pods
+        }
+        pendings.push_back(std::make_pair(container_group, std::vector<Container::Ptr>()));
+        BOOST_FOREACH(ContainerMap::value_type& pair, container_group->states[kContainerPending]) {
+            pendings.back().second.push_back(pair.second);
+        }
+    }
+
+    int put_count = 0;
+    // requirements which fit no agent in this pass, keyed by fingerprint and priority
+    std::map<std::pair<uint64_t, int>, ResourceError> infeasible;
+    for (size_t i = 0; i < pendings.size(); i++) {
+        const ContainerGroup::Ptr& container_group = pendings[i].first;
+        const std::vector<Container::Ptr>& containers = pendings[i].second;
+        ScoreContext context;
+        if (container_group->require->gang) {
+            put_count += PlaceGang(container_group, context);
+            continue;
+        }
+        for (size_t j = 0; j < containers.size(); j++) {
+            const Container::Ptr& container = containers[j];
+            if (container->status != kContainerPending) {
+                continue;
+            }
+            const Requirement::Ptr& require = container->require;
+            std::pair<uint64_t, int> feasible_key(require->Fingerprint(), container->priority);
+            std::map<std::pair<uint64_t, int>, ResourceError>::iterator inf_it;
+            inf_it = infeasible.find(feasible_key);
+            if (inf_it != infeasible.end()) {
+                for (; j < containers.size(); j++) {
+                    containers[j]->last_res_err = inf_it->second;
+                }
+                break;
+            }
+            ResourceError res_err;
+            Agent* agent = SelectAgent(container_group, container, context, res_err);
+            bool put_ok = false;
+            if (agent != NULL) {
+                agent->Put(container);
+                ChangeStatus(container, kContainerAllocating);
+                if (context.racks_built) {
+                    context.rack_counts[GetRack(*agent)]++;
+                }
+                put_ok = true;
+                put_count++;
+            }
+            if (!put_ok && FLAGS_enable_preemption && Preempt(container, res_err)) {
+                put_count++;
+                continue;
+            }
+            if (!put_ok) {
+                VLOG(10) << "batch put fail: " << container->id
+                         << ", err:" << proto::ResourceError_Name(res_err);
+                // pending containers of one group share the same requirement,
+                // and agents only get fuller in this pass
+                if (require->max_per_host <= 0) {
+                    infeasible[feasible_key] = res_err;
+                }
+                for (; j < containers.size(); j++) {
+                    containers[j]->last_res_err = res_err;
+                }
+                break;
+            }
+        }
+    }
+    return put_count;
+}
+
+void Scheduler::SelectCandidates(const Requirement::Ptr& require,
+                                 int64_t cpu_need,
+                                 int64_t memory_need,
+                                 std::vector<Agent*>& candidates,
+                                 ResourceError& err) {
+    mu_.AssertHeld();
+    std::vector<AgentEndpoint> endpoints;
+    agent_index_.Select(require->pool_names, require->tag, cpu_need, memory_need,
+                        FLAGS_sched_select_max_agents > 0 ? FLAGS_sched_select_max_agents : 0,
+                        endpoints, err);
+    candidates.reserve(endpoints.size());
+    BOOST_FOREACH(const AgentEndpoint& endpoint, endpoints) {
+        std::map<AgentEndpoint, Agent::Ptr>::iterator it = agents_.find(endpoint);
+        if (it != agents_.end()) {
+            candidates.push_back(it->second.get());
+        }
+    }
+}
+
+void Scheduler::OrderCandidates(const Container::Ptr& container,
+                                std::vector<Agent*>& candidates,
+                                ResourceError& res_err) {
+    mu_.AssertHeld();
+    const Requirement::Ptr& require = container->require;
+    int64_t cpu_need = 0;
+    int64_t memory_need = require->TmpfsNeed();
+    if (container->priority != proto::kJobBestEffort) {
+        cpu_need = require->CpuNeed();
+        memory_need += require->MemoryNeed();
+    }
+    bool scoring = false;
+    std::map<std::string, ScorePolicy::Ptr>::iterator policy_it;
+    for (policy_it = score_policies_.begin(); policy_it != score_policies_.end(); policy_it++) {
+        if (!policy_it->second->Empty()) {
+            scoring = true;
+        }
+    }
+    std::vector<Agent*> found;
+    SelectCandidates(require, cpu_need, memory_need, found, res_err);
+    // with scoring, agents evenly sampled from the candidates are scored
+    // first, the others are only tried when none of them fits
+    size_t stride = 1;
+    if (scoring && FLAGS_sched_score_candidates > 0) {
+        stride = std::max(found.size() / FLAGS_sched_score_candidates,
+                          static_cast<size_t>(1));
+    }
+    candidates.clear();
+    candidates.reserve(found.size());
+    for (size_t k = 0; k < found.size(); k += stride) {
+        candidates.push_back(found[k]);
+    }
+    for (size_t k = 0; stride > 1 && k < found.size(); k++) {
+        if (k % stride != 0) {
+            candidates.push_back(found[k]);
+        }
+    }
+}
+
+Agent* Scheduler::SelectAgent(const ContainerGroup::Ptr& container_group,
+                              const Container::Ptr& container,
+                              ScoreContext& context,
+                              ResourceError& res_err) {
+    mu_.AssertHeld();
+    std::vector<Agent*> candidates;
+    OrderCandidates(container, candidates, res_err);
+    return PickAgent(container_group, container, candidates, context, res_err);
+}
+
+Agent* Scheduler::PickAgent(const ContainerGroup::Ptr& container_group,
+                            const Container::Ptr& container,
+                            const std::vector<Agent*>& candidates,
+                            ScoreContext& context,
+                            ResourceError& res_err) {
+    mu_.AssertHeld();
+    Agent* best_agent = NULL;
+    double best_score = 0.0;
+    int scored = 0;
+    for (size_t k = 0; k < candidates.size(); k++) {
+        Agent* agent = candidates[k];
+        if (freezed_agents_.find(agent->endpoint_) != freezed_agents_.end()) {
+            continue;
+        }
+        ResourceError try_err;
+        if (!agent->TryPut(container.get(), try_err)) {
+            if (res_err == proto::kResOk
+                || res_err == proto::kTooManyPods) {
+                res_err = try_err;
+            }
+            continue;
+        }
+        const ScorePolicy* policy = GetScorePolicy(agent->pool_name_);
+        if (policy == NULL) { // first fit
+            if (best_agent == NULL) {
+                best_agent = agent;
+            }
+            break;
+        }
+        if (policy->NeedRack() && !context.racks_built) {
+            BuildScoreContext(container_group, context);
+        }
+        double score = policy->Score(context, *agent, *container);
+        if (best_agent == NULL || score > best_score) {
+            best_agent = agent;
+            best_score = score;
+        }
+        if (++scored >= FLAGS_sched_score_candidates) {
+            break;
+        }
+    }
+    return best_agent;
+}
+
+int Scheduler::PlaceGang(const ContainerGroup::Ptr& container_group, ScoreContext& context) {
+    mu_.AssertHeld();
+    // containers are put on agents tentatively, they turn to allocating
+    // only when every pending container of the group is put
+    ContainerMap pendings = container_group->states[kContainerPending];
+    std::vector<Container::Ptr> placed;
+    ResourceError res_err = proto::kResOk;
+    // the members share one requirement, so the candidates are looked up
+    // once for the gang; TryPut still sees what earlier members took
+    std::vector<Agent*> candidates;
+    Requirement::Ptr candidates_require;
+    ResourceError select_err = proto::kResOk;
+    BOOST_FOREACH(ContainerMap::value_type& pair, pendings) {
+        const Container::Ptr& container = pair.second;
+        if (container->require != candidates_require) {
+            OrderCandidates(container, candidates, select_err);
+            candidates_require = container->require;
+        }
+        res_err = select_err;
+        Agent* agent = PickAgent(container_group, container, candidates, context, res_err);
+        if (agent == NULL) {
+            break;
+        }
+        agent->Put(container);
+        if (context.racks_built) {
+            context.rack_counts[GetRack(*agent)]++;
+        }
+        placed.push_back(container);
+    }
+    if (placed.size() == pendings.size()) {
+        BOOST_FOREACH(const Container::Ptr& container, placed) {
+            ChangeStatus(container_group, container, kContainerAllocating);
+        }
+        return placed.size();
+    }
+    VLOG(10) << "gang does not fit: " << container_group->id
+             << ", put " << placed.size() << " of " << pendings.size()
+             << ", err:" << proto::ResourceError_Name(res_err);
+    BOOST_FOREACH(const Container::Ptr& container, placed) {
+        std::map<AgentEndpoint, Agent::Ptr>::iterator it = agents_.find(container->allocated_agent);
+        assert(it != agents_.end());
+        it->second->Evict(container);
+        container->allocated_volums.clear();
+        container->allocated_ports.clear();
+        container->allocated_volum_containers.clear();
+        container->allocated_agent.erase();
+    }
+    BOOST_FOREACH(ContainerMap::value_type& pair, pendings) {
+        pair.second->last_res_err = res_err;
+    }
+    return 0;
+}
+
+int Scheduler::ScheduleGangs() {
+    MutexLock lock(&mu_);
+    int put_count = 0;
+    std::set<ContainerGroup::Ptr, ContainerGroupQueueLess>::iterator it;
+    for (it = container_group_queue_.begin(); it != container_group_queue_.end(); it++) {
+        const ContainerGroup::Ptr& container_group = *it;
+        if (!container_group->require->gang
+            || container_group->states[kContainerPending].empty()) {
+            continue;
+        }
+        ScoreContext context;
+        put_count += PlaceGang(container_group, context);
+    }
+    return put_count;
 }
 
 bool Scheduler::ManualSchedule(const AgentEndpoint& endpoint,
@@ -1286,40 +2140,129 @@ bool Scheduler::ManualSchedule(const AgentEndpoint& endpoint,
         fail_reason = "tag or pool mismatching";
         return false;
     }
-    std::vector<Container::Ptr> agent_containers;
-    BOOST_FOREACH(ContainerMap::value_type& pair, agent->containers_) {
-        agent_containers.push_back(pair.second);
-    }
-    std::sort(agent_containers.begin(),
-              agent_containers.end(), ContainerPriorityLess());
-    std::vector<Container::Ptr>::reverse_iterator it;
+    std::vector<Container::Ptr> victims;
     ResourceError res_err;
-    bool preempt_succ = false;
-    for (it = agent_containers.rbegin();
-         it != agent_containers.rend(); it++) {
-        Container::Ptr poor_container = *it;
-        if (poor_container->require->container_type == proto::kVolumContainer) {
+    int64_t now = common::timer::get_micros();
+    if (!preemptor_.SelectVictims(*agent, container_manual, true, now, victims, res_err)) {
+        container_manual->last_res_err = res_err;
+        fail_reason = "no room after preemption: " + proto::ResourceError_Name(res_err);
+        return false;
+    }
+    PutOnVictims(agent.get(), container_manual, victims);
+    preemptor_.Record(victims, now);
+    return true;
+}
+
+bool Scheduler::SetScorePolicy(const std::string& pool_name, const std::string& spec) {
+    ScorePolicy::Ptr policy(new ScorePolicy());
+    if (!policy->Parse(spec)) {
+        return false;
+    }
+    MutexLock lock(&mu_);
+    score_policies_[pool_name] = policy;
+    return true;
+}
+
+const ScorePolicy* Scheduler::GetScorePolicy(const std::string& pool_name) {
+    mu_.AssertHeld();
+    std::map<std::string, ScorePolicy::Ptr>::iterator it = score_policies_.find(pool_name);
+    if (it == score_policies_.end()) {
+        it = score_policies_.find("");
+    }
+    if (it == score_policies_.end() || it->second->Empty()) {
+        return NULL;
+    }
+    return it->second.get();
+}
+
+void Scheduler::BuildScoreContext(const ContainerGroup::Ptr& container_group,
+                                  ScoreContext& context) {
+    mu_.AssertHeld();
+    context.rack_counts.clear();
+    ContainerStatus placed[] = {kContainerAllocating, kContainerReady};
+    for (size_t i = 0; i < sizeof(placed) / sizeof(placed[0]); i++) {
+        BOOST_FOREACH(const ContainerMap::value_type& pair, container_group->states[placed[i]]) {
+            std::map<AgentEndpoint, Agent::Ptr>::iterator it;
+            it = agents_.find(pair.second->allocated_agent);
+            if (it != agents_.end()) {
+                context.rack_counts[GetRack(*it->second)]++;
+            }
+        }
+    }
+    context.racks_built = true;
+}
+
+bool Scheduler::Preempt(const Container::Ptr& container, ResourceError& err) {
+    mu_.AssertHeld();
+    const Requirement::Ptr& require = container->require;
+    std::vector<Agent*> candidates;
+    ResourceError select_err;
+    SelectCandidates(require, 0, 0, candidates, select_err);
+    int64_t now = common::timer::get_micros();
+    Agent* best_agent = NULL;
+    std::vector<Container::Ptr> best_victims;
+    Preemptor::Cost best_cost;
+    int examined = 0;
+    for (size_t i = 0; i < candidates.size() && examined < FLAGS_preempt_max_agents; i++) {
+        Agent* agent = candidates[i];
+        if (freezed_agents_.find(agent->endpoint_) != freezed_agents_.end()) {
             continue;
         }
-        if (!agent->TryPut(container_manual.get(), res_err)) {
-            if (res_err == proto::kTagMismatch || res_err == proto::kPoolMismatch) {
-                fail_reason = "tag or pool mismatching";
-                return false;
-            }
-            ChangeStatus(poor_container, kContainerPending); //evict one
+        examined++;
+        std::vector<Container::Ptr> victims;
+        ResourceError victim_err;
+        if (!preemptor_.SelectVictims(*agent, container, false, now, victims, victim_err)) {
+            continue;
         }
-        //try again after evicting
-        if (agent->TryPut(container_manual.get(), res_err)) {
-            agent->Put(container_manual);
-            ChangeStatus(container_manual, kContainerAllocating);
-            preempt_succ = true;
-            break;
+        Preemptor::Cost cost = Preemptor::GetCost(victims, now);
+        if (best_agent == NULL || cost < best_cost) {
+            best_agent = agent;
+            best_victims.swap(victims);
+            best_cost = cost;
+        }
+    }
+    if (best_agent == NULL) {
+        return false;
+    }
+    PutOnVictims(best_agent, container, best_victims);
+    preemptor_.Record(best_victims, now);
+    err = proto::kResOk;
+    return true;
+}
+
+void Scheduler::PutOnVictims(Agent* agent, const Container::Ptr& container,
+                             const std::vector<Container::Ptr>& victims) {
+    mu_.AssertHeld();
+    BOOST_FOREACH(const Container::Ptr& victim, victims) {
+        LOG(INFO) << "preempt " << victim->id << " on " << agent->endpoint_
+                  << " for " << container->id;
+        ChangeStatus(victim, kContainerPending);
+    }
+    agent->Put(container);
+    ChangeStatus(container, kContainerAllocating);
+    // destroyed by the next MakeCommand of the agent
+    BOOST_FOREACH(const Container::Ptr& victim, victims) {
+        container->victims.insert(victim->id);
+    }
+}
+
+bool Scheduler::WaitForVictims(const Container::Ptr& container,
+                               const std::set<ContainerId>& remote_ids) {
+    mu_.AssertHeld();
+    std::set<ContainerId>::iterator it = container->victims.begin();
+    while (it != container->victims.end()) {
+        if (remote_ids.find(*it) == remote_ids.end()) {
+            container->victims.erase(it++);
         } else {
-            container_manual->last_res_err = res_err;
-            continue;
+            it++;
         }
     }
-    return preempt_succ;
+    if (!container->victims.empty()) {
+        LOG(INFO) << "wait for " << container->victims.size()
+                  << " victims destroyed before creating " << container->id;
+        return true;
+    }
+    return false;
 }
 
 bool Scheduler::Update(const ContainerGroupId& container_group_id,
@@ -1333,8 +2276,7 @@ bool Scheduler::Update(const ContainerGroupId& container_group_id,
         return false;
     }
     ContainerGroup::Ptr container_group = it->second;
-    Requirement::Ptr require(new Requirement());
-    SetRequirement(require, container_desc);
+    Requirement::Ptr require(new Requirement(container_desc));
     if (!RequireHasDiff(require.get(), container_group->require.get())) {
         LOG(WARNING) << "version same, ignore updating";
         container_group->update_interval = update_interval;
@@ -1343,12 +2285,15 @@ bool Scheduler::Update(const ContainerGroupId& container_group_id,
         return false;
     }
     new_version = GetNewVersion();
-    require->version = new_version;
+    proto::ContainerDescription new_desc = container_desc;
+    new_desc.set_version(new_version);
+    require.reset(new Requirement(new_desc));
     container_group->update_interval = update_interval;
     container_group->last_update_time = common::timer::now_time();
+    AccountUserAlloc(container_group, -container_group->Replica());
     container_group->require = require;
-    container_group->container_desc = container_desc;
-    container_group->container_desc.set_version(new_version);
+    AccountUserAlloc(container_group, container_group->Replica());
+    container_group->container_desc = new_desc;
     container_group->update_time = common::timer::get_micros();
     BOOST_FOREACH(ContainerMap::value_type& pair, container_group->states[kContainerPending]) {
         Container::Ptr pending_container = pair.second;
@@ -1387,8 +2332,10 @@ void Scheduler::MakeCommand(const std::string& agent_endpoint,
     int64_t memory_deep_reserved = 0;
     ContainerMap containers_local = agent->containers_;
     std::map<ContainerId, ContainerStatus> remote_status;
+    std::set<ContainerId> remote_ids;
     for (int i = 0; i < agent_info.container_info_size(); i++) {
         const proto::ContainerInfo& container_remote = agent_info.container_info(i);
+        remote_ids.insert(container_remote.id());
         ContainerMap::iterator it_local = containers_local.find(container_remote.id());
         AgentCommand cmd;
         if (it_local == containers_local.end()) {
@@ -1434,10 +2381,19 @@ void Scheduler::MakeCommand(const std::string& agent_endpoint,
         }
         remote_status[container_remote.id()] = container_remote.status();
         Container::Ptr container_local = it_local->second;
+        container_local->reported = true;
+        std::map<ContainerGroupId, ContainerGroup::Ptr>::iterator group_it;
+        group_it = container_groups_.find(container_local->container_group_id);
+        if (group_it != container_groups_.end()) {
+            AccountContainer(group_it->second, container_local, -1);
+        }
         container_local->remote_info.set_cpu_used(container_remote.cpu_used());
         container_local->remote_info.set_memory_used(container_remote.memory_used());
         container_local->remote_info.mutable_volum_used()->CopyFrom(container_remote.volum_used());
         container_local->remote_info.mutable_port_used()->CopyFrom(container_remote.port_used());
+        if (group_it != container_groups_.end()) {
+            AccountContainer(group_it->second, container_local, 1);
+        }
     }
 
     // set resource reserved
@@ -1469,6 +2425,10 @@ void Scheduler::MakeCommand(const std::string& agent_endpoint,
                     cmd.action = kDestroyContainer;
                     commands.push_back(cmd);
                     ChangeStatus(container_local, kContainerPending);
+                } else if (WaitForVictims(container_local, remote_ids)) {
+                    // destroyed first
+                } else if (container_local->reserving) {
+                    VLOG(10) << "wait for the reservation of " << container_local->id;
                 } else {
                     cmd.action = kCreateContainer;
                     cmd.desc = container_group->container_desc;
@@ -1502,6 +2462,102 @@ void Scheduler::MakeCommand(const std::string& agent_endpoint,
     }
 }
 
+void Scheduler::TrackPlacements(bool track, bool reserve) {
+    MutexLock locker(&mu_);
+    track_placements_ = track;
+    reserve_placements_ = track && reserve;
+    if (!track) {
+        placements_.clear();
+    }
+}
+
+void Scheduler::TakePlacements(std::map<AgentEndpoint, std::vector<AgentCommand> >& placements) {
+    std::map<AgentEndpoint, std::vector<Container::Ptr> > placed;
+    MutexLock locker(&mu_);
+    placed.swap(placements_);
+    std::map<AgentEndpoint, std::vector<Container::Ptr> >::iterator it;
+    for (it = placed.begin(); it != placed.end(); it++) {
+        const AgentEndpoint& endpoint = it->first;
+        BOOST_FOREACH(const Container::Ptr& container, it->second) {
+            if (container->status != kContainerAllocating
+                || container->allocated_agent != endpoint) {
+                continue;
+            }
+            if (!container->victims.empty()) {
+                // reserved once MakeCommand finds the victims gone
+                placements_[endpoint].push_back(container);
+                continue;
+            }
+            std::map<ContainerGroupId, ContainerGroup::Ptr>::iterator group_it;
+            group_it = container_groups_.find(container->container_group_id);
+            if (group_it == container_groups_.end()) {
+                continue;
+            }
+            AgentCommand cmd;
+            cmd.action = kCreateContainer;
+            cmd.container_id = container->id;
+            cmd.container_group_id = container->container_group_id;
+            cmd.desc = group_it->second->container_desc;
+            SetVolumsAndPorts(container, cmd.desc);
+            placements[endpoint].push_back(cmd);
+        }
+    }
+}
+
+void Scheduler::AckReservation(const ContainerGroupId& container_group_id,
+                               const ContainerId& container_id,
+                               const AgentEndpoint& endpoint) {
+    MutexLock locker(&mu_);
+    std::map<ContainerGroupId, ContainerGroup::Ptr>::iterator it = container_groups_.find(container_group_id);
+    if (it == container_groups_.end()) {
+        return;
+    }
+    ContainerMap::iterator container_it = it->second->containers.find(container_id);
+    if (container_it == it->second->containers.end()) {
+        return;
+    }
+    Container::Ptr container = container_it->second;
+    if (container->status == kContainerAllocating
+        && container->allocated_agent == endpoint) {
+        container->reserving = false;
+    }
+}
+
+bool Scheduler::CancelPlacement(const ContainerGroupId& container_group_id,
+                                const ContainerId& container_id,
+                                const AgentEndpoint& endpoint) {
+    MutexLock locker(&mu_);
+    std::map<ContainerGroupId, ContainerGroup::Ptr>::iterator it = container_groups_.find(container_group_id);
+    if (it == container_groups_.end()) {
+        return false;
+    }
+    ContainerGroup::Ptr container_group = it->second;
+    ContainerMap::iterator container_it = container_group->containers.find(container_id);
+    if (container_it == container_group->containers.end()) {
+        return false;
+    }
+    Container::Ptr container = container_it->second;
+    if (container->status != kContainerAllocating
+        || container->allocated_agent != endpoint) {
+        return false;
+    }
+    if (!container->victims.empty()) {
+        // the agent still holds the victims, which make it refuse
+        LOG(INFO) << "placement kept until its victims are destroyed: " << container_id;
+        return false;
+    }
+    if (container->reported) {
+        // created already, e.g. a reservation coming after the create
+        LOG(INFO) << "placement kept as its agent reports it: " << container_id;
+        container->reserving = false;
+        return false;
+    }
+    LOG(INFO) << "placement canceled by agent: " << endpoint
+              << ", container: " << container_id;
+    ChangeStatus(container_group, container, kContainerPending);
+    return true;
+}
+
 bool Scheduler::RequireHasDiff(const Requirement* v1, const Requirement* v2) {
     mu_.AssertHeld();
     if (v1 == v2) {//same object
@@ -1592,7 +2648,11 @@ bool Scheduler::RequireHasDiff(const Requirement* v1, const Requirement* v2) {
     for (size_t i = 0; i < v1->blkios.size(); i++) {
         const proto::BlkioRequired& b1 = v1->blkios[i];
         const proto::BlkioRequired& b2 = v2->blkios[i];
-        if (b1.weight() != b2.weight()) {
+        if (b1.weight() != b2.weight()
+            || b1.read_bps_limit() != b2.read_bps_limit()
+            || b1.write_bps_limit() != b2.write_bps_limit()
+            || b1.read_iops_limit() != b2.read_iops_limit()
+            || b1.write_iops_limit() != b2.write_iops_limit()) {
             return true;
         }
     }
@@ -1640,18 +2700,50 @@ void Scheduler::SetVolumsAndPorts(const Container::Ptr& container,
     }
 }
 
-bool Scheduler::ListContainerGroups(std::vector<proto::ContainerGroupStatistics>& container_groups) {
-    MutexLock lock(&mu_);
+bool Scheduler::ListContainerGroups(std::vector<proto::ContainerGroupStatistics>& container_groups,
+                                    int64_t& snapshot_time) {
+    GroupStatsSnapshot snapshot;
+    bool need_build = false;
+    int64_t now = common::timer::get_micros();
+    {
+        MutexLock lock(&snapshot_mu_);
+        snapshot = group_stats_snapshot_;
+        snapshot_time = snapshot_time_;
+        if (!snapshot) {
+            need_build = true;
+            snapshot_building_ = true;
+        } else if (now - snapshot_time_ >= FLAGS_query_snapshot_interval * 1000
+                   && !snapshot_building_) {
+            // others go on with the old snapshot while this one is rebuilding
+            need_build = true;
+            snapshot_building_ = true;
+        }
+    }
+    if (need_build) {
+        boost::shared_ptr<std::vector<proto::ContainerGroupStatistics> > fresh(
+            new std::vector<proto::ContainerGroupStatistics>()
+        );
+        {
+            MutexLock lock(&mu_);
+            BuildContainerGroupStatistics(*fresh);
+        }
+        MutexLock lock(&snapshot_mu_);
+        group_stats_snapshot_ = fresh;
+        snapshot_time_ = now;
+        snapshot_building_ = false;
+        snapshot = fresh;
+        snapshot_time = now;
+    }
+    container_groups = *snapshot;
+    return true;
+}
+
+void Scheduler::BuildContainerGroupStatistics(std::vector<proto::ContainerGroupStatistics>& container_groups) {
+    mu_.AssertHeld();
     std::map<ContainerGroupId, ContainerGroup::Ptr>::iterator it;
     for (it = container_groups_.begin(); it != container_groups_.end(); it++) {
-        int64_t cpu_assigned = 0; //for one container group
-        int64_t cpu_used = 0;
-        int64_t memory_assigned = 0;
-        int64_t memory_used = 0;
-        std::map<proto::VolumMedium, int64_t> volum_assigned;
-        std::map<proto::VolumMedium, int64_t> volum_used;
-
         ContainerGroup::Ptr& container_group = it->second;
+        const ResourceStat& ready_stat = container_group->ready_stat;
         proto::ContainerGroupStatistics group_stat;
         group_stat.set_id(container_group->id);
         group_stat.set_name(container_group->name);
@@ -1669,47 +2761,24 @@ bool Scheduler::ListContainerGroups(std::vector<proto::ContainerGroupStatistics>
         } else {
             group_stat.set_status(proto::kContainerGroupNormal);
         }
-        std::map<ContainerId, Container::Ptr>::iterator jt;
-        for (jt = container_group->containers.begin();
-             jt != container_group->containers.end(); jt++) {
-            //sum up all containers
-            Container::Ptr container = jt->second;
-            if (container->status != kContainerReady) {
-                continue;
-            }
-            for (size_t i = 0; i < container->require->volums.size(); i++) {
-                proto::VolumMedium medium = container->require->volums[i].medium();
-                int64_t as = container->require->volums[i].size();
-                int64_t us = 0;
-                if ((int)i < container->remote_info.volum_used_size()) {
-                    us = container->remote_info.volum_used(i).used_size();
-                }
-                volum_assigned[medium] += as;
-                volum_used[medium] += us;
-            }
-            cpu_assigned += container->require->CpuNeed();
-            cpu_used += container->remote_info.cpu_used();
-            memory_assigned += container->require->MemoryNeed();
-            memory_used += container->remote_info.memory_used();
-        }
-        group_stat.mutable_cpu()->set_assigned(cpu_assigned);
-        group_stat.mutable_cpu()->set_used(cpu_used);
-        group_stat.mutable_memory()->set_assigned(memory_assigned);
-        group_stat.mutable_memory()->set_used(memory_used);
+        group_stat.mutable_cpu()->set_assigned(ready_stat.cpu_assigned);
+        group_stat.mutable_cpu()->set_used(ready_stat.cpu_used);
+        group_stat.mutable_memory()->set_assigned(ready_stat.memory_assigned);
+        group_stat.mutable_memory()->set_used(ready_stat.memory_used);
 
-        std::map<proto::VolumMedium, int64_t>::iterator v_it;
-        for (v_it = volum_assigned.begin(); v_it != volum_assigned.end(); v_it++) {
+        std::map<proto::VolumMedium, int64_t>::const_iterator v_it;
+        for (v_it = ready_stat.volum_assigned.begin();
+             v_it != ready_stat.volum_assigned.end(); v_it++) {
             proto::VolumResource* volum_stat = group_stat.add_volums();
             proto::VolumMedium medium = v_it->first;
             int64_t assigned_size = v_it->second;
-            int64_t used_size = volum_used[medium];
+            int64_t used_size = ready_stat.volum_used.find(medium)->second;
             volum_stat->set_medium(medium);
             volum_stat->mutable_volum()->set_assigned(assigned_size);
             volum_stat->mutable_volum()->set_used(used_size);
         }
         container_groups.push_back(group_stat);
     }
-    return true;
 }
 
 bool Scheduler::ShowContainerGroup(const ContainerGroupId& container_group_id,
@@ -1790,32 +2859,82 @@ bool Scheduler::ShowAgent(const AgentEndpoint& endpoint,
 
 void Scheduler::ShowUserAlloc(const std::string& user_name, proto::Quota& alloc) {
     MutexLock lock(&mu_);
+    std::map<std::string, proto::Quota>::const_iterator it = user_alloc_.find(user_name);
+    proto::Quota user_alloc;
+    if (it != user_alloc_.end()) {
+        user_alloc = it->second;
+    }
+    alloc.set_millicore(user_alloc.millicore());
+    alloc.set_memory(user_alloc.memory());
+    alloc.set_replica(user_alloc.replica());
+    alloc.set_disk(user_alloc.disk());
+    alloc.set_ssd(user_alloc.ssd());
+}
+
+bool Scheduler::CheckStatistics(std::string& diff) {
+    MutexLock lock(&mu_);
+    std::map<std::string, proto::Quota> user_alloc;
     std::map<ContainerGroupId, ContainerGroup::Ptr>::iterator it;
-    int64_t cpu_alloc = 0; //for one user
-    int64_t memory_alloc = 0;
-    int64_t ssd_alloc = 0;
-    int64_t disk_alloc = 0;
-    int64_t replica_alloc = 0;
     for (it = container_groups_.begin(); it != container_groups_.end(); it++) {
         const ContainerGroup::Ptr& container_group = it->second;
-        if (container_group->user_name != user_name) {
-            continue;
+        ResourceStat ready_stat;
+        BOOST_FOREACH(const ContainerMap::value_type& pair,
+                      container_group->states[kContainerReady]) {
+            ready_stat.Add(*pair.second, 1);
+        }
+        if (!(ready_stat == container_group->ready_stat)) {
+            diff = "ready resources of container group " + container_group->id;
+            return false;
         }
         int64_t replica = container_group->Replica();
-        replica_alloc +=  replica;
+        if (replica == 0) {
+            continue;
+        }
+        const Requirement& require = *container_group->require;
+        proto::Quota& alloc = user_alloc[container_group->user_name];
+        alloc.set_replica(alloc.replica() + replica);
         if (container_group->priority != proto::kJobBestEffort) {
-            cpu_alloc += container_group->require->CpuNeed() * replica;
-            memory_alloc += container_group->require->MemoryNeed() * replica;
+            alloc.set_millicore(alloc.millicore() + require.CpuNeed() * replica);
+            alloc.set_memory(alloc.memory() + require.MemoryNeed() * replica);
+        }
+        alloc.set_memory(alloc.memory() + require.TmpfsNeed() * replica);
+        alloc.set_disk(alloc.disk() + require.DiskNeed() * replica);
+        alloc.set_ssd(alloc.ssd() + require.SsdNeed() * replica);
+    }
+    if (user_alloc.size() != user_alloc_.size()) {
+        diff = "number of users with allocation";
+        return false;
+    }
+    std::map<std::string, proto::Quota>::iterator u_it;
+    for (u_it = user_alloc.begin(); u_it != user_alloc.end(); u_it++) {
+        std::map<std::string, proto::Quota>::iterator jt = user_alloc_.find(u_it->first);
+        if (jt == user_alloc_.end()
+            || jt->second.SerializeAsString() != u_it->second.SerializeAsString()) {
+            diff = "allocation of user " + u_it->first;
+            return false;
         }
-        memory_alloc += container_group->require->TmpfsNeed() * replica;
-        disk_alloc += container_group->require->DiskNeed() * replica;
-        ssd_alloc += container_group->require->SsdNeed() * replica;
     }
-    alloc.set_millicore(cpu_alloc);
-    alloc.set_memory(memory_alloc);
-    alloc.set_replica(replica_alloc);
-    alloc.set_disk(disk_alloc);
-    alloc.set_ssd(ssd_alloc);
+    std::map<std::string, PoolStat> pool_stats;
+    std::map<AgentEndpoint, Agent::Ptr>::iterator a_it;
+    for (a_it = agents_.begin(); a_it != agents_.end(); a_it++) {
+        const Agent::Ptr& agent = a_it->second;
+        PoolStat& pool_stat = pool_stats[agent->pool_name_];
+        pool_stat.total_agents++;
+        pool_stat.cpu_total += agent->cpu_total_;
+        pool_stat.cpu_assigned += agent->cpu_assigned_;
+        pool_stat.memory_total += agent->memory_total_;
+        pool_stat.memory_assigned += agent->memory_assigned_;
+    }
+    std::map<std::string, PoolStat>::iterator p_it;
+    for (p_it = pool_stats.begin(); p_it != pool_stats.end(); p_it++) {
+        PoolStat pool_stat;
+        if (!agent_index_.GetPoolStat(p_it->first, pool_stat)
+            || !(pool_stat == p_it->second)) {
+            diff = "statistics of pool " + p_it->first;
+            return false;
+        }
+    }
+    return true;
 }
 
 std::string Scheduler::GetNewVersion() {
@@ -1832,8 +2951,7 @@ std::string Scheduler::GetNewVersion() {
 }
 
 void Scheduler::MetaToQuota(const proto::ContainerGroupMeta& meta, proto::Quota& quota) {
-    Requirement::Ptr require(new Requirement);
-    SetRequirement(require, meta.desc());
+    Requirement::Ptr require(new Requirement(meta.desc()));
     int64_t replica = meta.replica();
     quota.set_replica(replica);
     if (meta.desc().priority() != proto::kJobBestEffort) {
@@ -1852,7 +2970,7 @@ bool Scheduler::IsBeingShared(const ContainerGroupId& container_group_id,
     std::map<ContainerGroupId, ContainerGroup::Ptr>::iterator it;
     for (it = container_groups_.begin(); it != container_groups_.end(); it++) {
         ContainerGroup::Ptr& container_group = it->second;
-        std::vector<ContainerGroupId>::iterator jt;
+        std::vector<ContainerGroupId>::const_iterator jt;
         for (jt = container_group->require->volum_jobs.begin();
              jt != container_group->require->volum_jobs.end();
              jt++) {
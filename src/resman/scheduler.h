@@ -6,6 +6,7 @@
 #include <map>
 #include <set>
 #include <list>
+#include <deque>
 #include <vector>
 #include <string>
 #include <utility>
@@ -47,63 +48,61 @@ struct AgentCommand {
     proto::ContainerDescription desc;
 };
 
+// built once for each version of a container group from its description,
+// immutable afterwards so that the totals below always match the fields
 struct Requirement {
-    std::string tag;
-    std::set<std::string> pool_names;
-    int max_per_host;
-    bool v2_support;
-    std::vector<proto::CpuRequired> cpu;
-    std::vector<proto::MemoryRequired> memory;
-    std::vector<proto::VolumRequired> volums;
-    std::vector<proto::PortRequired> ports;
-    std::string version;
-    std::vector<proto::TcpthrotRequired> tcp_throts;
-    std::vector<proto::BlkioRequired> blkios;
-    std::vector<std::string> volum_jobs;
-    proto::ContainerType container_type;
-    Requirement() : max_per_host(0), v2_support(false), container_type(proto::kNormalContainer) {};
-    int64_t CpuNeed() {
-        int64_t total = 0;
-        for (size_t i = 0; i < cpu.size(); i++) {
-            total += cpu[i].milli_core();
-        }
-        return total;
+    const std::string tag;
+    const std::set<std::string> pool_names;
+    const int max_per_host;
+    const bool v2_support;
+    const bool gang;
+    const std::vector<proto::CpuRequired> cpu;
+    const std::vector<proto::MemoryRequired> memory;
+    const std::vector<proto::VolumRequired> volums;
+    const std::vector<proto::PortRequired> ports;
+    const std::string version;
+    const std::vector<proto::TcpthrotRequired> tcp_throts;
+    const std::vector<proto::BlkioRequired> blkios;
+    const std::vector<std::string> volum_jobs;
+    const std::set<ContainerGroupId> anti_affinity;
+    const proto::ContainerType container_type;
+    explicit Requirement(const proto::ContainerDescription& container_desc);
+    int64_t CpuNeed() const {
+        return cpu_need_;
     }
-    int64_t MemoryNeed() {
-        int64_t total = 0;
-        for (size_t i = 0; i < memory.size(); i++) {
-            total += memory[i].size();
-        }
-        return total;
+    int64_t MemoryNeed() const {
+        return memory_need_;
     }
-    int64_t DiskNeed() {
-        int64_t total = 0;
-        for (size_t i = 0; i < volums.size(); i++) {
-            if (volums[i].medium() == proto::kDisk) {
-                total += volums[i].size();
-            }
-        }
-        return total;
+    int64_t DiskNeed() const {
+        return disk_need_;
     }
-    int64_t SsdNeed() {
-        int64_t total = 0;
-        for (size_t i = 0; i < volums.size(); i++) {
-            if (volums[i].medium() == proto::kSsd) {
-                total += volums[i].size();
-            }
-        }
-        return total;
+    int64_t SsdNeed() const {
+        return ssd_need_;
     }
-    int64_t TmpfsNeed() {
-        int64_t total = 0;
-        for (size_t i = 0; i < volums.size(); i++) {
-            if (volums[i].medium() == proto::kTmpfs) {
-                total += volums[i].size();
-            }
-        }
-        return total;
+    int64_t TmpfsNeed() const {
+        return tmpfs_need_;
+    }
+    size_t PortCount() const {
+        return ports.size();
+    }
+    // volums placed on devices, in the order of volums
+    const std::vector<proto::VolumRequired>& DeviceVolums() const {
+        return device_volums_;
+    }
+    // same for requirements which are equally feasible on any agent
+    uint64_t Fingerprint() const {
+        return fingerprint_;
     }
     typedef boost::shared_ptr<Requirement> Ptr;
+private:
+    void Summarize();
+    int64_t cpu_need_;
+    int64_t memory_need_;
+    int64_t disk_need_;
+    int64_t ssd_need_;
+    int64_t tmpfs_need_;
+    std::vector<proto::VolumRequired> device_volums_;
+    uint64_t fingerprint_;
 };
 
 struct VolumInfo {
@@ -125,18 +124,44 @@ struct Container {
     ResourceError last_res_err;
     proto::ContainerInfo remote_info;
     std::vector<ContainerId> allocated_volum_containers;
-    Container() : priority(proto::kJobService), status(kContainerPending), last_res_err(proto::kResOk) {}
+    int64_t allocated_time; // when the container was put on its agent
+    // preempted for it and still reported by its agent, it is created
+    // there when they are gone
+    std::set<ContainerId> victims;
+    // its reservation is on the way, it is created once the agent acks
+    bool reserving;
+    // its agent has reported it since it was put there
+    bool reported;
+    Container() : priority(proto::kJobService), status(kContainerPending),
+                  last_res_err(proto::kResOk), allocated_time(0),
+                  reserving(false), reported(false) {}
     typedef boost::shared_ptr<Container> Ptr;
 };
 
-struct ContainerPriorityLess{
-    bool operator() (const Container::Ptr& a, const Container::Ptr& b) {
-        return a->priority < b->priority;
+typedef std::map<ContainerId, Container::Ptr> ContainerMap;
+
+// resources of the ready containers in a container group, kept up to date
+// by the scheduler on every status change instead of summed up on each query
+struct ResourceStat {
+    int64_t cpu_assigned;
+    int64_t cpu_used;
+    int64_t memory_assigned;
+    int64_t memory_used;
+    std::map<proto::VolumMedium, int64_t> volum_assigned;
+    std::map<proto::VolumMedium, int64_t> volum_used;
+    ResourceStat() : cpu_assigned(0), cpu_used(0),
+                     memory_assigned(0), memory_used(0) {}
+    void Add(const Container& container, int64_t sign);
+    bool operator == (const ResourceStat& b) const {
+        return cpu_assigned == b.cpu_assigned
+               && cpu_used == b.cpu_used
+               && memory_assigned == b.memory_assigned
+               && memory_used == b.memory_used
+               && volum_assigned == b.volum_assigned
+               && volum_used == b.volum_used;
     }
 };
 
-typedef std::map<ContainerId, Container::Ptr> ContainerMap;
-
 struct ContainerGroup {
     ContainerGroupId id;
     Requirement::Ptr require;
@@ -153,6 +178,7 @@ struct ContainerGroup {
     int64_t submit_time;
     int64_t update_time;
     std::string last_sched_container_id;
+    ResourceStat ready_stat;
     ContainerGroup() : priority(kJobService),
                        terminated(false),
                        update_interval(0),
@@ -168,9 +194,33 @@ struct ContainerGroup {
     typedef boost::shared_ptr<ContainerGroup> Ptr;
 };
 
+class AgentIndex;
+class Preemptor;
+class ScorePolicy;
+struct ScoreContext;
+
+struct PoolStat {
+    int64_t total_agents;
+    int64_t cpu_total;
+    int64_t cpu_assigned;
+    int64_t memory_total;
+    int64_t memory_assigned;
+    PoolStat() : total_agents(0), cpu_total(0), cpu_assigned(0),
+                 memory_total(0), memory_assigned(0) {}
+    bool operator == (const PoolStat& b) const {
+        return total_agents == b.total_agents
+               && cpu_total == b.cpu_total
+               && cpu_assigned == b.cpu_assigned
+               && memory_total == b.memory_total
+               && memory_assigned == b.memory_assigned;
+    }
+};
+
 class Agent {
 public:
     friend class Scheduler;
+    friend class AgentIndex;
+    friend class Preemptor;
     explicit Agent(const AgentEndpoint& endpoint,
                    int64_t cpu,
                    int64_t memory,
@@ -191,19 +241,38 @@ public:
     bool TryPut(const Container* container, ResourceError& err);
     void Put(Container::Ptr container);
     void Evict(Container::Ptr container);
+    const AgentEndpoint& Endpoint() const {
+        return endpoint_;
+    }
+    const std::set<std::string>& Tags() const {
+        return tags_;
+    }
+    int64_t CpuFree() const {
+        return cpu_total_ - cpu_assigned_;
+    }
+    int64_t CpuTotal() const {
+        return cpu_total_;
+    }
+    int64_t MemoryFree() const {
+        return memory_total_ - memory_assigned_;
+    }
+    int64_t MemoryTotal() const {
+        return memory_total_;
+    }
+    int ContainerCount(const ContainerGroupId& container_group_id) const;
     typedef boost::shared_ptr<Agent> Ptr;
 private:
     bool SelectDevices(const std::vector<proto::VolumRequired>& volums,
                        std::vector<DevicePath>& devices);
-    bool RecurSelectDevices(size_t i, const std::vector<proto::VolumRequired>& volums,
-                            std::map<DevicePath, VolumInfo>& volum_free,
-                            std::vector<DevicePath>& devices,
-                            std::set<DevicePath>& path_used);
     bool SelectFreePorts(const std::vector<proto::PortRequired>& ports_need,
                          std::vector<std::string>& ports_free);
     bool SelectFreeVolumContainers(const std::vector<ContainerGroupId>& volum_jobs,
                                    std::vector<ContainerId>& volum_containers);
     ContainerGroupId ExtractGroupId(const ContainerId& container_id);
+    void UpdateIndex();
+    // undo Evict of a container which still holds its allocation on the agent,
+    // for trial evictions; volum containers are never evicted this way
+    void Unevict(Container::Ptr container);
     AgentEndpoint endpoint_;
     std::set<std::string> tags_;
     std::string pool_name_;
@@ -225,6 +294,95 @@ private:
     std::map<ContainerGroupId, int> container_counts_;
     std::map<ContainerGroupId, std::set<ContainerId> > volum_jobs_free_;
     int32_t batch_container_count_;
+    AgentIndex* index_;
+};
+
+// secondary index of agents: pool -> tag -> ordered by free cpu and memory,
+// agents without any tag are only indexed under the empty tag
+class AgentIndex {
+public:
+    void Update(Agent* agent);
+    void Remove(const AgentEndpoint& endpoint);
+    // endpoints of the agents which may hold the requirement, the least loaded
+    // (most free cpu, then most free memory) first, so that containers spread
+    // over the pool; at most max_visits entries of each bucket are examined,
+    // 0 for no limit. err is set to the reason when no agent found
+    void Select(const std::set<std::string>& pool_names,
+                const std::string& tag,
+                int64_t cpu_need,
+                int64_t memory_need,
+                size_t max_visits,
+                std::vector<AgentEndpoint>& endpoints,
+                ResourceError& err);
+    // totals of the indexed agents in the pool, maintained on Update/Remove
+    bool GetPoolStat(const std::string& pool_name, PoolStat& stat) const;
+private:
+    struct Entry {
+        int64_t cpu_free;
+        int64_t memory_free;
+        AgentEndpoint endpoint;
+        bool operator < (const Entry& b) const {
+            if (cpu_free != b.cpu_free) {
+                return cpu_free < b.cpu_free;
+            }
+            if (memory_free != b.memory_free) {
+                return memory_free < b.memory_free;
+            }
+            return endpoint < b.endpoint;
+        }
+    };
+    struct IndexedKey {
+        std::string pool_name;
+        std::set<std::string> tags;
+        Entry entry;
+        PoolStat stat;
+    };
+    typedef std::set<Entry> Bucket;
+    std::map<std::string, std::map<std::string, Bucket> > buckets_;
+    std::map<AgentEndpoint, IndexedKey> indexed_;
+    std::map<std::string, PoolStat> pool_stats_;
+};
+
+// picks the containers to evict from one agent so that a pending container fits,
+// and keeps the per container group disruption budget
+class Preemptor {
+public:
+    // the more important the victims and the more work they have done,
+    // the more a preemption costs
+    struct Cost {
+        int top_priority;
+        size_t victims;
+        int64_t work_lost;
+        Cost() : top_priority(proto::kJobBestEffort + 1), victims(0), work_lost(0) {}
+        bool operator < (const Cost& b) const {
+            if (top_priority != b.top_priority) {
+                return top_priority > b.top_priority;
+            }
+            if (victims != b.victims) {
+                return victims < b.victims;
+            }
+            return work_lost < b.work_lost;
+        }
+    };
+    // at most group_budget containers of one group are preempted within window seconds
+    Preemptor(int group_budget, int window);
+    // a minimal set of victims on the agent, only less important containers
+    // within the budget are considered unless manual is set;
+    // an empty set is returned when the container fits already
+    bool SelectVictims(Agent& agent, const Container::Ptr& container,
+                       bool manual, int64_t now,
+                       std::vector<Container::Ptr>& victims,
+                       ResourceError& err);
+    // charge the budget of the victims' groups
+    void Record(const std::vector<Container::Ptr>& victims, int64_t now);
+    static Cost GetCost(const std::vector<Container::Ptr>& victims, int64_t now);
+private:
+    bool Fits(Agent& agent, const Container::Ptr& container,
+              const std::vector<Container::Ptr>& victims, ResourceError& err);
+    int Budget(const ContainerGroupId& container_group_id, int64_t now);
+    int group_budget_;
+    int window_;
+    std::map<ContainerGroupId, std::deque<int64_t> > history_;
 };
 
 struct ContainerGroupQueueLess {
@@ -242,8 +400,9 @@ struct ContainerGroupQueueLess {
 class Scheduler {
 public:
     explicit Scheduler();
-    //start the main schueduling loop
-    void Start();
+    //start the main schueduling loop,
+    //without the loop, scheduling is driven by ScheduleAgent/ScheduleBatch
+    void Start(bool sched_loop = true);
     void Stop();
 
     void AddAgent(Agent::Ptr agent, const proto::AgentInfo& agent_info);
@@ -252,6 +411,7 @@ public:
                             const proto::ContainerDescription& container_desc,
                             int replica, int priority,
                             const std::string& user_name);
+    // an existing container group is updated in place, keeping its containers
     void Reload(const proto::ContainerGroupMeta& container_group_meta);
     bool Kill(const ContainerGroupId& container_group_id);
     bool ManualSchedule(const AgentEndpoint& endpoint,
@@ -274,7 +434,11 @@ public:
     void MakeCommand(const std::string& agent_endpoint,
                      const proto::AgentInfo& agent_info,
                      std::vector<AgentCommand>& commands);
-    bool ListContainerGroups(std::vector<proto::ContainerGroupStatistics>& container_groups);
+    // served from a snapshot which is at most FLAGS_query_snapshot_interval old,
+    // so that it does not wait for the scheduler lock on every call;
+    // snapshot_time is when the snapshot was taken
+    bool ListContainerGroups(std::vector<proto::ContainerGroupStatistics>& container_groups,
+                             int64_t& snapshot_time);
     bool ShowContainerGroup(const ContainerGroupId& container_group_id,
                             std::vector<proto::ContainerStatistics>& containers);
     bool ShowAgent(const AgentEndpoint& endpoint,
@@ -288,6 +452,47 @@ public:
     void MetaToQuota(const proto::ContainerGroupMeta& meta, proto::Quota& quota);
     bool IsBeingShared(const ContainerGroupId& container_group_id,
                        ContainerGroupId& top_container_group_id);
+    // one scheduling pass over all agents and all pending containers,
+    // candidate agents are looked up in the agent index;
+    // return the number of containers put on agents
+    int ScheduleBatch();
+    // put pending containers on one agent, as one tick of the scheduling loop;
+    // return the number of containers put on the agent
+    int ScheduleAgent(const AgentEndpoint& endpoint);
+    // place the pending containers of gang container groups, all or nothing
+    // for each group; the per agent loop leaves gangs to this, once a round.
+    // Gangs stay out of preemption: they do not evict others to fit, and
+    // their members are never picked as victims
+    int ScheduleGangs();
+    // scoring of the agents in the pool, the empty pool name sets the default;
+    // an empty spec means first fit. Scores pick the agent of a container in
+    // ScheduleBatch and ScheduleGangs only, the per agent loop (ScheduleAgent)
+    // offers one agent at a time and always puts first fit
+    bool SetScorePolicy(const std::string& pool_name, const std::string& spec);
+    // keep the containers newly put on agents for TakePlacements; with
+    // reserve, MakeCommand creates them only after AckReservation
+    void TrackPlacements(bool track, bool reserve);
+    // create commands of the containers put on agents since the last call,
+    // by agent, leaving out those which are not allocating there any more;
+    // those preempting containers are kept for a later call, after the
+    // destroys of their victims
+    void TakePlacements(std::map<AgentEndpoint, std::vector<AgentCommand> >& placements);
+    // the agent holds the reservation of the container, or knows nothing of
+    // reservations, the create command may go
+    void AckReservation(const ContainerGroupId& container_group_id,
+                        const ContainerId& container_id,
+                        const AgentEndpoint& endpoint);
+    // the agent can not hold the container, put it back to pending
+    // unless it has moved on, its victims are still on the agent or the
+    // agent reports it already; return false if so
+    bool CancelPlacement(const ContainerGroupId& container_group_id,
+                         const ContainerId& container_id,
+                         const AgentEndpoint& endpoint);
+protected:
+    // compare the running statistics of groups, users and pools with a full
+    // recomputation, return false and the first difference if they disagree;
+    // for tests only
+    bool CheckStatistics(std::string& diff);
 private:
     void ChangeStatus(Container::Ptr container,
                       proto::ContainerStatus new_status);
@@ -300,21 +505,74 @@ private:
     ContainerGroupId GenerateContainerGroupId(const std::string& container_group_name);
     ContainerId GenerateContainerId(const ContainerGroupId& container_group_id, int offset);
     void ScheduleNextAgent(AgentEndpoint pre_endpoint);
+    void ScheduleBatchLoop();
+    int ScheduleAgentLocked(Agent::Ptr agent);
     void CheckTagAndPool(Agent::Ptr agent);
     void CheckVersion(Agent::Ptr agent);
     bool CheckTagAndPoolOnce(Agent::Ptr agent, Container::Ptr container);
     void CheckContainerGroupGC(ContainerGroup::Ptr container_group);
+    // evict lower priority containers from the cheapest agent and put the container there
+    bool Preempt(const Container::Ptr& container, ResourceError& err);
+    // the agents the index finds for the requirement, in the index order
+    void SelectCandidates(const Requirement::Ptr& require,
+                          int64_t cpu_need,
+                          int64_t memory_need,
+                          std::vector<Agent*>& candidates,
+                          ResourceError& err);
+    // the candidates of the container in the order PickAgent tries them,
+    // evenly sampled ones first when scoring
+    void OrderCandidates(const Container::Ptr& container,
+                         std::vector<Agent*>& candidates,
+                         ResourceError& err);
+    // a feasible agent for the container among the candidates, the best scored
+    // one if the pools have score policies; NULL and err set if none fits
+    Agent* PickAgent(const ContainerGroup::Ptr& container_group,
+                     const Container::Ptr& container,
+                     const std::vector<Agent*>& candidates,
+                     ScoreContext& context,
+                     ResourceError& err);
+    // OrderCandidates and PickAgent in one go
+    Agent* SelectAgent(const ContainerGroup::Ptr& container_group,
+                       const Container::Ptr& container,
+                       ScoreContext& context,
+                       ResourceError& err);
+    int PlaceGang(const ContainerGroup::Ptr& container_group, ScoreContext& context);
+    // the policy of the pool or the default one, NULL for first fit
+    const ScorePolicy* GetScorePolicy(const std::string& pool_name);
+    void BuildScoreContext(const ContainerGroup::Ptr& container_group, ScoreContext& context);
+    void PutOnVictims(Agent* agent, const Container::Ptr& container,
+                      const std::vector<Container::Ptr>& victims);
+    // forgets the victims of the container its agent does not report any
+    // more, true if some are still there
+    bool WaitForVictims(const Container::Ptr& container,
+                        const std::set<ContainerId>& remote_ids);
     bool RequireHasDiff(const Requirement* v1, const Requirement* v2);
-    void SetRequirement(Requirement::Ptr require,
-                        const proto::ContainerDescription& container_desc);
     void SetVolumsAndPorts(const Container::Ptr& container,
                            proto::ContainerDescription& container_desc);
+    // add or remove the contribution of a container which is in states[status]
+    void AccountContainer(const ContainerGroup::Ptr& container_group,
+                          const Container::Ptr& container, int64_t sign);
+    void AccountUserAlloc(const ContainerGroup::Ptr& container_group, int64_t replica);
+    void BuildContainerGroupStatistics(std::vector<proto::ContainerGroupStatistics>& container_groups);
     std::string GetNewVersion();
     std::map<AgentEndpoint, Agent::Ptr> agents_;
     std::set<AgentEndpoint> freezed_agents_;
     std::map<ContainerGroupId, ContainerGroup::Ptr> container_groups_;
     std::set<ContainerGroup::Ptr, ContainerGroupQueueLess> container_group_queue_;
+    AgentIndex agent_index_;
+    Preemptor preemptor_;
+    std::map<std::string, boost::shared_ptr<ScorePolicy> > score_policies_;
+    std::map<std::string, proto::Quota> user_alloc_;
+    bool track_placements_;
+    bool reserve_placements_;
+    std::map<AgentEndpoint, std::vector<Container::Ptr> > placements_;
     Mutex mu_;
+    // snapshot of ListContainerGroups, mu_ and snapshot_mu_ are never held together
+    typedef boost::shared_ptr<const std::vector<proto::ContainerGroupStatistics> > GroupStatsSnapshot;
+    Mutex snapshot_mu_;
+    GroupStatsSnapshot group_stats_snapshot_;
+    int64_t snapshot_time_;
+    bool snapshot_building_;
     ThreadPool sched_pool_;
     ThreadPool gc_pool_;
     bool stop_;
@@ -0,0 +1,156 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "volum_solver.h"
+
+#include <set>
+#include <algorithm>
+#include <boost/foreach.hpp>
+
+namespace baidu {
+namespace galaxy {
+namespace sched {
+
+// max number of assignments the exhaustive fallback may visit
+const size_t sMaxExhaustiveSteps = 4096;
+
+typedef std::map<DevicePath, VolumInfo> VolumMap;
+
+namespace {
+
+struct VolumOrderLess {
+    explicit VolumOrderLess(const std::vector<proto::VolumRequired>& volums)
+        : volums_(volums) {}
+    bool operator() (size_t a, size_t b) const {
+        const proto::VolumRequired& va = volums_[a];
+        const proto::VolumRequired& vb = volums_[b];
+        if (va.exclusive() != vb.exclusive()) {
+            return va.exclusive();
+        }
+        if (va.size() != vb.size()) {
+            return va.size() > vb.size();
+        }
+        return a < b;
+    }
+    const std::vector<proto::VolumRequired>& volums_;
+};
+
+bool Fits(const DevicePath& device_path,
+          const VolumInfo& volum_info,
+          const proto::VolumRequired& volum_need,
+          const std::set<DevicePath>& path_used) {
+    if (volum_info.exclusive || volum_need.size() > volum_info.size) {
+        return false;
+    }
+    if (volum_info.medium != volum_need.medium()) {
+        return false;
+    }
+    if (volum_need.exclusive() &&
+        path_used.find(device_path) != path_used.end()) {
+        return false;
+    }
+    return true;
+}
+
+bool RecurSelect(size_t i, const std::vector<proto::VolumRequired>& volums,
+                 VolumMap& volum_free,
+                 std::vector<DevicePath>& devices,
+                 std::set<DevicePath>& path_used) {
+    if (i >= volums.size()) {
+        return devices.size() == volums.size();
+    }
+    const proto::VolumRequired& volum_need = volums[i];
+    BOOST_FOREACH(VolumMap::value_type& pair, volum_free) {
+        const DevicePath& device_path = pair.first;
+        VolumInfo& volum_info = pair.second;
+        if (!Fits(device_path, volum_info, volum_need, path_used)) {
+            continue;
+        }
+        bool first_use = path_used.insert(device_path).second;
+        volum_info.size -= volum_need.size();
+        volum_info.exclusive = volum_need.exclusive();
+        devices.push_back(device_path);
+        if (RecurSelect(i + 1, volums, volum_free, devices, path_used)) {
+            return true;
+        }
+        volum_info.size += volum_need.size();
+        volum_info.exclusive = false;
+        devices.pop_back();
+        if (first_use) {
+            path_used.erase(device_path);
+        }
+    }
+    return false;
+}
+
+} //namespace
+
+bool BestFitVolumDevices(const std::vector<proto::VolumRequired>& volums,
+                         const VolumMap& volum_free,
+                         std::vector<DevicePath>& devices) {
+    std::vector<size_t> order;
+    for (size_t i = 0; i < volums.size(); i++) {
+        order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), VolumOrderLess(volums));
+    VolumMap free = volum_free; //copy once
+    std::set<DevicePath> path_used;
+    std::vector<DevicePath> selected(volums.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        const proto::VolumRequired& volum_need = volums[order[i]];
+        VolumMap::iterator best = free.end();
+        for (VolumMap::iterator it = free.begin(); it != free.end(); it++) {
+            if (!Fits(it->first, it->second, volum_need, path_used)) {
+                continue;
+            }
+            // strict less keeps the smallest device path on ties
+            if (best == free.end() || it->second.size < best->second.size) {
+                best = it;
+            }
+        }
+        if (best == free.end()) {
+            return false;
+        }
+        best->second.size -= volum_need.size();
+        if (volum_need.exclusive()) {
+            best->second.exclusive = true;
+        }
+        path_used.insert(best->first);
+        selected[order[i]] = best->first;
+    }
+    devices.insert(devices.end(), selected.begin(), selected.end());
+    return true;
+}
+
+bool ExhaustiveVolumDevices(const std::vector<proto::VolumRequired>& volums,
+                            const VolumMap& volum_free,
+                            std::vector<DevicePath>& devices) {
+    VolumMap free = volum_free;
+    std::set<DevicePath> path_used;
+    std::vector<DevicePath> selected;
+    if (!RecurSelect(0, volums, free, selected, path_used)) {
+        return false;
+    }
+    devices.insert(devices.end(), selected.begin(), selected.end());
+    return true;
+}
+
+bool SelectVolumDevices(const std::vector<proto::VolumRequired>& volums,
+                        const VolumMap& volum_free,
+                        std::vector<DevicePath>& devices) {
+    if (BestFitVolumDevices(volums, volum_free, devices)) {
+        return true;
+    }
+    size_t steps = 1;
+    for (size_t i = 0; i < volums.size(); i++) {
+        steps *= std::max(volum_free.size(), static_cast<size_t>(1));
+        if (steps > sMaxExhaustiveSteps) {
+            return false;
+        }
+    }
+    return ExhaustiveVolumDevices(volums, volum_free, devices);
+}
+
+} //namespace sched
+} //namespace galaxy
+} //namespace baidu
@@ -0,0 +1,38 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#pragma once
+
+#include <map>
+#include <vector>
+#include "scheduler.h"
+
+namespace baidu {
+namespace galaxy {
+namespace sched {
+
+// assign one device to each volum, devices[i] is the device of volums[i].
+// A device marked exclusive in volum_free can not be used, a device taken
+// by an exclusive volum can not be used by other volums of the container.
+//
+// best-fit-decreasing is tried first, exhaustive search is only used as a
+// fallback when the input is tiny
+bool SelectVolumDevices(const std::vector<proto::VolumRequired>& volums,
+                        const std::map<DevicePath, VolumInfo>& volum_free,
+                        std::vector<DevicePath>& devices);
+
+// exclusive volums first, then larger volums first; each volum goes to the
+// device which leaves the least free space, ties are broken by device path.
+// O(V * (log V + D))
+bool BestFitVolumDevices(const std::vector<proto::VolumRequired>& volums,
+                         const std::map<DevicePath, VolumInfo>& volum_free,
+                         std::vector<DevicePath>& devices);
+
+// backtracking in the order of volums, O(D ^ V)
+bool ExhaustiveVolumDevices(const std::vector<proto::VolumRequired>& volums,
+                            const std::map<DevicePath, VolumInfo>& volum_free,
+                            std::vector<DevicePath>& devices);
+
+} //namespace sched
+} //namespace galaxy
+} //namespace baidu
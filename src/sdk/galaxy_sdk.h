@@ -112,7 +112,19 @@ struct TcpthrotRequired {
     bool send_bps_excess;
 };
 struct BlkioRequired {
+    BlkioRequired() :
+        weight(0),
+        read_bps_limit(0),
+        write_bps_limit(0),
+        read_iops_limit(0),
+        write_iops_limit(0) {}
+
     int32_t weight;
+    // no limit if 0
+    int64_t read_bps_limit;
+    int64_t write_bps_limit;
+    int64_t read_iops_limit;
+    int64_t write_iops_limit;
 };
 struct PortRequired {
     std::string port_name;
@@ -317,6 +329,7 @@ enum Status {
    kManualReload = 26,
    kManualTerminate = 27,
    kManualQuit = 28,
+   kThrottled = 29,
 };
 struct ErrorCode {
     Status status;
@@ -582,6 +595,8 @@ struct ContainerGroupStatistics {
 struct ListContainerGroupsResponse {
     ErrorCode error_code;
     std::vector<ContainerGroupStatistics> containers;
+    // the list may lag behind resman by up to query_snapshot_interval
+    int64_t snapshot_time;
 };
 struct ShowContainerGroupRequest {
     User user;
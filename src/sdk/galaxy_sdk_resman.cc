@@ -376,6 +376,7 @@ bool ResourceManagerImpl::ListContainerGroups(const ListContainerGroupsRequest&
     if (response->error_code.status != kOk) {
         return false;
     }
+    response->snapshot_time = pb_response.snapshot_time();
     for (int i = 0; i < pb_response.containers().size(); ++i) {
         const ::baidu::galaxy::proto::ContainerGroupStatistics& pb_container = pb_response.containers(i);
         ContainerGroupStatistics container;
@@ -486,6 +487,10 @@ bool ResourceManagerImpl::ShowContainerGroup(const ShowContainerGroupRequest& re
         cgroup.memory.size = pb_cgroup.memory().size();
         cgroup.memory.excess = pb_cgroup.memory().excess();
         cgroup.blkio.weight = pb_cgroup.blkio().weight();
+        cgroup.blkio.read_bps_limit = pb_cgroup.blkio().read_bps_limit();
+        cgroup.blkio.write_bps_limit = pb_cgroup.blkio().write_bps_limit();
+        cgroup.blkio.read_iops_limit = pb_cgroup.blkio().read_iops_limit();
+        cgroup.blkio.write_iops_limit = pb_cgroup.blkio().write_iops_limit();
         cgroup.tcp_throt.recv_bps_quota = pb_cgroup.tcp_throt().recv_bps_quota();
         cgroup.tcp_throt.recv_bps_excess = pb_cgroup.tcp_throt().recv_bps_excess();
         cgroup.tcp_throt.send_bps_quota = pb_cgroup.tcp_throt().send_bps_quota();
@@ -171,7 +171,16 @@ bool FillBlkioRequired(const BlkioRequired& sdk_blk,
         fprintf(stderr, "blkio weight must be in 0~1000\n");
         return false;
     }
+    if (sdk_blk.read_bps_limit < 0 || sdk_blk.write_bps_limit < 0
+            || sdk_blk.read_iops_limit < 0 || sdk_blk.write_iops_limit < 0) {
+        fprintf(stderr, "blkio limits must not be less than 0\n");
+        return false;
+    }
     blk->set_weight(sdk_blk.weight);
+    blk->set_read_bps_limit(sdk_blk.read_bps_limit);
+    blk->set_write_bps_limit(sdk_blk.write_bps_limit);
+    blk->set_read_iops_limit(sdk_blk.read_iops_limit);
+    blk->set_write_iops_limit(sdk_blk.write_iops_limit);
     return true;
 }
 
@@ -908,6 +917,10 @@ void PbJobDescription2SdkJobDescription(const ::baidu::galaxy::proto::JobDescrip
         task.tcp_throt.send_bps_quota = pb_job.pod().tasks(i).tcp_throt().send_bps_quota();
         task.tcp_throt.send_bps_excess = pb_job.pod().tasks(i).tcp_throt().send_bps_excess();
         task.blkio.weight = pb_job.pod().tasks(i).blkio().weight();
+        task.blkio.read_bps_limit = pb_job.pod().tasks(i).blkio().read_bps_limit();
+        task.blkio.write_bps_limit = pb_job.pod().tasks(i).blkio().write_bps_limit();
+        task.blkio.read_iops_limit = pb_job.pod().tasks(i).blkio().read_iops_limit();
+        task.blkio.write_iops_limit = pb_job.pod().tasks(i).blkio().write_iops_limit();
         for (int j = 0; j < pb_job.pod().tasks(i).ports().size(); ++j) {
             PortRequired port;
             port.port_name = pb_job.pod().tasks(i).ports(j).port_name();
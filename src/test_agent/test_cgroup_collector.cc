@@ -0,0 +1,111 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_CGROUP_COLLECTOR_ON
+#include "agent/cgroup/cgroup_collector.h"
+#include "agent/cgroup/control_file.h"
+#include "protocol/agent.pb.h"
+#include <boost/filesystem/operations.hpp>
+#include "timer.h"
+#include <stdio.h>
+#include <unistd.h>
+
+static void WriteFile(const std::string& path, const std::string& content) {
+    FILE* f = fopen(path.c_str(), "w");
+    ASSERT_TRUE(NULL != f);
+    fputs(content.c_str(), f);
+    fclose(f);
+}
+
+TEST(CgroupCollector, DeltaOfCycles) {
+    const std::string cpuacct = "./cgroup_collector_cpuacct.stat";
+    const std::string memory = "./cgroup_collector_memory.usage_in_bytes";
+    WriteFile(cpuacct, "user 100\nsystem 100\n");
+    WriteFile(memory, "4096\n");
+
+    baidu::galaxy::cgroup::CgroupCollector collector;
+    collector.SetCpuacctPath(cpuacct);
+    collector.SetMemoryPath(memory);
+    int64_t t0 = baidu::common::timer::get_micros();
+    EXPECT_EQ(0, collector.Collect().Code());
+    // no sleeping inside
+    EXPECT_LT(baidu::common::timer::get_micros() - t0, 500000);
+    boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix = collector.Statistics();
+    EXPECT_EQ(4096, metrix->memory_used_in_byte());
+    EXPECT_FALSE(metrix->has_cpu_used_in_millicore());
+
+    // the next cycle sees a new /proc/stat
+    ::usleep(2 * baidu::galaxy::cgroup::SystemCpuSampler::kMaxSampleAge);
+    WriteFile(cpuacct, "user 150\nsystem 150\n");
+    EXPECT_EQ(0, collector.Collect().Code());
+    metrix = collector.Statistics();
+    EXPECT_GT(metrix->cpu_used_in_millicore(), 0);
+
+    // cgroup recreated, counters start over
+    ::usleep(2 * baidu::galaxy::cgroup::SystemCpuSampler::kMaxSampleAge);
+    WriteFile(cpuacct, "user 1\nsystem 1\n");
+    EXPECT_EQ(0, collector.Collect().Code());
+    EXPECT_FALSE(collector.Statistics()->has_cpu_used_in_millicore());
+
+    remove(cpuacct.c_str());
+    remove(memory.c_str());
+}
+
+TEST(CgroupCollector, Blkio) {
+    const std::string cpuacct = "./cgroup_collector_cpuacct.stat";
+    const std::string memory = "./cgroup_collector_memory.usage_in_bytes";
+    const std::string blkio = "./cgroup_collector_blkio";
+    WriteFile(cpuacct, "user 100\nsystem 100\n");
+    WriteFile(memory, "4096\n");
+    boost::filesystem::create_directories(blkio);
+    WriteFile(blkio + "/blkio.throttle.io_service_bytes",
+              "8:0 Read 1000000\n8:0 Write 2000000\n8:0 Sync 0\n8:0 Async 0\n"
+              "8:0 Total 3000000\n8:16 Read 0\n8:16 Write 0\nTotal 3000000\n");
+    WriteFile(blkio + "/blkio.throttle.io_serviced",
+              "8:0 Read 100\n8:0 Write 200\n8:0 Total 300\nTotal 300\n");
+
+    baidu::galaxy::cgroup::CgroupCollector collector;
+    collector.SetCpuacctPath(cpuacct);
+    collector.SetMemoryPath(memory);
+    collector.SetBlkioPath(blkio);
+    EXPECT_EQ(0, collector.Collect().Code());
+    boost::shared_ptr<baidu::galaxy::proto::CgroupMetrix> metrix = collector.Statistics();
+    ASSERT_EQ(2, metrix->blkio_size());
+    EXPECT_EQ("8:0", metrix->blkio(0).device());
+    EXPECT_EQ(1000000, metrix->blkio(0).read_bytes());
+    EXPECT_EQ(2000000, metrix->blkio(0).write_bytes());
+    EXPECT_EQ(100, metrix->blkio(0).read_ios());
+    EXPECT_EQ(200, metrix->blkio(0).write_ios());
+    EXPECT_EQ(0, metrix->blkio(1).read_ios());
+    EXPECT_FALSE(metrix->blkio(0).has_read_bps());
+
+    ::usleep(500000);
+    WriteFile(blkio + "/blkio.throttle.io_service_bytes",
+              "8:0 Read 2000000\n8:0 Write 2000000\n8:16 Read 0\n8:16 Write 0\n");
+    WriteFile(blkio + "/blkio.throttle.io_serviced",
+              "8:0 Read 200\n8:0 Write 200\n");
+    EXPECT_EQ(0, collector.Collect().Code());
+    metrix = collector.Statistics();
+    ASSERT_EQ(2, metrix->blkio_size());
+    // about 1000000 bytes and 100 ios in half a second
+    EXPECT_GT(metrix->blkio(0).read_bps(), 1000000);
+    EXPECT_LE(metrix->blkio(0).read_bps(), 2000000);
+    EXPECT_GT(metrix->blkio(0).read_iops(), 100);
+    EXPECT_LE(metrix->blkio(0).read_iops(), 200);
+    EXPECT_EQ(0, metrix->blkio(0).write_bps());
+    EXPECT_EQ(0, metrix->blkio(0).write_iops());
+    EXPECT_EQ(0, metrix->blkio(1).read_bps());
+
+    // no throttle statistics, io is left out
+    boost::filesystem::remove_all(blkio);
+    baidu::galaxy::cgroup::ControlFileCache::GetInstance()->Invalidate(blkio);
+    EXPECT_EQ(0, collector.Collect().Code());
+    EXPECT_EQ(0, collector.Statistics()->blkio_size());
+
+    remove(cpuacct.c_str());
+    remove(memory.c_str());
+}
+#endif
@@ -9,6 +9,9 @@
 #include "agent/collector/collector_engine.h"
 #include "agent/util/error_code.h"
 
+#include <time.h>
+#include <unistd.h>
+
 class TestCollectorEngine : public testing::Test {
 protected:
     static void SetUpTestCase() {
@@ -20,10 +23,19 @@ protected:
 
 class CollectorForTest : public baidu::galaxy::collector::Collector {
 public:
-    CollectorForTest() {}
+    CollectorForTest(const std::string& name = "collector_for_test", int cost = 0) :
+        name_(name),
+        cost_(cost),
+        enable_(false),
+        count_(0) {
+    }
+
     ~CollectorForTest() {}
     virtual baidu::galaxy::util::ErrorCode Collect() {
-        std::cerr << "Collect ok .." << std::endl;
+        count_++;
+        if (cost_ > 0) {
+            usleep(cost_);
+        }
         return ERRORCODE_OK;
     }
 
@@ -35,22 +47,42 @@ public:
         return enable_;
     }
 
-    virtual bool Equal(const Collector& r) {
-        return this->Name() == r.Name();
+    virtual bool Equal(const Collector* r) {
+        return this->Name() == r->Name();
     }
 
     virtual int Cycle() {
-        return 5;
+        return 1;
     }
 
     virtual std::string Name() const {
-        return "collector_for_test";
+        return name_;
+    }
+
+    int Count() {
+        return count_;
     }
 
 private:
-    bool enable_;
+    std::string name_;
+    int cost_;  // unit micro second
+    volatile bool enable_;
+    volatile int count_;
 };
 
+static bool GetStat(const std::string& name,
+                    baidu::galaxy::collector::CollectorEngine::CollectorStat* stat) {
+    std::vector<baidu::galaxy::collector::CollectorEngine::CollectorStat> stats;
+    baidu::galaxy::collector::CollectorEngine::GetInstance()->GetStats(stats);
+    for (size_t i = 0; i < stats.size(); i++) {
+        if (stats[i].name == name) {
+            *stat = stats[i];
+            return true;
+        }
+    }
+    return false;
+}
+
 TEST_F(TestCollectorEngine, Register_Unregister)
 {
     boost::shared_ptr<baidu::galaxy::collector::CollectorEngine> ce
@@ -67,17 +99,67 @@ TEST_F(TestCollectorEngine, Register_Unregister)
     ce->Unregister(collector);
 }
 
+struct CollectorStarted {
+    bool operator()() {
+        baidu::galaxy::collector::CollectorEngine::CollectorStat fast;
+        baidu::galaxy::collector::CollectorEngine::CollectorStat slow;
+        return GetStat("fast", &fast) && GetStat("slow", &slow)
+               && fast.collections >= 3 && slow.overruns >= 1 && slow.skipped >= 1;
+    }
+};
+
+struct CollectorDropped {
+    bool operator()() {
+        baidu::galaxy::collector::CollectorEngine::CollectorStat stat;
+        return !GetStat("fast", &stat) && !GetStat("slow", &stat);
+    }
+};
+
+// polls for up to timeout seconds, the bounds leave room for a loaded host
+template <class Predicate>
+static bool WaitFor(Predicate predicate, int timeout) {
+    for (int i = 0; i < timeout * 10; i++) {
+        if (predicate()) {
+            return true;
+        }
+        usleep(100000);
+    }
+    return false;
+}
+
 TEST_F(TestCollectorEngine, Setup)
 {
     boost::shared_ptr<baidu::galaxy::collector::CollectorEngine> ce
         = baidu::galaxy::collector::CollectorEngine::GetInstance();
 
-    boost::shared_ptr<CollectorForTest> collector(new CollectorForTest());
-    collector->Enable(true);
-    baidu::galaxy::util::ErrorCode ec = ce->Register(collector);
-    EXPECT_EQ(0, ec.Code());
-    ce->Setup();
-    sleep(10);
+    boost::shared_ptr<CollectorForTest> fast(new CollectorForTest("fast"));
+    fast->Enable(true);
+    EXPECT_EQ(0, ce->Register(fast, true).Code());
+    // outruns its one second cycle each time
+    boost::shared_ptr<CollectorForTest> slow(new CollectorForTest("slow", 1500000));
+    slow->Enable(true);
+    EXPECT_EQ(0, ce->Register(slow).Code());
+    time_t start = time(NULL);
+    EXPECT_EQ(0, ce->Setup());
+    ASSERT_TRUE(WaitFor(CollectorStarted(), 20));
+    int64_t elapsed = time(NULL) - start;
+
+    // the slow one never holds up the fast one, which keeps to its cycle
+    baidu::galaxy::collector::CollectorEngine::CollectorStat stat;
+    ASSERT_TRUE(GetStat("fast", &stat));
+    EXPECT_TRUE(stat.fast);
+    EXPECT_LE(stat.collections, elapsed + 2);
+    EXPECT_EQ(0, stat.overruns);
+    EXPECT_GE(fast->Count(), 3);
+
+    ASSERT_TRUE(GetStat("slow", &stat));
+    EXPECT_FALSE(stat.fast);
+    EXPECT_GE(stat.last_cost, 1500000);
+
+    // disabled ones are dropped once they are done
+    fast->Enable(false);
+    slow->Enable(false);
+    EXPECT_TRUE(WaitFor(CollectorDropped(), 10));
     ce->TearDown();
 }
 
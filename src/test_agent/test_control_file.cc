@@ -0,0 +1,115 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_CONTROL_FILE_ON
+#include "agent/cgroup/control_file.h"
+#include "agent/cgroup/subsystem.h"
+#include <boost/filesystem/operations.hpp>
+#include <stdio.h>
+
+static void WriteFile(const std::string& path, const std::string& content) {
+    FILE* f = fopen(path.c_str(), "w");
+    ASSERT_TRUE(NULL != f);
+    fputs(content.c_str(), f);
+    fclose(f);
+}
+
+TEST(ControlFileCache, ReadAgain) {
+    baidu::galaxy::cgroup::ControlFileCache* cache =
+        baidu::galaxy::cgroup::ControlFileCache::GetInstance();
+    const std::string dir = "./control_file_test";
+    boost::filesystem::create_directories(dir);
+    const std::string usage = dir + "/memory.usage_in_bytes";
+    const std::string procs = dir + "/cgroup.procs";
+    WriteFile(usage, "4096\n");
+    WriteFile(procs, "");
+
+    size_t size = cache->Size();
+    std::string data;
+    ASSERT_EQ(0, cache->Read(usage, data).Code());
+    EXPECT_EQ("4096\n", data);
+    EXPECT_EQ(size + 1, cache->Size());
+
+    // the open file sees the new content, longer than the buffer too
+    std::string pids;
+    for (int i = 0; i < 2000; i++) {
+        pids += "12345\n";
+    }
+    WriteFile(procs, pids);
+    std::vector<std::string> lines;
+    ASSERT_EQ(0, cache->ReadLines(procs, lines).Code());
+    EXPECT_EQ(2000u, lines.size());
+    EXPECT_EQ("12345", lines[1999]);
+    WriteFile(usage, "8192\n");
+    ASSERT_EQ(0, cache->Read(usage, data).Code());
+    EXPECT_EQ("8192\n", data);
+    EXPECT_EQ(size + 2, cache->Size());
+
+    // a sibling with the same prefix stays
+    const std::string other = dir + "_other";
+    boost::filesystem::create_directories(other);
+    WriteFile(other + "/cgroup.procs", "1\n");
+    ASSERT_EQ(0, cache->Read(other + "/cgroup.procs", data).Code());
+    cache->Invalidate(dir);
+    EXPECT_EQ(size + 1, cache->Size());
+    cache->Invalidate(other + "/");
+    EXPECT_EQ(size, cache->Size());
+
+    boost::filesystem::remove_all(dir);
+    boost::filesystem::remove_all(other);
+    EXPECT_NE(0, cache->Read(usage, data).Code());
+}
+
+TEST(ControlFileCache, NotCachedWhileDestroyed) {
+    baidu::galaxy::cgroup::ControlFileCache* cache =
+        baidu::galaxy::cgroup::ControlFileCache::GetInstance();
+    const std::string dir = "./control_file_destroy";
+    boost::filesystem::create_directories(dir);
+    const std::string usage = dir + "/memory.usage_in_bytes";
+    WriteFile(usage, "4096\n");
+
+    size_t size = cache->Size();
+    std::string data;
+    ASSERT_EQ(0, cache->Read(usage, data).Code());
+    EXPECT_EQ(size + 1, cache->Size());
+
+    // a collector reading before the cgroup is removed opens the file again
+    cache->Invalidate(dir);
+    EXPECT_EQ(size, cache->Size());
+    ASSERT_EQ(0, cache->Read(usage, data).Code());
+    EXPECT_EQ("4096\n", data);
+    EXPECT_EQ(size, cache->Size());
+
+    boost::filesystem::remove_all(dir);
+    cache->Release(dir);
+    EXPECT_NE(0, cache->Read(usage, data).Code());
+    EXPECT_EQ(size, cache->Size());
+
+    // created again with the same path
+    boost::filesystem::create_directories(dir);
+    WriteFile(usage, "8192\n");
+    ASSERT_EQ(0, cache->Read(usage, data).Code());
+    EXPECT_EQ(size + 1, cache->Size());
+    cache->Invalidate(dir);
+    boost::filesystem::remove_all(dir);
+    cache->Release(dir);
+    EXPECT_EQ(size, cache->Size());
+}
+
+TEST(ControlFileCache, Attach) {
+    const std::string path = "./control_file_attach";
+    ASSERT_EQ(0, baidu::galaxy::cgroup::Attach(path, 100).Code());
+    ASSERT_EQ(0, baidu::galaxy::cgroup::Attach(path, 200, true).Code());
+    std::string data;
+    ASSERT_EQ(0, baidu::galaxy::cgroup::ControlFileCache::GetInstance()->Read(path, data).Code());
+    EXPECT_EQ("100\n200\n", data);
+    ASSERT_EQ(0, baidu::galaxy::cgroup::Attach(path, "FROZEN").Code());
+    ASSERT_EQ(0, baidu::galaxy::cgroup::ControlFileCache::GetInstance()->Read(path, data).Code());
+    EXPECT_EQ("FROZEN\n", data);
+    baidu::galaxy::cgroup::ControlFileCache::GetInstance()->Invalidate(path);
+    remove(path.c_str());
+}
+#endif
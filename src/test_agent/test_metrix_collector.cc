@@ -0,0 +1,32 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_METRIX_COLLECTOR_ON
+#include "agent/container/metrix_collector.h"
+
+using baidu::galaxy::container::MetrixCollector;
+
+TEST(MetrixCollector, ParseNetDev) {
+    std::vector<std::string> lines;
+    lines.push_back("Inter-|   Receive                                                |  Transmit");
+    lines.push_back(" face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed");
+    lines.push_back("    lo: 9000 90 0 0 0 0 0 0 9000 90 0 0 0 0 0 0");
+    lines.push_back("  eth0: 1000 10 0 0 0 0 0 0 2000 20 0 0 0 0 0 0");
+    lines.push_back("  eth1:300 3 0 0 0 0 0 0 400 4 0 0 0 0 0 0");
+
+    MetrixCollector::NetCounters net;
+    ASSERT_TRUE(MetrixCollector::ParseNetDev(lines, &net));
+    // lo is left out
+    EXPECT_EQ(1300, net.in_bytes);
+    EXPECT_EQ(13, net.in_packets);
+    EXPECT_EQ(2400, net.out_bytes);
+    EXPECT_EQ(24, net.out_packets);
+
+    lines.resize(3);
+    MetrixCollector::NetCounters none;
+    EXPECT_FALSE(MetrixCollector::ParseNetDev(lines, &none));
+}
+#endif
@@ -0,0 +1,84 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_METRIX_STORE_ON
+#include "agent/collector/metrix_store.h"
+
+using baidu::galaxy::collector::MetrixSample;
+using baidu::galaxy::collector::MetrixStore;
+
+static MetrixSample Sample(int64_t time, int64_t cpu, int64_t memory) {
+    MetrixSample sample;
+    sample.time = time;
+    sample.cpu_used_in_millicore = cpu;
+    sample.memory_used_in_byte = memory;
+    return sample;
+}
+
+TEST(MetrixStore, Range) {
+    MetrixStore store(4);
+    std::vector<MetrixSample> samples;
+    EXPECT_FALSE(store.Range("c1", 0, 100, samples));
+
+    for (int64_t t = 1; t <= 6; t++) {
+        store.Append("c1", Sample(t * 10, t, t * 100));
+    }
+
+    // the two oldest ones are overwritten
+    ASSERT_TRUE(store.Range("c1", 0, 100, samples));
+    ASSERT_EQ(4u, samples.size());
+    EXPECT_EQ(30, samples[0].time);
+    EXPECT_EQ(60, samples[3].time);
+    EXPECT_EQ(1, samples[3].sample_count);
+    EXPECT_EQ(6, samples[3].cpu_max_in_millicore);
+
+    samples.clear();
+    ASSERT_TRUE(store.Range("c1", 40, 60, samples));
+    ASSERT_EQ(2u, samples.size());
+    EXPECT_EQ(40, samples[0].time);
+    EXPECT_EQ(50, samples[1].time);
+
+    // the host is kept
+    store.Append("", Sample(10, 1, 1));
+    store.Append("c2", Sample(10, 1, 1));
+    EXPECT_EQ(3u, store.Size());
+    std::set<std::string> ids;
+    ids.insert("c2");
+    store.Retain(ids);
+    EXPECT_EQ(2u, store.Size());
+    EXPECT_FALSE(store.Range("c1", 0, 100, samples));
+    EXPECT_TRUE(store.Range("", 0, 100, samples));
+}
+
+TEST(MetrixStore, Aggregate) {
+    std::vector<MetrixSample> samples;
+    samples.push_back(Sample(105, 100, 1000));
+    samples.push_back(Sample(110, 300, 3000));
+    samples.push_back(Sample(125, 200, 2000));
+    samples.push_back(Sample(160, 400, 500));
+    samples[0].net_in_bps = 100;
+    samples[1].net_in_bps = 200;
+    samples[0].write_bps = 1000;
+    samples[1].write_bps = 3000;
+
+    std::vector<MetrixSample> aggregates;
+    MetrixStore::Aggregate(samples, 100, 20, aggregates);
+    ASSERT_EQ(3u, aggregates.size());
+    EXPECT_EQ(100, aggregates[0].time);
+    EXPECT_EQ(200, aggregates[0].cpu_used_in_millicore);
+    EXPECT_EQ(300, aggregates[0].cpu_max_in_millicore);
+    EXPECT_EQ(2000, aggregates[0].memory_used_in_byte);
+    EXPECT_EQ(3000, aggregates[0].memory_max_in_byte);
+    EXPECT_EQ(2, aggregates[0].sample_count);
+    EXPECT_EQ(150, aggregates[0].net_in_bps);
+    EXPECT_EQ(2000, aggregates[0].write_bps);
+    EXPECT_EQ(120, aggregates[1].time);
+    EXPECT_EQ(1, aggregates[1].sample_count);
+    // intervals with no sample are left out
+    EXPECT_EQ(160, aggregates[2].time);
+    EXPECT_EQ(400, aggregates[2].cpu_max_in_millicore);
+}
+#endif
@@ -0,0 +1,120 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_REPORT_TRACKER_ON
+#include "agent/container/report_tracker.h"
+#include <gflags/gflags.h>
+
+DECLARE_int32(report_max_removed);
+
+typedef std::vector<boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> > ContainerInfos;
+
+static boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> NewInfo(const std::string& id,
+        baidu::galaxy::proto::ContainerStatus status,
+        int64_t memory_used) {
+    boost::shared_ptr<baidu::galaxy::proto::ContainerInfo> ci(new baidu::galaxy::proto::ContainerInfo());
+    ci->set_id(id);
+    ci->set_group_id("group");
+    ci->set_status(status);
+    ci->set_memory_used(memory_used);
+    return ci;
+}
+
+TEST(ReportTracker, Delta) {
+    baidu::galaxy::container::ReportTracker tracker(1000);
+    ContainerInfos cis;
+    cis.push_back(NewInfo("c1", baidu::galaxy::proto::kContainerReady, 1000));
+    cis.push_back(NewInfo("c2", baidu::galaxy::proto::kContainerAllocating, 1000));
+
+    int64_t seq = 0;
+    ContainerInfos changed;
+    std::vector<std::string> removed;
+    // first report is always full
+    EXPECT_FALSE(tracker.Diff(cis, 0, &seq, changed, removed));
+    int64_t first = seq;
+
+    // nothing changed, small usage drift ignored
+    cis[0]->set_memory_used(1050);
+    EXPECT_TRUE(tracker.Diff(cis, first, &seq, changed, removed));
+    EXPECT_EQ(first, seq);
+    EXPECT_TRUE(changed.empty());
+    EXPECT_TRUE(removed.empty());
+
+    // status change and large drift reported, removal remembered
+    ContainerInfos now;
+    now.push_back(NewInfo("c1", baidu::galaxy::proto::kContainerReady, 2000));
+    now.push_back(NewInfo("c3", baidu::galaxy::proto::kContainerAllocating, 0));
+    EXPECT_TRUE(tracker.Diff(now, first, &seq, changed, removed));
+    EXPECT_GT(seq, first);
+    ASSERT_EQ(2u, changed.size());
+    EXPECT_EQ("c1", changed[0]->id());
+    EXPECT_EQ("c3", changed[1]->id());
+    ASSERT_EQ(1u, removed.size());
+    EXPECT_EQ("c2", removed[0]);
+
+    // a reporter already at seq sees nothing
+    changed.clear();
+    removed.clear();
+    int64_t second = seq;
+    EXPECT_TRUE(tracker.Diff(now, second, &seq, changed, removed));
+    EXPECT_TRUE(changed.empty());
+    EXPECT_TRUE(removed.empty());
+
+    // seq from the future, e.g. from another agent incarnation
+    EXPECT_FALSE(tracker.Diff(now, second + 100, &seq, changed, removed));
+}
+
+TEST(ReportTracker, ForgetRemoved) {
+    int32_t max_removed = FLAGS_report_max_removed;
+    FLAGS_report_max_removed = 1;
+    baidu::galaxy::container::ReportTracker tracker(0);
+    ContainerInfos cis;
+    cis.push_back(NewInfo("c1", baidu::galaxy::proto::kContainerReady, 0));
+    cis.push_back(NewInfo("c2", baidu::galaxy::proto::kContainerReady, 0));
+
+    int64_t seq = 0;
+    ContainerInfos changed;
+    std::vector<std::string> removed;
+    tracker.Diff(cis, 0, &seq, changed, removed);
+    int64_t first = seq;
+
+    ContainerInfos none;
+    // two removals, but only one remembered, so first is too old to serve
+    EXPECT_FALSE(tracker.Diff(none, first, &seq, changed, removed));
+    changed.clear();
+    removed.clear();
+    EXPECT_TRUE(tracker.Diff(none, seq, &seq, changed, removed));
+    EXPECT_TRUE(removed.empty());
+    FLAGS_report_max_removed = max_removed;
+}
+
+TEST(ReportTracker, VolumChange) {
+    baidu::galaxy::container::ReportTracker tracker(1000);
+    ContainerInfos cis;
+    cis.push_back(NewInfo("c1", baidu::galaxy::proto::kContainerReady, 0));
+    baidu::galaxy::proto::Volum* volum = cis[0]->add_volum_used();
+    volum->set_path("/home/work");
+    volum->set_device_path("/home/disk1");
+    volum->set_used_size(1000);
+
+    int64_t seq = 0;
+    ContainerInfos changed;
+    std::vector<std::string> removed;
+    tracker.Diff(cis, 0, &seq, changed, removed);
+    int64_t first = seq;
+
+    // usage within the drift ratio is not a change
+    volum->set_used_size(1010);
+    EXPECT_TRUE(tracker.Diff(cis, first, &seq, changed, removed));
+    EXPECT_TRUE(changed.empty());
+
+    // moving to another device is
+    volum->set_device_path("/home/disk2");
+    EXPECT_TRUE(tracker.Diff(cis, first, &seq, changed, removed));
+    ASSERT_EQ(1u, changed.size());
+    EXPECT_EQ("c1", changed[0]->id());
+}
+#endif
@@ -0,0 +1,78 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_RESOURCE_MANAGER_ON
+#include "agent/resource/resource_manager.h"
+#include "protocol/galaxy.pb.h"
+#include <gflags/gflags.h>
+#include <unistd.h>
+
+DECLARE_int64(cpu_resource);
+DECLARE_int64(memory_resource);
+DECLARE_string(volum_resource);
+
+static baidu::galaxy::proto::ContainerDescription NewDesc(int64_t milli_core) {
+    baidu::galaxy::proto::ContainerDescription desc;
+    desc.set_priority(baidu::galaxy::proto::kJobService);
+    desc.mutable_workspace_volum()->set_medium(baidu::galaxy::proto::kDisk);
+    desc.mutable_workspace_volum()->set_source_path("/tmp");
+    desc.mutable_workspace_volum()->set_size(1024);
+    baidu::galaxy::proto::Cgroup* cgroup = desc.add_cgroups();
+    cgroup->mutable_cpu()->set_milli_core(milli_core);
+    cgroup->mutable_memory()->set_size(1024);
+    return desc;
+}
+
+static int64_t CpuAssigned(baidu::galaxy::resource::ResourceManager& rm) {
+    return rm.GetCpuResource()->assigned();
+}
+
+class TestResourceManager : public testing::Test {
+protected:
+    virtual void SetUp() {
+        FLAGS_cpu_resource = 4000;
+        FLAGS_memory_resource = 1024 * 1024;
+        FLAGS_volum_resource = "/:1048576:DISK:/tmp";
+        ASSERT_EQ(0, rm_.Load());
+    }
+
+    baidu::galaxy::resource::ResourceManager rm_;
+};
+
+TEST_F(TestResourceManager, ReserveAndClaim) {
+    baidu::galaxy::proto::ContainerDescription desc = NewDesc(1000);
+    EXPECT_EQ(0, rm_.Reserve("group.c1", desc, 10000).Code());
+    EXPECT_EQ(1000, CpuAssigned(rm_));
+    // reserving again renews the lease only
+    EXPECT_EQ(0, rm_.Reserve("group.c1", desc, 10000).Code());
+    EXPECT_EQ(1000, CpuAssigned(rm_));
+
+    EXPECT_TRUE(rm_.Claim("group.c1", desc));
+    EXPECT_EQ(1000, CpuAssigned(rm_));
+    EXPECT_FALSE(rm_.Claim("group.c1", desc));
+    EXPECT_EQ(0, rm_.Release(desc).Code());
+    EXPECT_EQ(0, CpuAssigned(rm_));
+
+    // a lease of another desc is given back
+    EXPECT_EQ(0, rm_.Reserve("group.c2", desc, 10000).Code());
+    EXPECT_FALSE(rm_.Claim("group.c2", NewDesc(2000)));
+    EXPECT_EQ(0, CpuAssigned(rm_));
+
+    // leases count against the capacity
+    EXPECT_EQ(0, rm_.Reserve("group.c3", NewDesc(3000), 10000).Code());
+    EXPECT_NE(0, rm_.Reserve("group.c4", NewDesc(2000), 10000).Code());
+    EXPECT_NE(0, rm_.Allocate(NewDesc(2000)).Code());
+}
+
+TEST_F(TestResourceManager, LeaseExpire) {
+    EXPECT_EQ(0, rm_.Reserve("group.c1", NewDesc(3000), 1).Code());
+    EXPECT_EQ(3000, CpuAssigned(rm_));
+    usleep(5000);
+    rm_.ExpireLeases();
+    EXPECT_EQ(0, CpuAssigned(rm_));
+    EXPECT_FALSE(rm_.Claim("group.c1", NewDesc(3000)));
+}
+#endif
@@ -21,7 +21,13 @@
 
 //#define TEST_CONTAINER_ON
 #define TEST_CONTAINER_STATUS_ON
-//#define TEST_COLLECTOR_ENGINE_ON
+#define TEST_REPORT_TRACKER_ON
+#define TEST_RESOURCE_MANAGER_ON
+#define TEST_CGROUP_COLLECTOR_ON
+#define TEST_CONTROL_FILE_ON
+#define TEST_METRIX_STORE_ON
+#define TEST_METRIX_COLLECTOR_ON
+#define TEST_COLLECTOR_ENGINE_ON
 //#define TEST_FILE_INPUT_STREAM
 //#define TEST_OUTPUT_STREAM_FILE_ON
 //#define TEST_DICT_FILE_ON
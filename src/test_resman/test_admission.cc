@@ -0,0 +1,103 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_ADMISSION_ON
+#include <set>
+#include <string>
+#include <gflags/gflags.h>
+#include "resman/admission.h"
+#include "resman/resman_impl.h"
+
+DECLARE_double(user_read_rate);
+DECLARE_int32(user_read_burst);
+
+namespace proto = baidu::galaxy::proto;
+using baidu::galaxy::Admission;
+
+TEST(TestAdmission, TokenBucket) {
+    Admission admission;
+    admission.SetLimit(Admission::kMutate, 10, 2);
+    std::set<std::string> users;
+    users.insert("alice");
+    users.insert("bob");
+    admission.SetUsers(users);
+    EXPECT_TRUE(admission.Admit("alice", Admission::kMutate, 0));
+    EXPECT_TRUE(admission.Admit("alice", Admission::kMutate, 0));
+    EXPECT_FALSE(admission.Admit("alice", Admission::kMutate, 0));
+    // one token each 100ms
+    EXPECT_FALSE(admission.Admit("alice", Admission::kMutate, 50000));
+    EXPECT_TRUE(admission.Admit("alice", Admission::kMutate, 100000));
+    // no more than the burst after a while
+    EXPECT_TRUE(admission.Admit("alice", Admission::kMutate, 10000000));
+    EXPECT_TRUE(admission.Admit("alice", Admission::kMutate, 10000000));
+    EXPECT_FALSE(admission.Admit("alice", Admission::kMutate, 10000000));
+
+    // other users and reads are on their own
+    EXPECT_TRUE(admission.Admit("bob", Admission::kMutate, 10000000));
+    EXPECT_TRUE(admission.Admit("alice", Admission::kRead, 10000000));
+
+    // unknown users share one bucket
+    EXPECT_TRUE(admission.Admit("eve1", Admission::kMutate, 0));
+    EXPECT_TRUE(admission.Admit("eve2", Admission::kMutate, 0));
+    EXPECT_FALSE(admission.Admit("eve3", Admission::kMutate, 0));
+    admission.AddUser("carol");
+    EXPECT_TRUE(admission.Admit("carol", Admission::kMutate, 0));
+}
+
+TEST(TestAdmission, KindOf) {
+    EXPECT_EQ(Admission::kRead, Admission::KindOf("Status"));
+    EXPECT_EQ(Admission::kRead, Admission::KindOf("ListContainerGroups"));
+    EXPECT_EQ(Admission::kRead, Admission::KindOf("ShowAgent"));
+    EXPECT_EQ(Admission::kRead, Admission::KindOf("GetTagsByAgent"));
+    EXPECT_EQ(Admission::kMutate, Admission::KindOf("UpdateContainerGroup"));
+    EXPECT_EQ(Admission::kMutate, Admission::KindOf("AddAgent"));
+}
+
+class AdmissionTestClosure : public google::protobuf::Closure {
+public:
+    virtual void Run() {}
+};
+
+TEST(TestAdmission, NoLimitByDefault) {
+    baidu::galaxy::ResManImpl resman(new baidu::galaxy::MemoryMetaStore(), NULL);
+    ASSERT_TRUE(resman.Init());
+    const google::protobuf::MethodDescriptor* method =
+        proto::ResMan::descriptor()->FindMethodByName("Status");
+    AdmissionTestClosure done;
+    proto::StatusRequest request;
+    request.mutable_user()->set_user("alice");
+    for (int i = 0; i < 1000; i++) {
+        proto::StatusResponse response;
+        resman.CallMethod(method, NULL, &request, &response, &done);
+        ASSERT_EQ(proto::kOk, response.error_code().status());
+    }
+}
+
+TEST(TestAdmission, Throttled) {
+    double read_rate = FLAGS_user_read_rate;
+    int32_t read_burst = FLAGS_user_read_burst;
+    FLAGS_user_read_rate = 0.001;
+    FLAGS_user_read_burst = 2;
+    baidu::galaxy::ResManImpl resman(new baidu::galaxy::MemoryMetaStore(), NULL);
+    ASSERT_TRUE(resman.Init());
+    const google::protobuf::MethodDescriptor* method =
+        proto::ResMan::descriptor()->FindMethodByName("Status");
+    AdmissionTestClosure done;
+    proto::StatusRequest request;
+    request.mutable_user()->set_user("alice");
+    for (int i = 0; i < 3; i++) {
+        proto::StatusResponse response;
+        resman.CallMethod(method, NULL, &request, &response, &done);
+        if (i < 2) {
+            EXPECT_EQ(proto::kOk, response.error_code().status());
+        } else {
+            EXPECT_EQ(proto::kThrottled, response.error_code().status());
+        }
+    }
+    FLAGS_user_read_rate = read_rate;
+    FLAGS_user_read_burst = read_burst;
+}
+#endif
@@ -0,0 +1,141 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_AGENT_SCORER_ON
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "resman/scheduler.h"
+#include "resman/agent_scorer.h"
+
+namespace sched = baidu::galaxy::sched;
+namespace proto = baidu::galaxy::proto;
+
+class TestAgentScorer : public testing::Test {
+protected:
+    void AddAgent(sched::Scheduler& scheduler, const std::string& endpoint,
+                  int64_t cpu, int64_t memory, const std::string& rack) {
+        std::map<sched::DevicePath, sched::VolumInfo> volums;
+        sched::VolumInfo& home = volums["/home"];
+        home.medium = proto::kDisk;
+        home.size = 1024L * 1024 * 1024 * 1024;
+        std::set<std::string> tags;
+        if (!rack.empty()) {
+            tags.insert(rack);
+        }
+        sched::Agent::Ptr agent(new sched::Agent(endpoint, cpu, memory,
+                                                 volums, tags, "test_pool"));
+        proto::AgentInfo agent_info;
+        scheduler.AddAgent(agent, agent_info);
+    }
+
+    proto::ContainerDescription MakeDesc(int64_t cpu, int64_t memory) {
+        proto::ContainerDescription desc;
+        desc.set_priority(proto::kJobService);
+        desc.add_pool_names("test_pool");
+        desc.mutable_workspace_volum()->set_medium(proto::kDisk);
+        desc.mutable_workspace_volum()->set_size(1024);
+        proto::Cgroup* cgroup = desc.add_cgroups();
+        cgroup->mutable_cpu()->set_milli_core(cpu);
+        cgroup->mutable_memory()->set_size(memory);
+        return desc;
+    }
+
+    // number of containers of the group on each agent
+    std::map<std::string, int> Placement(sched::Scheduler& scheduler,
+                                         const std::string& group_id) {
+        std::vector<proto::ContainerStatistics> containers;
+        scheduler.ShowContainerGroup(group_id, containers);
+        std::map<std::string, int> placement;
+        for (size_t i = 0; i < containers.size(); i++) {
+            if (!containers[i].endpoint().empty()) {
+                placement[containers[i].endpoint()]++;
+            }
+        }
+        return placement;
+    }
+};
+
+TEST_F(TestAgentScorer, ScorePolicy_Parse)
+{
+    sched::ScorePolicy policy;
+    EXPECT_TRUE(policy.Parse(""));
+    EXPECT_TRUE(policy.Empty());
+    EXPECT_TRUE(policy.Parse("least_allocated:1, rack_spread:2"));
+    EXPECT_FALSE(policy.Empty());
+    EXPECT_TRUE(policy.NeedRack());
+    EXPECT_FALSE(policy.Parse("least_allocated:x"));
+    EXPECT_FALSE(policy.Parse("no_such_scorer"));
+    // a failed parse keeps the former policy
+    EXPECT_TRUE(policy.NeedRack());
+}
+
+TEST_F(TestAgentScorer, MostAllocated_Packs)
+{
+    sched::Scheduler scheduler;
+    EXPECT_TRUE(scheduler.SetScorePolicy("test_pool", "most_allocated"));
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096, "");
+    AddAgent(scheduler, "agent_1:8221", 8000, 8192, "");
+    AddAgent(scheduler, "agent_2:8221", 4000, 4096, "");
+    std::string group_id = scheduler.Submit("job_pack", MakeDesc(1000, 1024),
+                                            4, proto::kJobService, "test");
+    EXPECT_EQ(4, scheduler.ScheduleBatch());
+    std::map<std::string, int> placement = Placement(scheduler, group_id);
+    EXPECT_EQ(1u, placement.size());
+}
+
+TEST_F(TestAgentScorer, LeastAllocated_Spreads)
+{
+    sched::Scheduler scheduler;
+    EXPECT_TRUE(scheduler.SetScorePolicy("", "least_allocated"));
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096, "");
+    AddAgent(scheduler, "agent_1:8221", 4000, 4096, "");
+    AddAgent(scheduler, "agent_2:8221", 4000, 4096, "");
+    std::string group_id = scheduler.Submit("job_spread", MakeDesc(1000, 1024),
+                                            3, proto::kJobService, "test");
+    EXPECT_EQ(3, scheduler.ScheduleBatch());
+    std::map<std::string, int> placement = Placement(scheduler, group_id);
+    EXPECT_EQ(3u, placement.size());
+}
+
+TEST_F(TestAgentScorer, RackSpread)
+{
+    sched::Scheduler scheduler;
+    EXPECT_TRUE(scheduler.SetScorePolicy("", "rack_spread:2,most_allocated:1"));
+    AddAgent(scheduler, "agent_0:8221", 8000, 8192, "rack:a");
+    AddAgent(scheduler, "agent_1:8221", 8000, 8192, "rack:a");
+    AddAgent(scheduler, "agent_2:8221", 8000, 8192, "rack:b");
+    std::string group_id = scheduler.Submit("job_rack", MakeDesc(1000, 1024),
+                                            4, proto::kJobService, "test");
+    EXPECT_EQ(4, scheduler.ScheduleBatch());
+    std::map<std::string, int> placement = Placement(scheduler, group_id);
+    EXPECT_EQ(2, placement["agent_2:8221"]);
+    EXPECT_EQ(2, placement["agent_0:8221"] + placement["agent_1:8221"]);
+}
+
+TEST_F(TestAgentScorer, AntiAffinity)
+{
+    sched::Scheduler scheduler;
+    EXPECT_TRUE(scheduler.SetScorePolicy("", "most_allocated:1,anti_affinity:4"));
+    AddAgent(scheduler, "agent_0:8221", 8000, 8192, "");
+    AddAgent(scheduler, "agent_1:8221", 8000, 8192, "");
+    std::string db = scheduler.Submit("job_db", MakeDesc(1000, 1024),
+                                      1, proto::kJobService, "test");
+    EXPECT_EQ(1, scheduler.ScheduleBatch());
+    std::map<std::string, int> db_placement = Placement(scheduler, db);
+    ASSERT_EQ(1u, db_placement.size());
+
+    proto::ContainerDescription desc = MakeDesc(1000, 1024);
+    desc.add_anti_affinity_groups(db);
+    std::string web = scheduler.Submit("job_web", desc, 2, proto::kJobService, "test");
+    EXPECT_EQ(2, scheduler.ScheduleBatch());
+    std::map<std::string, int> web_placement = Placement(scheduler, web);
+    ASSERT_EQ(1u, web_placement.size());
+    EXPECT_NE(db_placement.begin()->first, web_placement.begin()->first);
+}
+
+#endif
@@ -0,0 +1,81 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_CLUSTER_STAT_ON
+#include "resman/cluster_stat.h"
+
+namespace proto = baidu::galaxy::proto;
+
+static proto::AgentInfo MakeInfo(int64_t cpu, int64_t memory,
+                                 int64_t disk, int containers) {
+    proto::AgentInfo info;
+    info.mutable_cpu_resource()->set_total(cpu);
+    info.mutable_cpu_resource()->set_assigned(cpu / 2);
+    info.mutable_cpu_resource()->set_used(cpu / 4);
+    info.mutable_memory_resource()->set_total(memory);
+    info.mutable_memory_resource()->set_assigned(memory / 2);
+    info.mutable_memory_resource()->set_used(memory / 4);
+    proto::VolumResource* vr = info.add_volum_resources();
+    vr->set_medium(proto::kDisk);
+    vr->set_device_path("/home");
+    vr->mutable_volum()->set_total(disk);
+    vr->mutable_volum()->set_assigned(disk / 2);
+    vr->mutable_volum()->set_used(0);
+    for (int i = 0; i < containers; i++) {
+        info.add_container_info();
+    }
+    return info;
+}
+
+TEST(TestClusterStat, Incremental) {
+    baidu::galaxy::ClusterStat stat;
+    proto::AgentInfo info1 = MakeInfo(1000, 4096, 100, 2);
+    proto::AgentInfo info2 = MakeInfo(2000, 8192, 200, 3);
+    stat.Add("main", proto::kAgentAlive, info1, 1);
+    stat.Add("test", proto::kAgentAlive, info2, 1);
+
+    proto::StatusResponse status;
+    stat.Fill(&status);
+    EXPECT_EQ(3000, status.cpu().total());
+    EXPECT_EQ(1500, status.cpu().assigned());
+    EXPECT_EQ(12288, status.memory().total());
+    EXPECT_EQ(2, status.alive_agents());
+    EXPECT_EQ(0, status.dead_agents());
+    EXPECT_EQ(5, status.total_containers());
+    ASSERT_EQ(1, status.volum_size());
+    EXPECT_EQ(300, status.volum(0).volum().total());
+    EXPECT_EQ(proto::kDisk, status.volum(0).medium());
+    ASSERT_EQ(2, status.pools_size());
+    EXPECT_EQ("main", status.pools(0).name());
+    EXPECT_EQ(1, status.pools(0).alive_agents());
+
+    // agent2 dies with a new report
+    proto::AgentInfo info2_new = MakeInfo(2000, 8192, 200, 1);
+    stat.Add("test", proto::kAgentAlive, info2, -1);
+    stat.Add("test", proto::kAgentDead, info2_new, 1);
+    status.Clear();
+    stat.Fill(&status);
+    EXPECT_EQ(1, status.alive_agents());
+    EXPECT_EQ(1, status.dead_agents());
+    EXPECT_EQ(3, status.total_containers());
+    ASSERT_EQ(2, status.pools_size());
+    EXPECT_EQ(1, status.pools(1).total_agents());
+    EXPECT_EQ(0, status.pools(1).alive_agents());
+
+    // removing every agent leaves nothing behind
+    stat.Add("main", proto::kAgentAlive, info1, -1);
+    stat.Add("test", proto::kAgentDead, info2_new, -1);
+    status.Clear();
+    stat.Fill(&status);
+    EXPECT_EQ(0, status.cpu().total());
+    EXPECT_EQ(0, status.alive_agents());
+    EXPECT_EQ(0, status.dead_agents());
+    EXPECT_EQ(0, status.total_containers());
+    EXPECT_EQ(0, status.volum_size());
+    EXPECT_EQ(0, status.pools_size());
+}
+
+#endif
@@ -0,0 +1,217 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_META_CODEC_ON
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include "meta_codec.h"
+#include "resman/resman_impl.h"
+
+DECLARE_string(nexus_root);
+DECLARE_bool(meta_compact_encoding);
+
+namespace proto = baidu::galaxy::proto;
+using baidu::galaxy::MetaCodec;
+using baidu::galaxy::DescRefs;
+
+TEST(TestMetaCodec, EncodeDecode) {
+    std::string payload(4096, 'x');
+    std::string record;
+    std::string decoded;
+    MetaCodec::Encode(payload, 512, &record);
+    EXPECT_TRUE(MetaCodec::IsEncoded(record));
+    EXPECT_LT(record.size(), payload.size());
+    ASSERT_TRUE(MetaCodec::Decode(record, &decoded));
+    EXPECT_EQ(payload, decoded);
+
+    // short ones are kept as they are
+    MetaCodec::Encode("abc", 512, &record);
+    EXPECT_EQ(6u, record.size());
+    ASSERT_TRUE(MetaCodec::Decode(record, &decoded));
+    EXPECT_EQ("abc", decoded);
+    MetaCodec::Encode(payload, -1, &record);
+    EXPECT_EQ(payload.size() + 3, record.size());
+
+    // written before the encoding
+    proto::TagMeta tag;
+    tag.set_tag("ssd");
+    tag.add_endpoints("agent1:1646");
+    std::string legacy = tag.SerializeAsString();
+    EXPECT_FALSE(MetaCodec::IsEncoded(legacy));
+    ASSERT_TRUE(MetaCodec::Decode(legacy, &decoded));
+    EXPECT_EQ(legacy, decoded);
+
+    // from a later schema
+    record[1] = static_cast<char>(MetaCodec::kSchemaVersion + 1);
+    EXPECT_FALSE(MetaCodec::Decode(record, &decoded));
+}
+
+TEST(TestMetaCodec, Digest) {
+    EXPECT_EQ(MetaCodec::Digest("desc"), MetaCodec::Digest("desc"));
+    EXPECT_NE(MetaCodec::Digest("desc"), MetaCodec::Digest("dese"));
+    EXPECT_NE(MetaCodec::Digest(""), MetaCodec::Digest(std::string(1, '\0')));
+    // sha-256
+    EXPECT_EQ("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+              MetaCodec::Digest(""));
+    EXPECT_EQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+              MetaCodec::Digest("abc"));
+    EXPECT_EQ("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+              MetaCodec::Digest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+    EXPECT_EQ("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+              MetaCodec::Digest(std::string(1000000, 'a')));
+}
+
+TEST(TestDescRefs, Assign) {
+    DescRefs refs;
+    std::set<std::string> a;
+    a.insert("a");
+    std::set<std::string> b;
+    b.insert("b");
+    std::vector<std::string> added;
+    std::vector<std::string> released;
+    refs.Assign("g1", a, &added, &released);
+    ASSERT_EQ(1u, added.size());
+    EXPECT_EQ("a", added[0]);
+    EXPECT_TRUE(released.empty());
+
+    added.clear();
+    refs.Assign("g2", a, &added, &released);
+    EXPECT_TRUE(added.empty());
+    EXPECT_EQ(2, refs.Count("a"));
+
+    // shared with g2, not released
+    refs.Assign("g1", b, &added, &released);
+    ASSERT_EQ(1u, added.size());
+    EXPECT_EQ("b", added[0]);
+    EXPECT_TRUE(released.empty());
+
+    refs.Assign("g2", std::set<std::string>(), &added, &released);
+    ASSERT_EQ(1u, released.size());
+    EXPECT_EQ("a", released[0]);
+    EXPECT_EQ(0, refs.Count("a"));
+    std::set<std::string> digests;
+    refs.Get("g1", &digests);
+    EXPECT_EQ(b, digests);
+}
+
+// the resman under test owns its store, the test keeps looking into it
+class ForwardMetaStore : public baidu::galaxy::MetaStore {
+public:
+    explicit ForwardMetaStore(baidu::galaxy::MemoryMetaStore* store) : store_(store) {}
+    virtual bool Put(const std::string& key, const std::string& value) {
+        return store_->Put(key, value);
+    }
+    virtual bool Delete(const std::string& key) {
+        return store_->Delete(key);
+    }
+    virtual bool Scan(const std::string& start, const std::string& end,
+                      std::map<std::string, std::string>& kvs) {
+        return store_->Scan(start, end, kvs);
+    }
+private:
+    baidu::galaxy::MemoryMetaStore* store_;
+};
+
+class NoopTransport : public baidu::galaxy::AgentTransport {
+public:
+    virtual void Query(const std::string& endpoint,
+                       const proto::QueryRequest* request,
+                       proto::QueryResponse* response,
+                       QueryCallback callback) {
+        callback(request, response, true, 0);
+    }
+    virtual void CreateContainer(const std::string& endpoint,
+                                 const proto::CreateContainerRequest* request,
+                                 proto::CreateContainerResponse* response,
+                                 CreateContainerCallback callback) {
+        callback(request, response, true, 0);
+    }
+    virtual void RemoveContainer(const std::string& endpoint,
+                                 const proto::RemoveContainerRequest* request,
+                                 proto::RemoveContainerResponse* response,
+                                 RemoveContainerCallback callback) {
+        callback(request, response, true, 0);
+    }
+    virtual void BatchCommand(const std::string& endpoint,
+                              const proto::BatchCommandRequest* request,
+                              proto::BatchCommandResponse* response,
+                              BatchCommandCallback callback) {
+        callback(request, response, true, 0);
+    }
+    virtual void Reserve(const std::string& endpoint,
+                         const proto::ReserveRequest* request,
+                         proto::ReserveResponse* response,
+                         ReserveCallback callback) {
+        callback(request, response, true, 0);
+    }
+};
+
+class DoneClosure : public google::protobuf::Closure {
+public:
+    virtual void Run() {}
+};
+
+TEST(TestMetaCodec, MigrateContainerGroups) {
+    bool compact_encoding = FLAGS_meta_compact_encoding;
+    FLAGS_meta_compact_encoding = true;
+    baidu::galaxy::MemoryMetaStore store;
+    const std::string group_prefix = FLAGS_nexus_root + "/container_group/";
+    const std::string desc_prefix = FLAGS_nexus_root + "/container_group_desc/";
+    proto::ContainerGroupMeta meta;
+    meta.set_name("group");
+    meta.set_user_name("galaxy");
+    meta.set_replica(0);
+    meta.set_status(proto::kContainerGroupNormal);
+    meta.mutable_desc()->set_cmd_line(std::string(1024, 'c'));
+    meta.mutable_desc()->set_version("1");
+    meta.mutable_desc()->add_pool_names("main");
+    meta.set_id("group_1");
+    store.Put(group_prefix + "group_1", meta.SerializeAsString());
+    meta.set_id("group_2");
+    store.Put(group_prefix + "group_2", meta.SerializeAsString());
+    store.Put(desc_prefix + "orphan", "");
+    store.Put(FLAGS_nexus_root + "/tag/ssd", proto::TagMeta().SerializeAsString());
+
+    {
+        baidu::galaxy::ResManImpl resman(new ForwardMetaStore(&store), new NoopTransport());
+        ASSERT_TRUE(resman.Init());
+        resman.MigrateMeta();
+    }
+    std::string value;
+    std::string payload;
+    ASSERT_TRUE(store.Get(FLAGS_nexus_root + "/tag/ssd", &value));
+    EXPECT_TRUE(MetaCodec::IsEncoded(value));
+    EXPECT_FALSE(store.Get(desc_prefix + "orphan", &value));
+
+    // both groups refer to one desc
+    std::map<std::string, std::string> descs;
+    ASSERT_TRUE(store.Scan(desc_prefix, desc_prefix + "\xff", descs));
+    ASSERT_EQ(1u, descs.size());
+    for (int i = 1; i <= 2; i++) {
+        ASSERT_TRUE(store.Get(group_prefix + "group_" + std::string(1, '0' + i), &value));
+        ASSERT_TRUE(MetaCodec::IsEncoded(value));
+        ASSERT_TRUE(MetaCodec::Decode(value, &payload));
+        proto::ContainerGroupMeta record;
+        ASSERT_TRUE(record.ParseFromString(payload));
+        EXPECT_FALSE(record.has_desc());
+        EXPECT_EQ(desc_prefix + record.desc_digest(), descs.begin()->first);
+    }
+    EXPECT_LT(descs.begin()->second.size(), meta.desc().SerializeAsString().size());
+
+    baidu::galaxy::ResManImpl resman(new ForwardMetaStore(&store), new NoopTransport());
+    ASSERT_TRUE(resman.Init());
+    proto::ShowContainerGroupRequest request;
+    proto::ShowContainerGroupResponse response;
+    DoneClosure done;
+    request.set_id("group_2");
+    resman.ShowContainerGroup(NULL, &request, &response, &done);
+    EXPECT_EQ(meta.desc().SerializeAsString(), response.desc().SerializeAsString());
+    FLAGS_meta_compact_encoding = compact_encoding;
+}
+#endif
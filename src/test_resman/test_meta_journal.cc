@@ -0,0 +1,185 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_META_JOURNAL_ON
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gflags/gflags.h>
+#include "resman/meta_journal.h"
+
+DECLARE_int64(meta_flush_interval);
+
+namespace galaxy = baidu::galaxy;
+
+class TestMetaJournal : public testing::Test {
+protected:
+    virtual void SetUp() {
+        path_ = "test_meta_journal.journal";
+        unlink(path_.c_str());
+        // flush by hand only
+        FLAGS_meta_flush_interval = 3600 * 1000;
+    }
+    virtual void TearDown() {
+        unlink(path_.c_str());
+    }
+    std::string path_;
+};
+
+TEST_F(TestMetaJournal, WriteBehind) {
+    galaxy::MemoryMetaStore store;
+    galaxy::MetaJournal journal(&store, path_);
+    ASSERT_TRUE(journal.Open("/epoch", "e1"));
+    journal.Flush();
+    int64_t writes = store.WriteCount();
+    EXPECT_TRUE(journal.Put("/user/a", "1"));
+    EXPECT_TRUE(journal.Put("/user/a", "2"));
+    EXPECT_TRUE(journal.Put("/user/b", "1"));
+    EXPECT_TRUE(journal.Delete("/user/b"));
+
+    // seen before reaching the store
+    std::string value;
+    EXPECT_FALSE(store.Get("/user/a", &value));
+    std::map<std::string, std::string> kvs;
+    EXPECT_TRUE(journal.Scan("/user/", "/user/\xff", kvs));
+    ASSERT_EQ(1u, kvs.size());
+    EXPECT_EQ("2", kvs["/user/a"]);
+
+    // coalesced, one write for each key
+    EXPECT_TRUE(journal.Flush());
+    EXPECT_EQ(0u, journal.PendingSize());
+    EXPECT_EQ(writes + 2, store.WriteCount());
+    EXPECT_TRUE(store.Get("/user/a", &value));
+    EXPECT_EQ("2", value);
+    EXPECT_FALSE(store.Get("/user/b", &value));
+}
+
+TEST_F(TestMetaJournal, ReplayAndRetry) {
+    galaxy::MemoryMetaStore store;
+    store.Put("/tag/old", "x");
+    {
+        galaxy::MetaJournal journal(&store, path_);
+        ASSERT_TRUE(journal.Open("/epoch", "e1"));
+        store.SetAvailable(false);
+        EXPECT_TRUE(journal.Put("/tag/t1", "a"));
+        EXPECT_TRUE(journal.Delete("/tag/old"));
+        EXPECT_FALSE(journal.Flush());
+        EXPECT_EQ(2u, journal.PendingSize());
+    }
+
+    // restarted, writes acknowledged before come back from the journal
+    store.SetAvailable(true);
+    galaxy::MetaJournal journal(&store, path_);
+    ASSERT_TRUE(journal.Open("/epoch", "e2"));
+    EXPECT_EQ(2u, journal.PendingSize());
+    std::map<std::string, std::string> kvs;
+    EXPECT_TRUE(journal.Scan("/tag/", "/tag/\xff", kvs));
+    ASSERT_EQ(1u, kvs.size());
+    EXPECT_EQ("a", kvs["/tag/t1"]);
+
+    EXPECT_TRUE(journal.Flush());
+    EXPECT_EQ(0u, journal.PendingSize());
+    std::string value;
+    EXPECT_TRUE(store.Get("/tag/t1", &value));
+    EXPECT_FALSE(store.Get("/tag/old", &value));
+}
+
+TEST_F(TestMetaJournal, NotLeaderNoFlush) {
+    galaxy::MemoryMetaStore store;
+    store.Put("/user/a", "1");
+    {
+        galaxy::MetaJournal journal(&store, path_);
+        ASSERT_TRUE(journal.Open("/epoch", "e1"));
+        store.SetAvailable(false);
+        EXPECT_TRUE(journal.Put("/user/a", "2"));
+        EXPECT_FALSE(journal.Flush());
+    }
+    store.SetAvailable(true);
+    int64_t writes = store.WriteCount();
+
+    // waits for the lock, the journal left is neither replayed nor flushed
+    galaxy::MetaJournal journal(&store, path_);
+    EXPECT_FALSE(journal.Put("/user/a", "3"));
+    EXPECT_EQ(0u, journal.PendingSize());
+    std::map<std::string, std::string> kvs;
+    EXPECT_TRUE(journal.Scan("/user/", "/user/\xff", kvs));
+    EXPECT_EQ("1", kvs["/user/a"]);
+    EXPECT_TRUE(journal.Flush());
+    EXPECT_EQ(writes, store.WriteCount());
+    std::string value;
+    EXPECT_TRUE(store.Get("/user/a", &value));
+    EXPECT_EQ("1", value);
+}
+
+TEST_F(TestMetaJournal, StaleJournalDropped) {
+    galaxy::MemoryMetaStore store;
+    {
+        galaxy::MetaJournal journal(&store, path_);
+        ASSERT_TRUE(journal.Open("/epoch", "e1"));
+        store.SetAvailable(false);
+        EXPECT_TRUE(journal.Put("/user/a", "stale"));
+        EXPECT_FALSE(journal.Flush());
+    }
+    store.SetAvailable(true);
+
+    // another leader has written the store since
+    {
+        galaxy::MetaJournal journal(&store, "");
+        ASSERT_TRUE(journal.Open("/epoch", "e2"));
+        EXPECT_TRUE(journal.Put("/user/a", "leader"));
+    }
+
+    galaxy::MetaJournal journal(&store, path_);
+    ASSERT_TRUE(journal.Open("/epoch", "e3"));
+    EXPECT_EQ(0u, journal.PendingSize());
+    EXPECT_TRUE(journal.Flush());
+    std::string value;
+    EXPECT_TRUE(store.Get("/user/a", &value));
+    EXPECT_EQ("leader", value);
+    EXPECT_TRUE(store.Get("/epoch", &value));
+    EXPECT_EQ("e3", value);
+}
+
+static ino_t Inode(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return 0;
+    }
+    return st.st_ino;
+}
+
+TEST_F(TestMetaJournal, IdleFlushKeepsJournal) {
+    galaxy::MemoryMetaStore store;
+    galaxy::MetaJournal journal(&store, path_);
+    ASSERT_TRUE(journal.Open("/epoch", "e1"));
+    EXPECT_TRUE(journal.Put("/user/a", "1"));
+    EXPECT_TRUE(journal.Flush());
+    ino_t drained = Inode(path_);
+    ASSERT_NE(0u, drained);
+
+    // nothing written since, the journal is not rewritten
+    EXPECT_TRUE(journal.Flush());
+    EXPECT_TRUE(journal.Flush());
+    EXPECT_EQ(drained, Inode(path_));
+
+    EXPECT_TRUE(journal.Put("/user/a", "2"));
+    EXPECT_TRUE(journal.Flush());
+    EXPECT_NE(drained, Inode(path_));
+}
+
+TEST_F(TestMetaJournal, WriteThrough) {
+    galaxy::MemoryMetaStore store;
+    galaxy::MetaJournal journal(&store, "");
+    ASSERT_TRUE(journal.Open("/epoch", "e1"));
+    EXPECT_TRUE(journal.Put("/agent/a", "1"));
+    EXPECT_EQ(0u, journal.PendingSize());
+    std::string value;
+    EXPECT_TRUE(store.Get("/agent/a", &value));
+    store.SetAvailable(false);
+    EXPECT_FALSE(journal.Put("/agent/a", "2"));
+}
+#endif
@@ -0,0 +1,476 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_RESMAN_STANDBY_ON
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <gflags/gflags.h>
+#include <boost/scoped_ptr.hpp>
+#include "resman/resman_impl.h"
+
+DECLARE_int32(agent_query_interval);
+DECLARE_int32(agent_query_min_interval);
+DECLARE_int64(standby_sync_interval);
+DECLARE_bool(agent_batch_command);
+DECLARE_int32(agent_timeout);
+
+namespace proto = baidu::galaxy::proto;
+
+// leader and standby share the store, each one owns its own front
+class SharedMetaStore : public baidu::galaxy::MetaStore {
+public:
+    explicit SharedMetaStore(baidu::galaxy::MemoryMetaStore* store) : store_(store) {}
+    virtual bool Put(const std::string& key, const std::string& value) {
+        return store_->Put(key, value);
+    }
+    virtual bool Delete(const std::string& key) {
+        return store_->Delete(key);
+    }
+    virtual bool Scan(const std::string& start, const std::string& end,
+                      std::map<std::string, std::string>& kvs) {
+        return store_->Scan(start, end, kvs);
+    }
+private:
+    baidu::galaxy::MemoryMetaStore* store_;
+};
+
+// answers queries at once with the report set for the agent
+class StubAgentTransport : public baidu::galaxy::AgentTransport {
+public:
+    StubAgentTransport() : commands_(0), removes_(0), fail_batch_(false) {}
+
+    // as an agent not knowing the batch rpc
+    void FailBatch() {
+        baidu::common::MutexLock lock(&mu_);
+        fail_batch_ = true;
+    }
+
+    void SetReport(const std::string& endpoint, const proto::AgentInfo& info) {
+        baidu::common::MutexLock lock(&mu_);
+        reports_[endpoint] = info;
+    }
+
+    int64_t Commands() {
+        baidu::common::MutexLock lock(&mu_);
+        return commands_;
+    }
+
+    int64_t Removes() {
+        baidu::common::MutexLock lock(&mu_);
+        return removes_;
+    }
+
+    virtual void Query(const std::string& endpoint,
+                       const proto::QueryRequest* request,
+                       proto::QueryResponse* response,
+                       QueryCallback callback) {
+        bool found = false;
+        {
+            baidu::common::MutexLock lock(&mu_);
+            std::map<std::string, proto::AgentInfo>::const_iterator it = reports_.find(endpoint);
+            if (it != reports_.end()) {
+                response->mutable_agent_info()->CopyFrom(it->second);
+                found = true;
+            }
+        }
+        // as the agent, the version of descriptions only but in full reports
+        proto::AgentInfo* info = response->mutable_agent_info();
+        for (int i = 0; found && !request->full_report() && i < info->container_info_size(); i++) {
+            proto::ContainerDescription* desc = info->mutable_container_info(i)->mutable_container_desc();
+            std::string version = desc->version();
+            desc->Clear();
+            desc->set_version(version);
+        }
+        response->mutable_code()->set_status(found ? proto::kOk : proto::kError);
+        callback(request, response, !found, 0);
+    }
+
+    virtual void CreateContainer(const std::string& endpoint,
+                                 const proto::CreateContainerRequest* request,
+                                 proto::CreateContainerResponse* response,
+                                 CreateContainerCallback callback) {
+        Command();
+        response->mutable_code()->set_status(proto::kOk);
+        callback(request, response, false, 0);
+    }
+
+    virtual void RemoveContainer(const std::string& endpoint,
+                                 const proto::RemoveContainerRequest* request,
+                                 proto::RemoveContainerResponse* response,
+                                 RemoveContainerCallback callback) {
+        Command();
+        {
+            baidu::common::MutexLock lock(&mu_);
+            removes_++;
+        }
+        response->mutable_code()->set_status(proto::kOk);
+        callback(request, response, false, 0);
+    }
+
+    virtual void BatchCommand(const std::string& endpoint,
+                              const proto::BatchCommandRequest* request,
+                              proto::BatchCommandResponse* response,
+                              BatchCommandCallback callback) {
+        bool fail_batch = false;
+        {
+            baidu::common::MutexLock lock(&mu_);
+            fail_batch = fail_batch_;
+        }
+        if (fail_batch) {
+            response->mutable_code()->set_status(proto::kError);
+            callback(request, response, true, 0);
+            return;
+        }
+        Command();
+        response->mutable_code()->set_status(proto::kOk);
+        for (int i = 0; i < request->commands_size(); i++) {
+            response->add_results()->set_status(proto::kOk);
+        }
+        callback(request, response, false, 0);
+    }
+
+    virtual void Reserve(const std::string& endpoint,
+                         const proto::ReserveRequest* request,
+                         proto::ReserveResponse* response,
+                         ReserveCallback callback) {
+        response->mutable_code()->set_status(proto::kOk);
+        for (int i = 0; i < request->containers_size(); i++) {
+            response->add_results()->set_status(proto::kOk);
+        }
+        callback(request, response, false, 0);
+    }
+
+private:
+    void Command() {
+        baidu::common::MutexLock lock(&mu_);
+        commands_++;
+    }
+    baidu::common::Mutex mu_;
+    std::map<std::string, proto::AgentInfo> reports_;
+    int64_t commands_;
+    int64_t removes_;
+    bool fail_batch_;
+};
+
+class NoopClosure : public google::protobuf::Closure {
+public:
+    virtual void Run() {}
+};
+
+class TestResManStandby : public testing::Test {
+protected:
+    virtual void SetUp() {
+        agent_query_interval_ = FLAGS_agent_query_interval;
+        agent_query_min_interval_ = FLAGS_agent_query_min_interval;
+        standby_sync_interval_ = FLAGS_standby_sync_interval;
+        agent_batch_command_ = FLAGS_agent_batch_command;
+        agent_timeout_ = FLAGS_agent_timeout;
+        FLAGS_agent_query_interval = 1;
+        FLAGS_agent_query_min_interval = 100;
+        FLAGS_standby_sync_interval = 100;
+    }
+
+    virtual void TearDown() {
+        FLAGS_agent_query_interval = agent_query_interval_;
+        FLAGS_agent_query_min_interval = agent_query_min_interval_;
+        FLAGS_standby_sync_interval = standby_sync_interval_;
+        FLAGS_agent_batch_command = agent_batch_command_;
+        FLAGS_agent_timeout = agent_timeout_;
+    }
+
+    static proto::ContainerInfo* AddContainer(proto::AgentInfo* info,
+                                              const std::string& id,
+                                              const std::string& version,
+                                              int64_t milli_core) {
+        proto::ContainerInfo* container = info->add_container_info();
+        container->set_id(id);
+        container->set_group_id("group1");
+        container->set_created_time(1);
+        container->set_status(proto::kContainerReady);
+        proto::ContainerDescription* desc = container->mutable_container_desc();
+        desc->set_version(version);
+        desc->add_cgroups()->mutable_cpu()->set_milli_core(milli_core);
+        return container;
+    }
+
+    static proto::ShowAgentResponse ShowAgent(baidu::galaxy::ResManImpl* resman,
+                                              const std::string& endpoint) {
+        proto::ShowAgentRequest request;
+        proto::ShowAgentResponse response;
+        NoopClosure done;
+        request.set_endpoint(endpoint);
+        resman->ShowAgent(NULL, &request, &response, &done);
+        return response;
+    }
+
+    static proto::AgentInfo Report(const std::string& container_group_id) {
+        proto::AgentInfo info;
+        info.mutable_cpu_resource()->set_total(16000);
+        info.mutable_memory_resource()->set_total(64LL << 30);
+        if (!container_group_id.empty()) {
+            proto::ContainerInfo* container = info.add_container_info();
+            container->set_id(container_group_id + ".vm_0");
+            container->set_group_id(container_group_id);
+            container->set_status(proto::kContainerReady);
+        }
+        return info;
+    }
+
+    static void AddAgent(baidu::galaxy::ResManImpl* resman, const std::string& endpoint) {
+        proto::AddAgentRequest request;
+        proto::AddAgentResponse response;
+        NoopClosure done;
+        request.set_endpoint(endpoint);
+        request.set_pool("main");
+        resman->AddAgent(NULL, &request, &response, &done);
+        ASSERT_EQ(proto::kOk, response.error_code().status());
+    }
+
+    static proto::StatusResponse Status(baidu::galaxy::ResManImpl* resman) {
+        proto::StatusRequest request;
+        proto::StatusResponse response;
+        NoopClosure done;
+        resman->Status(NULL, &request, &response, &done);
+        return response;
+    }
+
+    // polls for up to 5 seconds
+    template <class Predicate>
+    static bool WaitFor(Predicate predicate) {
+        for (int i = 0; i < 500; i++) {
+            if (predicate()) {
+                return true;
+            }
+            usleep(10000);
+        }
+        return false;
+    }
+
+    int32_t agent_query_interval_;
+    int32_t agent_query_min_interval_;
+    int64_t standby_sync_interval_;
+    bool agent_batch_command_;
+    int32_t agent_timeout_;
+};
+
+struct ReportedAgents {
+    baidu::galaxy::ResManImpl* resman;
+    uint32_t count;
+    bool operator()() {
+        proto::StatusRequest request;
+        proto::StatusResponse response;
+        NoopClosure done;
+        resman->Status(NULL, &request, &response, &done);
+        // the resource of an agent is known from its report
+        return response.total_agents() == count && response.alive_agents() == count
+               && response.cpu().total() == count * 16000;
+    }
+};
+
+struct ReportedResource {
+    baidu::galaxy::ResManImpl* resman;
+    int64_t cpu;
+    bool operator()() {
+        proto::StatusRequest request;
+        proto::StatusResponse response;
+        NoopClosure done;
+        resman->Status(NULL, &request, &response, &done);
+        return response.cpu().total() == cpu;
+    }
+};
+
+struct CommandSent {
+    StubAgentTransport* transport;
+    bool operator()() {
+        return transport->Commands() > 0;
+    }
+};
+
+struct ShownContainers {
+    baidu::galaxy::ResManImpl* resman;
+    int count;
+    bool operator()() {
+        proto::ShowAgentRequest request;
+        proto::ShowAgentResponse response;
+        NoopClosure done;
+        request.set_endpoint("agent1:1646");
+        resman->ShowAgent(NULL, &request, &response, &done);
+        return response.containers_size() == count;
+    }
+};
+
+struct DeadAgents {
+    baidu::galaxy::ResManImpl* resman;
+    uint32_t count;
+    bool operator()() {
+        proto::StatusRequest request;
+        proto::StatusResponse response;
+        NoopClosure done;
+        resman->Status(NULL, &request, &response, &done);
+        return response.dead_agents() == count;
+    }
+};
+
+struct RemoveSent {
+    StubAgentTransport* transport;
+    bool operator()() {
+        return transport->Removes() > 0;
+    }
+};
+
+TEST_F(TestResManStandby, FollowAndTakeOver) {
+    baidu::galaxy::MemoryMetaStore store;
+    boost::scoped_ptr<baidu::galaxy::ResManImpl> leader(
+        new baidu::galaxy::ResManImpl(new SharedMetaStore(&store), new StubAgentTransport()));
+    ASSERT_TRUE(leader->Init());
+    AddAgent(leader.get(), "agent1:1646");
+    AddAgent(leader.get(), "agent2:1646");
+
+    StubAgentTransport* transport = new StubAgentTransport();
+    // a container the leader does not know of
+    transport->SetReport("agent1:1646", Report("unknown_group"));
+    transport->SetReport("agent2:1646", Report(""));
+    transport->SetReport("agent3:1646", Report(""));
+    boost::scoped_ptr<baidu::galaxy::ResManImpl> standby(
+        new baidu::galaxy::ResManImpl(new SharedMetaStore(&store), transport));
+    ASSERT_TRUE(standby->Init());
+    standby->StartStandby();
+
+    // written by the leader after the standby started
+    AddAgent(leader.get(), "agent3:1646");
+    ReportedAgents reported = {standby.get(), 3};
+    ASSERT_TRUE(WaitFor(reported));
+    EXPECT_TRUE(Status(standby.get()).in_safe_mode());
+    EXPECT_EQ(0, transport->Commands());
+
+    // no wait for agents to report again
+    standby->TakeOver();
+    EXPECT_FALSE(Status(standby.get()).in_safe_mode());
+    EXPECT_EQ(3u, Status(standby.get()).alive_agents());
+    CommandSent sent = {transport};
+    EXPECT_TRUE(WaitFor(sent));
+}
+
+TEST_F(TestResManStandby, SilentAgentKeepsSafeMode) {
+    baidu::galaxy::MemoryMetaStore store;
+    boost::scoped_ptr<baidu::galaxy::ResManImpl> leader(
+        new baidu::galaxy::ResManImpl(new SharedMetaStore(&store), new StubAgentTransport()));
+    ASSERT_TRUE(leader->Init());
+    AddAgent(leader.get(), "agent1:1646");
+    AddAgent(leader.get(), "agent2:1646");
+
+    // agent2 never answers the standby
+    StubAgentTransport* transport = new StubAgentTransport();
+    transport->SetReport("agent1:1646", Report("unknown_group"));
+    boost::scoped_ptr<baidu::galaxy::ResManImpl> standby(
+        new baidu::galaxy::ResManImpl(new SharedMetaStore(&store), transport));
+    ASSERT_TRUE(standby->Init());
+    standby->StartStandby();
+    ReportedResource reported = {standby.get(), 16000};
+    ASSERT_TRUE(WaitFor(reported));
+    EXPECT_EQ(2u, Status(standby.get()).alive_agents());
+
+    // the containers of agent2 are unknown, placing them again runs them twice
+    standby->TakeOver();
+    EXPECT_TRUE(Status(standby.get()).in_safe_mode());
+    usleep(300000);
+    EXPECT_TRUE(Status(standby.get()).in_safe_mode());
+    EXPECT_EQ(0, transport->Commands());
+}
+
+TEST_F(TestResManStandby, FailedBatchResentOneByOne) {
+    FLAGS_agent_batch_command = true;
+    baidu::galaxy::MemoryMetaStore store;
+    boost::scoped_ptr<baidu::galaxy::ResManImpl> leader(
+        new baidu::galaxy::ResManImpl(new SharedMetaStore(&store), new StubAgentTransport()));
+    ASSERT_TRUE(leader->Init());
+    AddAgent(leader.get(), "agent1:1646");
+
+    StubAgentTransport* transport = new StubAgentTransport();
+    transport->FailBatch();
+    transport->SetReport("agent1:1646", Report("unknown_group"));
+    boost::scoped_ptr<baidu::galaxy::ResManImpl> resman(
+        new baidu::galaxy::ResManImpl(new SharedMetaStore(&store), transport));
+    ASSERT_TRUE(resman->Init());
+    resman->StartStandby();
+    ReportedAgents reported = {resman.get(), 1};
+    ASSERT_TRUE(WaitFor(reported));
+
+    // the container of the unknown group is removed all the same
+    resman->TakeOver();
+    RemoveSent sent = {transport};
+    EXPECT_TRUE(WaitFor(sent));
+}
+TEST_F(TestResManStandby, DeadAgentFoundBetweenQueries) {
+    FLAGS_agent_timeout = 1;
+    // no query in the time of the test after the first one
+    FLAGS_agent_query_min_interval = 60 * 1000;
+    baidu::galaxy::MemoryMetaStore store;
+    StubAgentTransport* transport = new StubAgentTransport();
+    transport->SetReport("agent1:1646", Report(""));
+    boost::scoped_ptr<baidu::galaxy::ResManImpl> resman(
+        new baidu::galaxy::ResManImpl(new SharedMetaStore(&store), transport));
+    ASSERT_TRUE(resman->Init());
+    AddAgent(resman.get(), "agent1:1646");
+    proto::KeepAliveRequest request;
+    proto::KeepAliveResponse response;
+    NoopClosure done;
+    request.set_endpoint("agent1:1646");
+    resman->KeepAlive(NULL, &request, &response, &done);
+    ReportedAgents reported = {resman.get(), 1};
+    ASSERT_TRUE(WaitFor(reported));
+
+    // no heartbeat any more
+    DeadAgents dead = {resman.get(), 1};
+    EXPECT_TRUE(WaitFor(dead));
+}
+
+TEST_F(TestResManStandby, StandbyKeepsDescriptions) {
+    baidu::galaxy::MemoryMetaStore store;
+    proto::ContainerGroupMeta group;
+    group.set_id("group1");
+    group.set_replica(2);
+    group.mutable_desc()->set_version("v2");
+    group.mutable_desc()->add_pool_names("main");
+    group.mutable_desc()->add_cgroups()->mutable_cpu()->set_milli_core(500);
+    store.Put("/galaxy3/container_group/group1", group.SerializeAsString());
+    boost::scoped_ptr<baidu::galaxy::ResManImpl> leader(
+        new baidu::galaxy::ResManImpl(new SharedMetaStore(&store), new StubAgentTransport()));
+    ASSERT_TRUE(leader->Init());
+    AddAgent(leader.get(), "agent1:1646");
+
+    // containers of an older version, their own descriptions count
+    StubAgentTransport* transport = new StubAgentTransport();
+    proto::AgentInfo report = Report("");
+    AddContainer(&report, "group1.vm_0", "v1", 1000);
+    transport->SetReport("agent1:1646", report);
+    boost::scoped_ptr<baidu::galaxy::ResManImpl> standby(
+        new baidu::galaxy::ResManImpl(new SharedMetaStore(&store), transport));
+    ASSERT_TRUE(standby->Init());
+    standby->StartStandby();
+    ShownContainers one = {standby.get(), 1};
+    ASSERT_TRUE(WaitFor(one));
+
+    // a new container, not known from a full report yet
+    AddContainer(&report, "group1.vm_1", "v1", 1000);
+    transport->SetReport("agent1:1646", report);
+    ShownContainers two = {standby.get(), 2};
+    ASSERT_TRUE(WaitFor(two));
+    proto::ShowAgentResponse shown = ShowAgent(standby.get(), "agent1:1646");
+    for (int i = 0; i < shown.containers_size(); i++) {
+        EXPECT_EQ(1000, shown.containers(i).cpu().assigned());
+    }
+
+    // the known one again, from a report without descriptions
+    report.mutable_container_info()->RemoveLast();
+    transport->SetReport("agent1:1646", report);
+    ASSERT_TRUE(WaitFor(one));
+    shown = ShowAgent(standby.get(), "agent1:1646");
+    ASSERT_EQ(1, shown.containers_size());
+    EXPECT_EQ(1000, shown.containers(0).cpu().assigned());
+}
+#endif
@@ -0,0 +1,57 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_RPC_RECORDER_ON
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include "resman/rpc_recorder.h"
+
+namespace proto = baidu::galaxy::proto;
+
+TEST(TestRpcRecorder, RoundTrip) {
+    std::string path = "test_rpc_recorder.record";
+    unlink(path.c_str());
+    {
+        baidu::galaxy::RpcRecorder recorder;
+        ASSERT_TRUE(recorder.Open(path));
+        recorder.RecordMeta("/user/u1", "meta");
+        proto::KeepAliveRequest request;
+        request.set_endpoint("agent1:1646");
+        recorder.Record("baidu.galaxy.proto.ResMan.KeepAlive", "", request, NULL);
+        proto::KeepAliveResponse response;
+        response.mutable_error_code()->set_status(proto::kOk);
+        recorder.Record("baidu.galaxy.proto.Agent.Query", "agent1:1646", request, &response);
+    }
+    // torn record of a crash at the tail
+    FILE* file = fopen(path.c_str(), "ab");
+    ASSERT_TRUE(file != NULL);
+    fwrite("\x10\x00", 1, 2, file);
+    fclose(file);
+
+    baidu::galaxy::RpcRecordReader reader;
+    ASSERT_TRUE(reader.Open(path));
+    proto::RpcRecord record;
+    ASSERT_TRUE(reader.Next(&record));
+    EXPECT_EQ("/user/u1", record.meta_key());
+    EXPECT_EQ("meta", record.request());
+
+    ASSERT_TRUE(reader.Next(&record));
+    EXPECT_EQ("baidu.galaxy.proto.ResMan.KeepAlive", record.method());
+    EXPECT_FALSE(record.has_response());
+    proto::KeepAliveRequest request;
+    ASSERT_TRUE(request.ParseFromString(record.request()));
+    EXPECT_EQ("agent1:1646", request.endpoint());
+
+    ASSERT_TRUE(reader.Next(&record));
+    EXPECT_EQ("agent1:1646", record.endpoint());
+    EXPECT_TRUE(record.has_response());
+    EXPECT_GT(record.time(), 0);
+
+    EXPECT_FALSE(reader.Next(&record));
+    unlink(path.c_str());
+}
+#endif
@@ -0,0 +1,652 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_SCHEDULER_ON
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <gflags/gflags.h>
+#include "resman/scheduler.h"
+#include "timer.h"
+
+DECLARE_int64(query_snapshot_interval);
+DECLARE_bool(enable_preemption);
+DECLARE_int32(preempt_group_budget);
+DECLARE_int32(sched_select_max_agents);
+
+namespace sched = baidu::galaxy::sched;
+namespace proto = baidu::galaxy::proto;
+
+// exposes the statistics check of the scheduler
+class SchedulerForTest : public sched::Scheduler {
+public:
+    using sched::Scheduler::CheckStatistics;
+};
+
+class TestScheduler : public testing::Test {
+protected:
+    virtual void SetUp() {
+        query_snapshot_interval_ = FLAGS_query_snapshot_interval;
+        enable_preemption_ = FLAGS_enable_preemption;
+        preempt_group_budget_ = FLAGS_preempt_group_budget;
+        sched_select_max_agents_ = FLAGS_sched_select_max_agents;
+        FLAGS_query_snapshot_interval = 0;
+        FLAGS_enable_preemption = false;
+        FLAGS_preempt_group_budget = 2;
+        FLAGS_sched_select_max_agents = 1000;
+    }
+
+    virtual void TearDown() {
+        FLAGS_query_snapshot_interval = query_snapshot_interval_;
+        FLAGS_enable_preemption = enable_preemption_;
+        FLAGS_preempt_group_budget = preempt_group_budget_;
+        FLAGS_sched_select_max_agents = sched_select_max_agents_;
+    }
+
+    void AddAgent(sched::Scheduler& scheduler, const std::string& endpoint,
+                  int64_t cpu, int64_t memory) {
+        std::map<sched::DevicePath, sched::VolumInfo> volums;
+        sched::VolumInfo& home = volums["/home"];
+        home.medium = proto::kDisk;
+        home.size = 1024L * 1024 * 1024 * 1024;
+        std::set<std::string> tags;
+        sched::Agent::Ptr agent(new sched::Agent(endpoint, cpu, memory,
+                                                 volums, tags, "test_pool"));
+        proto::AgentInfo agent_info;
+        scheduler.AddAgent(agent, agent_info);
+    }
+
+    proto::ContainerDescription MakeDesc(int64_t cpu, int64_t memory, int max_per_host) {
+        proto::ContainerDescription desc;
+        desc.set_priority(proto::kJobService);
+        desc.set_max_per_host(max_per_host);
+        desc.add_pool_names("test_pool");
+        desc.mutable_workspace_volum()->set_medium(proto::kDisk);
+        desc.mutable_workspace_volum()->set_size(1024);
+        proto::Cgroup* cgroup = desc.add_cgroups();
+        cgroup->mutable_cpu()->set_milli_core(cpu);
+        cgroup->mutable_memory()->set_size(memory);
+        return desc;
+    }
+
+    int CountStatus(sched::Scheduler& scheduler, const std::string& group_id,
+                    proto::ContainerStatus status) {
+        std::vector<proto::ContainerStatistics> containers;
+        scheduler.ShowContainerGroup(group_id, containers);
+        int count = 0;
+        for (size_t i = 0; i < containers.size(); i++) {
+            if (containers[i].status() == status) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    int64_t query_snapshot_interval_;
+    bool enable_preemption_;
+    int32_t preempt_group_budget_;
+    int32_t sched_select_max_agents_;
+};
+
+TEST_F(TestScheduler, ScheduleBatch_AllFit)
+{
+    sched::Scheduler scheduler;
+    for (int i = 0; i < 10; i++) {
+        std::stringstream ss;
+        ss << "agent_" << i << ":8221";
+        AddAgent(scheduler, ss.str(), 4000, 4096);
+    }
+    std::string group_id = scheduler.Submit("job_all_fit", MakeDesc(1000, 1024, 0),
+                                            30, proto::kJobService, "test");
+    EXPECT_EQ(30, scheduler.ScheduleBatch());
+    EXPECT_EQ(30, CountStatus(scheduler, group_id, proto::kContainerAllocating));
+    EXPECT_EQ(0, scheduler.ScheduleBatch());
+}
+
+TEST_F(TestScheduler, ScheduleBatch_PartialFit)
+{
+    sched::Scheduler scheduler;
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096);
+    AddAgent(scheduler, "agent_1:8221", 4000, 4096);
+    std::string group_id = scheduler.Submit("job_partial", MakeDesc(1000, 1024, 3),
+                                            10, proto::kJobService, "test");
+    EXPECT_EQ(6, scheduler.ScheduleBatch());
+    EXPECT_EQ(6, CountStatus(scheduler, group_id, proto::kContainerAllocating));
+    EXPECT_EQ(4, CountStatus(scheduler, group_id, proto::kContainerPending));
+}
+
+TEST_F(TestScheduler, ScheduleBatch_FreezedAgent)
+{
+    sched::Scheduler scheduler;
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096);
+    AddAgent(scheduler, "agent_1:8221", 4000, 4096);
+    EXPECT_TRUE(scheduler.FreezeAgent("agent_1:8221"));
+    std::string group_id = scheduler.Submit("job_freezed", MakeDesc(1000, 1024, 0),
+                                            8, proto::kJobService, "test");
+    EXPECT_EQ(4, scheduler.ScheduleBatch());
+    std::vector<proto::ContainerStatistics> containers;
+    EXPECT_TRUE(scheduler.ShowAgent("agent_1:8221", containers));
+    EXPECT_EQ(0u, containers.size());
+}
+
+TEST_F(TestScheduler, ScheduleBatch_IndexTagAndPool)
+{
+    sched::Scheduler scheduler;
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096);
+    AddAgent(scheduler, "agent_1:8221", 4000, 4096);
+    AddAgent(scheduler, "agent_2:8221", 4000, 4096);
+    scheduler.AddTag("agent_1:8221", "ssd");
+    scheduler.SetPool("agent_2:8221", "other_pool");
+    proto::ContainerDescription desc = MakeDesc(1000, 1024, 0);
+    desc.set_tag("ssd");
+    std::string group_id = scheduler.Submit("job_tag", desc, 6, proto::kJobService, "test");
+    EXPECT_EQ(4, scheduler.ScheduleBatch());
+    std::vector<proto::ContainerStatistics> containers;
+    EXPECT_TRUE(scheduler.ShowAgent("agent_1:8221", containers));
+    EXPECT_EQ(4u, containers.size());
+
+    containers.clear();
+    scheduler.ShowContainerGroup(group_id, containers);
+    for (size_t i = 0; i < containers.size(); i++) {
+        if (containers[i].status() == proto::kContainerPending) {
+            EXPECT_EQ(proto::kNoCpu, containers[i].last_res_err());
+        }
+    }
+
+    // containers are evicted after removing the tag, and the index follows
+    scheduler.RemoveTag("agent_1:8221", "ssd");
+    EXPECT_EQ(0, scheduler.ScheduleBatch());
+    EXPECT_EQ(6, CountStatus(scheduler, group_id, proto::kContainerPending));
+    scheduler.AddTag("agent_0:8221", "ssd");
+    EXPECT_EQ(4, scheduler.ScheduleBatch());
+    containers.clear();
+    EXPECT_TRUE(scheduler.ShowAgent("agent_0:8221", containers));
+    EXPECT_EQ(4u, containers.size());
+}
+
+TEST_F(TestScheduler, ScheduleBatch_LeastLoadedFirst)
+{
+    sched::Scheduler scheduler;
+    AddAgent(scheduler, "agent_0:8221", 2000, 4096);
+    AddAgent(scheduler, "agent_1:8221", 8000, 4096);
+    AddAgent(scheduler, "agent_2:8221", 4000, 4096);
+    std::string group_id = scheduler.Submit("job_spread", MakeDesc(1000, 512, 0),
+                                            1, proto::kJobService, "test");
+    EXPECT_EQ(1, scheduler.ScheduleBatch());
+    std::vector<proto::ContainerStatistics> containers;
+    EXPECT_TRUE(scheduler.ShowAgent("agent_1:8221", containers));
+    EXPECT_EQ(1u, containers.size());
+
+    // only the agent with the most free cpu is examined, its memory is short
+    AddAgent(scheduler, "agent_3:8221", 16000, 256);
+    FLAGS_sched_select_max_agents = 1;
+    group_id = scheduler.Submit("job_bounded", MakeDesc(1000, 512, 0),
+                                1, proto::kJobService, "test");
+    EXPECT_EQ(0, scheduler.ScheduleBatch());
+    EXPECT_EQ(1, CountStatus(scheduler, group_id, proto::kContainerPending));
+    FLAGS_sched_select_max_agents = 0;
+    EXPECT_EQ(1, scheduler.ScheduleBatch());
+    EXPECT_EQ(1, CountStatus(scheduler, group_id, proto::kContainerAllocating));
+}
+
+TEST_F(TestScheduler, ListContainerGroups_Snapshot)
+{
+    sched::Scheduler scheduler;
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096);
+    scheduler.Submit("job_a", MakeDesc(1000, 1024, 0), 2, proto::kJobService, "test");
+    std::vector<proto::ContainerGroupStatistics> groups;
+    int64_t snapshot_time = 0;
+    EXPECT_TRUE(scheduler.ListContainerGroups(groups, snapshot_time));
+    ASSERT_EQ(1u, groups.size());
+    EXPECT_EQ(2u, groups[0].pending());
+    EXPECT_LT(0, snapshot_time);
+
+    // a fresh snapshot is served without rebuilding, with the time it was taken
+    FLAGS_query_snapshot_interval = 3600 * 1000;
+    scheduler.Submit("job_b", MakeDesc(1000, 1024, 0), 2, proto::kJobService, "test");
+    groups.clear();
+    int64_t cached_time = 0;
+    EXPECT_TRUE(scheduler.ListContainerGroups(groups, cached_time));
+    EXPECT_EQ(1u, groups.size());
+    EXPECT_EQ(snapshot_time, cached_time);
+
+    FLAGS_query_snapshot_interval = 0;
+    scheduler.ScheduleBatch();
+    groups.clear();
+    EXPECT_TRUE(scheduler.ListContainerGroups(groups, snapshot_time));
+    EXPECT_LE(cached_time, snapshot_time);
+    ASSERT_EQ(2u, groups.size());
+    EXPECT_EQ(0u, groups[0].pending());
+    EXPECT_EQ(2u, groups[0].allocating());
+}
+
+TEST_F(TestScheduler, Statistics_Incremental)
+{
+    SchedulerForTest scheduler;
+    scheduler.Start(false);
+    std::string diff;
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096);
+    AddAgent(scheduler, "agent_1:8221", 4000, 4096);
+    std::string group_a = scheduler.Submit("job_a", MakeDesc(1000, 1024, 0),
+                                           4, proto::kJobService, "user_a");
+    std::string group_b = scheduler.Submit("job_b", MakeDesc(500, 512, 0),
+                                           6, proto::kJobService, "user_b");
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+    EXPECT_EQ(10, scheduler.ScheduleBatch());
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+
+    // report every container of job_a ready
+    std::vector<proto::ContainerStatistics> containers;
+    scheduler.ShowContainerGroup(group_a, containers);
+    std::map<std::string, proto::AgentInfo> reports;
+    for (size_t i = 0; i < containers.size(); i++) {
+        proto::ContainerInfo* info = reports[containers[i].endpoint()].add_container_info();
+        info->set_id(containers[i].id());
+        info->set_group_id(group_a);
+        info->set_status(proto::kContainerReady);
+        info->set_cpu_used(100);
+        info->set_memory_used(200);
+    }
+    std::map<std::string, proto::AgentInfo>::iterator it;
+    for (it = reports.begin(); it != reports.end(); it++) {
+        std::vector<sched::AgentCommand> commands;
+        scheduler.MakeCommand(it->first, it->second, commands);
+    }
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+    std::vector<proto::ContainerGroupStatistics> groups;
+    int64_t snapshot_time = 0;
+    scheduler.ListContainerGroups(groups, snapshot_time);
+    ASSERT_EQ(2u, groups.size());
+    const proto::ContainerGroupStatistics& stat_a = groups[0].id() == group_a ? groups[0] : groups[1];
+    EXPECT_EQ(4u, stat_a.ready());
+    EXPECT_EQ(4000, stat_a.cpu().assigned());
+    EXPECT_EQ(400, stat_a.cpu().used());
+    EXPECT_EQ(800, stat_a.memory().used());
+    ASSERT_EQ(1, stat_a.volums_size());
+    EXPECT_EQ(4096, stat_a.volums(0).volum().assigned());
+
+    proto::Quota alloc;
+    scheduler.ShowUserAlloc("user_b", alloc);
+    EXPECT_EQ(6, alloc.replica());
+    EXPECT_EQ(3000, alloc.millicore());
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+
+    std::string new_version;
+    EXPECT_TRUE(scheduler.Update(group_b, MakeDesc(600, 512, 0), 0, new_version));
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+    scheduler.ShowUserAlloc("user_b", alloc);
+    EXPECT_EQ(3600, alloc.millicore());
+    EXPECT_TRUE(scheduler.ChangeReplica(group_a, 2));
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+    EXPECT_TRUE(scheduler.Kill(group_b));
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+    scheduler.RemoveAgent("agent_0:8221");
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+    scheduler.SetPool("agent_1:8221", "other_pool");
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+    scheduler.ShowUserAlloc("user_b", alloc);
+    EXPECT_EQ(0, alloc.replica());
+}
+
+TEST_F(TestScheduler, AddAgent_ReportedContainers)
+{
+    SchedulerForTest scheduler;
+    proto::ContainerDescription desc = MakeDesc(1000, 1024, 0);
+    desc.set_version("ver_1");
+    std::string group_id = scheduler.Submit("job_reported", desc, 2,
+                                            proto::kJobService, "test");
+    std::vector<proto::ContainerStatistics> containers;
+    scheduler.ShowContainerGroup(group_id, containers);
+    ASSERT_EQ(2u, containers.size());
+
+    // one container known as pending, one the scheduler has never seen
+    proto::AgentInfo agent_info;
+    proto::ContainerInfo* info = agent_info.add_container_info();
+    info->set_id(containers[0].id());
+    info->set_group_id(group_id);
+    info->set_status(proto::kContainerReady);
+    info->mutable_container_desc()->CopyFrom(desc);
+    info = agent_info.add_container_info();
+    info->set_id(group_id + ".vm_unknown");
+    info->set_group_id(group_id);
+    info->set_status(proto::kContainerReady);
+    info->mutable_container_desc()->CopyFrom(desc);
+    std::map<sched::DevicePath, sched::VolumInfo> volums;
+    std::set<std::string> tags;
+    sched::Agent::Ptr agent(new sched::Agent("agent_0:8221", 4000, 4096,
+                                             volums, tags, "test_pool"));
+    scheduler.AddAgent(agent, agent_info);
+    EXPECT_EQ(2, CountStatus(scheduler, group_id, proto::kContainerReady));
+    EXPECT_EQ(1, CountStatus(scheduler, group_id, proto::kContainerPending));
+    EXPECT_EQ(2000, agent->CpuTotal() - agent->CpuFree());
+    std::string diff;
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+}
+
+TEST_F(TestScheduler, Preempt_MinimalVictims)
+{
+    FLAGS_enable_preemption = true;
+    SchedulerForTest scheduler;
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096);
+    std::string small = scheduler.Submit("job_small", MakeDesc(1000, 512, 0),
+                                         2, proto::kJobBatch, "test");
+    std::string large = scheduler.Submit("job_large", MakeDesc(2000, 512, 0),
+                                         1, proto::kJobBatch, "test");
+    EXPECT_EQ(3, scheduler.ScheduleBatch());
+    std::string high = scheduler.Submit("job_high", MakeDesc(2000, 512, 0),
+                                        1, proto::kJobService, "test");
+    EXPECT_EQ(1, scheduler.ScheduleBatch());
+    EXPECT_EQ(1, CountStatus(scheduler, high, proto::kContainerAllocating));
+    // one victim is enough
+    EXPECT_EQ(1, CountStatus(scheduler, large, proto::kContainerPending));
+    EXPECT_EQ(2, CountStatus(scheduler, small, proto::kContainerAllocating));
+    // containers of the same priority are never preempted
+    EXPECT_EQ(0, scheduler.ScheduleBatch());
+    std::string diff;
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+}
+
+TEST_F(TestScheduler, Preempt_ReportedWorkKept)
+{
+    FLAGS_enable_preemption = true;
+    SchedulerForTest scheduler;
+    proto::ContainerDescription desc = MakeDesc(1000, 512, 0);
+    desc.set_priority(proto::kJobBatch);
+    std::string young = scheduler.Submit("job_young", desc, 1, proto::kJobBatch, "test");
+    std::string old = scheduler.Submit("job_old", desc, 1, proto::kJobBatch, "test");
+    // the agent comes back with both running, the young one reported first
+    int64_t now = baidu::common::timer::get_micros();
+    proto::AgentInfo agent_info;
+    std::string groups[] = {young, old};
+    int64_t created[] = {now - 1000000L, now - 3600 * 1000000L};
+    for (int i = 0; i < 2; i++) {
+        std::vector<proto::ContainerStatistics> containers;
+        scheduler.ShowContainerGroup(groups[i], containers);
+        proto::ContainerInfo* info = agent_info.add_container_info();
+        info->set_id(containers[0].id());
+        info->set_group_id(groups[i]);
+        info->set_status(proto::kContainerReady);
+        info->set_created_time(created[i]);
+        info->mutable_container_desc()->CopyFrom(desc);
+    }
+    std::map<sched::DevicePath, sched::VolumInfo> volums;
+    volums["/home"].medium = proto::kDisk;
+    volums["/home"].size = 1024L * 1024 * 1024;
+    std::set<std::string> tags;
+    sched::Agent::Ptr agent(new sched::Agent("agent_0:8221", 2000, 4096,
+                                             volums, tags, "test_pool"));
+    scheduler.AddAgent(agent, agent_info);
+
+    // too large for the agent even without victims, trials leave it as it was
+    std::string huge = scheduler.Submit("job_huge", MakeDesc(4000, 512, 0),
+                                        1, proto::kJobService, "test");
+    EXPECT_EQ(0, scheduler.ScheduleBatch());
+    EXPECT_EQ(0, agent->CpuFree());
+    std::string diff;
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+    EXPECT_TRUE(scheduler.Kill(huge));
+
+    // the one which has done less work is preempted
+    std::string high = scheduler.Submit("job_high", MakeDesc(1000, 512, 0),
+                                        1, proto::kJobService, "test");
+    EXPECT_EQ(1, scheduler.ScheduleBatch());
+    EXPECT_EQ(1, CountStatus(scheduler, young, proto::kContainerPending));
+    EXPECT_EQ(1, CountStatus(scheduler, old, proto::kContainerReady));
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+}
+
+TEST_F(TestScheduler, Preempt_ReserveAfterVictims)
+{
+    FLAGS_enable_preemption = true;
+    sched::Scheduler scheduler;
+    // commands are made by a started scheduler only, the test schedules
+    scheduler.Start(false);
+    scheduler.TrackPlacements(true, true);
+    AddAgent(scheduler, "agent_0:8221", 2000, 4096);
+    std::string low = scheduler.Submit("job_low", MakeDesc(1000, 512, 0),
+                                       2, proto::kJobBatch, "test");
+    EXPECT_EQ(2, scheduler.ScheduleBatch());
+    std::map<sched::AgentEndpoint, std::vector<sched::AgentCommand> > placements;
+    scheduler.TakePlacements(placements);
+    proto::AgentInfo agent_info;
+    std::vector<proto::ContainerStatistics> containers;
+    scheduler.ShowContainerGroup(low, containers);
+    for (size_t i = 0; i < containers.size(); i++) {
+        proto::ContainerInfo* info = agent_info.add_container_info();
+        info->set_id(containers[i].id());
+        info->set_group_id(low);
+        info->set_status(proto::kContainerReady);
+    }
+    std::vector<sched::AgentCommand> commands;
+    scheduler.MakeCommand("agent_0:8221", agent_info, commands);
+    EXPECT_EQ(2, CountStatus(scheduler, low, proto::kContainerReady));
+
+    std::string high = scheduler.Submit("job_high", MakeDesc(1000, 512, 0),
+                                        1, proto::kJobService, "test");
+    EXPECT_EQ(1, scheduler.ScheduleBatch());
+    containers.clear();
+    scheduler.ShowContainerGroup(high, containers);
+    ASSERT_EQ(1u, containers.size());
+    const std::string high_id = containers[0].id();
+
+    // not reserved while the victim runs, nor canceled by a refusing agent
+    placements.clear();
+    scheduler.TakePlacements(placements);
+    EXPECT_TRUE(placements["agent_0:8221"].empty());
+    EXPECT_FALSE(scheduler.CancelPlacement(high, high_id, "agent_0:8221"));
+    EXPECT_EQ(1, CountStatus(scheduler, high, proto::kContainerAllocating));
+
+    // the victim is destroyed first
+    commands.clear();
+    scheduler.MakeCommand("agent_0:8221", agent_info, commands);
+    ASSERT_EQ(1u, commands.size());
+    EXPECT_EQ(sched::kDestroyContainer, commands[0].action);
+    const std::string victim_id = commands[0].container_id;
+
+    // reserved once the agent does not report it, and created after the ack
+    proto::AgentInfo after;
+    for (int i = 0; i < agent_info.container_info_size(); i++) {
+        if (agent_info.container_info(i).id() != victim_id) {
+            after.add_container_info()->CopyFrom(agent_info.container_info(i));
+        }
+    }
+    commands.clear();
+    scheduler.MakeCommand("agent_0:8221", after, commands);
+    EXPECT_TRUE(commands.empty());
+    placements.clear();
+    scheduler.TakePlacements(placements);
+    ASSERT_EQ(1u, placements["agent_0:8221"].size());
+    EXPECT_EQ(high_id, placements["agent_0:8221"][0].container_id);
+    scheduler.AckReservation(high, high_id, "agent_0:8221");
+    scheduler.MakeCommand("agent_0:8221", after, commands);
+    ASSERT_EQ(1u, commands.size());
+    EXPECT_EQ(sched::kCreateContainer, commands[0].action);
+    EXPECT_EQ(high_id, commands[0].container_id);
+    EXPECT_TRUE(scheduler.CancelPlacement(high, high_id, "agent_0:8221"));
+}
+
+TEST_F(TestScheduler, Preempt_GroupBudget)
+{
+    FLAGS_enable_preemption = true;
+    FLAGS_preempt_group_budget = 1;
+    sched::Scheduler scheduler;
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096);
+    std::string low = scheduler.Submit("job_low", MakeDesc(1000, 512, 0),
+                                       4, proto::kJobBatch, "test");
+    EXPECT_EQ(4, scheduler.ScheduleBatch());
+    std::string high = scheduler.Submit("job_high", MakeDesc(1000, 512, 0),
+                                        2, proto::kJobService, "test");
+    EXPECT_EQ(1, scheduler.ScheduleBatch());
+    EXPECT_EQ(1, CountStatus(scheduler, high, proto::kContainerAllocating));
+    EXPECT_EQ(1, CountStatus(scheduler, high, proto::kContainerPending));
+    EXPECT_EQ(3, CountStatus(scheduler, low, proto::kContainerAllocating));
+
+    // manual preemption is not limited by the budget
+    std::string fail_reason;
+    EXPECT_TRUE(scheduler.ManualSchedule("agent_0:8221", high, fail_reason));
+    EXPECT_EQ(2, CountStatus(scheduler, high, proto::kContainerAllocating));
+    EXPECT_EQ(2, CountStatus(scheduler, low, proto::kContainerAllocating));
+}
+
+TEST_F(TestScheduler, Gang_AllOrNothing)
+{
+    SchedulerForTest scheduler;
+    scheduler.Start(false);
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096);
+    AddAgent(scheduler, "agent_1:8221", 4000, 4096);
+    proto::ContainerDescription desc = MakeDesc(1000, 512, 0);
+    desc.set_gang(true);
+    std::string large = scheduler.Submit("job_large", desc, 10, proto::kJobService, "test");
+    EXPECT_EQ(0, scheduler.ScheduleBatch());
+    EXPECT_EQ(10, CountStatus(scheduler, large, proto::kContainerPending));
+    std::vector<proto::ContainerStatistics> containers;
+    EXPECT_TRUE(scheduler.ShowAgent("agent_0:8221", containers));
+    EXPECT_EQ(0u, containers.size());
+    std::string diff;
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+
+    std::string small = scheduler.Submit("job_small", desc, 6, proto::kJobService, "test");
+    EXPECT_EQ(6, scheduler.ScheduleBatch());
+    EXPECT_EQ(6, CountStatus(scheduler, small, proto::kContainerAllocating));
+
+    // the per agent loop leaves gangs alone
+    EXPECT_TRUE(scheduler.ChangeReplica(large, 2));
+    EXPECT_EQ(0, scheduler.ScheduleAgent("agent_0:8221"));
+    EXPECT_EQ(2, scheduler.ScheduleGangs());
+    EXPECT_EQ(2, CountStatus(scheduler, large, proto::kContainerAllocating));
+    EXPECT_TRUE(scheduler.CheckStatistics(diff)) << diff;
+}
+
+TEST_F(TestScheduler, Gang_NotPreempted)
+{
+    FLAGS_enable_preemption = true;
+    sched::Scheduler scheduler;
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096);
+    proto::ContainerDescription desc = MakeDesc(1000, 512, 0);
+    desc.set_gang(true);
+    std::string gang = scheduler.Submit("job_gang", desc, 4, proto::kJobBatch, "test");
+    EXPECT_EQ(4, scheduler.ScheduleBatch());
+    std::string high = scheduler.Submit("job_high", MakeDesc(1000, 512, 0),
+                                        1, proto::kJobService, "test");
+    EXPECT_EQ(0, scheduler.ScheduleBatch());
+    EXPECT_EQ(4, CountStatus(scheduler, gang, proto::kContainerAllocating));
+    EXPECT_EQ(1, CountStatus(scheduler, high, proto::kContainerPending));
+}
+
+TEST_F(TestScheduler, Requirement_Summarize)
+{
+    proto::ContainerDescription desc = MakeDesc(1000, 1024, 0);
+    desc.add_cgroups()->mutable_cpu()->set_milli_core(1000);
+    desc.mutable_workspace_volum()->set_medium(proto::kTmpfs);
+    desc.mutable_workspace_volum()->set_size(100);
+    proto::VolumRequired* volum = desc.add_data_volums();
+    volum->set_medium(proto::kDisk);
+    volum->set_size(200);
+    volum = desc.add_data_volums();
+    volum->set_medium(proto::kSsd);
+    volum->set_size(300);
+    desc.set_version("ver_1");
+    sched::Requirement require(desc);
+    EXPECT_EQ(2000, require.CpuNeed());
+    EXPECT_EQ(1024, require.MemoryNeed());
+    EXPECT_EQ(100, require.TmpfsNeed());
+    EXPECT_EQ(200, require.DiskNeed());
+    EXPECT_EQ(300, require.SsdNeed());
+    EXPECT_EQ(2u, require.DeviceVolums().size());
+    EXPECT_EQ("ver_1", require.version);
+
+    desc.set_version("ver_2");
+    sched::Requirement other(desc);
+    EXPECT_EQ(require.Fingerprint(), other.Fingerprint());
+    desc.mutable_cgroups(0)->mutable_memory()->set_size(2048);
+    sched::Requirement larger(desc);
+    EXPECT_EQ(2048, larger.MemoryNeed());
+    EXPECT_NE(require.Fingerprint(), larger.Fingerprint());
+}
+
+TEST_F(TestScheduler, Placements_TakeAndCancel)
+{
+    sched::Scheduler scheduler;
+    scheduler.TrackPlacements(true, true);
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096);
+    AddAgent(scheduler, "agent_1:8221", 4000, 4096);
+    std::string group_id = scheduler.Submit("job_placed", MakeDesc(1000, 1024, 0),
+                                            4, proto::kJobService, "test");
+    EXPECT_EQ(4, scheduler.ScheduleBatch());
+    std::map<sched::AgentEndpoint, std::vector<sched::AgentCommand> > placements;
+    scheduler.TakePlacements(placements);
+    size_t total = 0;
+    std::map<sched::AgentEndpoint, std::vector<sched::AgentCommand> >::iterator it;
+    for (it = placements.begin(); it != placements.end(); it++) {
+        for (size_t i = 0; i < it->second.size(); i++) {
+            EXPECT_EQ(sched::kCreateContainer, it->second[i].action);
+            EXPECT_EQ(group_id, it->second[i].container_group_id);
+            EXPECT_EQ(1000, it->second[i].desc.cgroups(0).cpu().milli_core());
+        }
+        total += it->second.size();
+    }
+    EXPECT_EQ(4u, total);
+    std::map<sched::AgentEndpoint, std::vector<sched::AgentCommand> > again;
+    scheduler.TakePlacements(again);
+    EXPECT_TRUE(again.empty());
+
+    it = placements.begin();
+    const sched::AgentCommand& cmd = it->second[0];
+    std::string other = it->first == "agent_0:8221" ? "agent_1:8221" : "agent_0:8221";
+    EXPECT_FALSE(scheduler.CancelPlacement(group_id, cmd.container_id, other));
+    EXPECT_TRUE(scheduler.CancelPlacement(group_id, cmd.container_id, it->first));
+    EXPECT_FALSE(scheduler.CancelPlacement(group_id, cmd.container_id, it->first));
+    EXPECT_EQ(1, CountStatus(scheduler, group_id, proto::kContainerPending));
+
+    // placed again, and reserved again
+    EXPECT_EQ(1, scheduler.ScheduleBatch());
+    scheduler.TakePlacements(again);
+    ASSERT_EQ(1u, again.size());
+    ASSERT_EQ(1u, again.begin()->second.size());
+    EXPECT_EQ(cmd.container_id, again.begin()->second[0].container_id);
+}
+
+TEST_F(TestScheduler, Placements_CreateAfterAck)
+{
+    sched::Scheduler scheduler;
+    scheduler.Start(false);
+    scheduler.TrackPlacements(true, true);
+    AddAgent(scheduler, "agent_0:8221", 4000, 4096);
+    std::string group_id = scheduler.Submit("job_placed", MakeDesc(1000, 1024, 0),
+                                            1, proto::kJobService, "test");
+    EXPECT_EQ(1, scheduler.ScheduleBatch());
+    std::map<sched::AgentEndpoint, std::vector<sched::AgentCommand> > placements;
+    scheduler.TakePlacements(placements);
+    ASSERT_EQ(1u, placements["agent_0:8221"].size());
+    const std::string container_id = placements["agent_0:8221"][0].container_id;
+
+    // no create before the agent holds the reservation
+    proto::AgentInfo agent_info;
+    std::vector<sched::AgentCommand> commands;
+    scheduler.MakeCommand("agent_0:8221", agent_info, commands);
+    EXPECT_TRUE(commands.empty());
+    scheduler.AckReservation(group_id, container_id, "agent_1:8221");
+    scheduler.MakeCommand("agent_0:8221", agent_info, commands);
+    EXPECT_TRUE(commands.empty());
+    scheduler.AckReservation(group_id, container_id, "agent_0:8221");
+    scheduler.MakeCommand("agent_0:8221", agent_info, commands);
+    ASSERT_EQ(1u, commands.size());
+    EXPECT_EQ(sched::kCreateContainer, commands[0].action);
+
+    // a container its agent reports is never put back to pending
+    proto::ContainerInfo* info = agent_info.add_container_info();
+    info->set_id(container_id);
+    info->set_group_id(group_id);
+    info->set_status(proto::kContainerAllocating);
+    commands.clear();
+    scheduler.MakeCommand("agent_0:8221", agent_info, commands);
+    EXPECT_FALSE(scheduler.CancelPlacement(group_id, container_id, "agent_0:8221"));
+    EXPECT_EQ(1, CountStatus(scheduler, group_id, proto::kContainerAllocating));
+}
+
+#endif
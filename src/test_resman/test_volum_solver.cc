@@ -0,0 +1,131 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "unit_test.h"
+
+#ifdef TEST_VOLUM_SOLVER_ON
+#include <map>
+#include <set>
+#include <vector>
+#include <sstream>
+#include <stdlib.h>
+#include "resman/volum_solver.h"
+
+namespace sched = baidu::galaxy::sched;
+namespace proto = baidu::galaxy::proto;
+
+class TestVolumSolver : public testing::Test {
+protected:
+    void AddDevice(const std::string& path, proto::VolumMedium medium, int64_t size) {
+        sched::VolumInfo& info = volum_free_[path];
+        info.medium = medium;
+        info.size = size;
+    }
+
+    void AddVolum(proto::VolumMedium medium, int64_t size, bool exclusive) {
+        proto::VolumRequired volum;
+        volum.set_medium(medium);
+        volum.set_size(size);
+        volum.set_exclusive(exclusive);
+        volums_.push_back(volum);
+    }
+
+    bool Valid(const std::vector<sched::DevicePath>& devices) {
+        if (devices.size() != volums_.size()) {
+            return false;
+        }
+        std::map<sched::DevicePath, sched::VolumInfo> free = volum_free_;
+        std::map<sched::DevicePath, int> use_count;
+        std::set<sched::DevicePath> exclusive;
+        for (size_t i = 0; i < devices.size(); i++) {
+            sched::VolumInfo& info = free[devices[i]];
+            if (info.exclusive || info.medium != volums_[i].medium()) {
+                return false;
+            }
+            info.size -= volums_[i].size();
+            if (info.size < 0) {
+                return false;
+            }
+            use_count[devices[i]]++;
+            if (volums_[i].exclusive()) {
+                exclusive.insert(devices[i]);
+            }
+        }
+        std::set<sched::DevicePath>::iterator it;
+        for (it = exclusive.begin(); it != exclusive.end(); it++) {
+            if (use_count[*it] > 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::map<sched::DevicePath, sched::VolumInfo> volum_free_;
+    std::vector<proto::VolumRequired> volums_;
+};
+
+TEST_F(TestVolumSolver, BestFit_ExclusiveFirst)
+{
+    AddDevice("/home/disk0", proto::kDisk, 100);
+    AddDevice("/home/disk1", proto::kDisk, 1000);
+    AddVolum(proto::kDisk, 10, false);
+    AddVolum(proto::kDisk, 100, true);
+    std::vector<sched::DevicePath> devices;
+    EXPECT_TRUE(sched::BestFitVolumDevices(volums_, volum_free_, devices));
+    ASSERT_EQ(2u, devices.size());
+    EXPECT_EQ("/home/disk1", devices[0]);
+    EXPECT_EQ("/home/disk0", devices[1]);
+}
+
+TEST_F(TestVolumSolver, BestFit_TieBreakByPath)
+{
+    AddDevice("/home/disk2", proto::kDisk, 500);
+    AddDevice("/home/disk1", proto::kDisk, 500);
+    AddDevice("/home/ssd0", proto::kSsd, 500);
+    AddVolum(proto::kDisk, 100, false);
+    std::vector<sched::DevicePath> devices;
+    EXPECT_TRUE(sched::BestFitVolumDevices(volums_, volum_free_, devices));
+    ASSERT_EQ(1u, devices.size());
+    EXPECT_EQ("/home/disk1", devices[0]);
+}
+
+TEST_F(TestVolumSolver, Select_NoDevice)
+{
+    AddDevice("/home/disk0", proto::kDisk, 100);
+    volum_free_["/home/disk1"].exclusive = true;
+    volum_free_["/home/disk1"].size = 1000;
+    AddVolum(proto::kDisk, 50, true);
+    AddVolum(proto::kDisk, 50, true);
+    std::vector<sched::DevicePath> devices;
+    EXPECT_FALSE(sched::SelectVolumDevices(volums_, volum_free_, devices));
+    EXPECT_TRUE(devices.empty());
+}
+
+TEST_F(TestVolumSolver, Select_AgreeWithExhaustive)
+{
+    srand(0);
+    for (int round = 0; round < 500; round++) {
+        volum_free_.clear();
+        volums_.clear();
+        for (int i = 0; i < 4; i++) {
+            std::stringstream ss;
+            ss << "/home/disk" << i;
+            AddDevice(ss.str(), (i == 3) ? proto::kSsd : proto::kDisk, 50 + rand() % 200);
+        }
+        for (int i = 0; i < 3; i++) {
+            AddVolum((rand() % 4 == 0) ? proto::kSsd : proto::kDisk,
+                     10 + rand() % 150, rand() % 3 == 0);
+        }
+        std::vector<sched::DevicePath> expected;
+        std::vector<sched::DevicePath> devices;
+        bool exhaustive_ok = sched::ExhaustiveVolumDevices(volums_, volum_free_, expected);
+        bool select_ok = sched::SelectVolumDevices(volums_, volum_free_, devices);
+        EXPECT_EQ(exhaustive_ok, select_ok);
+        if (select_ok) {
+            EXPECT_TRUE(Valid(devices));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,18 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <gtest/gtest.h>
+#include <iostream>
+
+#define TEST_SCHEDULER_ON
+#define TEST_VOLUM_SOLVER_ON
+#define TEST_AGENT_SCORER_ON
+#define TEST_META_JOURNAL_ON
+#define TEST_RPC_RECORDER_ON
+#define TEST_CLUSTER_STAT_ON
+#define TEST_RESMAN_STANDBY_ON
+#define TEST_META_CODEC_ON
+#define TEST_ADMISSION_ON
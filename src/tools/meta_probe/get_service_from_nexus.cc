@@ -17,6 +17,7 @@
 #include "ins_sdk.h"
 #include "protocol/appmaster.pb.h"
 #include "protocol/galaxy.pb.h"
+#include "utils/meta_codec.h"
 #include "boost/shared_ptr.hpp"
 #include <gflags/gflags.h>
 #include <stdio.h>
@@ -37,6 +38,12 @@ int LoadFromNexus(boost::shared_ptr<galaxy::ins::sdk::InsSDK> nexus,
             const std::string& path, 
             std::vector<std::string>& data);
 
+// descs stored apart from the records under path, by digest
+template <class Desc>
+int LoadDescsFromNexus(boost::shared_ptr<galaxy::ins::sdk::InsSDK> nexus,
+            const std::string& path,
+            std::map<std::string, Desc>& descs);
+
 struct MetrixInfo {
     std::string id;
     std::string naming_node;
@@ -82,9 +89,17 @@ int main(int argc, char** argv) {
     }
 
 
+    std::map<std::string, baidu::galaxy::proto::ContainerDescription> cg_descs;
+    if (0 != LoadDescsFromNexus(nexus, FLAGS_container_group_path, cg_descs)) {
+        return -1;
+    }
+
     for (size_t i = 0; i < cg_str.size(); i++) {
         baidu::galaxy::proto::ContainerGroupMeta cgm;
         if (cgm.ParseFromString(cg_str[i])) {
+            if (cgm.has_desc_digest() && cg_descs.find(cgm.desc_digest()) != cg_descs.end()) {
+                cgm.mutable_desc()->CopyFrom(cg_descs[cgm.desc_digest()]);
+            }
             if (cgm.has_desc()) {
                 baidu::galaxy::proto::ContainerDescription desc = cgm.desc();
                 if (desc.has_container_type() && desc.container_type() == baidu::galaxy::proto::kVolumContainer) {
@@ -110,10 +125,18 @@ int main(int argc, char** argv) {
     }
 
 
+    std::map<std::string, baidu::galaxy::proto::JobDescription> job_descs;
+    if (0 != LoadDescsFromNexus(nexus, FLAGS_service_path, job_descs)) {
+        return -1;
+    }
+
     std::vector<boost::shared_ptr<MetrixInfo> > vminfo;
     for (size_t i = 0; i < vservice_str.size(); i++) {
         baidu::galaxy::proto::JobInfo job;
         if (job.ParseFromString(vservice_str[i])) {
+            if (job.has_desc_digest() && job_descs.find(job.desc_digest()) != job_descs.end()) {
+                job.mutable_desc()->CopyFrom(job_descs[job.desc_digest()]);
+            }
             baidu::galaxy::proto::PodDescription pod = job.desc().pod();
             for (int j = 0; j < pod.tasks_size(); j++) {
                 if (pod.tasks(j).services_size() > 0
@@ -155,6 +178,32 @@ void PrintHelp(const char* argv0) {
     std::cout << "usage: " << argv0 << " --nexus_addr=xx nexus_path=xx\n";
 }
 
+std::string DescPath(const std::string& path) {
+    std::string record_path = path;
+    if (!record_path.empty() && record_path[record_path.size() - 1] == '/') {
+        record_path.erase(record_path.size() - 1);
+    }
+    return baidu::galaxy::MetaCodec::DescPrefix(record_path) + "/";
+}
+
+template <class Desc>
+int LoadDescsFromNexus(boost::shared_ptr<galaxy::ins::sdk::InsSDK> nexus,
+            const std::string& path,
+            std::map<std::string, Desc>& descs) {
+    const std::string start_key = DescPath(path);
+    ::galaxy::ins::sdk::ScanResult* result
+        = nexus->Scan(start_key, start_key + "~");
+    while (!result->Done()) {
+        std::string value;
+        if (baidu::galaxy::MetaCodec::Decode(result->Value(), &value)) {
+            descs[result->Key().substr(start_key.size())].ParseFromString(value);
+        }
+        result->Next();
+    }
+    delete result;
+    return 0;
+}
+
 int LoadFromNexus(boost::shared_ptr<galaxy::ins::sdk::InsSDK> nexus, 
             const std::string& path, 
             std::vector<std::string>& data) {
@@ -162,10 +211,15 @@ int LoadFromNexus(boost::shared_ptr<galaxy::ins::sdk::InsSDK> nexus,
     int i = 0;
     const std::string start_key = path;
     const std::string end_key = path + "~";
+    const std::string desc_path = DescPath(path);
     ::galaxy::ins::sdk::ScanResult* result
         = nexus->Scan(start_key, end_key);
     while (!result->Done()) {
-        data.push_back(result->Value());
+        std::string value;
+        if (result->Key().compare(0, desc_path.size(), desc_path) != 0
+                    && baidu::galaxy::MetaCodec::Decode(result->Value(), &value)) {
+            data.push_back(value);
+        }
         result->Next();
         i++;
         if (i > 5000) {
@@ -0,0 +1,323 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// offline replay of the rpc recorded by resman with --rpc_record_path.
+//
+// the meta recorded at start is loaded into an in-memory meta store, then
+// the recorded rpc are fed into an in-process ResManImpl at the recorded
+// pace scaled by --replay_speed. Agents are stubbed: a query of resman
+// is answered with the next recorded query result of the agent, waiting
+// for it if it is not due yet, commands to agents succeed at once. The
+// latency of each rpc method is reported at the end; --replay_threads=1
+// gives a deterministic order of handling.
+
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <google/protobuf/descriptor.h>
+#include "resman/resman_impl.h"
+#include "resman/rpc_recorder.h"
+#include "timer.h"
+
+DEFINE_string(replay_file, "", "rpc record file written by resman with --rpc_record_path");
+DEFINE_double(replay_speed, 1.0, "speed relative to the recording, 0 to replay as fast as possible");
+DEFINE_int32(replay_threads, 8, "threads handling the replayed rpc");
+
+DECLARE_string(nexus_root);
+DECLARE_double(user_read_rate);
+DECLARE_double(user_mutate_rate);
+DECLARE_bool(agent_reservation);
+
+namespace proto = baidu::galaxy::proto;
+
+class StubAgentTransport : public baidu::galaxy::AgentTransport {
+public:
+    StubAgentTransport() {}
+
+    virtual ~StubAgentTransport() {
+        std::map<std::string, std::deque<PendingQuery> >::iterator it;
+        for (it = queries_.begin(); it != queries_.end(); it++) {
+            for (size_t i = 0; i < it->second.size(); i++) {
+                delete it->second[i].request;
+                delete it->second[i].response;
+            }
+        }
+    }
+
+    virtual void Query(const std::string& endpoint,
+                       const proto::QueryRequest* request,
+                       proto::QueryResponse* response,
+                       QueryCallback callback) {
+        PendingQuery query;
+        query.request = request;
+        query.response = response;
+        query.callback = callback;
+        std::string result;
+        {
+            baidu::common::MutexLock lock(&mu_);
+            // the replayed resman may query later than the recorded one
+            std::deque<std::string>& results = results_[endpoint];
+            if (results.empty()) {
+                queries_[endpoint].push_back(query);
+                return;
+            }
+            result = results.front();
+            results.pop_front();
+        }
+        Answer(endpoint, query, result);
+    }
+
+    virtual void CreateContainer(const std::string& endpoint,
+                                 const proto::CreateContainerRequest* request,
+                                 proto::CreateContainerResponse* response,
+                                 CreateContainerCallback callback) {
+        response->mutable_code()->set_status(proto::kOk);
+        callback(request, response, false, 0);
+    }
+
+    virtual void RemoveContainer(const std::string& endpoint,
+                                 const proto::RemoveContainerRequest* request,
+                                 proto::RemoveContainerResponse* response,
+                                 RemoveContainerCallback callback) {
+        response->mutable_code()->set_status(proto::kOk);
+        callback(request, response, false, 0);
+    }
+
+    virtual void BatchCommand(const std::string& endpoint,
+                              const proto::BatchCommandRequest* request,
+                              proto::BatchCommandResponse* response,
+                              BatchCommandCallback callback) {
+        response->mutable_code()->set_status(proto::kOk);
+        for (int i = 0; i < request->commands_size(); i++) {
+            response->add_results()->set_status(proto::kOk);
+        }
+        callback(request, response, false, 0);
+    }
+
+    // not recorded, answered as an agent without reservation
+    virtual void Reserve(const std::string& endpoint,
+                         const proto::ReserveRequest* request,
+                         proto::ReserveResponse* response,
+                         ReserveCallback callback) {
+        callback(request, response, true, 0);
+    }
+
+    // answers the oldest query of resman to the agent with the recorded
+    // result, or keeps the result for the next query
+    void Deliver(const proto::RpcRecord& record) {
+        PendingQuery query;
+        {
+            baidu::common::MutexLock lock(&mu_);
+            std::deque<PendingQuery>& queries = queries_[record.endpoint()];
+            if (queries.empty()) {
+                results_[record.endpoint()].push_back(record.response());
+                return;
+            }
+            query = queries.front();
+            queries.pop_front();
+        }
+        Answer(record.endpoint(), query, record.response());
+    }
+
+    // recorded results never asked for by the replayed resman
+    int64_t Unmatched() {
+        baidu::common::MutexLock lock(&mu_);
+        int64_t unmatched = 0;
+        std::map<std::string, std::deque<std::string> >::iterator it;
+        for (it = results_.begin(); it != results_.end(); it++) {
+            unmatched += it->second.size();
+        }
+        return unmatched;
+    }
+
+private:
+    struct PendingQuery {
+        const proto::QueryRequest* request;
+        proto::QueryResponse* response;
+        QueryCallback callback;
+    };
+
+    void Answer(const std::string& endpoint, const PendingQuery& query,
+                const std::string& result) {
+        if (!query.response->ParseFromString(result)) {
+            LOG(WARNING) << "broken query result of " << endpoint;
+        }
+        query.callback(query.request, query.response, false, 0);
+    }
+
+    baidu::common::Mutex mu_;
+    std::map<std::string, std::deque<PendingQuery> > queries_;
+    std::map<std::string, std::deque<std::string> > results_;
+};
+
+struct MethodStat {
+    int64_t count;
+    int64_t total;
+    std::vector<int64_t> latency;
+    MethodStat() : count(0), total(0) {}
+};
+
+class Replayer {
+public:
+    Replayer() : transport_(NULL), pool_(FLAGS_replay_threads) {}
+
+    bool Load(const std::string& path) {
+        baidu::galaxy::RpcRecordReader reader;
+        if (!reader.Open(path)) {
+            return false;
+        }
+        proto::RpcRecord record;
+        while (reader.Next(&record)) {
+            records_.push_back(record);
+        }
+        LOG(INFO) << "load " << records_.size() << " records from " << path;
+        return !records_.empty();
+    }
+
+    bool Start() {
+        baidu::galaxy::MemoryMetaStore* store = new baidu::galaxy::MemoryMetaStore();
+        size_t meta_count = 0;
+        for (size_t i = 0; i < records_.size(); i++) {
+            if (records_[i].has_meta_key()) {
+                store->Put(FLAGS_nexus_root + records_[i].meta_key(), records_[i].request());
+                meta_count++;
+            }
+        }
+        LOG(INFO) << "load " << meta_count << " meta";
+        transport_ = new StubAgentTransport();
+        resman_.reset(new baidu::galaxy::ResManImpl(store, transport_));
+        return resman_->Init();
+    }
+
+    void Run() {
+        int64_t begin = 0;
+        int64_t replay_begin = baidu::common::timer::get_micros();
+        for (size_t i = 0; i < records_.size(); i++) {
+            const proto::RpcRecord& record = records_[i];
+            if (record.has_meta_key()) {
+                continue;
+            }
+            if (begin == 0) {
+                begin = record.time();
+            }
+            if (FLAGS_replay_speed > 0) {
+                int64_t due = replay_begin + (record.time() - begin) / FLAGS_replay_speed;
+                int64_t now = baidu::common::timer::get_micros();
+                if (due > now) {
+                    usleep(due - now);
+                }
+            }
+            pool_.AddTask(boost::bind(&Replayer::Handle, this, &record));
+        }
+        pool_.Stop(true);
+        LOG(INFO) << "replay done in "
+                  << (baidu::common::timer::get_micros() - replay_begin) / 1000 << " ms";
+    }
+
+    void Report() {
+        printf("%-40s %10s %12s %12s %12s\n", "method", "count", "avg(us)", "p99(us)", "max(us)");
+        std::map<std::string, MethodStat>::iterator it;
+        for (it = stats_.begin(); it != stats_.end(); it++) {
+            MethodStat& stat = it->second;
+            std::sort(stat.latency.begin(), stat.latency.end());
+            int64_t p99 = stat.latency[stat.latency.size() * 99 / 100];
+            printf("%-40s %10ld %12ld %12ld %12ld\n", it->first.c_str(),
+                   stat.count, stat.total / stat.count, p99, stat.latency.back());
+        }
+        printf("agent query results never asked for: %ld\n", transport_->Unmatched());
+    }
+
+private:
+    struct Call {
+        Replayer* replayer;
+        std::string method;
+        google::protobuf::Message* request;
+        google::protobuf::Message* response;
+        int64_t start;
+    };
+
+    void Handle(const proto::RpcRecord* record) {
+        const google::protobuf::MethodDescriptor* method =
+            google::protobuf::DescriptorPool::generated_pool()->FindMethodByName(record->method());
+        if (method == NULL || method->service() != proto::ResMan::descriptor()) {
+            int64_t start = baidu::common::timer::get_micros();
+            transport_->Deliver(*record);
+            Account(ShortName(record->method()), baidu::common::timer::get_micros() - start);
+            return;
+        }
+        Call* call = new Call();
+        call->replayer = this;
+        call->method = ShortName(method->full_name());
+        call->request = resman_->GetRequestPrototype(method).New();
+        call->response = resman_->GetResponsePrototype(method).New();
+        if (!call->request->ParseFromString(record->request())) {
+            LOG(WARNING) << "broken request of " << record->method();
+        }
+        call->start = baidu::common::timer::get_micros();
+        resman_->CallMethod(method, NULL, call->request, call->response,
+                            google::protobuf::NewCallback(&Replayer::Done, call));
+    }
+
+    // service.method without the package
+    static std::string ShortName(const std::string& full_name) {
+        std::string::size_type pos = full_name.rfind('.');
+        if (pos == std::string::npos || pos == 0) {
+            return full_name;
+        }
+        pos = full_name.rfind('.', pos - 1);
+        return pos == std::string::npos ? full_name : full_name.substr(pos + 1);
+    }
+
+    static void Done(Call* call) {
+        call->replayer->Account(call->method, baidu::common::timer::get_micros() - call->start);
+        delete call->request;
+        delete call->response;
+        delete call;
+    }
+
+    void Account(const std::string& method, int64_t latency) {
+        baidu::common::MutexLock lock(&mu_);
+        MethodStat& stat = stats_[method];
+        stat.count++;
+        stat.total += latency;
+        stat.latency.push_back(latency);
+    }
+
+    std::vector<proto::RpcRecord> records_;
+    StubAgentTransport* transport_;
+    boost::scoped_ptr<baidu::galaxy::ResManImpl> resman_;
+    baidu::common::ThreadPool pool_;
+    baidu::common::Mutex mu_;
+    std::map<std::string, MethodStat> stats_;
+};
+
+int main(int argc, char** argv) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+    // the recorded rpc were admitted already, at any replay speed
+    FLAGS_user_read_rate = 0;
+    FLAGS_user_mutate_rate = 0;
+    // reservations are timed by resman, not by the record
+    FLAGS_agent_reservation = false;
+    Replayer replayer;
+    if (!replayer.Load(FLAGS_replay_file)) {
+        fprintf(stderr, "no record to replay in %s\n", FLAGS_replay_file.c_str());
+        return -1;
+    }
+    if (!replayer.Start()) {
+        fprintf(stderr, "fail to init resman\n");
+        return -1;
+    }
+    replayer.Run();
+    replayer.Report();
+    return 0;
+}
@@ -0,0 +1,522 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// offline scheduler simulator: drives sched::Scheduler in-process with fake
+// agents and a replayable trace, no resman rpc or nexus involved.
+//
+// trace format, one event per line, time in milliseconds of virtual time:
+//   <time> agents <count> <millicore> <memory> <disk> <pool>
+//   <time> create <name> <replica> <priority> <millicore> <memory> <disk> <pool>
+//   <time> update <name> <millicore> <memory>
+//   <time> scale <name> <replica>
+//   <time> remove <name>
+//   <time> fail <agent_index>
+//   <time> recover <agent_index>
+//   <time> preempt <name> <agent_index>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include "resman/scheduler.h"
+#include "timer.h"
+
+DEFINE_string(sim_trace, "", "trace file to replay, a synthetic trace is generated if empty");
+DEFINE_string(sim_dump_trace, "", "write the replayed trace to this file");
+DEFINE_string(sim_mode, "batch", "scheduling mode: batch or agent");
+DEFINE_int32(sim_agents, 2000, "agents of the synthetic trace");
+DEFINE_int32(sim_groups, 1000, "container groups of the synthetic trace");
+DEFINE_int32(sim_max_replica, 50, "max replica of one container group in the synthetic trace");
+DEFINE_int32(sim_duration, 600, "seconds over which synthetic events are spread");
+DEFINE_int32(sim_drain, 120, "seconds simulated after the last event");
+DEFINE_int32(sim_seed, 1, "random seed of the synthetic trace");
+
+DECLARE_int64(sched_interval);
+DECLARE_int64(batch_sched_interval);
+DECLARE_int32(agent_query_interval);
+
+namespace sched = baidu::galaxy::sched;
+namespace proto = baidu::galaxy::proto;
+
+const int64_t kGB = 1024L * 1024 * 1024;
+
+struct Event {
+    int64_t time;
+    std::string line;
+    bool operator < (const Event& b) const {
+        return time < b.time;
+    }
+};
+
+struct FakeAgent {
+    std::string endpoint;
+    int64_t millicore;
+    int64_t memory;
+    int64_t disk;
+    std::string pool;
+    bool alive;
+    std::map<std::string, proto::ContainerInfo> containers;
+};
+
+class Simulator {
+public:
+    Simulator() : now_(0), event_time_(0), passes_(0), pass_cost_(0),
+                  preempt_calls_(0), preempt_succ_(0), preempt_victims_(0),
+                  ref_millicore_(0), ref_memory_(0) {}
+    bool Load(const std::string& path);
+    void Generate();
+    void Dump(const std::string& path);
+    void Run();
+    void Report();
+private:
+    void Apply(const std::string& line);
+    void AddAgent(FakeAgent& agent);
+    void QueryAgents();
+    void SchedulePass();
+    void CheckPlaced();
+    void MarkPending(const std::string& group_id, int replica);
+    proto::ContainerDescription MakeDesc(int priority, int64_t millicore,
+                                         int64_t memory, int64_t disk,
+                                         const std::string& pool);
+
+    sched::Scheduler scheduler_;
+    std::vector<Event> events_;
+    std::vector<FakeAgent> agents_;
+    std::map<std::string, std::string> group_ids_; // name -> group id
+    std::map<std::string, proto::ContainerDescription> descs_;
+    std::map<std::string, int> priorities_; // group id -> priority
+    std::map<std::string, std::map<std::string, int64_t> > pending_since_;
+    std::vector<int64_t> latencies_;
+    size_t next_agent_;
+    int64_t now_;
+    int64_t event_time_;
+    int64_t passes_;
+    int64_t pass_cost_;
+    int64_t preempt_calls_;
+    int64_t preempt_succ_;
+    int64_t preempt_victims_;
+    int64_t ref_millicore_;
+    int64_t ref_memory_;
+};
+
+bool Simulator::Load(const std::string& path) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        LOG(WARNING) << "fail to open trace: " << path;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::stringstream ss(line);
+        Event ev;
+        ss >> ev.time;
+        std::getline(ss, ev.line);
+        events_.push_back(ev);
+    }
+    std::stable_sort(events_.begin(), events_.end());
+    return true;
+}
+
+void Simulator::Generate() {
+    srand(FLAGS_sim_seed);
+    int64_t duration = FLAGS_sim_duration * 1000L;
+    std::stringstream ss;
+    Event ev;
+    ev.time = 0;
+    ss << " agents " << FLAGS_sim_agents << " " << 32000 << " " << 64 * kGB
+       << " " << 2000 * kGB << " main";
+    ev.line = ss.str();
+    events_.push_back(ev);
+    const int64_t millicores[] = {500, 1000, 2000, 4000, 8000};
+    const int64_t memories[] = {1, 2, 4, 8, 16};
+    const int priorities[] = {proto::kJobMonitor, proto::kJobService, proto::kJobService,
+                              proto::kJobBatch, proto::kJobBestEffort};
+    for (int i = 0; i < FLAGS_sim_groups; i++) {
+        std::stringstream name;
+        name << "group_" << i;
+        int64_t submit = duration * i / FLAGS_sim_groups;
+        std::stringstream line;
+        line << " create " << name.str() << " " << 1 + rand() % FLAGS_sim_max_replica
+             << " " << priorities[rand() % 5] << " " << millicores[rand() % 5]
+             << " " << memories[rand() % 5] * kGB << " " << (10 + rand() % 100) * kGB << " main";
+        ev.time = submit;
+        ev.line = line.str();
+        events_.push_back(ev);
+        int dice = rand() % 10;
+        int64_t later = submit + rand() % (duration / 4 + 1);
+        std::stringstream follow;
+        if (dice == 0) {
+            follow << " remove " << name.str();
+        } else if (dice == 1) {
+            follow << " update " << name.str() << " " << millicores[rand() % 5]
+                   << " " << memories[rand() % 5] * kGB;
+        } else if (dice == 2) {
+            follow << " scale " << name.str() << " " << 1 + rand() % FLAGS_sim_max_replica;
+        } else if (dice == 3) {
+            follow << " preempt " << name.str() << " " << rand() % FLAGS_sim_agents;
+        } else {
+            continue;
+        }
+        ev.time = later;
+        ev.line = follow.str();
+        events_.push_back(ev);
+    }
+    for (int i = 0; i < FLAGS_sim_agents / 100; i++) {
+        int agent_index = rand() % FLAGS_sim_agents;
+        int64_t fail_time = rand() % duration;
+        std::stringstream fail;
+        fail << " fail " << agent_index;
+        ev.time = fail_time;
+        ev.line = fail.str();
+        events_.push_back(ev);
+        std::stringstream recover;
+        recover << " recover " << agent_index;
+        ev.time = fail_time + 30000 + rand() % 60000;
+        ev.line = recover.str();
+        events_.push_back(ev);
+    }
+    std::stable_sort(events_.begin(), events_.end());
+}
+
+void Simulator::Dump(const std::string& path) {
+    std::ofstream out(path.c_str());
+    for (size_t i = 0; i < events_.size(); i++) {
+        out << events_[i].time << events_[i].line << "\n";
+    }
+}
+
+proto::ContainerDescription Simulator::MakeDesc(int priority, int64_t millicore,
+                                                int64_t memory, int64_t disk,
+                                                const std::string& pool) {
+    proto::ContainerDescription desc;
+    desc.set_priority(priority);
+    desc.add_pool_names(pool);
+    desc.mutable_workspace_volum()->set_medium(proto::kDisk);
+    desc.mutable_workspace_volum()->set_size(disk);
+    desc.mutable_workspace_volum()->set_dest_path("/home/work");
+    proto::Cgroup* cgroup = desc.add_cgroups();
+    cgroup->mutable_cpu()->set_milli_core(millicore);
+    cgroup->mutable_memory()->set_size(memory);
+    return desc;
+}
+
+void Simulator::AddAgent(FakeAgent& agent) {
+    std::map<sched::DevicePath, sched::VolumInfo> volums;
+    sched::VolumInfo& home = volums["/home"];
+    home.medium = proto::kDisk;
+    home.size = agent.disk;
+    std::set<std::string> tags;
+    sched::Agent::Ptr sched_agent(new sched::Agent(agent.endpoint, agent.millicore,
+                                                   agent.memory, volums, tags, agent.pool));
+    proto::AgentInfo agent_info;
+    scheduler_.AddAgent(sched_agent, agent_info);
+    agent.alive = true;
+}
+
+void Simulator::MarkPending(const std::string& group_id, int replica) {
+    std::vector<proto::ContainerStatistics> containers;
+    scheduler_.ShowContainerGroup(group_id, containers);
+    for (size_t i = 0; i < containers.size() && (int)i < replica * 2; i++) {
+        if (containers[i].status() == proto::kContainerPending
+            && pending_since_[group_id].find(containers[i].id()) == pending_since_[group_id].end()) {
+            pending_since_[group_id][containers[i].id()] = event_time_;
+        }
+    }
+}
+
+void Simulator::Apply(const std::string& line) {
+    std::stringstream ss(line);
+    std::string action;
+    ss >> action;
+    if (action == "agents") {
+        int count = 0;
+        FakeAgent agent;
+        ss >> count >> agent.millicore >> agent.memory >> agent.disk >> agent.pool;
+        for (int i = 0; i < count; i++) {
+            std::stringstream endpoint;
+            endpoint << "sim_agent_" << agents_.size() << ":8221";
+            agent.endpoint = endpoint.str();
+            agents_.push_back(agent);
+            AddAgent(agents_.back());
+        }
+    } else if (action == "create") {
+        std::string name, pool;
+        int replica = 0, priority = 0;
+        int64_t millicore = 0, memory = 0, disk = 0;
+        ss >> name >> replica >> priority >> millicore >> memory >> disk >> pool;
+        proto::ContainerDescription desc = MakeDesc(priority, millicore, memory, disk, pool);
+        std::string group_id = scheduler_.Submit(name, desc, replica, priority, "sim");
+        if (group_id.empty()) {
+            LOG(WARNING) << "fail to submit: " << name;
+            return;
+        }
+        group_ids_[name] = group_id;
+        descs_[name] = desc;
+        priorities_[group_id] = priority;
+        ref_millicore_ = std::max(ref_millicore_, millicore);
+        ref_memory_ = std::max(ref_memory_, memory);
+        MarkPending(group_id, replica);
+    } else if (action == "update") {
+        std::string name;
+        int64_t millicore = 0, memory = 0;
+        ss >> name >> millicore >> memory;
+        if (group_ids_.find(name) == group_ids_.end()) {
+            return;
+        }
+        proto::ContainerDescription& desc = descs_[name];
+        desc.mutable_cgroups(0)->mutable_cpu()->set_milli_core(millicore);
+        desc.mutable_cgroups(0)->mutable_memory()->set_size(memory);
+        std::string new_version;
+        if (scheduler_.Update(group_ids_[name], desc, 0, new_version)) {
+            desc.set_version(new_version);
+        }
+    } else if (action == "scale") {
+        std::string name;
+        int replica = 0;
+        ss >> name >> replica;
+        if (group_ids_.find(name) == group_ids_.end()) {
+            return;
+        }
+        scheduler_.ChangeReplica(group_ids_[name], replica);
+        MarkPending(group_ids_[name], replica);
+    } else if (action == "remove") {
+        std::string name;
+        ss >> name;
+        if (group_ids_.find(name) == group_ids_.end()) {
+            return;
+        }
+        scheduler_.Kill(group_ids_[name]);
+        pending_since_.erase(group_ids_[name]);
+        group_ids_.erase(name);
+    } else if (action == "fail" || action == "recover") {
+        size_t agent_index = 0;
+        ss >> agent_index;
+        if (agent_index >= agents_.size()) {
+            return;
+        }
+        FakeAgent& agent = agents_[agent_index];
+        if (action == "fail" && agent.alive) {
+            std::map<std::string, proto::ContainerInfo>::iterator it;
+            for (it = agent.containers.begin(); it != agent.containers.end(); it++) {
+                pending_since_[it->second.group_id()][it->first] = event_time_;
+            }
+            agent.containers.clear();
+            agent.alive = false;
+            scheduler_.RemoveAgent(agent.endpoint);
+        } else if (action == "recover" && !agent.alive) {
+            AddAgent(agent);
+        }
+    } else if (action == "preempt") {
+        std::string name;
+        size_t agent_index = 0;
+        ss >> name >> agent_index;
+        if (group_ids_.find(name) == group_ids_.end() || agent_index >= agents_.size()) {
+            return;
+        }
+        const std::string& endpoint = agents_[agent_index].endpoint;
+        std::vector<proto::ContainerStatistics> before;
+        std::vector<proto::ContainerStatistics> after;
+        scheduler_.ShowAgent(endpoint, before);
+        std::string fail_reason;
+        preempt_calls_++;
+        if (scheduler_.ManualSchedule(endpoint, group_ids_[name], fail_reason)) {
+            preempt_succ_++;
+        }
+        scheduler_.ShowAgent(endpoint, after);
+        std::set<std::string> remain;
+        for (size_t i = 0; i < after.size(); i++) {
+            remain.insert(after[i].id());
+        }
+        for (size_t i = 0; i < before.size(); i++) {
+            if (remain.find(before[i].id()) == remain.end()) {
+                preempt_victims_++;
+            }
+        }
+    } else {
+        LOG(WARNING) << "unknown event: " << line;
+    }
+}
+
+void Simulator::QueryAgents() {
+    for (size_t i = 0; i < agents_.size(); i++) {
+        FakeAgent& agent = agents_[i];
+        if (!agent.alive) {
+            continue;
+        }
+        proto::AgentInfo agent_info;
+        std::map<std::string, proto::ContainerInfo>::iterator it;
+        for (it = agent.containers.begin(); it != agent.containers.end(); it++) {
+            agent_info.add_container_info()->CopyFrom(it->second);
+        }
+        std::vector<sched::AgentCommand> commands;
+        scheduler_.MakeCommand(agent.endpoint, agent_info, commands);
+        for (size_t j = 0; j < commands.size(); j++) {
+            const sched::AgentCommand& cmd = commands[j];
+            if (cmd.action == sched::kCreateContainer) {
+                proto::ContainerInfo& info = agent.containers[cmd.container_id];
+                info.set_id(cmd.container_id);
+                info.set_group_id(cmd.container_group_id);
+                info.set_status(proto::kContainerReady);
+                info.mutable_container_desc()->CopyFrom(cmd.desc);
+            } else {
+                agent.containers.erase(cmd.container_id);
+            }
+        }
+    }
+}
+
+void Simulator::SchedulePass() {
+    int64_t start = baidu::common::timer::get_micros();
+    if (FLAGS_sim_mode == "agent") {
+        if (!agents_.empty()) {
+            next_agent_ = next_agent_ % agents_.size();
+            if (next_agent_ == 0) {
+                scheduler_.ScheduleGangs();
+            }
+            if (agents_[next_agent_].alive) {
+                scheduler_.ScheduleAgent(agents_[next_agent_].endpoint);
+            }
+            next_agent_++;
+        }
+    } else {
+        scheduler_.ScheduleBatch();
+    }
+    pass_cost_ += baidu::common::timer::get_micros() - start;
+    passes_++;
+}
+
+void Simulator::CheckPlaced() {
+    std::map<std::string, std::map<std::string, int64_t> >::iterator it;
+    for (it = pending_since_.begin(); it != pending_since_.end();) {
+        std::map<std::string, int64_t>& pendings = it->second;
+        if (pendings.empty()) {
+            pending_since_.erase(it++);
+            continue;
+        }
+        std::vector<proto::ContainerStatistics> containers;
+        scheduler_.ShowContainerGroup(it->first, containers);
+        for (size_t i = 0; i < containers.size(); i++) {
+            const proto::ContainerStatistics& container = containers[i];
+            std::map<std::string, int64_t>::iterator jt = pendings.find(container.id());
+            if (jt == pendings.end()) {
+                continue;
+            }
+            if (container.status() == proto::kContainerAllocating
+                || container.status() == proto::kContainerReady) {
+                latencies_.push_back(now_ - jt->second);
+                pendings.erase(jt);
+            } else if (container.status() != proto::kContainerPending) {
+                pendings.erase(jt);
+            }
+        }
+        it++;
+    }
+}
+
+void Simulator::Run() {
+    next_agent_ = 0;
+    int64_t step = (FLAGS_sim_mode == "agent") ? FLAGS_sched_interval : FLAGS_batch_sched_interval;
+    int64_t query_interval = FLAGS_agent_query_interval * 1000L;
+    int64_t end_time = (events_.empty() ? 0 : events_.back().time) + FLAGS_sim_drain * 1000L;
+    scheduler_.Start(false);
+    size_t ev_idx = 0;
+    int64_t next_query = 0;
+    for (now_ = 0; now_ <= end_time; now_ += step) {
+        while (ev_idx < events_.size() && events_[ev_idx].time <= now_) {
+            event_time_ = events_[ev_idx].time;
+            Apply(events_[ev_idx].line);
+            ev_idx++;
+        }
+        SchedulePass();
+        CheckPlaced();
+        if (now_ >= next_query) {
+            QueryAgents();
+            next_query = now_ + query_interval;
+        }
+    }
+    scheduler_.Stop();
+}
+
+void Simulator::Report() {
+    int64_t unplaced = 0;
+    std::map<std::string, std::map<std::string, int64_t> >::iterator it;
+    for (it = pending_since_.begin(); it != pending_since_.end(); it++) {
+        unplaced += it->second.size();
+    }
+    std::sort(latencies_.begin(), latencies_.end());
+    printf("mode: %s, agents: %lu, events: %lu, virtual time: %ld s\n",
+           FLAGS_sim_mode.c_str(), agents_.size(), events_.size(), now_ / 1000);
+    printf("placed: %lu, still pending: %ld\n", latencies_.size(), unplaced);
+    if (!latencies_.empty()) {
+        size_t n = latencies_.size();
+        printf("placement latency (ms): p50 %ld, p90 %ld, p99 %ld, max %ld\n",
+               latencies_[n * 50 / 100], latencies_[n * 90 / 100],
+               latencies_[n * 99 / 100], latencies_[n - 1]);
+    }
+    printf("scheduling passes: %ld, %.1f passes/s (wall), %.1f us/pass\n",
+           passes_, pass_cost_ > 0 ? passes_ * 1000000.0 / pass_cost_ : 0.0,
+           passes_ > 0 ? (double)pass_cost_ / passes_ : 0.0);
+    printf("preemption: %ld calls, %ld succeeded, %ld victims\n",
+           preempt_calls_, preempt_succ_, preempt_victims_);
+
+    // free memory on agents which can not hold the largest container of the trace
+    int64_t free_memory = 0;
+    int64_t stranded_memory = 0;
+    for (size_t i = 0; i < agents_.size(); i++) {
+        const FakeAgent& agent = agents_[i];
+        if (!agent.alive) {
+            continue;
+        }
+        std::vector<proto::ContainerStatistics> containers;
+        scheduler_.ShowAgent(agent.endpoint, containers);
+        int64_t cpu_free = agent.millicore;
+        int64_t memory_free = agent.memory;
+        for (size_t j = 0; j < containers.size(); j++) {
+            const std::string& container_id = containers[j].id();
+            std::string group_id = container_id.substr(0, container_id.rfind("."));
+            if (priorities_[group_id] == proto::kJobBestEffort) {
+                continue;
+            }
+            cpu_free -= containers[j].cpu().assigned();
+            memory_free -= containers[j].memory().assigned();
+        }
+        free_memory += memory_free;
+        if (cpu_free < ref_millicore_ || memory_free < ref_memory_) {
+            stranded_memory += memory_free;
+        }
+    }
+    printf("fragmentation: %.2f%% of %ld GB free memory can not hold %ld millicore/%ld GB\n",
+           free_memory > 0 ? stranded_memory * 100.0 / free_memory : 0.0,
+           free_memory / kGB, ref_millicore_, ref_memory_ / kGB);
+}
+
+int main(int argc, char** argv) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+    Simulator simulator;
+    if (!FLAGS_sim_trace.empty()) {
+        if (!simulator.Load(FLAGS_sim_trace)) {
+            return -1;
+        }
+    } else {
+        simulator.Generate();
+    }
+    if (!FLAGS_sim_dump_trace.empty()) {
+        simulator.Dump(FLAGS_sim_dump_trace);
+    }
+    simulator.Run();
+    simulator.Report();
+    return 0;
+}
@@ -0,0 +1,196 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "meta_codec.h"
+
+#include <stdio.h>
+#include <snappy.h>
+
+namespace baidu {
+namespace galaxy {
+
+const uint8_t MetaCodec::kSchemaVersion;
+const uint8_t MetaCodec::kMetaCompressed;
+
+static const size_t kHeaderSize = 3;
+
+void MetaCodec::Encode(const std::string& payload,
+                       int64_t compress_min_size,
+                       std::string* record) {
+    uint8_t flags = 0;
+    std::string compressed;
+    if (compress_min_size >= 0
+        && payload.size() >= static_cast<size_t>(compress_min_size)) {
+        snappy::Compress(payload.data(), payload.size(), &compressed);
+        if (compressed.size() < payload.size()) {
+            flags |= kMetaCompressed;
+        }
+    }
+    record->clear();
+    record->push_back('\0');
+    record->push_back(static_cast<char>(kSchemaVersion));
+    record->push_back(static_cast<char>(flags));
+    if (flags & kMetaCompressed) {
+        record->append(compressed);
+    } else {
+        record->append(payload);
+    }
+}
+
+bool MetaCodec::IsEncoded(const std::string& record) {
+    return record.size() >= kHeaderSize && record[0] == '\0';
+}
+
+bool MetaCodec::Decode(const std::string& record, std::string* payload) {
+    if (!IsEncoded(record)) {
+        // written before the encoding
+        *payload = record;
+        return true;
+    }
+    uint8_t version = static_cast<uint8_t>(record[1]);
+    uint8_t flags = static_cast<uint8_t>(record[2]);
+    if (version > kSchemaVersion) {
+        return false;
+    }
+    const char* data = record.data() + kHeaderSize;
+    size_t size = record.size() - kHeaderSize;
+    if (flags & kMetaCompressed) {
+        return snappy::Uncompress(data, size, payload);
+    }
+    payload->assign(data, size);
+    return true;
+}
+
+static const uint32_t kSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t RotateRight(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void Sha256Block(const uint8_t* block, uint32_t* h) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (static_cast<uint32_t>(block[i * 4]) << 24)
+               | (static_cast<uint32_t>(block[i * 4 + 1]) << 16)
+               | (static_cast<uint32_t>(block[i * 4 + 2]) << 8)
+               | static_cast<uint32_t>(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+    uint32_t e = h[4], f = h[5], g = h[6], k = h[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = k + s1 + ch + kSha256K[i] + w[i];
+        uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+        k = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+std::string MetaCodec::Digest(const std::string& data) {
+    // sha-256, the descriptions of different records are never mixed up
+    // by a collision, as they are shared by digest without comparing them
+    uint32_t h[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    size_t full_blocks = data.size() / 64;
+    for (size_t i = 0; i < full_blocks; i++) {
+        Sha256Block(bytes + i * 64, h);
+    }
+    // the tail, 0x80 and the length in bits, in one or two blocks
+    uint8_t tail[128] = {0};
+    size_t rest = data.size() - full_blocks * 64;
+    for (size_t i = 0; i < rest; i++) {
+        tail[i] = bytes[full_blocks * 64 + i];
+    }
+    tail[rest] = 0x80;
+    size_t tail_size = rest + 1 + 8 <= 64 ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tail_size - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+    }
+    for (size_t i = 0; i < tail_size; i += 64) {
+        Sha256Block(tail + i, h);
+    }
+    char buf[65];
+    for (int i = 0; i < 8; i++) {
+        snprintf(buf + i * 8, sizeof(buf) - i * 8, "%08x", h[i]);
+    }
+    return std::string(buf, 64);
+}
+
+std::string MetaCodec::DescPrefix(const std::string& record_prefix) {
+    return record_prefix + "_desc";
+}
+
+void DescRefs::Assign(const std::string& key,
+                      const std::set<std::string>& digests,
+                      std::vector<std::string>* added,
+                      std::vector<std::string>* released) {
+    std::set<std::string> old_digests;
+    std::map<std::string, std::set<std::string> >::iterator it = digests_.find(key);
+    if (it != digests_.end()) {
+        old_digests.swap(it->second);
+        digests_.erase(it);
+    }
+    std::set<std::string>::const_iterator digest_it;
+    for (digest_it = digests.begin(); digest_it != digests.end(); digest_it++) {
+        if (refs_[*digest_it]++ == 0 && added != NULL) {
+            added->push_back(*digest_it);
+        }
+    }
+    for (digest_it = old_digests.begin(); digest_it != old_digests.end(); digest_it++) {
+        if (--refs_[*digest_it] == 0) {
+            refs_.erase(*digest_it);
+            if (released != NULL) {
+                released->push_back(*digest_it);
+            }
+        }
+    }
+    if (!digests.empty()) {
+        digests_[key] = digests;
+    }
+}
+
+void DescRefs::Get(const std::string& key, std::set<std::string>* digests) const {
+    digests->clear();
+    std::map<std::string, std::set<std::string> >::const_iterator it = digests_.find(key);
+    if (it != digests_.end()) {
+        *digests = it->second;
+    }
+}
+
+int64_t DescRefs::Count(const std::string& digest) const {
+    std::map<std::string, int64_t>::const_iterator it = refs_.find(digest);
+    return it == refs_.end() ? 0 : it->second;
+}
+
+}
+}
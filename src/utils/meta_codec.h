@@ -0,0 +1,61 @@
+// Copyright (c) 2016, Baidu.com, Inc. All Rights Reserved
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace baidu {
+namespace galaxy {
+
+// Encoding of the meta records kept on nexus.
+//
+// An encoded record is a zero byte, the schema version, a flags byte and
+// the payload, snappy compressed if kMetaCompressed is set. No serialized
+// protobuf message starts with a zero byte, so records written before the
+// encoding existed are told apart and decoded as they are.
+//
+// Descriptions are content addressed: a record keeps the digest of its
+// description, the description itself is stored once under
+// DescPrefix(record prefix) + "/" + digest and shared by every record
+// with the same content.
+class MetaCodec {
+public:
+    static const uint8_t kSchemaVersion = 1;
+    static const uint8_t kMetaCompressed = 0x1;
+
+    // payloads not shorter than compress_min_size are compressed,
+    // unless compressing does not make them smaller
+    static void Encode(const std::string& payload,
+                       int64_t compress_min_size,
+                       std::string* record);
+    static bool Decode(const std::string& record, std::string* payload);
+    static bool IsEncoded(const std::string& record);
+
+    static std::string Digest(const std::string& data);
+    static std::string DescPrefix(const std::string& record_prefix);
+};
+
+// Which records refer to which descriptions, not thread safe.
+class DescRefs {
+public:
+    // the record at key refers to digests from now on, digests no record
+    // referred to before go to added, those no record refers to any more
+    // go to released
+    void Assign(const std::string& key,
+                const std::set<std::string>& digests,
+                std::vector<std::string>* added,
+                std::vector<std::string>* released);
+    void Get(const std::string& key, std::set<std::string>* digests) const;
+    int64_t Count(const std::string& digest) const;
+private:
+    std::map<std::string, std::set<std::string> > digests_;
+    std::map<std::string, int64_t> refs_;
+};
+
+}
+}